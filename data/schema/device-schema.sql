@@ -64,7 +64,12 @@ CREATE TABLE device_%deviceid_songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
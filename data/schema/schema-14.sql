@@ -0,0 +1,7 @@
+CREATE TABLE IF NOT EXISTS subdirectories_journal (
+  directory_id INTEGER NOT NULL,
+  path TEXT NOT NULL,
+  UNIQUE (directory_id, path) ON CONFLICT IGNORE
+);
+
+UPDATE schema_version SET version=14;
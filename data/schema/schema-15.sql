@@ -0,0 +1,9 @@
+ALTER TABLE %allsongstables ADD COLUMN replaygain_track_gain REAL;
+
+ALTER TABLE %allsongstables ADD COLUMN replaygain_track_peak REAL;
+
+ALTER TABLE %allsongstables ADD COLUMN replaygain_album_gain REAL;
+
+ALTER TABLE %allsongstables ADD COLUMN replaygain_album_peak REAL;
+
+UPDATE schema_version SET version=15;
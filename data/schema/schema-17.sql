@@ -0,0 +1,3 @@
+ALTER TABLE songs ADD COLUMN replaygain_failed_mtime INTEGER NOT NULL DEFAULT -1;
+
+UPDATE schema_version SET version=17;
@@ -4,7 +4,7 @@ CREATE TABLE IF NOT EXISTS schema_version (
 
 DELETE FROM schema_version;
 
-INSERT INTO schema_version (version) VALUES (13);
+INSERT INTO schema_version (version) VALUES (17);
 
 CREATE TABLE IF NOT EXISTS directories (
   path TEXT NOT NULL,
@@ -17,6 +17,12 @@ CREATE TABLE IF NOT EXISTS subdirectories (
   mtime INTEGER NOT NULL
 );
 
+CREATE TABLE IF NOT EXISTS subdirectories_journal (
+  directory_id INTEGER NOT NULL,
+  path TEXT NOT NULL,
+  UNIQUE (directory_id, path) ON CONFLICT IGNORE
+);
+
 CREATE TABLE IF NOT EXISTS songs (
 
   title TEXT,
@@ -72,7 +78,14 @@ CREATE TABLE IF NOT EXISTS songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL,
+
+  replaygain_failed_mtime INTEGER NOT NULL DEFAULT -1
 
 );
 
@@ -131,7 +144,12 @@ CREATE TABLE IF NOT EXISTS subsonic_songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
@@ -190,7 +208,12 @@ CREATE TABLE IF NOT EXISTS tidal_artists_songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
@@ -249,7 +272,12 @@ CREATE TABLE IF NOT EXISTS tidal_albums_songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
@@ -308,7 +336,12 @@ CREATE TABLE IF NOT EXISTS tidal_songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
@@ -367,7 +400,12 @@ CREATE TABLE IF NOT EXISTS qobuz_artists_songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
@@ -426,7 +464,12 @@ CREATE TABLE IF NOT EXISTS qobuz_albums_songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
@@ -485,7 +528,12 @@ CREATE TABLE IF NOT EXISTS qobuz_songs (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
@@ -510,6 +558,7 @@ CREATE TABLE IF NOT EXISTS playlist_items (
   type INTEGER NOT NULL DEFAULT 0,
   collection_id INTEGER,
   playlist_url TEXT,
+  position INTEGER NOT NULL DEFAULT 0,
 
   title TEXT,
   album TEXT,
@@ -564,7 +613,12 @@ CREATE TABLE IF NOT EXISTS playlist_items (
 
   cue_path TEXT,
 
-  rating INTEGER DEFAULT -1
+  rating INTEGER DEFAULT -1,
+
+  replaygain_track_gain REAL,
+  replaygain_track_peak REAL,
+  replaygain_album_gain REAL,
+  replaygain_album_peak REAL
 
 );
 
@@ -590,6 +644,8 @@ CREATE INDEX IF NOT EXISTS idx_album ON songs (album);
 
 CREATE INDEX IF NOT EXISTS idx_title ON songs (title);
 
+CREATE INDEX IF NOT EXISTS idx_playlist_items_position ON playlist_items (playlist, position);
+
 CREATE VIEW IF NOT EXISTS duplicated_songs as select artist dup_artist, album dup_album, title dup_title from songs as inner_songs where artist != '' and album != '' and title != '' and unavailable = 0 group by artist, album , title having count(*) > 1;
 
 CREATE VIRTUAL TABLE IF NOT EXISTS songs_fts USING fts5(
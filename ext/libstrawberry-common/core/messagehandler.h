@@ -102,6 +102,9 @@ public:
   // Sets the "id" field of reply to the same as the request, and sends the reply on the socket.  Used on the worker side.
   void SendReply(const MessageType &request, MessageType *reply);
 
+  // Returns the number of requests that haven't got a reply yet.  Must be called from my thread.
+  int pending_reply_count() const { return pending_replies_.count(); }
+
 protected:
   // Called when a message is received from the socket.
   virtual void MessageArrived(const MessageType &message) { Q_UNUSED(message); }
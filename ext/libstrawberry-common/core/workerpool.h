@@ -25,6 +25,8 @@
 #include <QCoreApplication>
 #include <QThread>
 #include <QMutex>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <QLocalServer>
 #include <QProcess>
 #include <QFile>
@@ -57,6 +59,8 @@ protected slots:
   virtual void NewConnection() {}
   virtual void ProcessError(QProcess::ProcessError) {}
   virtual void SendQueuedMessages() {}
+  virtual void StopIdleWorkers() {}
+  virtual void ReplyFinished() {}
 };
 
 
@@ -64,6 +68,8 @@ protected slots:
 // A local socket server is started for each process, and the address is passed to the process as argv[1].
 // The process is expected to connect back to the socket server, and when it does a HandlerType is created for it.
 // Instances of HandlerType are created in the WorkerPool's thread.
+// The pool starts with the minimum number of workers. When messages are waiting in the queue because all workers are busy, another worker is started,
+// up to the maximum number of workers. Workers above the minimum are stopped again when they have been idle for a while.
 template <typename HandlerType>
 class WorkerPool : public _WorkerPoolBase {
  public:
@@ -77,9 +83,19 @@ class WorkerPool : public _WorkerPoolBase {
   // You must call this before calling Start().
   void SetExecutableName(const QString &executable_name);
 
-  // Sets the number of worker process to use.  Defaults to 1 <= (processors / 2) <= 2.
+  // Sets the number of worker process to use.  Defaults to 1 <= (processors / 2) <= 4.
   void SetWorkerCount(int count);
 
+  // Sets the minimum and maximum number of worker processes to use.
+  void SetWorkerCount(const int min_count, const int max_count);
+
+  // Sets how many messages can be sent to one worker before it has replied, so messages are pipelined instead of sent one at a time.
+  // The remaining messages wait in the queue until a worker has room for them.  0 means no limit, which is the default.
+  void SetMaxMessagesPerWorker(const int count);
+
+  // Sets how long a worker above the minimum number of workers can be idle before it is stopped.
+  void SetIdleTimeout(const int msec);
+
   // Sets the prefix to use for the local server (on unix this is a named pipe in /tmp).
   // Defaults to QApplication::applicationName().
   // A random number is appended to this name when creating each server.
@@ -99,19 +115,26 @@ protected:
   void NewConnection() override;
   void ProcessError(QProcess::ProcessError error) override;
   void SendQueuedMessages() override;
+  void StopIdleWorkers() override;
+  void ReplyFinished() override;
 
 private:
   struct Worker {
-    Worker() : local_server_(nullptr), local_socket_(nullptr), process_(nullptr), handler_(nullptr) {}
+    Worker() : local_server_(nullptr), local_socket_(nullptr), process_(nullptr), handler_(nullptr), idle_since_(-1) {}
 
     QLocalServer *local_server_;
     QLocalSocket *local_socket_;
     QProcess *process_;
     HandlerType *handler_;
+    qint64 idle_since_;
   };
 
   // Must only ever be called on my thread.
   void StartOneWorker(Worker *worker);
+  void StopOneWorker(Worker *worker);
+
+  // Returns true if a worker was started but hasn't connected back yet.  Must be called from my thread.
+  bool HasStartingWorker() const;
 
   template <typename T>
   Worker *FindWorker(T Worker::*member, T value) {
@@ -143,10 +166,16 @@ private:
   QString executable_name_;
   QString executable_path_;
 
-  int worker_count_;
+  int min_worker_count_;
+  int max_worker_count_;
+  int max_messages_per_worker_;
+  int idle_timeout_;
   mutable int next_worker_;
   QList<Worker> workers_;
 
+  QTimer *idle_timer_;
+  QElapsedTimer elapsed_timer_;
+
   QAtomicInt next_id_;
 
   QMutex message_queue_mutex_;
@@ -157,10 +186,14 @@ private:
 template <typename HandlerType>
 WorkerPool<HandlerType>::WorkerPool(QObject *parent)
   : _WorkerPoolBase(parent),
+    max_messages_per_worker_(0),
+    idle_timeout_(60000),
     next_worker_(0),
+    idle_timer_(nullptr),
     next_id_(0) {
 
-  worker_count_ = qBound(1, QThread::idealThreadCount() / 2, 4);
+  min_worker_count_ = qBound(1, QThread::idealThreadCount() / 2, 4);
+  max_worker_count_ = min_worker_count_;
   local_server_name_ = qApp->applicationName().toLower();
 
   if (local_server_name_.isEmpty())
@@ -197,8 +230,26 @@ WorkerPool<HandlerType>::~WorkerPool() {
 
 template <typename HandlerType>
 void WorkerPool<HandlerType>::SetWorkerCount(int count) {
+  SetWorkerCount(count, count);
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::SetWorkerCount(const int min_count, const int max_count) {
   Q_ASSERT(workers_.isEmpty());
-  worker_count_ = count;
+  min_worker_count_ = qMax(1, min_count);
+  max_worker_count_ = qMax(min_worker_count_, max_count);
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::SetMaxMessagesPerWorker(const int count) {
+  Q_ASSERT(workers_.isEmpty());
+  max_messages_per_worker_ = qMax(0, count);
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::SetIdleTimeout(const int msec) {
+  Q_ASSERT(workers_.isEmpty());
+  idle_timeout_ = msec;
 }
 
 template <typename HandlerType>
@@ -241,13 +292,22 @@ void WorkerPool<HandlerType>::DoStart() {
     }
   }
 
-  // Start all the workers
-  for (int i = 0; i < worker_count_; ++i) {
+  elapsed_timer_.start();
+
+  // Start the minimum number of workers, more are started when needed.
+  for (int i = 0; i < min_worker_count_; ++i) {
     Worker worker;
     StartOneWorker(&worker);
 
     workers_ << worker;
   }
+
+  if (max_worker_count_ > min_worker_count_) {
+    idle_timer_ = new QTimer(this);
+    idle_timer_->setInterval(qMax(1000, idle_timeout_ / 4));
+    connect(idle_timer_, SIGNAL(timeout()), SLOT(StopIdleWorkers()));
+    idle_timer_->start();
+  }
 }
 
 template <typename HandlerType>
@@ -286,6 +346,76 @@ void WorkerPool<HandlerType>::StartOneWorker(Worker *worker) {
   worker->process_->start(executable_path_, QStringList() << worker->local_server_->fullServerName());
 }
 
+template <typename HandlerType>
+void WorkerPool<HandlerType>::StopOneWorker(Worker *worker) {
+  Q_ASSERT(QThread::currentThread() == thread());
+
+  qLog(Debug) << "Stopping idle worker" << worker;
+
+  // Closing the socket makes the worker exit, don't restart it when it does.
+  if (worker->process_) {
+    disconnect(worker->process_, SIGNAL(errorOccurred(QProcess::ProcessError)), this, SLOT(ProcessError(QProcess::ProcessError)));
+    connect(worker->process_, SIGNAL(finished(int, QProcess::ExitStatus)), worker->process_, SLOT(deleteLater()));
+    worker->process_ = nullptr;
+  }
+  if (worker->local_socket_) {
+    worker->local_socket_->close();
+  }
+
+  DeleteQObjectPointerLater(&worker->local_server_);
+  DeleteQObjectPointerLater(&worker->local_socket_);
+  DeleteQObjectPointerLater(&worker->handler_);
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::StopIdleWorkers() {
+
+  Q_ASSERT(QThread::currentThread() == thread());
+
+  const qint64 now = elapsed_timer_.elapsed();
+
+  for (int i = workers_.count() - 1; i >= 0 && workers_.count() > min_worker_count_; --i) {
+    Worker &worker = workers_[i];
+    if (!worker.handler_ || worker.handler_->is_device_closed()) continue;
+
+    if (worker.handler_->pending_reply_count() > 0) {
+      worker.idle_since_ = -1;
+      continue;
+    }
+    if (worker.idle_since_ < 0) {
+      worker.idle_since_ = now;
+      continue;
+    }
+    if (now - worker.idle_since_ >= idle_timeout_) {
+      StopOneWorker(&worker);
+      workers_.removeAt(i);
+      next_worker_ = 0;
+    }
+  }
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::ReplyFinished() {
+
+  Q_ASSERT(QThread::currentThread() == thread());
+
+  // Workers are idle from when their last reply arrived, not from when the idle timer first sees them without replies.
+  const qint64 now = elapsed_timer_.elapsed();
+  for (Worker &worker : workers_) {
+    if (worker.handler_ && worker.handler_->pending_reply_count() == 0 && worker.idle_since_ < 0) {
+      worker.idle_since_ = now;
+    }
+  }
+}
+
+template <typename HandlerType>
+bool WorkerPool<HandlerType>::HasStartingWorker() const {
+  for (const Worker &worker : workers_) {
+    if (worker.process_ && !worker.handler_) return true;
+  }
+  return false;
+}
+
 template <typename HandlerType>
 void WorkerPool<HandlerType>::NewConnection() {
 
@@ -382,8 +512,27 @@ void WorkerPool<HandlerType>::SendQueuedMessages() {
       break;
     }
 
+    // When the workers are limited, there might be room for queued messages again once this one is finished.
+    if (max_messages_per_worker_ > 0) {
+      connect(reply, SIGNAL(Finished(bool)), SLOT(SendQueuedMessages()), Qt::QueuedConnection);
+    }
+
+    // The worker is busy again, it can't be stopped as idle until its replies have arrived.
+    if (idle_timer_) {
+      FindWorker(&Worker::handler_, handler)->idle_since_ = -1;
+      connect(reply, SIGNAL(Finished(bool)), SLOT(ReplyFinished()), Qt::QueuedConnection);
+    }
+
     handler->SendRequest(reply);
   }
+
+  // All workers are busy, start another one if we're allowed to.
+  if (!message_queue_.isEmpty() && !workers_.isEmpty() && workers_.count() < max_worker_count_ && !HasStartingWorker()) {
+    qLog(Debug) << "Starting another worker for" << message_queue_.count() << "queued messages";
+    Worker worker;
+    StartOneWorker(&worker);
+    workers_ << worker;
+  }
 }
 
 template <typename HandlerType>
@@ -391,9 +540,10 @@ HandlerType *WorkerPool<HandlerType>::NextHandler() const {
   for (int i = 0; i < workers_.count(); ++i) {
     const int worker_index = (next_worker_ + i) % workers_.count();
 
-    if (workers_[worker_index].handler_ && !workers_[worker_index].handler_->is_device_closed()) {
+    const Worker &worker = workers_[worker_index];
+    if (worker.handler_ && !worker.handler_->is_device_closed() && (max_messages_per_worker_ == 0 || worker.handler_->pending_reply_count() < max_messages_per_worker_)) {
       next_worker_ = (worker_index + 1) % workers_.count();
-      return workers_[worker_index].handler_;
+      return worker.handler_;
     }
   }
 
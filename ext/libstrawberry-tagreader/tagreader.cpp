@@ -79,6 +79,7 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QList>
+#include <QPair>
 #include <QByteArray>
 #include <QDateTime>
 #include <QVariant>
@@ -609,6 +610,86 @@ bool TagReader::SaveFile(const QString &filename, const pb::tagreader::SongMetad
   return ret;
 }
 
+bool TagReader::SaveReplayGain(const QString &filename, const pb::tagreader::SaveReplayGainRequest &replaygain) const {
+
+  if (filename.isEmpty()) return false;
+
+  qLog(Debug) << "Saving ReplayGain to" << filename;
+  std::unique_ptr<TagLib::FileRef> fileref(factory_->GetFileRef(filename));
+  if (!fileref || fileref->isNull()) return false;
+
+  // The field names and value formats are the ones from the ReplayGain 2.0 specification.
+  QList<QPair<QString, QString>> fields;
+  fields << qMakePair(QString("REPLAYGAIN_TRACK_GAIN"), QString("%1 dB").arg(replaygain.track_gain(), 0, 'f', 2));
+  fields << qMakePair(QString("REPLAYGAIN_TRACK_PEAK"), QString::number(replaygain.track_peak(), 'f', 6));
+  if (replaygain.has_album_gain()) {
+    fields << qMakePair(QString("REPLAYGAIN_ALBUM_GAIN"), QString("%1 dB").arg(replaygain.album_gain(), 0, 'f', 2));
+    fields << qMakePair(QString("REPLAYGAIN_ALBUM_PEAK"), QString::number(replaygain.album_peak(), 'f', 6));
+  }
+
+  TagLib::Ogg::XiphComment *vorbis_comments = nullptr;
+  TagLib::APE::Tag *ape_tag = nullptr;
+
+  if (TagLib::FLAC::File *file = dynamic_cast<TagLib::FLAC::File*>(fileref->file())) {
+    vorbis_comments = file->xiphComment(true);
+  }
+  else if (TagLib::WavPack::File *file_wavpack = dynamic_cast<TagLib::WavPack::File*>(fileref->file())) {
+    ape_tag = file_wavpack->APETag(true);
+    if (!ape_tag) return false;
+  }
+  else if (TagLib::APE::File *file_ape = dynamic_cast<TagLib::APE::File*>(fileref->file())) {
+    ape_tag = file_ape->APETag(true);
+    if (!ape_tag) return false;
+  }
+  else if (TagLib::MPC::File *file_mpc = dynamic_cast<TagLib::MPC::File*>(fileref->file())) {
+    ape_tag = file_mpc->APETag(true);
+    if (!ape_tag) return false;
+  }
+  else if (TagLib::MPEG::File *file_mpeg = dynamic_cast<TagLib::MPEG::File*>(fileref->file())) {
+    TagLib::ID3v2::Tag *tag = file_mpeg->ID3v2Tag(true);
+    if (!tag) return false;
+    for (const QPair<QString, QString> &field : fields) {
+      SetUserTextFrame(field.first, field.second, tag);
+    }
+  }
+  else if (TagLib::MP4::File *file_mp4 = dynamic_cast<TagLib::MP4::File*>(fileref->file())) {
+    TagLib::MP4::Tag *tag = file_mp4->tag();
+    if (!tag) return false;
+    for (const QPair<QString, QString> &field : fields) {
+      tag->setItem(QStringToTaglibString("----:com.apple.iTunes:" + field.first.toLower()), TagLib::StringList(QStringToTaglibString(field.second)));
+    }
+  }
+  else {
+    vorbis_comments = dynamic_cast<TagLib::Ogg::XiphComment*>(fileref->file()->tag());
+    if (!vorbis_comments) {
+      qLog(Debug) << "Can't save ReplayGain to" << filename;
+      return false;
+    }
+  }
+
+  if (vorbis_comments) {
+    for (const QPair<QString, QString> &field : fields) {
+      vorbis_comments->addField(QStringToTaglibString(field.first), QStringToTaglibString(field.second), true);
+    }
+  }
+  else if (ape_tag) {
+    for (const QPair<QString, QString> &field : fields) {
+      ape_tag->addValue(QStringToTaglibString(field.first), QStringToTaglibString(field.second), true);
+    }
+  }
+
+  bool ret = fileref->save();
+#ifdef Q_OS_LINUX
+  if (ret) {
+    // Linux: inotify doesn't seem to notice the change to the file unless we change the timestamps as well. (this is what touch does)
+    utimensat(0, QFile::encodeName(filename).constData(), nullptr, 0);
+  }
+#endif  // Q_OS_LINUX
+
+  return ret;
+
+}
+
 void TagReader::SaveAPETag(TagLib::APE::Tag *tag, const pb::tagreader::SongMetadata &song) const {
 
   tag->setItem("album artist", TagLib::APE::Item("album artist", TagLib::StringList(song.albumartist().c_str())));
@@ -56,6 +56,7 @@ class TagReader {
 
   void ReadFile(const QString &filename, pb::tagreader::SongMetadata *song) const;
   bool SaveFile(const QString &filename, const pb::tagreader::SongMetadata &song) const;
+  bool SaveReplayGain(const QString &filename, const pb::tagreader::SaveReplayGainRequest &replaygain) const;
 
   bool IsMediaFile(const QString &filename) const;
   QByteArray LoadEmbeddedArt(const QString &filename) const;
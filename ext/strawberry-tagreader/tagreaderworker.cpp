@@ -38,9 +38,17 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
   if (message.has_read_file_request()) {
     tag_reader_.ReadFile(QStringFromStdString(message.read_file_request().filename()), reply.mutable_read_file_response()->mutable_metadata());
   }
+  else if (message.has_read_files_request()) {
+    for (const std::string &filename : message.read_files_request().filenames()) {
+      tag_reader_.ReadFile(QStringFromStdString(filename), reply.mutable_read_files_response()->add_files()->mutable_metadata());
+    }
+  }
   else if (message.has_save_file_request()) {
     reply.mutable_save_file_response()->set_success(tag_reader_.SaveFile(QStringFromStdString(message.save_file_request().filename()), message.save_file_request().metadata()));
   }
+  else if (message.has_save_replaygain_request()) {
+    reply.mutable_save_replaygain_response()->set_success(tag_reader_.SaveReplayGain(QStringFromStdString(message.save_replaygain_request().filename()), message.save_replaygain_request()));
+  }
 
   else if (message.has_is_media_file_request()) {
     reply.mutable_is_media_file_response()->set_success(tag_reader_.IsMediaFile(QStringFromStdString(message.is_media_file_request().filename())));
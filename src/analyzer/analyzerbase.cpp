@@ -25,13 +25,17 @@
 #include "analyzerbase.h"
 
 #include <algorithm>
+#include <functional>
 #include <cmath>
 #include <cstdint>
 
 #include <QWidget>
-#include <QVector>
 #include <QPainter>
 #include <QPalette>
+#include <QMutex>
+#include <QImage>
+#include <QMetaObject>
+#include <QtConcurrentRun>
 #include <QTimerEvent>
 #include <QtEvents>
 
@@ -62,8 +66,68 @@ Analyzer::Base::Base(QWidget *parent, uint scopeSize)
       fht_(new FHT(scopeSize)),
       engine_(nullptr),
       lastscope_(512),
+      aux_(512),
       new_frame_(false),
-      is_playing_(false) {}
+      is_playing_(false),
+      engine_state_(Engine::Empty),
+      threaded_(false),
+      rendering_(0),
+      render_state_(Engine::Empty) {
+
+  render_pool_.setMaxThreadCount(1);
+  // Keep the render thread around instead of starting a new one for every frame.
+  render_pool_.setExpiryTimeout(-1);
+
+}
+
+Analyzer::Base::~Base() {
+
+  render_pool_.waitForDone();
+  delete fht_;
+
+}
+
+void Analyzer::Base::set_threaded(const bool threaded) {
+
+  if (threaded == threaded_) return;
+
+  render_pool_.waitForDone();
+  threaded_ = threaded;
+  update();
+
+}
+
+void Analyzer::Base::changeTimeout(uint newTimeout) {
+
+  {
+    QMutexLocker l(&render_mutex_);
+    timeout_ = newTimeout;
+    framerateChanged();
+  }
+
+  if (timer_.isActive()) {
+    timer_.stop();
+    timer_.start(timeout_, this);
+  }
+
+}
+
+bool Analyzer::Base::event(QEvent *e) {
+
+  switch (e->type()) {
+    case QEvent::Resize:
+    case QEvent::PaletteChange: {
+      // The analyzers rebuild their buffers here, wait until the render thread is done with them.
+      QMutexLocker l(&render_mutex_);
+      render_size_ = size();
+      render_background_ = palette().color(QPalette::Window);
+      return QWidget::event(e);
+    }
+    default:
+      return QWidget::event(e);
+  }
+
+}
 
 void Analyzer::Base::hideEvent(QHideEvent*) { timer_.stop(); }
 
@@ -71,15 +135,15 @@ void Analyzer::Base::showEvent(QShowEvent*) { timer_.start(timeout(), this); }
 
 void Analyzer::Base::transform(Scope& scope) {
 
-  QVector<float> aux(fht_->size());
-  if (static_cast<long unsigned int>(aux.size()) >= scope.size()) {
-    std::copy(scope.begin(), scope.end(), aux.begin());
+  aux_.resize(fht_->size());
+  if (aux_.size() >= scope.size()) {
+    std::copy(scope.begin(), scope.end(), aux_.begin());
   }
   else {
-    std::copy(scope.begin(), scope.begin() + aux.size(), aux.begin());
+    std::copy(scope.begin(), scope.begin() + aux_.size(), aux_.begin());
   }
 
-  fht_->logSpectrum(scope.data(), aux.data());
+  fht_->logSpectrum(scope.data(), aux_.data());
   fht_->scale(scope.data(), 1.0 / 20);
 
   scope.resize(fht_->size() / 2);  // second half of values are rubbish
@@ -89,22 +153,39 @@ void Analyzer::Base::transform(Scope& scope) {
 void Analyzer::Base::paintEvent(QPaintEvent *e) {
 
   QPainter p(this);
+
+  if (threaded_) {
+    QMutexLocker l(&frame_mutex_);
+    if (frame_.isNull()) {
+      p.fillRect(e->rect(), palette().color(QPalette::Window));
+    }
+    else {
+      p.drawImage(0, 0, frame_);
+    }
+    new_frame_ = false;
+    return;
+  }
+
   p.fillRect(e->rect(), palette().color(QPalette::Window));
 
-  switch (engine_->state()) {
-    case Engine::Playing: {
-      const Engine::Scope& thescope = engine_->scope(timeout_);
-      int i = 0;
+  const Engine::State state = engine_->state();
+  paintFrame(p, state, state == Engine::Playing ? engine_->scope(timeout_) : render_scope_, new_frame_);
 
-      // convert to mono here - our built in analyzers need mono, but the engines provide interleaved pcm
-      for (uint x = 0; static_cast<int>(x) < fht_->size(); ++x) {
-        lastscope_[x] = double(thescope[i] + thescope[i + 1]) / (2 * (1 << 15));
-        i += 2;
-      }
+  new_frame_ = false;
+
+}
+
+void Analyzer::Base::paintFrame(QPainter &p, const Engine::State state, const Engine::Scope &scope, const bool new_frame) {
+
+  engine_state_ = state;
+
+  switch (state) {
+    case Engine::Playing: {
+      convertScope(scope);
 
       is_playing_ = true;
       transform(lastscope_);
-      analyze(p, lastscope_, new_frame_);
+      analyze(p, lastscope_, new_frame);
 
       lastscope_.resize(fht_->size());
 
@@ -112,15 +193,72 @@ void Analyzer::Base::paintEvent(QPaintEvent *e) {
     }
     case Engine::Paused:
       is_playing_ = false;
-      analyze(p, lastscope_, new_frame_);
+      analyze(p, lastscope_, new_frame);
       break;
 
     default:
       is_playing_ = false;
-      demo(p);
+      demo(p, new_frame);
   }
 
-  new_frame_ = false;
+}
+
+void Analyzer::Base::QueueFrame() {
+
+  // Skip the frame if the render thread is still busy with the last one.
+  if (!engine_ || rendering_.loadAcquire()) return;
+
+  // The engine is only used from the GUI thread, the render thread gets a copy of its samples.
+  render_state_ = engine_->state();
+  if (render_state_ == Engine::Playing) {
+    const Engine::Scope &scope = engine_->scope(timeout_);
+    render_scope_.assign(scope.begin(), scope.end());
+  }
+
+  rendering_.storeRelease(1);
+  (void)QtConcurrent::run(&render_pool_, std::bind(&Base::RenderFrame, this));
+
+}
+
+void Analyzer::Base::RenderFrame() {
+
+  {
+    QMutexLocker l(&render_mutex_);
+
+    if (!render_size_.isEmpty()) {
+      if (render_image_.size() != render_size_) {
+        render_image_ = QImage(render_size_, QImage::Format_ARGB32_Premultiplied);
+      }
+      render_image_.fill(render_background_);
+
+      QPainter p(&render_image_);
+      paintFrame(p, render_state_, render_scope_, true);
+      p.end();
+
+      QMutexLocker frame_lock(&frame_mutex_);
+      frame_.swap(render_image_);
+    }
+  }
+
+  rendering_.storeRelease(0);
+
+  QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+
+}
+
+void Analyzer::Base::convertScope(const Engine::Scope &scope) {
+
+  // Our built in analyzers need mono, but the engines provide interleaved pcm
+  const int size = fht_->size();
+  const int frames = qMin(size, static_cast<int>(scope.size() / 2));
+  lastscope_.resize(size);
+
+  const Engine::Scope::value_type *source = scope.data();
+  float *dest = lastscope_.data();
+  for (int i = 0; i < frames; ++i) {
+    dest[i] = static_cast<float>(source[i * 2] + source[i * 2 + 1]) * (1.0F / (2 * (1 << 15)));
+  }
+  std::fill(dest + frames, dest + size, 0.0F);
 
 }
 
@@ -160,7 +298,7 @@ int Analyzer::Base::resizeForBands(int bands) {
 
 }
 
-void Analyzer::Base::demo(QPainter& p) {
+void Analyzer::Base::demo(QPainter& p, bool new_frame) {
 
   static int t = 201;  // FIXME make static to namespace perhaps
 
@@ -172,10 +310,10 @@ void Analyzer::Base::demo(QPainter& p) {
     for (uint i = 0; i < s.size(); ++i)
       s[i] = dt * (sin(M_PI + (i * M_PI) / s.size()) + 1.0);
 
-    analyze(p, s, new_frame_);
+    analyze(p, s, new_frame);
   }
   else
-    analyze(p, Scope(32, 0), new_frame_);
+    analyze(p, Scope(32, 0), new_frame);
 
   ++t;
 
@@ -225,6 +363,11 @@ void Analyzer::Base::timerEvent(QTimerEvent *e) {
   if (e->timerId() != timer_.timerId()) return;
 
   new_frame_ = true;
-  update();
+  if (threaded_) {
+    QueueFrame();
+  }
+  else {
+    update();
+  }
 
 }
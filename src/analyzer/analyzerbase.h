@@ -37,11 +37,18 @@
 #include <QBasicTimer>
 #include <QString>
 #include <QPainter>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include <QImage>
+#include <QColor>
+#include <QSize>
 
 #include "analyzer/fht.h"
 #include "engine/engine_fwd.h"
 #include "engine/enginebase.h"
 
+class QEvent;
 class QHideEvent;
 class QShowEvent;
 class QTimerEvent;
@@ -55,25 +62,26 @@ class Base : public QWidget {
   Q_OBJECT
 
  public:
-  ~Base() override { delete fht_; }
+  ~Base() override;
 
   uint timeout() const { return timeout_; }
 
   void set_engine(EngineBase *engine) { engine_ = engine; }
 
-  void changeTimeout(uint newTimeout) {
-    timeout_ = newTimeout;
-    if (timer_.isActive()) {
-      timer_.stop();
-      timer_.start(timeout_, this);
-    }
-  }
+  // In threaded mode the spectrum is computed and the frame painted into an image on a separate thread, the widget only draws the finished frames.
+  // Turn it off before deleting the analyzer, so the render thread is done with the subclass.
+  void set_threaded(const bool threaded);
+  bool threaded() const { return threaded_; }
+
+  // Also calls framerateChanged().
+  void changeTimeout(uint newTimeout);
 
   virtual void framerateChanged() {}
 
  protected:
   explicit Base(QWidget*, uint scopeSize = 7);
 
+  bool event(QEvent*) override;
   void hideEvent(QHideEvent*) override;
   void showEvent(QShowEvent*) override;
   void paintEvent(QPaintEvent*) override;
@@ -83,10 +91,17 @@ class Base : public QWidget {
 
   int resizeExponent(int);
   int resizeForBands(int);
+
+  // Mixes the engine's interleaved stereo samples down to mono into lastscope_.
+  void convertScope(const Engine::Scope&);
+
+  // Transforms the scope and paints a frame for the given engine state, on the GUI thread or on the render thread.
+  void paintFrame(QPainter &p, const Engine::State state, const Engine::Scope &scope, const bool new_frame);
+
   virtual void init() {}
   virtual void transform(Scope&);
   virtual void analyze(QPainter& p, const Scope&, bool new_frame) = 0;
-  virtual void demo(QPainter& p);
+  virtual void demo(QPainter& p, bool new_frame);
 
  protected:
   QBasicTimer timer_;
@@ -94,9 +109,33 @@ class Base : public QWidget {
   FHT *fht_;
   EngineBase *engine_;
   Scope lastscope_;
+  Scope aux_;  // input for the FHT, so we don't create a vector every frame
 
   bool new_frame_;
   bool is_playing_;
+  Engine::State engine_state_;
+
+  // The size of the widget, safe to use in analyze() on the render thread.
+  QSize render_size_;
+
+ private:
+  void QueueFrame();
+  void RenderFrame();
+
+  bool threaded_;
+  QThreadPool render_pool_;
+  QAtomicInt rendering_;
+
+  // Held while a frame is rendered on the render thread, and while the widget is resized or its palette changes.
+  QMutex render_mutex_;
+  QColor render_background_;
+  Engine::State render_state_;
+  Engine::Scope render_scope_;
+  QImage render_image_;
+
+  // The last finished frame.
+  QMutex frame_mutex_;
+  QImage frame_;
 };
 
 void interpolate(const Scope&, Scope&);
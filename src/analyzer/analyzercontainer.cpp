@@ -46,6 +46,7 @@
 
 const char *AnalyzerContainer::kSettingsGroup = "Analyzer";
 const char *AnalyzerContainer::kSettingsFramerate = "framerate";
+const char *AnalyzerContainer::kSettingsThreaded = "threaded";
 
 // Framerates
 const int AnalyzerContainer::kLowFramerate = 20;
@@ -60,6 +61,7 @@ AnalyzerContainer::AnalyzerContainer(QWidget *parent)
       context_menu_framerate_(new QMenu(tr("Framerate"), this)),
       group_(new QActionGroup(this)),
       group_framerate_(new QActionGroup(this)),
+      threaded_(true),
       double_click_timer_(new QTimer(this)),
       ignore_next_click_(false),
       current_analyzer_(nullptr),
@@ -76,6 +78,9 @@ AnalyzerContainer::AnalyzerContainer(QWidget *parent)
   AddFramerate(tr("Super high (%1 fps)").arg(kSuperHighFramerate), kSuperHighFramerate);
 
   context_menu_->addMenu(context_menu_framerate_);
+  threaded_action_ = context_menu_->addAction(tr("Render in the background"));
+  threaded_action_->setCheckable(true);
+  connect(threaded_action_, SIGNAL(toggled(bool)), SLOT(ChangeThreaded(bool)));
   context_menu_->addSeparator();
 
   AddAnalyzerType<BlockAnalyzer>();
@@ -97,6 +102,10 @@ AnalyzerContainer::AnalyzerContainer(QWidget *parent)
 
 }
 
+AnalyzerContainer::~AnalyzerContainer() {
+  DeleteAnalyzer();
+}
+
 void AnalyzerContainer::mouseReleaseEvent(QMouseEvent *e) {
 
   if (engine_->type() != Engine::EngineType::GStreamer) return;
@@ -125,10 +134,32 @@ void AnalyzerContainer::SetEngine(EngineBase *engine) {
 }
 
 void AnalyzerContainer::DisableAnalyzer() {
+  DeleteAnalyzer();
+
+  Save();
+}
+
+void AnalyzerContainer::DeleteAnalyzer() {
+
+  if (!current_analyzer_) return;
+
+  // Wait for the render thread before the analyzer subclass is destroyed.
+  current_analyzer_->set_threaded(false);
   delete current_analyzer_;
   current_analyzer_ = nullptr;
 
-  Save();
+}
+
+void AnalyzerContainer::ChangeThreaded(bool threaded) {
+
+  threaded_ = threaded;
+  if (current_analyzer_) current_analyzer_->set_threaded(threaded_);
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue(kSettingsThreaded, threaded_);
+  s.endGroup();
+
 }
 
 void AnalyzerContainer::ChangeAnalyzer(int id) {
@@ -140,9 +171,10 @@ void AnalyzerContainer::ChangeAnalyzer(int id) {
     return;
   }
 
-  delete current_analyzer_;
+  DeleteAnalyzer();
   current_analyzer_ = qobject_cast<Analyzer::Base*>(instance);
   current_analyzer_->set_engine(engine_);
+  current_analyzer_->set_threaded(threaded_);
   // Even if it is not supposed to happen, I don't want to get a dbz error
   current_framerate_ = current_framerate_ == 0 ? kMediumFramerate : current_framerate_;
   current_analyzer_->changeTimeout(1000 / current_framerate_);
@@ -158,10 +190,8 @@ void AnalyzerContainer::ChangeFramerate(int new_framerate) {
   if (current_analyzer_) {
     // Even if it is not supposed to happen, I don't want to get a dbz error
     new_framerate = new_framerate == 0 ? kMediumFramerate : new_framerate;
+    // Also notifies the current analyzer that the framerate has changed
     current_analyzer_->changeTimeout(1000 / new_framerate);
-
-    // notify the current analyzer that the framerate has changed
-    current_analyzer_->framerateChanged();
   }
   SaveFramerate(new_framerate);
 
@@ -173,8 +203,16 @@ void AnalyzerContainer::Load() {
   s.beginGroup(kSettingsGroup);
   QString type = s.value("type", "BlockAnalyzer").toString();
   current_framerate_ = s.value(kSettingsFramerate, kMediumFramerate).toInt();
+  threaded_ = s.value(kSettingsThreaded, true).toBool();
   s.endGroup();
 
+  {
+    // Don't save the setting we just loaded.
+    const bool blocked = threaded_action_->blockSignals(true);
+    threaded_action_->setChecked(threaded_);
+    threaded_action_->blockSignals(blocked);
+  }
+
   // Analyzer
   if (type.isEmpty()) {
     DisableAnalyzer();
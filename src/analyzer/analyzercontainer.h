@@ -45,12 +45,14 @@ class AnalyzerContainer : public QWidget {
 
  public:
   explicit AnalyzerContainer(QWidget *parent);
+  ~AnalyzerContainer() override;
 
   void SetEngine(EngineBase *engine);
   void SetActions(QAction *visualisation);
 
   static const char *kSettingsGroup;
   static const char *kSettingsFramerate;
+  static const char *kSettingsThreaded;
 
  signals:
   void WheelEvent(int delta);
@@ -63,6 +65,7 @@ class AnalyzerContainer : public QWidget {
   void ChangeAnalyzer(int id);
   void ChangeFramerate(int new_framerate);
   void DisableAnalyzer();
+  void ChangeThreaded(bool threaded);
   void ShowPopupMenu();
 
  private:
@@ -74,6 +77,7 @@ class AnalyzerContainer : public QWidget {
   void Load();
   void Save();
   void SaveFramerate(int framerate);
+  void DeleteAnalyzer();
   template <typename T>
   void AddAnalyzerType();
   void AddFramerate(const QString& name, int framerate);
@@ -89,6 +93,8 @@ class AnalyzerContainer : public QWidget {
   QList<int> framerate_list_;
   QList<QAction*> actions_;
   QAction *disable_action_;
+  QAction *threaded_action_;
+  bool threaded_;
 
   QTimer *double_click_timer_;
   QPoint last_click_pos_;
@@ -27,7 +27,7 @@
 #include <cmath>
 
 #include <QWidget>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QPalette>
 #include <QColor>
@@ -49,8 +49,8 @@ BlockAnalyzer::BlockAnalyzer(QWidget *parent)
       columns_(0),
       rows_(0),
       y_(0),
-      barpixmap_(1, 1),
-      topbarpixmap_(kWidth, kHeight),
+      barimage_(1, 1, QImage::Format_RGB32),
+      topbarimage_(kWidth, kHeight, QImage::Format_RGB32),
       scope_(kMinColumns),
       store_(1 << 8, 0),
       fade_bars_(kFadeSize),
@@ -63,7 +63,7 @@ BlockAnalyzer::BlockAnalyzer(QWidget *parent)
   setMaximumWidth(kMaxColumns * (kWidth + 1) - 1);
 
   // mxcl says null pixmaps cause crashes, so let's play it safe
-  for (uint i = 0; i < kFadeSize; ++i) fade_bars_[i] = QPixmap(1, 1);
+  for (uint i = 0; i < kFadeSize; ++i) fade_bars_[i] = QImage(1, 1, QImage::Format_RGB32);
 
 }
 
@@ -71,8 +71,8 @@ void BlockAnalyzer::resizeEvent(QResizeEvent *e) {
 
   QWidget::resizeEvent(e);
 
-  background_ = QPixmap(size());
-  canvas_ = QPixmap(size());
+  background_ = QImage(size(), QImage::Format_RGB32);
+  canvas_ = QImage(size(), QImage::Format_RGB32);
 
   const uint oldRows = rows_;
 
@@ -87,10 +87,10 @@ void BlockAnalyzer::resizeEvent(QResizeEvent *e) {
   scope_.resize(columns_);
 
   if (rows_ != oldRows) {
-    barpixmap_ = QPixmap(kWidth, rows_ * (kHeight + 1));
+    barimage_ = QImage(kWidth, rows_ * (kHeight + 1), QImage::Format_RGB32);
 
     for (uint i = 0; i < kFadeSize; ++i)
-      fade_bars_[i] = QPixmap(kWidth, rows_ * (kHeight + 1));
+      fade_bars_[i] = QImage(kWidth, rows_ * (kHeight + 1), QImage::Format_RGB32);
 
     yscale_.resize(rows_ + 1);
 
@@ -153,7 +153,7 @@ void BlockAnalyzer::analyze(QPainter &p, const Analyzer::Scope &s, bool new_fram
   // if it contains 6 elements there are 5 rows in the analyzer
 
   if (!new_frame) {
-    p.drawPixmap(0, 0, canvas_);
+    p.drawImage(0, 0, canvas_);
     return;
   }
 
@@ -162,7 +162,7 @@ void BlockAnalyzer::analyze(QPainter &p, const Analyzer::Scope &s, bool new_fram
   Analyzer::interpolate(s, scope_);
 
   // Paint the background
-  canvas_painter.drawPixmap(0, 0, background_);
+  canvas_painter.drawImage(0, 0, background_);
 
   for (uint y, x = 0; x < scope_.size(); ++x) {
     // determine y
@@ -184,19 +184,19 @@ void BlockAnalyzer::analyze(QPainter &p, const Analyzer::Scope &s, bool new_fram
     if (fade_intensity_[x] > 0) {
       const uint offset = --fade_intensity_[x];
       const uint y2 = y_ + (fade_pos_[x] * (kHeight + 1));
-      canvas_painter.drawPixmap(x * (kWidth + 1), y2, fade_bars_[offset], 0, 0, kWidth, height() - y2);
+      canvas_painter.drawImage(x * (kWidth + 1), y2, fade_bars_[offset], 0, 0, kWidth, canvas_.height() - y2);
     }
 
     if (fade_intensity_[x] == 0) fade_pos_[x] = rows_;
 
     // REMEMBER: y is a number from 0 to rows_, 0 means all blocks are glowing, rows_ means none are
-    canvas_painter.drawPixmap(x * (kWidth + 1), y * (kHeight + 1) + y_, *bar(), 0, y * (kHeight + 1), bar()->width(), bar()->height());
+    canvas_painter.drawImage(x * (kWidth + 1), y * (kHeight + 1) + y_, *bar(), 0, y * (kHeight + 1), bar()->width(), bar()->height());
   }
 
   for (int x = 0; x < store_.size(); ++x)
-    canvas_painter.drawPixmap(x * (kWidth + 1), static_cast<int>(store_[x]) * (kHeight + 1) + y_, topbarpixmap_);
+    canvas_painter.drawImage(x * (kWidth + 1), static_cast<int>(store_[x]) * (kHeight + 1) + y_, topbarimage_);
 
-  p.drawPixmap(0, 0, canvas_);
+  p.drawImage(0, 0, canvas_);
 
 }
 
@@ -328,7 +328,7 @@ void BlockAnalyzer::paletteChange(const QPalette&) {
   const QColor bg = palette().color(QPalette::Window);
   const QColor fg = ensureContrast(bg, palette().color(QPalette::Highlight));
 
-  topbarpixmap_.fill(fg);
+  topbarimage_.fill(fg);
 
   const double dr = 15 * static_cast<double>(bg.red() - fg.red()) / (rows_ * 16);
   const double dg = 15 * static_cast<double>(bg.green() - fg.green()) / (rows_ * 16);
@@ -356,7 +356,7 @@ void BlockAnalyzer::paletteChange(const QPalette&) {
     const double db2 = fg2.blue() - bg2.blue();
     const int r2 = bg2.red(), g2 = bg2.green(), b2 = bg2.blue();
 
-    // Precalculate all fade-bar pixmaps
+    // Precalculate all fade-bar images
     for (uint y = 0; y < kFadeSize; ++y) {
       fade_bars_[y].fill(palette().color(QPalette::Window));
       QPainter f(&fade_bars_[y]);
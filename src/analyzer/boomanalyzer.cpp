@@ -27,7 +27,7 @@
 #include <cmath>
 
 #include <QWidget>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QPalette>
 #include <QColor>
@@ -50,6 +50,8 @@ BoomAnalyzer::BoomAnalyzer(QWidget* parent)
       bands_(0),
       scope_(kMinBandCount),
       fg_(palette().color(QPalette::Highlight)),
+      bg_(palette().color(QPalette::Window)),
+      peak_(palette().color(QPalette::Midlight)),
       K_barHeight_(1.271)  // 1.471
       ,
       F_peakSpeed_(1.103)  // 1.122
@@ -58,7 +60,7 @@ BoomAnalyzer::BoomAnalyzer(QWidget* parent)
       bar_height_(kMaxBandCount, 0),
       peak_height_(kMaxBandCount, 0),
       peak_speed_(kMaxBandCount, 0.01),
-      barPixmap_(kColumnWidth, 50) {
+      barImage_(kColumnWidth, 50, QImage::Format_RGB32) {
 
   setMinimumWidth(kMinBandCount * (kColumnWidth + 1) - 1);
   setMaximumWidth(kMaxBandCount * (kColumnWidth + 1) - 1);
@@ -85,11 +87,11 @@ void BoomAnalyzer::resizeEvent(QResizeEvent* e) {
 
   F_ = static_cast<double>(HEIGHT) / (log10(256) * 1.1 /*<- max. amplitude*/);
 
-  barPixmap_ = QPixmap(kColumnWidth - 2, HEIGHT);
-  canvas_ = QPixmap(size());
-  canvas_.fill(palette().color(QPalette::Window));
+  barImage_ = QImage(kColumnWidth - 2, HEIGHT, QImage::Format_RGB32);
+  canvas_ = QImage(size(), QImage::Format_RGB32);
+  canvas_.fill(bg_);
 
-  QPainter p(&barPixmap_);
+  QPainter p(&barImage_);
   for (uint y = 0; y < HEIGHT; ++y) {
     const double F = static_cast<double>(y) * h;
 
@@ -101,6 +103,18 @@ void BoomAnalyzer::resizeEvent(QResizeEvent* e) {
 
 }
 
+void BoomAnalyzer::changeEvent(QEvent* e) {
+
+  QWidget::changeEvent(e);
+
+  // analyze() might run on the render thread, so it can't ask the widget for its palette.
+  if (e->type() == QEvent::PaletteChange) {
+    bg_ = palette().color(QPalette::Window);
+    peak_ = palette().color(QPalette::Midlight);
+  }
+
+}
+
 void BoomAnalyzer::transform(Scope& s) {
 
   fht_->spectrum(s.data());
@@ -112,15 +126,16 @@ void BoomAnalyzer::transform(Scope& s) {
 
 void BoomAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
 
-  if (!new_frame || engine_->state() == Engine::Paused) {
-    p.drawPixmap(0, 0, canvas_);
+  if (!new_frame || engine_state_ == Engine::Paused) {
+    p.drawImage(0, 0, canvas_);
     return;
   }
   float h;
-  const uint MAX_HEIGHT = height() - 1;
+  const uint HEIGHT = canvas_.height();
+  const uint MAX_HEIGHT = HEIGHT - 1;
 
+  canvas_.fill(bg_);
   QPainter canvas_painter(&canvas_);
-  canvas_.fill(palette().color(QPalette::Window));
 
   Analyzer::interpolate(scope, scope_);
 
@@ -157,18 +172,18 @@ void BoomAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
       }
     }
 
-    y = height() - uint(bar_height_[i]);
-    canvas_painter.drawPixmap(x + 1, y, barPixmap_, 0, y, -1, -1);
+    y = HEIGHT - uint(bar_height_[i]);
+    canvas_painter.drawImage(x + 1, y, barImage_, 0, y, -1, -1);
     canvas_painter.setPen(fg_);
     if (bar_height_[i] > 0)
-      canvas_painter.drawRect(x, y, kColumnWidth - 1, height() - y - 1);
+      canvas_painter.drawRect(x, y, kColumnWidth - 1, HEIGHT - y - 1);
 
-    y = height() - uint(peak_height_[i]);
-    canvas_painter.setPen(palette().color(QPalette::Midlight));
+    y = HEIGHT - uint(peak_height_[i]);
+    canvas_painter.setPen(peak_);
     canvas_painter.drawLine(x, y, x + kColumnWidth - 1, y);
   }
 
-  p.drawPixmap(0, 0, canvas_);
+  p.drawImage(0, 0, canvas_);
 
 }
 
@@ -29,12 +29,13 @@
 
 #include <QtGlobal>
 #include <QObject>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QColor>
 
 class QWidget;
 class QResizeEvent;
+class QEvent;
 
 class BoomAnalyzer : public Analyzer::Base {
   Q_OBJECT
@@ -53,6 +54,7 @@ class BoomAnalyzer : public Analyzer::Base {
 
  protected:
   void resizeEvent(QResizeEvent* e) override;
+  void changeEvent(QEvent* e) override;
 
   static const uint kColumnWidth;
   static const uint kMaxBandCount;
@@ -61,6 +63,8 @@ class BoomAnalyzer : public Analyzer::Base {
   uint bands_;
   Analyzer::Scope scope_;
   QColor fg_;
+  QColor bg_;
+  QColor peak_;
 
   double K_barHeight_, F_peakSpeed_, F_;
 
@@ -68,8 +72,8 @@ class BoomAnalyzer : public Analyzer::Base {
   std::vector<float> peak_height_;
   std::vector<float> peak_speed_;
 
-  QPixmap barPixmap_;
-  QPixmap canvas_;
+  QImage barImage_;
+  QImage canvas_;
 
 };
 
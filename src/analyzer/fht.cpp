@@ -30,9 +30,10 @@
 FHT::FHT(int n) : num_((n < 3) ? 0 : 1 << n), exp2_((n < 3) ? -1 : n) {
   if (n > 3) {
     buf_vector_.resize(num_);
-    tab_vector_.resize(num_ * 2);
     makeCasTable();
+    makePermutation();
   }
+  makeLogTable();
 }
 
 FHT::~FHT() {}
@@ -43,43 +44,77 @@ int FHT::size() const { return num_; }
 float* FHT::buf_() { return buf_vector_.data(); }
 float* FHT::tab_() { return tab_vector_.data(); }
 int* FHT::log_() { return log_vector_.data(); }
+int* FHT::perm_() { return perm_vector_.data(); }
 
 void FHT::makeCasTable(void) {
-  float* costab = tab_();
-  float* sintab = tab_() + num_ / 2 + 1;
 
-  for (int ul = 0; ul < num_; ul++) {
-    float d = M_PI * ul / (num_ / 2);
-    *costab = *sintab = cos(d);
+  // A stage combining blocks of n values needs n/2 cosines followed by n/2 sines, for n = 16 up to num_.
+  tab_vector_.resize(2 * (num_ - 8));
+  float* tab = tab_();
 
-    costab += 2;
-    sintab += 2;
-    if (sintab > tab_() + num_ * 2) sintab = tab_() + 1;
+  for (int n = 16; n <= num_; n *= 2) {
+    const int ndiv2 = n / 2;
+    for (int i = 0; i < ndiv2; i++) {
+      const double d = 2 * M_PI * i / n;
+      tab[i] = static_cast<float>(cos(d));
+      tab[ndiv2 + i] = static_cast<float>(sin(d));
+    }
+    tab += n;
+  }
+
+}
+
+void FHT::makePermutation() {
+
+  // Splitting each block into its even and odd values until blocks of 8 are left
+  // reverses the lowest exp2_ - 3 bits of the index and moves them to the top.
+  perm_vector_.resize(num_);
+  const int bits = exp2_ - 3;
+
+  for (int i = 0; i < num_; i++) {
+    int reversed = 0;
+    for (int b = 0; b < bits; b++) {
+      if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+    }
+    perm_()[(reversed << 3) | (i >> bits)] = i;
   }
+
+}
+
+void FHT::makeLogTable() {
+
+  const int n = num_ / 2;
+  if (n < 2) return;
+
+  log_vector_.resize(n);
+  const float f = n / log10(static_cast<double>(n));
+  int* r = log_();
+  for (int i = 0; i < n; i++, r++) {
+    const int j = static_cast<int>(rint(log10(i + 1.0) * f));
+    *r = j >= n ? n - 1 : j;
+  }
+
 }
 
 void FHT::scale(float* p, float d) {
-  for (int i = 0; i < (num_ / 2); i++) *p++ *= d;
+  for (int i = 0; i < (num_ / 2); i++) p[i] *= d;
 }
 
 void FHT::ewma(float* d, float* s, float w) {
-  for (int i = 0; i < (num_ / 2); i++, d++, s++) *d = *d * w + *s * (1 - w);
+  for (int i = 0; i < (num_ / 2); i++) d[i] = d[i] * w + s[i] * (1 - w);
 }
 
 void FHT::logSpectrum(float* out, float* p) {
 
-  int n = num_ / 2, i, j, k, *r;
-  if (log_vector_.size() < n) {
-    log_vector_.resize(n);
-    float f = n / log10(static_cast<double>(n));
-    for (i = 0, r = log_(); i < n; i++, r++) {
-      j = static_cast<int>(rint(log10(i + 1.0) * f));
-      *r = j >= n ? n - 1 : j;
-    }
-  }
+  const int n = num_ / 2;
+  if (log_vector_.size() < n) return;
+
+  int i, j, k;
+  const int* r = log_();
+
   semiLogSpectrum(p);
   *out++ = *p = *p / 100;
-  for (k = i = 1, r = log_(); i < n; i++) {
+  for (k = i = 1; i < n; i++) {
     j = *r++;
     if (i == j) {
       *out++ = p[i];
@@ -95,42 +130,39 @@ void FHT::logSpectrum(float* out, float* p) {
 
 void FHT::semiLogSpectrum(float* p) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++, p++) {
-    float e = 10.0 * log10(sqrt(*p / 2));
-    *p = e < 0 ? 0 : e;
+  // 10 * log10(sqrt(p / 2))
+  for (int i = 0; i < (num_ / 2); i++) {
+    const float e = 5.0F * std::log10(p[i] * 0.5F);
+    p[i] = e < 0 ? 0 : e;
   }
 }
 
 void FHT::spectrum(float* p) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++, p++)
-    *p = static_cast<float>(sqrt(*p / 2));
+  for (int i = 0; i < (num_ / 2); i++) p[i] = std::sqrt(p[i] * 0.5F);
 }
 
 void FHT::power(float* p) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++) *p++ /= 2;
+  for (int i = 0; i < (num_ / 2); i++) p[i] *= 0.5F;
 }
 
 void FHT::power2(float* p) {
-  _transform(p, num_, 0);
 
-  *p = static_cast<float>(2 * pow(*p, 2));
-  p++;
+  transform(p);
 
-  float* q = p + num_ - 2;
+  p[0] = 2 * p[0] * p[0];
   for (int i = 1; i < (num_ / 2); i++) {
-    *p = static_cast<float>(pow(*p, 2) + pow(*q, 2));
-    p++;
-    q--;
+    p[i] = p[i] * p[i] + p[num_ - i] * p[num_ - i];
   }
+
 }
 
 void FHT::transform(float* p) {
   if (num_ == 8)
     transform8(p);
-  else
-    _transform(p, num_, 0);
+  else if (num_ > 8)
+    _transform(p);
 }
 
 void FHT::transform8(float* p) {
@@ -162,46 +194,50 @@ void FHT::transform8(float* p) {
 
 }
 
-void FHT::_transform(float* p, int n, int k) {
-
-  if (n == 8) {
-    transform8(p + k);
-    return;
-  }
-
-  int i, j, ndiv2 = n / 2;
-  float a, *t1, *t2, *t3, *t4, *ptab, *pp;
-
-  for (i = 0, t1 = buf_(), t2 = buf_() + ndiv2, pp = &p[k]; i < ndiv2; i++)
-    *t1++ = *pp++, *t2++ = *pp++;
-
-  std::copy(buf_(), buf_() + n, p + k);
-
-  _transform(p, ndiv2, k);
-  _transform(p, ndiv2, k + ndiv2);
-
-  j = num_ / ndiv2 - 1;
-  t1 = buf_();
-  t2 = t1 + ndiv2;
-  t3 = p + k + ndiv2;
-  ptab = tab_();
-  pp = p + k;
-
-  a = *ptab++ * *t3++;
-  a += *ptab * *pp;
-  ptab += j;
-
-  *t1++ = *pp + a;
-  *t2++ = *pp++ - a;
-
-  for (i = 1, t4 = p + k + n; i < ndiv2; i++, ptab += j) {
-    a = *ptab++ * *t3++;
-    a += *ptab * *--t4;
+void FHT::_transform(float* p) {
+
+  float* buf = buf_();
+  const int* perm = perm_();
+
+  for (int i = 0; i < num_; i++) buf[i] = p[perm[i]];
+  for (int k = 0; k < num_; k += 8) transform8(buf + k);
+
+  // Combine pairs of transformed blocks of n/2 values into blocks of n values.
+  const float* tab = tab_();
+  for (int n = 16; n <= num_; n *= 2) {
+    const int ndiv2 = n / 2;
+    const int ndiv4 = n / 4;
+    const float* costab = tab;
+    const float* sintab = tab + ndiv2;
+
+    for (float* t1 = buf; t1 < buf + num_; t1 += n) {
+      float* t2 = t1 + ndiv2;
+
+      float a = t2[0];
+      t2[0] = t1[0] - a;
+      t1[0] += a;
+
+      a = costab[ndiv4] * t2[ndiv4] + sintab[ndiv4] * t2[ndiv4];
+      t2[ndiv4] = t1[ndiv4] - a;
+      t1[ndiv4] += a;
+
+      // Value i needs value n/2 - i of the second block and the other way around, so they're done together.
+      for (int i = 1; i < ndiv4; i++) {
+        const int j = ndiv2 - i;
+        const float ai = costab[i] * t2[i] + sintab[i] * t2[j];
+        const float aj = costab[j] * t2[j] + sintab[j] * t2[i];
+        const float t1i = t1[i];
+        const float t1j = t1[j];
+        t1[i] = t1i + ai;
+        t2[i] = t1i - ai;
+        t1[j] = t1j + aj;
+        t2[j] = t1j - aj;
+      }
+    }
 
-    *t1++ = *pp + a;
-    *t2++ = *pp++ - a;
+    tab += n;
   }
 
-  std::copy(buf_(), buf_() + n, p + k);
+  std::copy(buf, buf + num_, p);
 
 }
@@ -40,22 +40,34 @@ class FHT {
   QVector<float> buf_vector_;
   QVector<float> tab_vector_;
   QVector<int> log_vector_;
+  QVector<int> perm_vector_;
 
   float* buf_();
   float* tab_();
   int* log_();
+  int* perm_();
 
   /**
-   * Create a table of "cas" (cosine and sine) values.
+   * Create the tables of cosine and sine values, one pair of tables
+   * for each butterfly stage so every stage reads them in order.
    * Has only to be done in the constructor and saves from
    * calculating the same values over and over while transforming.
    */
   void makeCasTable();
 
   /**
-   * Recursive in-place Hartley transform. For internal use only!
+   * Create the order in which the input values are fed to the
+   * transforms of 8 values, and the logarithmic index map
+   * used by logSpectrum().
    */
-  void _transform(float*, int, int);
+  void makePermutation();
+  void makeLogTable();
+
+  /**
+   * Iterative in-place Hartley transform. For internal use only!
+   * Uses the preallocated buffer and tables, so it doesn't allocate.
+   */
+  void _transform(float*);
 
  public:
   /**
@@ -81,7 +93,7 @@ class FHT {
   /**
    * Logarithmic audio spectrum. Maps semi-logarithmic spectrum
    * to logarithmic frequency scale, interpolates missing values.
-   * A logarithmic index map is calculated at the first run only.
+   * The logarithmic index map is calculated in the constructor.
    * @param p is the input array.
    * @param out is the spectrum.
    */
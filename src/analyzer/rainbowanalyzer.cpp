@@ -29,7 +29,7 @@
 
 #include <QtGlobal>
 #include <QWidget>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QColor>
 #include <QBrush>
@@ -68,8 +68,8 @@ Rainbow::RainbowAnalyzer::RainbowAnalyzer(const RainbowType& rbtype, QWidget* pa
       {
 
   rainbowtype = rbtype;
-  cat_dash_[0] = QPixmap(":/pictures/nyancat.png");
-  cat_dash_[1] = QPixmap(":/pictures/rainbowdash.png");
+  cat_dash_[0] = QImage(":/pictures/nyancat.png");
+  cat_dash_[1] = QImage(":/pictures/rainbowdash.png");
   memset(history_, 0, sizeof(history_));
 
   for (int i = 0; i < kRainbowBands; ++i) {
@@ -87,7 +87,7 @@ void Rainbow::RainbowAnalyzer::transform(Scope& s) { fht_->spectrum(s.data()); }
 void Rainbow::RainbowAnalyzer::timerEvent(QTimerEvent* e) {
 
   if (e->timerId() == timer_id_) {
-    frame_ = (frame_ + 1) % kFrameCount[rainbowtype];
+    frame_.storeRelease((frame_.loadAcquire() + 1) % kFrameCount[rainbowtype]);
   }
   else {
     Analyzer::Base::timerEvent(e);
@@ -100,8 +100,8 @@ void Rainbow::RainbowAnalyzer::resizeEvent(QResizeEvent* e) {
   Q_UNUSED(e);
 
   // Invalidate the buffer so it's recreated from scratch in the next paint event.
-  buffer_[0] = QPixmap();
-  buffer_[1] = QPixmap();
+  buffer_[0] = QImage();
+  buffer_[1] = QImage();
 
   available_rainbow_width_ = width() - kWidth[rainbowtype] + kRainbowOverlap[rainbowtype];
   px_per_frame_ = static_cast<float>(available_rainbow_width_) / (kHistorySize - 1) + 1;
@@ -142,7 +142,7 @@ void Rainbow::RainbowAnalyzer::analyze(QPainter& p, const Analyzer::Scope& s, bo
     QPointF* dest = polyline;
     float* source = history_;
 
-    const float top_of = static_cast<float>(height()) / 2 - static_cast<float>(kRainbowHeight[rainbowtype]) / 2;
+    const float top_of = static_cast<float>(render_size_.height()) / 2 - static_cast<float>(kRainbowHeight[rainbowtype]) / 2;
     for (int band = 0; band < kRainbowBands; ++band) {
       // Calculate the Y position of this band.
       const float y = static_cast<float>(kRainbowHeight[rainbowtype]) / (kRainbowBands + 1) * (band + 0.5) + top_of;
@@ -158,7 +158,7 @@ void Rainbow::RainbowAnalyzer::analyze(QPainter& p, const Analyzer::Scope& s, bo
     // Do we have to draw the whole rainbow into the buffer?
     if (buffer_[0].isNull()) {
       for (int i = 0; i < 2; ++i) {
-        buffer_[i] = QPixmap(QSize(width() + x_offset_, height()));
+        buffer_[i] = QImage(QSize(render_size_.width() + x_offset_, render_size_.height()), QImage::Format_RGB32);
         buffer_[i].fill(background_brush_.color());
       }
       current_buffer_ = 0;
@@ -179,8 +179,8 @@ void Rainbow::RainbowAnalyzer::analyze(QPainter& p, const Analyzer::Scope& s, bo
       QPainter buffer_painter(&buffer_[current_buffer_]);
       buffer_painter.setRenderHint(QPainter::Antialiasing);
 
-      buffer_painter.drawPixmap(0, 0, buffer_[last_buffer], px_per_frame_, 0, x_offset_ + available_rainbow_width_ - px_per_frame_, 0);
-      buffer_painter.fillRect(x_offset_ + available_rainbow_width_ - px_per_frame_, 0, kWidth[rainbowtype] - kRainbowOverlap[rainbowtype] + px_per_frame_, height(), background_brush_);
+      buffer_painter.drawImage(0, 0, buffer_[last_buffer], px_per_frame_, 0, x_offset_ + available_rainbow_width_ - px_per_frame_, 0);
+      buffer_painter.fillRect(x_offset_ + available_rainbow_width_ - px_per_frame_, 0, kWidth[rainbowtype] - kRainbowOverlap[rainbowtype] + px_per_frame_, render_size_.height(), background_brush_);
 
       for (int band = kRainbowBands - 1; band >= 0; --band) {
         buffer_painter.setPen(colors_[band]);
@@ -190,16 +190,16 @@ void Rainbow::RainbowAnalyzer::analyze(QPainter& p, const Analyzer::Scope& s, bo
   }
 
   // Draw the buffer on to the widget
-  p.drawPixmap(0, 0, buffer_[current_buffer_], x_offset_, 0, 0, 0);
+  p.drawImage(0, 0, buffer_[current_buffer_], x_offset_, 0, 0, 0);
 
   // Draw rainbow analyzer (nyan cat or rainbowdash)
   // Nyan nyan nyan nyan dash dash dash dash.
   if (!is_playing_) {
     // Ssshhh!
-    p.drawPixmap(SleepingDestRect(rainbowtype), cat_dash_[rainbowtype], SleepingSourceRect(rainbowtype));
+    p.drawImage(SleepingDestRect(rainbowtype), cat_dash_[rainbowtype], SleepingSourceRect(rainbowtype));
   }
   else {
-    p.drawPixmap(DestRect(rainbowtype), cat_dash_[rainbowtype], SourceRect(rainbowtype));
+    p.drawImage(DestRect(rainbowtype), cat_dash_[rainbowtype], SourceRect(rainbowtype));
   }
 
 }
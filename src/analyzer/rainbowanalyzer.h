@@ -30,7 +30,8 @@
 
 #include <QObject>
 #include <QWidget>
-#include <QPixmap>
+#include <QAtomicInt>
+#include <QImage>
 #include <QPainter>
 #include <QPen>
 #include <QBrush>
@@ -76,7 +77,7 @@ class RainbowAnalyzer : public Analyzer::Base {
   static RainbowType rainbowtype;
 
   inline QRect SourceRect(RainbowType _rainbowtype) const {
-    return QRect(0, kHeight[_rainbowtype] * frame_, kWidth[_rainbowtype], kHeight[_rainbowtype]);
+    return QRect(0, kHeight[_rainbowtype] * frame_.loadAcquire(), kWidth[_rainbowtype], kHeight[_rainbowtype]);
   }
 
   inline QRect SleepingSourceRect(RainbowType _rainbowtype) const {
@@ -84,11 +85,11 @@ class RainbowAnalyzer : public Analyzer::Base {
   }
 
   inline QRect DestRect(RainbowType _rainbowtype) const {
-    return QRect(width() - kWidth[_rainbowtype], (height() - kHeight[_rainbowtype]) / 2, kWidth[_rainbowtype], kHeight[_rainbowtype]);
+    return QRect(render_size_.width() - kWidth[_rainbowtype], (render_size_.height() - kHeight[_rainbowtype]) / 2, kWidth[_rainbowtype], kHeight[_rainbowtype]);
   }
 
   inline QRect SleepingDestRect(RainbowType _rainbowtype) const {
-    return QRect(width() - kWidth[_rainbowtype], (height() - kSleepingHeight[_rainbowtype]) / 2, kWidth[_rainbowtype], kSleepingHeight[_rainbowtype]);
+    return QRect(render_size_.width() - kWidth[_rainbowtype], (render_size_.height() - kSleepingHeight[_rainbowtype]) / 2, kWidth[_rainbowtype], kSleepingHeight[_rainbowtype]);
   }
 
  private:
@@ -97,18 +98,18 @@ class RainbowAnalyzer : public Analyzer::Base {
   QPen colors_[kRainbowBands];
 
   // Rainbow Nyancat & Dash
-  QPixmap cat_dash_[2];
+  QImage cat_dash_[2];
 
   // For the cat or dash animation
   int timer_id_;
-  int frame_;
+  QAtomicInt frame_;
 
   // The y positions of each point on the rainbow.
   float history_[kHistorySize * kRainbowBands];
 
   // A cache of the last frame's rainbow, 
   // so it can be used in the next frame.
-  QPixmap buffer_[2];
+  QImage buffer_[2];
   int current_buffer_;
 
   // Geometry information that's updated on resize:
@@ -46,6 +46,7 @@ const char *SCollection::kSongsTable = "songs";
 const char *SCollection::kDirsTable = "directories";
 const char *SCollection::kSubdirsTable = "subdirectories";
 const char *SCollection::kFtsTable = "songs_fts";
+const char *SCollection::kJournalTable = "subdirectories_journal";
 
 SCollection::SCollection(Application *app, QObject *parent)
     : QObject(parent),
@@ -63,6 +64,7 @@ SCollection::SCollection(Application *app, QObject *parent)
   qLog(Debug) << backend_ << "moved to thread" << app->database()->thread();
 
   backend_->Init(app->database(), Song::Source_Collection, kSongsTable, kDirsTable, kSubdirsTable, kFtsTable);
+  backend_->set_journal_table(kJournalTable);
 
   model_ = new CollectionModel(backend_, app_, this);
 
@@ -50,6 +50,7 @@ class SCollection : public QObject {
   static const char *kDirsTable;
   static const char *kSubdirsTable;
   static const char *kFtsTable;
+  static const char *kJournalTable;
 
   void Init();
   void Exit();
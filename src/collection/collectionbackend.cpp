@@ -24,12 +24,14 @@
 #include <cassert>
 
 #include <QtGlobal>
+#include <QtNumeric>
 #include <QObject>
 #include <QApplication>
 #include <QThread>
 #include <QMutex>
 #include <QSet>
 #include <QMap>
+#include <QHash>
 #include <QVector>
 #include <QVariant>
 #include <QByteArray>
@@ -54,6 +56,9 @@
 
 const char *CollectionBackend::kSettingsGroup = "Collection";
 
+// SQLite before version 3.32 allows at most 999 variables in one statement.
+const int CollectionBackend::kMaxSqlVariables = 999;
+
 CollectionBackend::CollectionBackend(QObject *parent) :
     CollectionBackendInterface(parent),
     db_(nullptr),
@@ -126,8 +131,8 @@ void CollectionBackend::LoadDirectories() {
 
   DirectoryList dirs = GetAllDirectories();
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   for (const Directory &dir : dirs) {
     emit DirectoryDiscovered(dir, SubdirsInDirectory(dir.id, db));
@@ -182,8 +187,8 @@ void CollectionBackend::ChangeDirPath(const int id, const QString &old_path, con
 
 DirectoryList CollectionBackend::GetAllDirectories() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   DirectoryList ret;
 
@@ -205,8 +210,8 @@ DirectoryList CollectionBackend::GetAllDirectories() {
 
 SubdirectoryList CollectionBackend::SubdirsInDirectory(const int id) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db = db_->Connect();
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db = db_->ConnectReadOnly();
   return SubdirsInDirectory(id, db);
 
 }
@@ -234,8 +239,8 @@ SubdirectoryList CollectionBackend::SubdirsInDirectory(const int id, QSqlDatabas
 
 void CollectionBackend::UpdateTotalSongCount() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0").arg(songs_table_));
@@ -249,8 +254,8 @@ void CollectionBackend::UpdateTotalSongCount() {
 
 void CollectionBackend::UpdateTotalArtistCount() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare(QString("select COUNT(distinct artist) from %1 WHERE unavailable = 0").arg(songs_table_));
@@ -264,8 +269,8 @@ void CollectionBackend::UpdateTotalArtistCount() {
 
 void CollectionBackend::UpdateTotalAlbumCount() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare(QString("select COUNT(distinct album) from %1 WHERE unavailable = 0").arg(songs_table_));
@@ -316,6 +321,14 @@ void CollectionBackend::RemoveDirectory(const Directory &dir) {
   q.exec();
   if (db_->CheckErrors(q)) return;
 
+  if (!journal_table_.isEmpty()) {
+    q = QSqlQuery(db);
+    q.prepare(QString("DELETE FROM %1 WHERE directory_id = :id").arg(journal_table_));
+    q.bindValue(":id", dir.id);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+  }
+
   // Now remove the directory itself
   q = QSqlQuery(db);
   q.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(dirs_table_));
@@ -329,11 +342,70 @@ void CollectionBackend::RemoveDirectory(const Directory &dir) {
 
 }
 
-SongList CollectionBackend::FindSongsInDirectory(const int id) {
+QStringList CollectionBackend::JournaledSubdirs(const int id) {
+
+  if (journal_table_.isEmpty()) return QStringList();
+
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT path FROM %1 WHERE directory_id = :id").arg(journal_table_));
+  q.bindValue(":id", id);
+  q.exec();
+  if (db_->CheckErrors(q)) return QStringList();
+
+  QStringList paths;
+  while (q.next()) {
+    paths << q.value(0).toString();
+  }
+
+  return paths;
+
+}
+
+void CollectionBackend::AddToJournal(const int id, const QString &path) {
+
+  if (journal_table_.isEmpty()) return;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare(QString("INSERT INTO %1 (directory_id, path) VALUES (:id, :path)").arg(journal_table_));
+  q.bindValue(":id", id);
+  q.bindValue(":path", path);
+  q.exec();
+  db_->CheckErrors(q);
+
+}
+
+void CollectionBackend::RemoveFromJournal(const int id, const QStringList &paths) {
+
+  if (journal_table_.isEmpty() || paths.isEmpty()) return;
 
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
+  QSqlQuery q(db);
+  q.prepare(QString("DELETE FROM %1 WHERE directory_id = :id AND path = :path").arg(journal_table_));
+
+  ScopedTransaction transaction(&db);
+  for (const QString &path : paths) {
+    q.bindValue(":id", id);
+    q.bindValue(":path", path);
+    q.exec();
+    db_->CheckErrors(q);
+  }
+  transaction.Commit();
+
+}
+
+SongList CollectionBackend::FindSongsInDirectory(const int id) {
+
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
   QSqlQuery q(db);
   q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id").arg(songs_table_));
   q.bindValue(":directory_id", id);
@@ -366,14 +438,10 @@ void CollectionBackend::AddOrUpdateSubdirs(const SubdirectoryList &subdirs) {
 
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
-  QSqlQuery find_query(db);
-  find_query.prepare(QString("SELECT ROWID FROM %1 WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
-  QSqlQuery add_query(db);
-  add_query.prepare(QString("INSERT INTO %1 (directory_id, path, mtime) VALUES (:id, :path, :mtime)").arg(subdirs_table_));
-  QSqlQuery update_query(db);
-  update_query.prepare(QString("UPDATE %1 SET mtime = :mtime WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
-  QSqlQuery delete_query(db);
-  delete_query.prepare(QString("DELETE FROM %1 WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
+  QSqlQuery find_query = db_->PreparedQuery(db, QString("SELECT ROWID FROM %1 WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
+  QSqlQuery add_query = db_->PreparedQuery(db, QString("INSERT INTO %1 (directory_id, path, mtime) VALUES (:id, :path, :mtime)").arg(subdirs_table_));
+  QSqlQuery update_query = db_->PreparedQuery(db, QString("UPDATE %1 SET mtime = :mtime WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
+  QSqlQuery delete_query = db_->PreparedQuery(db, QString("DELETE FROM %1 WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
 
   ScopedTransaction transaction(&db);
   for (const Subdirectory &subdir : subdirs) {
@@ -391,7 +459,9 @@ void CollectionBackend::AddOrUpdateSubdirs(const SubdirectoryList &subdirs) {
       find_query.exec();
       if (db_->CheckErrors(find_query)) continue;
 
-      if (find_query.next()) {
+      const bool exists = find_query.next();
+      find_query.finish();
+      if (exists) {
         update_query.bindValue(":mtime", subdir.mtime);
         update_query.bindValue(":id", subdir.directory_id);
         update_query.bindValue(":path", subdir.path);
@@ -420,53 +490,78 @@ void CollectionBackend::AddOrUpdateSongs(const SongList &songs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery check_dir(db);
-  check_dir.prepare(QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_));
-  QSqlQuery add_song(db);
-  add_song.prepare(QString("INSERT INTO %1 (" + Song::kColumnSpec + ") VALUES (" + Song::kBindSpec + ")").arg(songs_table_));
-  QSqlQuery update_song(db);
-  update_song.prepare(QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id").arg(songs_table_));
-  QSqlQuery add_song_fts(db);
-  add_song_fts.prepare(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ") VALUES (:id, " + Song::kFtsBindSpec + ")").arg(fts_table_));
-  QSqlQuery update_song_fts(db);
-  update_song_fts.prepare(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec + " WHERE ROWID = :id").arg(fts_table_));
+  // Look up the directories and the existing songs for the whole batch first, instead of once per song.
+  QSet<int> directory_ids;
+  if (!dirs_table_.isEmpty()) {
+    QSqlQuery q = db_->PreparedQuery(db, QString("SELECT ROWID FROM %1").arg(dirs_table_));
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+    while (q.next()) {
+      directory_ids.insert(q.value(0).toInt());
+    }
+    q.finish();
+  }
+
+  // A song that is in the batch more than once would be written twice, keep the last version of it.
+  SongList unique_songs;
+  QHash<int, int> index_by_id;
+  QHash<QString, int> index_by_song_id;
+  QStringList ids;
+  QStringList song_ids;
+  for (const Song &song : songs) {
+    if (song.id() != -1) {
+      if (index_by_id.contains(song.id())) {
+        unique_songs[index_by_id[song.id()]] = song;
+        continue;
+      }
+      index_by_id.insert(song.id(), unique_songs.count());
+      ids << QString::number(song.id());
+    }
+    else if (!song.song_id().isEmpty()) {
+      if (index_by_song_id.contains(song.song_id())) {
+        unique_songs[index_by_song_id[song.song_id()]] = song;
+        continue;
+      }
+      index_by_song_id.insert(song.song_id(), unique_songs.count());
+      song_ids << song.song_id();
+    }
+    unique_songs << song;
+  }
+
+  QHash<int, Song> old_songs_by_id;
+  if (!ids.isEmpty()) {
+    for (const Song &song : GetSongsById(ids, db)) {
+      old_songs_by_id.insert(song.id(), song);
+    }
+  }
+  QHash<QString, Song> old_songs_by_song_id;
+  if (!song_ids.isEmpty()) {
+    for (const Song &song : GetSongsBySongId(song_ids, db)) {
+      old_songs_by_song_id.insert(song.song_id(), song);
+    }
+  }
+
+  QSqlQuery add_song = db_->PreparedQuery(db, QString("INSERT INTO %1 (" + Song::kColumnSpec + ") VALUES (" + Song::kBindSpec + ")").arg(songs_table_));
 
   ScopedTransaction transaction(&db);
 
-  SongList added_songs;
-  SongList deleted_songs;
+  SongList new_songs;
+  SongList updated_songs;
+  QHash<int, Song> old_songs;
 
-  for (const Song &song : songs) {
+  for (const Song &song : unique_songs) {
 
     // Do a sanity check first - make sure the song's directory still exists
     // This is to fix a possible race condition when a directory is removed while CollectionWatcher is scanning it.
-    if (!dirs_table_.isEmpty()) {
-      check_dir.bindValue(":id", song.directory_id());
-      check_dir.exec();
-      if (db_->CheckErrors(check_dir)) continue;
-
-      if (!check_dir.next()) continue;  // Directory didn't exist
-    }
+    if (!dirs_table_.isEmpty() && !directory_ids.contains(song.directory_id())) continue;  // Directory didn't exist
 
     if (song.id() != -1) {  // This song exists in the DB.
 
       // Get the previous song data first
-      Song old_song(GetSongById(song.id()));
-      if (!old_song.is_valid()) continue;
-
-      // Update
-      song.BindToQuery(&update_song);
-      update_song.bindValue(":id", song.id());
-      update_song.exec();
-      if (db_->CheckErrors(update_song)) continue;
+      if (!old_songs_by_id.contains(song.id())) continue;
 
-      song.BindToFtsQuery(&update_song_fts);
-      update_song_fts.bindValue(":id", song.id());
-      update_song_fts.exec();
-      if (db_->CheckErrors(update_song_fts)) continue;
-
-      deleted_songs << old_song;
-      added_songs << song;
+      old_songs.insert(song.id(), old_songs_by_id.value(song.id()));
+      updated_songs << song;
 
       continue;
 
@@ -474,25 +569,18 @@ void CollectionBackend::AddOrUpdateSongs(const SongList &songs) {
     else if (!song.song_id().isEmpty()) {  // Song has a unique id, check if the song exists.
 
       // Get the previous song data first
-      Song old_song(GetSongBySongId(song.song_id()));
+      const Song old_song = old_songs_by_song_id.value(song.song_id());
 
       if (old_song.is_valid() && old_song.id() != -1) {
 
+        // The same row might also be in the batch by its ID.
+        if (old_songs.contains(old_song.id())) continue;
+
         Song new_song = song;
         new_song.set_id(old_song.id());
-        // Update
-        new_song.BindToQuery(&update_song);
-        update_song.bindValue(":id", new_song.id());
-        update_song.exec();
-        if (db_->CheckErrors(update_song)) continue;
-
-        new_song.BindToFtsQuery(&update_song_fts);
-        update_song_fts.bindValue(":id", new_song.id());
-        update_song_fts.exec();
-        if (db_->CheckErrors(update_song_fts)) continue;
 
-        deleted_songs << old_song;
-        added_songs << new_song;
+        old_songs.insert(old_song.id(), old_song);
+        updated_songs << new_song;
 
         continue;
 
@@ -510,17 +598,35 @@ void CollectionBackend::AddOrUpdateSongs(const SongList &songs) {
     // Get the new ID
     const int id = add_song.lastInsertId().toInt();
 
-    // Add to the FTS index
-    add_song_fts.bindValue(":id", id);
-    song.BindToFtsQuery(&add_song_fts);
-    add_song_fts.exec();
-    if (db_->CheckErrors(add_song_fts)) continue;
-
     Song copy(song);
     copy.set_id(id);
-    added_songs << copy;
+    new_songs << copy;
+
+  }
+
+  // Write the updated songs over their old rows, and add the new songs to the FTS index, with as few statements as possible.
+  // Only the songs that were written are announced, a chunk that failed leaves its rows as they were.
+  SongList added_songs = ReplaceSongs(updated_songs, db);
+
+  SongList deleted_songs;
+  for (const Song &song : added_songs) {
+    deleted_songs << old_songs.value(song.id());
+  }
 
+  const SongList indexed_songs = InsertFts(new_songs, db);
+  if (indexed_songs.count() != new_songs.count()) {
+    // Don't keep rows that are missing from the FTS index.
+    QSet<int> indexed_ids;
+    for (const Song &song : indexed_songs) indexed_ids.insert(song.id());
+    QSqlQuery remove = db_->PreparedQuery(db, QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_));
+    for (const Song &song : new_songs) {
+      if (indexed_ids.contains(song.id())) continue;
+      remove.bindValue(":id", song.id());
+      remove.exec();
+      db_->CheckErrors(remove);
+    }
   }
+  added_songs << indexed_songs;
 
   transaction.Commit();
 
@@ -534,13 +640,113 @@ void CollectionBackend::AddOrUpdateSongs(const SongList &songs) {
 
 }
 
+QString CollectionBackend::MultiRowInsertStatement(const QString &command, const QString &table, const QString &column_spec, const int column_count, const int row_count) {
+
+  QString row = QString("?, ").repeated(column_count);
+  row.chop(2);
+
+  QStringList rows;
+  rows.reserve(row_count);
+  for (int i = 0; i < row_count; ++i) {
+    rows << "(" + row + ")";
+  }
+
+  return QString("%1 INTO %2 (%3) VALUES %4").arg(command, table, column_spec, rows.join(", "));
+
+}
+
+SongList CollectionBackend::ReplaceSongs(const SongList &songs, QSqlDatabase &db) {
+
+  SongList replaced_songs;
+
+  const int column_count = Song::kColumns.count() + 1;
+  const int fts_column_count = Song::kFtsColumns.count() + 1;
+  const int rows_per_statement = kMaxSqlVariables / column_count;
+
+  for (int i = 0; i < songs.count(); i += rows_per_statement) {
+    const SongList chunk = songs.mid(i, rows_per_statement);
+
+    QSqlQuery replace_songs = db_->PreparedQuery(db, MultiRowInsertStatement("INSERT OR REPLACE", songs_table_, "ROWID, " + Song::kColumnSpec, column_count, chunk.count()));
+    QSqlQuery replace_songs_fts = db_->PreparedQuery(db, MultiRowInsertStatement("INSERT OR REPLACE", fts_table_, "ROWID, " + Song::kFtsColumnSpec, fts_column_count, chunk.count()));
+
+    int position = 0;
+    int fts_position = 0;
+    for (const Song &song : chunk) {
+      replace_songs.bindValue(position++, song.id());
+      for (const QVariant &value : song.ColumnValues()) {
+        replace_songs.bindValue(position++, value);
+      }
+      replace_songs_fts.bindValue(fts_position++, song.id());
+      for (const QVariant &value : song.FtsColumnValues()) {
+        replace_songs_fts.bindValue(fts_position++, value);
+      }
+    }
+
+    // Both statements are undone if either fails, so the songs and the FTS index stay in step.
+    QSqlQuery savepoint(db);
+    savepoint.exec("SAVEPOINT replace_songs");
+    if (db_->CheckErrors(savepoint)) continue;
+
+    replace_songs.exec();
+    bool failed = db_->CheckErrors(replace_songs);
+    if (!failed) {
+      replace_songs_fts.exec();
+      failed = db_->CheckErrors(replace_songs_fts);
+    }
+    if (failed) {
+      savepoint.exec("ROLLBACK TO replace_songs");
+      db_->CheckErrors(savepoint);
+      savepoint.exec("RELEASE replace_songs");
+      db_->CheckErrors(savepoint);
+      continue;
+    }
+
+    savepoint.exec("RELEASE replace_songs");
+    if (db_->CheckErrors(savepoint)) continue;
+
+    replaced_songs << chunk;
+  }
+
+  return replaced_songs;
+
+}
+
+SongList CollectionBackend::InsertFts(const SongList &songs, QSqlDatabase &db) {
+
+  SongList inserted_songs;
+
+  const int column_count = Song::kFtsColumns.count() + 1;
+  const int rows_per_statement = kMaxSqlVariables / column_count;
+
+  for (int i = 0; i < songs.count(); i += rows_per_statement) {
+    const SongList chunk = songs.mid(i, rows_per_statement);
+
+    QSqlQuery add_songs_fts = db_->PreparedQuery(db, MultiRowInsertStatement("INSERT", fts_table_, "ROWID, " + Song::kFtsColumnSpec, column_count, chunk.count()));
+
+    int position = 0;
+    for (const Song &song : chunk) {
+      add_songs_fts.bindValue(position++, song.id());
+      for (const QVariant &value : song.FtsColumnValues()) {
+        add_songs_fts.bindValue(position++, value);
+      }
+    }
+
+    add_songs_fts.exec();
+    if (db_->CheckErrors(add_songs_fts)) continue;
+
+    inserted_songs << chunk;
+  }
+
+  return inserted_songs;
+
+}
+
 void CollectionBackend::UpdateMTimesOnly(const SongList &songs) {
 
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(db);
-  q.prepare(QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id").arg(songs_table_));
+  QSqlQuery q = db_->PreparedQuery(db, QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id").arg(songs_table_));
 
   ScopedTransaction transaction(&db);
   for (const Song &song : songs) {
@@ -558,10 +764,8 @@ void CollectionBackend::DeleteSongs(const SongList &songs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery remove(db);
-  remove.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_));
-  QSqlQuery remove_fts(db);
-  remove_fts.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_));
+  QSqlQuery remove = db_->PreparedQuery(db, QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_));
+  QSqlQuery remove_fts = db_->PreparedQuery(db, QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_));
 
   ScopedTransaction transaction(&db);
   for (const Song &song : songs) {
@@ -588,8 +792,7 @@ void CollectionBackend::MarkSongsUnavailable(const SongList &songs, const bool u
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery remove(db);
-  remove.prepare(QString("UPDATE %1 SET unavailable = %2 WHERE ROWID = :id").arg(songs_table_).arg(int(unavailable)));
+  QSqlQuery remove = db_->PreparedQuery(db, QString("UPDATE %1 SET unavailable = %2 WHERE ROWID = :id").arg(songs_table_).arg(int(unavailable)));
 
   ScopedTransaction transaction(&db);
   for (const Song &song : songs) {
@@ -612,7 +815,7 @@ QStringList CollectionBackend::GetAll(const QString &column, const QueryOptions
   query.SetColumnSpec("DISTINCT " + column);
   query.AddCompilationRequirement(false);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -644,7 +847,7 @@ QStringList CollectionBackend::GetAllArtistsWithAlbums(const QueryOptions &opt)
   query2.AddWhere("albumartist", "", "=");
 
   {
-    QMutexLocker l(db_->Mutex());
+    QMutexLocker l(db_->ReadMutex());
     if (!ExecQuery(&query) || !ExecQuery(&query2)) {
       return QStringList();
     }
@@ -689,7 +892,7 @@ SongList CollectionBackend::GetSongs(const QString &artist, const QString &album
 SongList CollectionBackend::ExecCollectionQuery(CollectionQuery *query) {
 
   query->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(query)) return SongList();
 
   SongList ret;
@@ -703,14 +906,14 @@ SongList CollectionBackend::ExecCollectionQuery(CollectionQuery *query) {
 }
 
 Song CollectionBackend::GetSongById(const int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
   return GetSongById(id, db);
 }
 
 SongList CollectionBackend::GetSongsById(const QList<int> &ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QStringList str_ids;
   for (int id : ids) {
@@ -721,16 +924,16 @@ SongList CollectionBackend::GetSongsById(const QList<int> &ids) {
 }
 
 SongList CollectionBackend::GetSongsById(const QStringList &ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   return GetSongsById(ids, db);
 }
 
 SongList CollectionBackend::GetSongsByForeignId(const QStringList &ids, const QString &table, const QString &column) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QString in = ids.join(",");
 
@@ -778,8 +981,8 @@ SongList CollectionBackend::GetSongsById(const QStringList &ids, QSqlDatabase &d
 
 Song CollectionBackend::GetSongByUrl(const QUrl &url, const qint64 beginning) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND beginning = :beginning AND unavailable = 0").arg(songs_table_));
@@ -801,8 +1004,8 @@ Song CollectionBackend::GetSongByUrl(const QUrl &url, const qint64 beginning) {
 
 SongList CollectionBackend::GetSongsByUrl(const QUrl &url) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND unavailable = 0").arg(songs_table_));
@@ -828,16 +1031,16 @@ SongList CollectionBackend::GetSongsByUrl(const QUrl &url) {
 
 Song CollectionBackend::GetSongBySongId(const QString &song_id) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
   return GetSongBySongId(song_id, db);
 
 }
 
 SongList CollectionBackend::GetSongsBySongId(const QStringList &song_ids) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   return GetSongsBySongId(song_ids, db);
 
@@ -885,7 +1088,7 @@ SongList CollectionBackend::GetCompilationSongs(const QString &album, const Quer
   query.AddCompilationRequirement(true);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return SongList();
 
   SongList ret;
@@ -1018,7 +1221,7 @@ CollectionBackend::AlbumList CollectionBackend::GetAlbums(const QString &artist,
   }
 
   {
-    QMutexLocker l(db_->Mutex());
+    QMutexLocker l(db_->ReadMutex());
     if (!ExecQuery(&query)) return AlbumList();
   }
 
@@ -1087,7 +1290,7 @@ CollectionBackend::Album CollectionBackend::GetAlbumArt(const QString &artist, c
   }
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return ret;
 
   if (query.Next()) {
@@ -1123,7 +1326,7 @@ void CollectionBackend::UpdateManualAlbumArt(const QString &artist, const QStrin
     query.AddWhere("artist", artist);
   }
 
-  if (!ExecQuery(&query)) return;
+  if (!ExecQuery(&query, db)) return;
 
   SongList deleted_songs;
   while (query.Next()) {
@@ -1157,7 +1360,7 @@ void CollectionBackend::UpdateManualAlbumArt(const QString &artist, const QStrin
   db_->CheckErrors(q);
 
   // Now get the updated songs
-  if (!ExecQuery(&query)) return;
+  if (!ExecQuery(&query, db)) return;
 
   SongList added_songs;
   while (query.Next()) {
@@ -1186,7 +1389,7 @@ void CollectionBackend::ForceCompilation(const QString &album, const QList<QStri
     query.AddWhere("album", album);
     if (!artist.isEmpty()) query.AddWhere("artist", artist);
 
-    if (!ExecQuery(&query)) return;
+    if (!ExecQuery(&query, db)) return;
 
     while (query.Next()) {
       Song song(source_);
@@ -1209,7 +1412,7 @@ void CollectionBackend::ForceCompilation(const QString &album, const QList<QStri
     db_->CheckErrors(q);
 
     // Now get the updated songs
-    if (!ExecQuery(&query)) return;
+    if (!ExecQuery(&query, db)) return;
 
     while (query.Next()) {
       Song song(source_);
@@ -1226,7 +1429,11 @@ void CollectionBackend::ForceCompilation(const QString &album, const QList<QStri
 }
 
 bool CollectionBackend::ExecQuery(CollectionQuery *q) {
-  return !db_->CheckErrors(q->Exec(db_->Connect(), songs_table_, fts_table_));
+  return !db_->CheckErrors(q->Exec(db_->ConnectReadOnly(), songs_table_, fts_table_));
+}
+
+bool CollectionBackend::ExecQuery(CollectionQuery *q, QSqlDatabase &db) {
+  return !db_->CheckErrors(q->Exec(db, songs_table_, fts_table_));
 }
 
 void CollectionBackend::IncrementPlayCount(const int id) {
@@ -1308,10 +1515,56 @@ void CollectionBackend::DeleteAll() {
 
 }
 
+QList<int> CollectionBackend::GetSongIdsWithoutReplayGain() {
+
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QList<int> ids;
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT ROWID FROM %1 WHERE replaygain_track_gain IS NULL AND replaygain_failed_mtime != mtime AND unavailable = 0").arg(songs_table_));
+  q.exec();
+  if (db_->CheckErrors(q)) return ids;
+  while (q.next()) {
+    ids << q.value(0).toInt();
+  }
+
+  return ids;
+
+}
+
+SongList CollectionBackend::GetSongsOnSameAlbums(const QList<int> &ids) {
+
+  if (ids.isEmpty()) return SongList();
+
+  QStringList str_ids;
+  for (int id : ids) {
+    str_ids << QString::number(id);
+  }
+  const QString in = str_ids.join(",");
+
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE unavailable = 0 AND (ROWID IN (%2) OR (album != '' AND album IN (SELECT album FROM %1 WHERE ROWID IN (%2))))").arg(songs_table_, in));
+  q.exec();
+  if (db_->CheckErrors(q)) return SongList();
+
+  SongList ret;
+  while (q.next()) {
+    Song song(source_);
+    song.InitFromQuery(q, true);
+    ret << song;
+  }
+  return ret;
+
+}
+
 SongList CollectionBackend::FindSongs(const SmartPlaylistSearch &search) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   // Build the query
   QString sql = search.ToSql(songs_table());
@@ -1340,10 +1593,46 @@ SongList CollectionBackend::GetAllSongs() {
 
 }
 
+QMap<int, QUrl> CollectionBackend::GetSongUrlsAfterId(const int id, const int limit) {
+
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QMap<int, QUrl> urls;
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT ROWID, url FROM %1 WHERE ROWID > :id AND unavailable = 0 ORDER BY ROWID LIMIT :limit").arg(songs_table_));
+  q.bindValue(":id", id);
+  q.bindValue(":limit", limit);
+  q.exec();
+  if (db_->CheckErrors(q)) return urls;
+  while (q.next()) {
+    urls.insert(q.value(0).toInt(), QUrl::fromEncoded(q.value(1).toByteArray()));
+  }
+
+  return urls;
+
+}
+
+int CollectionBackend::GetSongCountAfterId(const int id) {
+
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT COUNT(*) FROM %1 WHERE ROWID > :id AND unavailable = 0").arg(songs_table_));
+  q.bindValue(":id", id);
+  q.exec();
+  if (db_->CheckErrors(q)) return 0;
+  if (!q.next()) return 0;
+
+  return q.value(0).toInt();
+
+}
+
 SongList CollectionBackend::GetSongsBy(const QString &artist, const QString &album, const QString &title) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   SongList songs;
   QSqlQuery q(db);
@@ -1448,6 +1737,66 @@ void CollectionBackend::UpdateSongsRating(const QList<int> &id_list, const float
 
 }
 
+void CollectionBackend::UpdateSongsReplayGain(const SongList &songs) {
+
+  if (songs.isEmpty()) return;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q = db_->PreparedQuery(db, QString("UPDATE %1 SET replaygain_track_gain = :track_gain, replaygain_track_peak = :track_peak, replaygain_album_gain = :album_gain, replaygain_album_peak = :album_peak WHERE ROWID = :id").arg(songs_table_));
+
+  ScopedTransaction transaction(&db);
+
+  QStringList id_str_list;
+  for (const Song &song : songs) {
+    if (song.id() == -1) continue;
+    q.bindValue(":track_gain", qIsNaN(song.replaygain_track_gain()) ? QVariant() : song.replaygain_track_gain());
+    q.bindValue(":track_peak", qIsNaN(song.replaygain_track_peak()) ? QVariant() : song.replaygain_track_peak());
+    q.bindValue(":album_gain", qIsNaN(song.replaygain_album_gain()) ? QVariant() : song.replaygain_album_gain());
+    q.bindValue(":album_peak", qIsNaN(song.replaygain_album_peak()) ? QVariant() : song.replaygain_album_peak());
+    q.bindValue(":id", song.id());
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+    id_str_list << QString::number(song.id());
+  }
+
+  transaction.Commit();
+
+  emit SongsReplayGainChanged(GetSongsById(id_str_list, db));
+
+}
+
+void CollectionBackend::UpdateSongsReplayGainAsync(const SongList &songs) {
+  metaObject()->invokeMethod(this, "UpdateSongsReplayGain", Qt::QueuedConnection, Q_ARG(SongList, songs));
+}
+
+void CollectionBackend::SetSongsReplayGainFailed(const SongList &songs) {
+
+  if (songs.isEmpty()) return;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q = db_->PreparedQuery(db, QString("UPDATE %1 SET replaygain_failed_mtime = mtime WHERE ROWID = :id").arg(songs_table_));
+
+  ScopedTransaction transaction(&db);
+
+  for (const Song &song : songs) {
+    if (song.id() == -1) continue;
+    q.bindValue(":id", song.id());
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+  }
+
+  transaction.Commit();
+
+}
+
+void CollectionBackend::SetSongsReplayGainFailedAsync(const SongList &songs) {
+  metaObject()->invokeMethod(this, "SetSongsReplayGainFailed", Qt::QueuedConnection, Q_ARG(SongList, songs));
+}
+
 void CollectionBackend::UpdateSongRatingAsync(const int id, const float rating) {
   metaObject()->invokeMethod(this, "UpdateSongRating", Qt::QueuedConnection, Q_ARG(int, id), Q_ARG(float, rating));
 }
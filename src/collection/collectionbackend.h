@@ -28,6 +28,7 @@
 #include <QObject>
 #include <QFileInfo>
 #include <QList>
+#include <QMap>
 #include <QString>
 #include <QStringList>
 #include <QUrl>
@@ -119,6 +120,7 @@ class CollectionBackend : public CollectionBackendInterface {
 
  public:
   static const char *kSettingsGroup;
+  static const int kMaxSqlVariables;
 
   Q_INVOKABLE explicit CollectionBackend(QObject *parent = nullptr);
 
@@ -133,6 +135,10 @@ class CollectionBackend : public CollectionBackendInterface {
   QString dirs_table() const { return dirs_table_; }
   QString subdirs_table() const { return subdirs_table_; }
 
+  // The journal records the subdirectories reported changed by the file system watcher until they are scanned.
+  void set_journal_table(const QString &journal_table) { journal_table_ = journal_table; }
+  bool has_journal() const { return !journal_table_.isEmpty(); }
+
   // Get a list of directories in the collection.  Emits DirectoriesDiscovered.
   void LoadDirectoriesAsync() override;
 
@@ -171,6 +177,10 @@ class CollectionBackend : public CollectionBackendInterface {
   void AddDirectory(const QString &path) override;
   void RemoveDirectory(const Directory &dir) override;
 
+  QStringList JournaledSubdirs(const int id);
+  void AddToJournal(const int id, const QString &path);
+  void RemoveFromJournal(const int id, const QStringList &paths);
+
   bool ExecQuery(CollectionQuery *q) override;
   SongList ExecCollectionQuery(CollectionQuery *query);
 
@@ -184,6 +194,13 @@ class CollectionBackend : public CollectionBackendInterface {
   SongList GetSongsBySongId(const QStringList &song_ids);
 
   SongList GetAllSongs();
+  // Returns the URLs of up to limit available songs with a ROWID above the given one, keyed by ROWID.
+  QMap<int, QUrl> GetSongUrlsAfterId(const int id, const int limit);
+  int GetSongCountAfterId(const int id);
+  // Returns the IDs of the songs without ReplayGain, except the ones that couldn't be analysed since they last changed.
+  QList<int> GetSongIdsWithoutReplayGain();
+  // Returns the given songs and the other songs on the same albums.
+  SongList GetSongsOnSameAlbums(const QList<int> &ids);
   SongList FindSongs(const SmartPlaylistSearch &search);
 
   Song::Source Source() const;
@@ -193,6 +210,9 @@ class CollectionBackend : public CollectionBackendInterface {
   void UpdateSongRatingAsync(const int id, const float rating);
   void UpdateSongsRatingAsync(const QList<int> &ids, const float rating);
 
+  void UpdateSongsReplayGainAsync(const SongList &songs);
+  void SetSongsReplayGainFailedAsync(const SongList &songs);
+
  public slots:
   void Exit();
   void LoadDirectories();
@@ -219,6 +239,11 @@ class CollectionBackend : public CollectionBackendInterface {
   void UpdateSongRating(const int id, const float rating);
   void UpdateSongsRating(const QList<int> &id_list, const float rating);
 
+  // Stores the ReplayGain values of the songs, which must have an ID.
+  void UpdateSongsReplayGain(const SongList &songs);
+  // Marks that the loudness of the songs couldn't be analysed, GetSongIdsWithoutReplayGain() skips them until their mtime changes.
+  void SetSongsReplayGainFailed(const SongList &songs);
+
  signals:
   void DirectoryDiscovered(Directory, SubdirectoryList);
   void DirectoryDeleted(Directory);
@@ -233,6 +258,7 @@ class CollectionBackend : public CollectionBackendInterface {
   void TotalArtistCountUpdated(int);
   void TotalAlbumCountUpdated(int);
   void SongsRatingChanged(SongList);
+  void SongsReplayGainChanged(SongList);
 
   void ExitFinished();
 
@@ -248,10 +274,19 @@ class CollectionBackend : public CollectionBackendInterface {
   };
 
   void UpdateCompilations(QSqlQuery &find_song, QSqlQuery &update_song, SongList &deleted_songs, SongList &added_songs, const QUrl &url, const bool compilation_detected);
+  static QString MultiRowInsertStatement(const QString &command, const QString &table, const QString &column_spec, const int column_count, const int row_count);
+  // Writes the songs over the rows with the same ROWID. Returns the songs that were written.
+  SongList ReplaceSongs(const SongList &songs, QSqlDatabase &db);
+  // Adds the songs to the FTS table. Returns the songs that were added.
+  SongList InsertFts(const SongList &songs, QSqlDatabase &db);
+
   AlbumList GetAlbums(const QString &artist, const QString &album_artist, const bool compilation_required = false, const QueryOptions &opt = QueryOptions());
   AlbumList GetAlbums(const QString &artist, const bool compilation_required, const QueryOptions &opt = QueryOptions());
   SubdirectoryList SubdirsInDirectory(const int id, QSqlDatabase &db);
 
+  // Runs the query on the given connection instead of a read-only one, for reads that need to see the caller's own writes in order.
+  bool ExecQuery(CollectionQuery *q, QSqlDatabase &db);
+
   Song GetSongById(const int id, QSqlDatabase &db);
   SongList GetSongsById(const QStringList &ids, QSqlDatabase &db);
 
@@ -265,6 +300,7 @@ class CollectionBackend : public CollectionBackendInterface {
   QString dirs_table_;
   QString subdirs_table_;
   QString fts_table_;
+  QString journal_table_;
   QThread *original_thread_;
 
 };
@@ -29,6 +29,7 @@
 #include <QtGlobal>
 #include <QtConcurrent>
 #include <QThread>
+#include <QTimer>
 #include <QMutex>
 #include <QFuture>
 #include <QDataStream>
@@ -52,10 +53,10 @@
 #include <QtDebug>
 
 #include "core/application.h"
-#include "core/closure.h"
 #include "core/database.h"
 #include "core/iconloader.h"
 #include "core/logging.h"
+#include "core/stringpool.h"
 #include "core/taskmanager.h"
 #include "collectionquery.h"
 #include "collectionbackend.h"
@@ -75,6 +76,10 @@ using std::placeholders::_2;
 const char *CollectionModel::kSavedGroupingsSettingsGroup = "SavedGroupings";
 const int CollectionModel::kPrettyCoverSize = 32;
 const char *CollectionModel::kPixmapDiskCacheDir = "pixmapcache";
+const int CollectionModel::kResetChunkSize = 500;
+const int CollectionModel::kResetChunksInFlight = 4;
+const int CollectionModel::kPruneDelayMsec = 10000;
+const int CollectionModel::kPruneIntervalMsec = 1800000;
 
 QNetworkDiskCache *CollectionModel::sIconCache = nullptr;
 
@@ -93,10 +98,20 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
       use_pretty_covers_(true),
       show_dividers_(true),
       use_disk_cache_(false),
-      use_lazy_loading_(true) {
+      use_lazy_loading_(true),
+      reset_generation_(0),
+      reset_streaming_(false),
+      reset_started_(false),
+      reset_chunks_free_(kResetChunksInFlight),
+      prune_timer_(new QTimer(this)) {
 
   root_->lazy_loaded = true;
 
+  // Songs that are changed in place also leave unused strings behind, so prune now and then even without deletions.
+  prune_timer_->setSingleShot(true);
+  connect(prune_timer_, SIGNAL(timeout()), SLOT(PruneStringPool()));
+  prune_timer_->start(kPruneIntervalMsec);
+
   group_by_[0] = GroupBy_AlbumArtist;
   group_by_[1] = GroupBy_AlbumDisc;
   group_by_[2] = GroupBy_None;
@@ -128,6 +143,7 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
   connect(backend_, SIGNAL(TotalAlbumCountUpdated(int)), SLOT(TotalAlbumCountUpdatedSlot(int)));
   connect(backend_, SIGNAL(SongsStatisticsChanged(SongList)), SLOT(SongsSlightlyChanged(SongList)));
   connect(backend_, SIGNAL(SongsRatingChanged(SongList)), SLOT(SongsSlightlyChanged(SongList)));
+  connect(backend_, SIGNAL(SongsReplayGainChanged(SongList)), SLOT(SongsSlightlyChanged(SongList)));
 
   backend_->UpdateTotalSongCountAsync();
   backend_->UpdateTotalArtistCountAsync();
@@ -138,7 +154,16 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
 }
 
 CollectionModel::~CollectionModel() {
+
+  // Stop any reset that's still streaming, it might be waiting for us to take its chunks.
+  reset_generation_.ref();
+  reset_chunks_free_.release(kResetChunksInFlight);
+  for (QFuture<void> &future : reset_futures_) {
+    future.waitForFinished();
+  }
+
   delete root_;
+
 }
 
 void CollectionModel::set_pretty_covers(const bool use_pretty_covers) {
@@ -220,6 +245,11 @@ void CollectionModel::Init(const bool async) {
 
 void CollectionModel::SongsDiscovered(const SongList &songs) {
 
+  if (reset_streaming_) {
+    pending_changes_ << PendingChange(PendingChange::Type_Discovered, songs);
+    return;
+  }
+
   for (const Song &song : songs) {
 
     // Sanity check to make sure we don't add songs that are outside the user's filter
@@ -350,6 +380,11 @@ void CollectionModel::SongsDiscovered(const SongList &songs) {
 
 void CollectionModel::SongsSlightlyChanged(const SongList &songs) {
 
+  if (reset_streaming_) {
+    pending_changes_ << PendingChange(PendingChange::Type_SlightlyChanged, songs);
+    return;
+  }
+
   // This is called if there was a minor change to the songs that will not normally require the collection to be restructured.
   // We can just update our internal cache of Song objects without worrying about resetting the model.
   for (const Song &song : songs) {
@@ -492,6 +527,11 @@ QString CollectionModel::DividerDisplayText(const GroupBy type, const QString &k
 
 void CollectionModel::SongsDeleted(const SongList &songs) {
 
+  if (reset_streaming_) {
+    pending_changes_ << PendingChange(PendingChange::Type_Deleted, songs);
+    return;
+  }
+
   // Delete the actual song nodes first, keeping track of each parent so we might check to see if they're empty later.
   QSet<CollectionItem*> parents;
   for (const Song &song : songs) {
@@ -590,6 +630,12 @@ void CollectionModel::SongsDeleted(const SongList &songs) {
     divider_nodes_.remove(divider_key);
   }
 
+
+  // The songs are still referenced until this returns, prune a bit later, once for a whole batch of deletions.
+  if (!prune_timer_->isActive() || prune_timer_->remainingTime() > kPruneDelayMsec) {
+    prune_timer_->start(kPruneDelayMsec);
+  }
+
 }
 
 QString CollectionModel::AlbumIconPixmapCacheKey(const QModelIndex &idx) const {
@@ -802,7 +848,7 @@ bool CollectionModel::HasCompilations(const CollectionQuery &query) {
   q.AddCompilationRequirement(true);
   q.SetLimit(1);
 
-  QMutexLocker l(backend_->db()->Mutex());
+  QMutexLocker l(backend_->db()->ReadMutex());
   if (!backend_->ExecQuery(&q)) return false;
 
   return q.Next();
@@ -813,46 +859,52 @@ CollectionModel::QueryResult CollectionModel::RunQuery(CollectionItem *parent) {
 
   QueryResult result;
 
+  CollectionQuery q(query_options_);
+  PrepareQuery(parent, &q, &result);
+
+  // Execute the query
+  QMutexLocker l(backend_->db()->ReadMutex());
+  if (backend_->ExecQuery(&q)) {
+    while (q.Next()) {
+      result.rows << SqlRow(q);
+    }
+  }
+
+  if (QThread::currentThread() != thread() && QThread::currentThread() != backend_->thread()) {
+    backend_->Close();
+  }
+
+  return result;
+
+}
+
+void CollectionModel::PrepareQuery(CollectionItem *parent, CollectionQuery *q, QueryResult *result) {
+
   // Information about what we want the children to be
-  int child_level = parent == root_ ? 0 : parent->container_level + 1;
+  int child_level = !parent || parent == root_ ? 0 : parent->container_level + 1;
   GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
 
   // Initialize the query.  child_type says what type of thing we want (artists, songs, etc.)
-  CollectionQuery q(query_options_);
-  InitQuery(child_type, &q);
+  InitQuery(child_type, q);
 
   // Walk up through the item's parents adding filters as necessary
   CollectionItem *p = parent;
   while (p && p->type == CollectionItem::Type_Container) {
-    FilterQuery(group_by_[p->container_level], p, &q);
+    FilterQuery(group_by_[p->container_level], p, q);
     p = p->parent;
   }
 
   // Artists GroupBy is special - we don't want compilation albums appearing
   if (IsArtistGroupBy(child_type)) {
     // Add the special Various artists node
-    if (show_various_artists_ && HasCompilations(q)) {
-      result.create_va = true;
+    if (show_various_artists_ && HasCompilations(*q)) {
+      result->create_va = true;
     }
 
     // Don't show compilations again outside the Various artists node
-    q.AddCompilationRequirement(false);
-  }
-
-  // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
-  if (backend_->ExecQuery(&q)) {
-    while (q.Next()) {
-      result.rows << SqlRow(q);
-    }
-  }
-
-  if (QThread::currentThread() != thread() && QThread::currentThread() != backend_->thread()) {
-    backend_->Close();
+    q->AddCompilationRequirement(false);
   }
 
-  return result;
-
 }
 
 void CollectionModel::PostQuery(CollectionItem *parent, const CollectionModel::QueryResult &result, const bool signal) {
@@ -892,22 +944,107 @@ void CollectionModel::LazyPopulate(CollectionItem *parent, const bool signal) {
 }
 
 void CollectionModel::ResetAsync() {
-  QFuture<CollectionModel::QueryResult> future = QtConcurrent::run(std::bind(&CollectionModel::RunQuery, this, root_));
-  NewClosure(future, this, SLOT(ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResult>)), future);
+
+  // Results from a reset that's still running are thrown away.
+  const int generation = reset_generation_.fetchAndAddOrdered(1) + 1;
+  reset_streaming_ = true;
+  reset_started_ = false;
+
+  for (QList<QFuture<void>>::iterator it = reset_futures_.begin(); it != reset_futures_.end();) {
+    if (it->isFinished()) it = reset_futures_.erase(it);
+    else ++it;
+  }
+  reset_futures_ << QtConcurrent::run(std::bind(&CollectionModel::StreamResetQuery, this, generation));
+
 }
 
-void CollectionModel::ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResult> future) {
+void CollectionModel::StreamResetQuery(const int generation) {
+
+  QueryResult result;
+
+  CollectionQuery q(query_options_);
+  PrepareQuery(nullptr, &q, &result);
+
+  {
+    // Only wait for the GUI thread to catch up when the reads don't hold the database mutex, otherwise the GUI thread could be waiting for it.
+    const bool throttled = backend_->db()->ReadMutex() == nullptr;
+    QMutexLocker l(backend_->db()->ReadMutex());
+    if (backend_->ExecQuery(&q)) {
+      while (q.Next()) {
+        result.rows << SqlRow(q);
+        if (result.rows.count() >= kResetChunkSize) {
+          if (!PushResetChunk(generation, result, false, throttled)) break;
+          result = QueryResult();
+        }
+      }
+    }
+    if (reset_generation_.loadAcquire() == generation) PushResetChunk(generation, result, true, false);
+  }
 
   if (QThread::currentThread() != thread() && QThread::currentThread() != backend_->thread()) {
     backend_->Close();
   }
 
-  const struct QueryResult result = future.result();
+}
 
-  BeginReset();
-  root_->lazy_loaded = true;
+bool CollectionModel::PushResetChunk(const int generation, const QueryResult &result, const bool last, const bool throttled) {
+
+  if (throttled) reset_chunks_free_.acquire();
+
+  if (reset_generation_.loadAcquire() != generation) {
+    if (throttled) reset_chunks_free_.release();
+    return false;
+  }
+
+  ResetChunk chunk;
+  chunk.generation = generation;
+  chunk.result = result;
+  chunk.last = last;
+  chunk.throttled = throttled;
+  {
+    QMutexLocker l(&reset_chunks_mutex_);
+    reset_chunks_ << chunk;
+  }
+
+  metaObject()->invokeMethod(this, "ResetAsyncChunkReady", Qt::QueuedConnection);
+
+  return true;
+
+}
+
+void CollectionModel::ResetAsyncChunkReady() {
+
+  ResetChunk chunk;
+  {
+    QMutexLocker l(&reset_chunks_mutex_);
+    if (reset_chunks_.isEmpty()) return;
+    chunk = reset_chunks_.takeFirst();
+  }
+  if (chunk.throttled) reset_chunks_free_.release();
+
+  if (chunk.generation != reset_generation_.loadAcquire() || !reset_streaming_) return;
+
+  if (reset_started_) {
+    // The rest of the rows are inserted into the model the view already shows.
+    PostQuery(root_, chunk.result, true);
+  }
+  else {
+    // Keep showing the old items until the first chunk is here, so a filter that finishes quickly still gives a single reset.
+    BeginReset();
+    root_->lazy_loaded = true;
+    PostQuery(root_, chunk.result, false);
+    endResetModel();
+    reset_started_ = true;
+  }
+
+  if (chunk.last) FinishResetStream();
+
+}
+
+void CollectionModel::FinishResetStream() {
 
-  PostQuery(root_, result, false);
+  reset_streaming_ = false;
+  reset_started_ = false;
 
   if (init_task_id_ != -1) {
     if (app_) {
@@ -916,7 +1053,22 @@ void CollectionModel::ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResu
     init_task_id_ = -1;
   }
 
-  endResetModel();
+  // Songs already loaded are skipped, so the changes can be applied even if the query saw them.
+  const QList<PendingChange> pending_changes = pending_changes_;
+  pending_changes_.clear();
+  for (const PendingChange &change : pending_changes) {
+    switch (change.type) {
+      case PendingChange::Type_Discovered:
+        SongsDiscovered(change.songs);
+        break;
+      case PendingChange::Type_Deleted:
+        SongsDeleted(change.songs);
+        break;
+      case PendingChange::Type_SlightlyChanged:
+        SongsSlightlyChanged(change.songs);
+        break;
+    }
+  }
 
 }
 
@@ -932,6 +1084,9 @@ void CollectionModel::BeginReset() {
   pending_art_.clear();
   pending_cache_keys_.clear();
 
+  // Drop the interned text of the songs that are gone now.
+  StringPool::Prune();
+
   root_ = new CollectionItem(this);
   root_->compilation_artist_node_ = nullptr;
   root_->lazy_loaded = false;
@@ -940,6 +1095,9 @@ void CollectionModel::BeginReset() {
 
 void CollectionModel::Reset() {
 
+  // This replaces the result of a reset that's still streaming.
+  reset_generation_.ref();
+
   BeginReset();
 
   // Populate top level
@@ -947,6 +1105,8 @@ void CollectionModel::Reset() {
 
   endResetModel();
 
+  if (reset_streaming_) FinishResetStream();
+
 }
 
 void CollectionModel::InitQuery(const GroupBy type, CollectionQuery *q) {
@@ -1876,6 +2036,13 @@ void CollectionModel::TotalAlbumCountUpdatedSlot(const int count) {
 
 }
 
+void CollectionModel::PruneStringPool() {
+
+  (void)QtConcurrent::run(&StringPool::Prune);
+  prune_timer_->start(kPruneIntervalMsec);
+
+}
+
 void CollectionModel::ClearDiskCache() {
   if (sIconCache) sIconCache->clear();
 }
@@ -28,6 +28,9 @@
 #include <QObject>
 #include <QAbstractItemModel>
 #include <QFuture>
+#include <QMutex>
+#include <QSemaphore>
+#include <QAtomicInt>
 #include <QDataStream>
 #include <QMetaType>
 #include <QPair>
@@ -52,6 +55,7 @@
 #include "covermanager/albumcoverloaderoptions.h"
 
 class QSettings;
+class QTimer;
 
 class Application;
 class CollectionBackend;
@@ -71,6 +75,12 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
   static const int kPrettyCoverSize;
   static const char *kPixmapDiskCacheDir;
 
+  // ResetAsync() hands the top level rows to the GUI thread in chunks of this many rows, with at most kResetChunksInFlight chunks waiting at a time.
+  static const int kResetChunkSize;
+  static const int kResetChunksInFlight;
+  static const int kPruneDelayMsec;
+  static const int kPruneIntervalMsec;
+
   enum Role {
     Role_Type = Qt::UserRole + 1,
     Role_ContainerType,
@@ -226,17 +236,27 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
   void TotalAlbumCountUpdatedSlot(const int count);
   void ClearDiskCache();
 
-  // Called after ResetAsync
-  void ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResult> future);
+  // Called for each chunk of rows from ResetAsync
+  void ResetAsyncChunkReady();
 
   void AlbumCoverLoaded(const quint64 id, const AlbumCoverLoaderResult &result);
 
+  void PruneStringPool();
+
  private:
   // Provides some optimisations for loading the list of items in the root.
   // This gets called a lot when filtering the playlist, so it's nice to be able to do it in a background thread.
   QueryResult RunQuery(CollectionItem *parent);
   void PostQuery(CollectionItem *parent, const QueryResult &result, const bool signal);
 
+  // Sets up the query for the children of the parent, or for the top level when parent is nullptr.
+  void PrepareQuery(CollectionItem *parent, CollectionQuery *q, QueryResult *result);
+
+  // Runs the top level query in a worker thread for ResetAsync and passes the rows on in chunks, stops early when a newer reset was started.
+  void StreamResetQuery(const int generation);
+  bool PushResetChunk(const int generation, const QueryResult &result, const bool last, const bool throttled);
+  void FinishResetStream();
+
   bool HasCompilations(const CollectionQuery &query);
 
   void BeginReset();
@@ -310,6 +330,37 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
   typedef QPair<CollectionItem*, QString> ItemAndCacheKey;
   QMap<quint64, ItemAndCacheKey> pending_art_;
   QSet<QString> pending_cache_keys_;
+
+  struct ResetChunk {
+    ResetChunk() : generation(0), last(false), throttled(false) {}
+    int generation;
+    QueryResult result;
+    bool last;
+    bool throttled;
+  };
+
+  // Changes from the backend that arrived while a reset was streaming, applied once the last chunk is in.
+  struct PendingChange {
+    enum Type {
+      Type_Discovered,
+      Type_Deleted,
+      Type_SlightlyChanged
+    };
+    PendingChange(const Type _type = Type_Discovered, const SongList &_songs = SongList()) : type(_type), songs(_songs) {}
+    Type type;
+    SongList songs;
+  };
+
+  QAtomicInt reset_generation_;
+  bool reset_streaming_;
+  bool reset_started_;
+  QMutex reset_chunks_mutex_;
+  QList<ResetChunk> reset_chunks_;
+  QSemaphore reset_chunks_free_;
+  QList<QFuture<void>> reset_futures_;
+  QList<PendingChange> pending_changes_;
+
+  QTimer *prune_timer_;
 };
 
 Q_DECLARE_METATYPE(CollectionModel::Grouping)
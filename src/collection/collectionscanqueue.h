@@ -0,0 +1,218 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COLLECTIONSCANQUEUE_H
+#define COLLECTIONSCANQUEUE_H
+
+#include "config.h"
+
+#include <memory>
+#include <vector>
+#include <deque>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include "directory.h"
+
+// Work-stealing queue of subdirectories used by the collection watcher when scanning with more than one thread.
+// Every worker has its own queue. Subdirectories discovered by a worker are added to the back of its own queue and taken from there first,
+// so each worker walks its part of the tree depth-first. An idle worker steals the oldest item from the front of another worker's queue.
+// Every item carries an order key which is the path of child indexes from the scan roots, results are handed back in that order,
+// which is the same order a single threaded depth-first scan would have produced them in.
+template <typename ResultType>
+class CollectionScanQueue {
+ public:
+  explicit CollectionScanQueue(const int worker_count);
+
+  typedef QVector<int> OrderKey;
+
+  struct Item {
+    Item() : force_noincremental(false) {}
+    QString path;
+    Subdirectory subdir;
+    bool force_noincremental;
+    OrderKey order;
+  };
+
+  int worker_count() const { return static_cast<int>(queues_.size()); }
+
+  // Adds an item to the back of the given worker's queue.  Can be called from any thread.
+  void Push(const int worker, const Item &item);
+
+  // Takes the next item for the given worker.  Blocks while the queues are empty but other workers are still scanning and might discover more subdirectories.
+  // Returns false when all items are finished or the queue was stopped.
+  bool Pop(const int worker, Item *item);
+
+  // Marks the item with the given order key as finished and stores its result.
+  void Finish(const OrderKey &order, const ResultType &result);
+
+  // Waits up to timeout_msec for results that can be committed, i.e. results that no unfinished item comes before, and appends them in scan order.
+  // Returns false when there is nothing more to wait for.
+  bool TakeResults(QList<ResultType> *results, const int timeout_msec);
+
+  // Wakes up all workers and makes Pop() return false.
+  void Stop();
+
+ private:
+  struct WorkerQueue {
+    QMutex mutex;
+    std::deque<Item> items;
+  };
+
+  bool TakeOwn(const int worker, Item *item);
+  bool Steal(const int worker, Item *item);
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  QAtomicInt queued_;
+
+  QMutex mutex_;
+  QWaitCondition work_available_;
+  QWaitCondition results_available_;
+  QMap<OrderKey, bool> pending_;
+  QMap<OrderKey, ResultType> finished_;
+  bool stopped_;
+
+  Q_DISABLE_COPY(CollectionScanQueue)
+};
+
+template <typename ResultType>
+CollectionScanQueue<ResultType>::CollectionScanQueue(const int worker_count) : queued_(0), stopped_(false) {
+
+  for (int i = 0; i < qMax(1, worker_count); ++i) {
+    queues_.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue));
+  }
+
+}
+
+template <typename ResultType>
+void CollectionScanQueue<ResultType>::Push(const int worker, const Item &item) {
+
+  QMutexLocker l(&mutex_);
+  pending_.insert(item.order, true);
+
+  WorkerQueue *queue = queues_[worker % queues_.size()].get();
+  {
+    QMutexLocker queue_lock(&queue->mutex);
+    queue->items.push_back(item);
+  }
+  queued_.ref();
+
+  work_available_.wakeOne();
+
+}
+
+template <typename ResultType>
+bool CollectionScanQueue<ResultType>::TakeOwn(const int worker, Item *item) {
+
+  WorkerQueue *queue = queues_[worker % queues_.size()].get();
+  QMutexLocker l(&queue->mutex);
+  if (queue->items.empty()) return false;
+  *item = queue->items.back();
+  queue->items.pop_back();
+  queued_.deref();
+  return true;
+
+}
+
+template <typename ResultType>
+bool CollectionScanQueue<ResultType>::Steal(const int worker, Item *item) {
+
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    WorkerQueue *queue = queues_[(worker + i) % queues_.size()].get();
+    QMutexLocker l(&queue->mutex);
+    if (queue->items.empty()) continue;
+    *item = queue->items.front();
+    queue->items.pop_front();
+    queued_.deref();
+    return true;
+  }
+
+  return false;
+
+}
+
+template <typename ResultType>
+bool CollectionScanQueue<ResultType>::Pop(const int worker, Item *item) {
+
+  forever {
+    if (TakeOwn(worker, item) || Steal(worker, item)) return true;
+
+    QMutexLocker l(&mutex_);
+    if (stopped_ || pending_.isEmpty()) return false;
+    // Another worker pushed an item since we looked.
+    if (queued_.loadAcquire() > 0) continue;
+    work_available_.wait(&mutex_);
+  }
+
+}
+
+template <typename ResultType>
+void CollectionScanQueue<ResultType>::Finish(const OrderKey &order, const ResultType &result) {
+
+  QMutexLocker l(&mutex_);
+  pending_.remove(order);
+  finished_.insert(order, result);
+
+  // Nothing can be discovered anymore, let idle workers exit.
+  if (pending_.isEmpty()) work_available_.wakeAll();
+
+  results_available_.wakeAll();
+
+}
+
+template <typename ResultType>
+bool CollectionScanQueue<ResultType>::TakeResults(QList<ResultType> *results, const int timeout_msec) {
+
+  QMutexLocker l(&mutex_);
+
+  auto committable = [this]() { return !finished_.isEmpty() && (pending_.isEmpty() || finished_.firstKey() < pending_.firstKey()); };
+
+  if (!stopped_ && !pending_.isEmpty() && !committable()) {
+    results_available_.wait(&mutex_, timeout_msec);
+  }
+
+  if (stopped_) return false;
+
+  while (committable()) {
+    results->append(finished_.first());
+    finished_.erase(finished_.begin());
+  }
+
+  return !pending_.isEmpty() || !finished_.isEmpty();
+
+}
+
+template <typename ResultType>
+void CollectionScanQueue<ResultType>::Stop() {
+
+  QMutexLocker l(&mutex_);
+  stopped_ = true;
+  work_available_.wakeAll();
+  results_available_.wakeAll();
+
+}
+
+#endif  // COLLECTIONSCANQUEUE_H
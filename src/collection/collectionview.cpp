@@ -58,6 +58,9 @@
 #include "collectionitemdelegate.h"
 #include "collectionmodel.h"
 #include "collectionview.h"
+#ifdef HAVE_GSTREAMER
+#  include "loudnessscanner.h"
+#endif
 #ifndef Q_OS_WIN
 #  include "device/devicemanager.h"
 #  include "device/devicestatefiltermodel.h"
@@ -89,6 +92,9 @@ CollectionView::CollectionView(QWidget *parent)
       action_edit_track_(nullptr),
       action_edit_tracks_(nullptr),
       action_rescan_songs_(nullptr),
+#ifdef HAVE_GSTREAMER
+      action_analyse_loudness_(nullptr),
+#endif
       action_show_in_browser_(nullptr),
       action_show_in_various_(nullptr),
       action_no_show_in_various_(nullptr),
@@ -361,6 +367,9 @@ void CollectionView::contextMenuEvent(QContextMenuEvent *e) {
     context_menu_->addSeparator();
 
     action_rescan_songs_ = context_menu_->addAction(tr("Rescan song(s)"), this, SLOT(RescanSongs()));
+#ifdef HAVE_GSTREAMER
+    action_analyse_loudness_ = context_menu_->addAction(tr("Analyse loudness"), this, SLOT(AnalyseLoudness()));
+#endif
 
     context_menu_->addSeparator();
     action_show_in_various_ = context_menu_->addAction( tr("Show in various artists"), this, SLOT(ShowInVarious()));
@@ -412,6 +421,11 @@ void CollectionView::contextMenuEvent(QContextMenuEvent *e) {
   action_rescan_songs_->setVisible(regular_editable > 0);
   action_rescan_songs_->setEnabled(regular_editable > 0);
 
+#ifdef HAVE_GSTREAMER
+  action_analyse_loudness_->setVisible(regular_editable > 0);
+  action_analyse_loudness_->setEnabled(regular_editable > 0);
+#endif
+
   action_organize_->setVisible(regular_elements == regular_editable);
 #ifndef Q_OS_WIN
   action_copy_to_device_->setVisible(regular_elements == regular_editable);
@@ -599,6 +613,14 @@ void CollectionView::RescanSongs() {
 
 }
 
+void CollectionView::AnalyseLoudness() {
+
+#ifdef HAVE_GSTREAMER
+  app_->loudness_scanner()->Scan(GetSelectedSongs());
+#endif
+
+}
+
 void CollectionView::CopyToDevice() {
 
 #ifndef Q_OS_WIN
@@ -106,6 +106,7 @@ class CollectionView : public AutoExpandingTreeView {
   void CopyToDevice();
   void EditTracks();
   void RescanSongs();
+  void AnalyseLoudness();
   void ShowInBrowser();
   void ShowInVarious();
   void NoShowInVarious();
@@ -142,6 +143,9 @@ class CollectionView : public AutoExpandingTreeView {
   QAction *action_edit_track_;
   QAction *action_edit_tracks_;
   QAction *action_rescan_songs_;
+#ifdef HAVE_GSTREAMER
+  QAction *action_analyse_loudness_;
+#endif
   QAction *action_show_in_browser_;
   QAction *action_show_in_various_;
   QAction *action_no_show_in_various_;
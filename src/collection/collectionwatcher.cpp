@@ -21,10 +21,16 @@
 
 #include "config.h"
 
+#include <memory>
+#include <functional>
 #include <cassert>
 
 #include <QObject>
 #include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QFuture>
+#include <QtConcurrentRun>
 #include <QIODevice>
 #include <QDir>
 #include <QDirIterator>
@@ -49,6 +55,7 @@
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
+#include "core/utilities.h"
 #include "directory.h"
 #include "collectionbackend.h"
 #include "collectionwatcher.h"
@@ -67,6 +74,8 @@ static const char *kNoMusicFile = ".nomusic";
 
 QStringList CollectionWatcher::sValidImages = QStringList() << "jpg" << "png" << "gif" << "jpeg";
 
+const int CollectionWatcher::kMaxScanThreads = 16;
+
 CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
     : QObject(parent),
       source_(source),
@@ -77,6 +86,8 @@ CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
       monitor_(true),
       mark_songs_unavailable_(false),
       live_scanning_(false),
+      use_journal_(false),
+      scan_threads_(1),
       stop_requested_(false),
       rescan_in_progress_(false),
       rescan_timer_(new QTimer(this)),
@@ -93,6 +104,7 @@ CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
   ReloadSettings();
 
   connect(rescan_timer_, SIGNAL(timeout()), SLOT(RescanPathsNow()));
+  connect(fs_watcher_, SIGNAL(ChangesLost()), SLOT(FileSystemChangesLost()));
 }
 
 void CollectionWatcher::ExitAsync() {
@@ -104,6 +116,7 @@ void CollectionWatcher::Exit() {
   assert(QThread::currentThread() == thread());
 
   Stop();
+
   if (backend_) backend_->Close();
   moveToThread(original_thread_);
   emit ExitFinished();
@@ -118,6 +131,9 @@ CollectionWatcher::ScanTransaction::ScanTransaction(CollectionWatcher *watcher,
       ignores_mtime_(ignores_mtime),
       mark_songs_unavailable_(mark_songs_unavailable),
       watcher_(watcher),
+      parent_(nullptr),
+      scan_queue_(nullptr),
+      worker_(0),
       cached_songs_dirty_(true),
       known_subdirs_dirty_(true)
       {
@@ -134,8 +150,28 @@ CollectionWatcher::ScanTransaction::ScanTransaction(CollectionWatcher *watcher,
 
 }
 
+CollectionWatcher::ScanTransaction::ScanTransaction(ScanTransaction *parent, ScanQueue *scan_queue, const int worker, const ScanQueue::OrderKey &order)
+    : task_id_(parent->task_id_),
+      progress_(0),
+      progress_max_(0),
+      dir_(parent->dir_),
+      incremental_(parent->incremental_),
+      ignores_mtime_(parent->ignores_mtime_),
+      mark_songs_unavailable_(parent->mark_songs_unavailable_),
+      watcher_(parent->watcher_),
+      parent_(parent),
+      scan_queue_(scan_queue),
+      worker_(worker),
+      order_(order),
+      cached_songs_dirty_(false),
+      known_subdirs_dirty_(false)
+      {}
+
 CollectionWatcher::ScanTransaction::~ScanTransaction() {
 
+  // Child transactions are merged into and committed by their parent
+  if (parent_) return;
+
   // If we're stopping then don't commit the transaction
   if (!watcher_->stop_requested_) {
     CommitNewOrUpdatedSongs();
@@ -147,6 +183,12 @@ CollectionWatcher::ScanTransaction::~ScanTransaction() {
 
 void CollectionWatcher::ScanTransaction::AddToProgress(int n) {
 
+  if (parent_) {
+    parent_->AddToProgress(n);
+    return;
+  }
+
+  QMutexLocker l(&progress_mutex_);
   progress_ += n;
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
 
@@ -154,13 +196,34 @@ void CollectionWatcher::ScanTransaction::AddToProgress(int n) {
 
 void CollectionWatcher::ScanTransaction::AddToProgressMax(int n) {
 
+  if (parent_) {
+    parent_->AddToProgressMax(n);
+    return;
+  }
+
+  QMutexLocker l(&progress_mutex_);
   progress_max_ += n;
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
 
 }
 
+void CollectionWatcher::ScanTransaction::Merge(ScanTransaction *child) {
+
+  deleted_songs << child->deleted_songs;
+  readded_songs << child->readded_songs;
+  new_songs << child->new_songs;
+  touched_songs << child->touched_songs;
+  new_subdirs << child->new_subdirs;
+  touched_subdirs << child->touched_subdirs;
+  deleted_subdirs << child->deleted_subdirs;
+
+}
+
 void CollectionWatcher::ScanTransaction::CommitNewOrUpdatedSongs() {
 
+  // Only the parent transaction commits, from the watcher thread
+  if (parent_) return;
+
   if (!new_songs.isEmpty()) {
     emit watcher_->NewOrUpdatedSongs(new_songs);
     new_songs.clear();
@@ -217,15 +280,30 @@ void CollectionWatcher::ScanTransaction::CommitNewOrUpdatedSongs() {
 
 SongList CollectionWatcher::ScanTransaction::FindSongsInSubdirectory(const QString &path) {
 
+  if (parent_) return parent_->FindSongsInSubdirectory(path);
+
   if (cached_songs_dirty_) {
     cached_songs_ = watcher_->backend_->FindSongsInDirectory(dir_);
+    cached_songs_by_path_.clear();
+    for (const Song &song : cached_songs_) {
+      cached_songs_by_path_[song.url().toLocalFile().section('/', 0, -2)] << song;
+    }
     cached_songs_dirty_ = false;
   }
 
-  // TODO: Make this faster
+  return cached_songs_by_path_.value(path);
+
+}
+
+SongList CollectionWatcher::ScanTransaction::GetSongsByUrl(const QUrl &url) {
+
+  // Child transactions run on the scan threads, so they look in the cache instead of opening a database connection per thread.
+  if (!parent_) return watcher_->backend_->GetSongsByUrl(url);
+
+  const QString filename = url.toLocalFile();
   SongList ret;
-  for (const Song &song : cached_songs_) {
-    if (song.url().toLocalFile().section('/', 0, -2) == path) ret << song;
+  for (const Song &song : parent_->FindSongsInSubdirectory(DirectoryPart(filename))) {
+    if (!song.is_unavailable() && song.url().toLocalFile() == filename) ret << song;
   }
   return ret;
 
@@ -234,45 +312,57 @@ SongList CollectionWatcher::ScanTransaction::FindSongsInSubdirectory(const QStri
 void CollectionWatcher::ScanTransaction::SetKnownSubdirs(const SubdirectoryList &subdirs) {
 
   known_subdirs_ = subdirs;
+  known_subdir_paths_.clear();
+  known_subdirs_by_parent_.clear();
+  for (const Subdirectory &subdir : known_subdirs_) {
+    if (subdir.mtime == 0) continue;
+    known_subdir_paths_.insert(subdir.path);
+    known_subdirs_by_parent_[subdir.path.left(subdir.path.lastIndexOf(QDir::separator()))] << subdir;
+  }
   known_subdirs_dirty_ = false;
 
 }
 
 bool CollectionWatcher::ScanTransaction::HasSeenSubdir(const QString &path) {
 
+  if (parent_) return parent_->HasSeenSubdir(path);
+
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  for (const Subdirectory &subdir : known_subdirs_) {
-    if (subdir.path == path && subdir.mtime != 0) return true;
-  }
-  return false;
+  return known_subdir_paths_.contains(path);
 
 }
 
 SubdirectoryList CollectionWatcher::ScanTransaction::GetImmediateSubdirs(const QString &path) {
 
+  if (parent_) return parent_->GetImmediateSubdirs(path);
+
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  SubdirectoryList ret;
-  for (const Subdirectory &subdir : known_subdirs_) {
-    if (subdir.path.left(subdir.path.lastIndexOf(QDir::separator())) == path && subdir.mtime != 0) {
-      ret << subdir;
-    }
-  }
-
-  return ret;
+  return known_subdirs_by_parent_.value(path);
 
 }
 
 SubdirectoryList CollectionWatcher::ScanTransaction::GetAllSubdirs() {
 
+  if (parent_) return parent_->GetAllSubdirs();
+
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
   return known_subdirs_;
 }
 
+void CollectionWatcher::ScanTransaction::PrimeCaches() {
+
+  if (parent_) return;
+
+  FindSongsInSubdirectory(QString());
+  GetAllSubdirs();
+
+}
+
 void CollectionWatcher::AddDirectory(const Directory &dir, const SubdirectoryList &subdirs) {
 
   watched_dirs_[dir.id] = dir;
@@ -282,18 +372,27 @@ void CollectionWatcher::AddDirectory(const Directory &dir, const SubdirectoryLis
     ScanTransaction transaction(this, dir.id, false, false, mark_songs_unavailable_);
     transaction.SetKnownSubdirs(subdirs);
     transaction.AddToProgressMax(1);
-    ScanSubdirectory(dir.path, Subdirectory(), &transaction);
+    Subdirectory root;
+    root.path = dir.path;
+    ScanSubdirectories(SubdirectoryList() << root, &transaction);
+    if (!stop_requested_) journaled_dirs_ << dir.id;
   }
   else {
     // We can do an incremental scan - looking at the mtimes of each subdirectory and only rescan if the directory has changed.
     ScanTransaction transaction(this, dir.id, true, false, mark_songs_unavailable_);
     transaction.SetKnownSubdirs(subdirs);
-    transaction.AddToProgressMax(subdirs.count());
-    for (const Subdirectory &subdir : subdirs) {
-      if (stop_requested_) break;
 
-      if (scan_on_startup_) ScanSubdirectory(subdir.path, subdir, &transaction);
+    if (scan_on_startup_) {
+      // The journal can't know about changes made while we weren't running, so every subdirectory is checked here.
+      transaction.AddToProgressMax(subdirs.count());
+      ScanSubdirectories(subdirs, &transaction);
+      // Also rescan what was still waiting in the journal, for example because rescanning was paused.
+      ScanJournaledSubdirs(&transaction);
+      if (!stop_requested_) journaled_dirs_ << dir.id;
+    }
 
+    for (const Subdirectory &subdir : subdirs) {
+      if (stop_requested_) break;
       if (monitor_) AddWatch(dir, subdir.path);
     }
   }
@@ -378,6 +477,9 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
   // Ask the database for a list of files in this directory
   SongList songs_in_db = t->FindSongsInSubdirectory(path);
 
+  // Read the tags of the files we already know need reading with one request to the tag reader, instead of one request per file.
+  QHash<QString, Song> songs_on_disk = ReadNewOrChangedFiles(files_on_disk, songs_in_db, t);
+
   QSet<QString> cues_processed;
 
   // Now compare the list from the database with the list of files on disk
@@ -427,7 +529,7 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
           // if no cue or it's about to lose it...
         }
         else {
-          UpdateNonCueAssociatedSong(file, matching_song, image, cue_deleted, t);
+          UpdateNonCueAssociatedSong(file, matching_song, image, cue_deleted, songs_on_disk, t);
         }
       }
 
@@ -437,7 +539,7 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
     }
     else {
       // The song is on disk but not in the DB
-      SongList song_list = ScanNewFile(file, path, matching_cue, &cues_processed);
+      SongList song_list = ScanNewFile(file, path, matching_cue, songs_on_disk, &cues_processed);
 
       if (song_list.isEmpty()) {
         continue;
@@ -482,8 +584,23 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
 
   if (live_scanning_) t->CommitNewOrUpdatedSongs();
 
-  // Recurse into the new subdirs that we found
   t->AddToProgressMax(my_new_subdirs.count());
+
+  // When scanning with several threads, hand the new subdirs to the scan queue, they are scanned by whichever worker gets to them first.
+  if (t->scan_queue()) {
+    for (int i = 0; i < my_new_subdirs.count(); ++i) {
+      ScanQueue::Item item;
+      item.path = my_new_subdirs[i].path;
+      item.subdir = my_new_subdirs[i];
+      item.force_noincremental = true;
+      item.order = t->order();
+      item.order << i;
+      t->scan_queue()->Push(t->worker(), item);
+    }
+    return;
+  }
+
+  // Recurse into the new subdirs that we found
   for (const Subdirectory &my_new_subdir : my_new_subdirs) {
     if (stop_requested_) return;
     ScanSubdirectory(my_new_subdir.path, my_new_subdir, t, true);
@@ -491,12 +608,77 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
 
 }
 
+void CollectionWatcher::ScanSubdirectories(const SubdirectoryList &subdirs, ScanTransaction *t, const bool force_noincremental) {
+
+  if (scan_threads_ <= 1 || subdirs.isEmpty()) {
+    for (const Subdirectory &subdir : subdirs) {
+      if (stop_requested_) break;
+      ScanSubdirectory(subdir.path, subdir, t, force_noincremental);
+    }
+    return;
+  }
+
+  // The workers only read the caches, so load them here before any worker starts.
+  t->PrimeCaches();
+
+  ScanQueue scan_queue(scan_threads_);
+  for (int i = 0; i < subdirs.count(); ++i) {
+    ScanQueue::Item item;
+    item.path = subdirs[i].path;
+    item.subdir = subdirs[i];
+    item.force_noincremental = force_noincremental;
+    item.order << i;
+    scan_queue.Push(i, item);
+  }
+
+  QList<QFuture<void>> futures;
+  for (int i = 0; i < scan_queue.worker_count(); ++i) {
+    futures << QtConcurrent::run(&scan_threadpool_, std::bind(&CollectionWatcher::ScanWorker, this, &scan_queue, i, t));
+  }
+
+  // Merge the results in scan order as they become available
+  bool more = true;
+  while (more) {
+    if (stop_requested_) {
+      scan_queue.Stop();
+      break;
+    }
+    QList<std::shared_ptr<ScanTransaction>> results;
+    more = scan_queue.TakeResults(&results, 500);
+    for (const std::shared_ptr<ScanTransaction> &result : results) {
+      t->Merge(result.get());
+    }
+    if (live_scanning_ && !results.isEmpty()) t->CommitNewOrUpdatedSongs();
+  }
+
+  for (QFuture<void> &future : futures) {
+    future.waitForFinished();
+  }
+
+}
+
+void CollectionWatcher::ScanWorker(ScanQueue *scan_queue, const int worker, ScanTransaction *t) {
+
+  QThread::currentThread()->setPriority(QThread::IdlePriority);
+  Utilities::SetThreadIOPriority(Utilities::IOPRIO_CLASS_IDLE);
+
+  ScanQueue::Item item;
+  while (scan_queue->Pop(worker, &item)) {
+    std::shared_ptr<ScanTransaction> child = std::make_shared<ScanTransaction>(t, scan_queue, worker, item.order);
+    if (!stop_requested_) {
+      ScanSubdirectory(item.path, item.subdir, child.get(), item.force_noincremental);
+    }
+    scan_queue->Finish(item.order, child);
+  }
+
+}
+
 void CollectionWatcher::UpdateCueAssociatedSongs(const QString &file, const QString &path, const QString &matching_cue, const QUrl &image, ScanTransaction *t) {
 
   QFile cue(matching_cue);
   cue.open(QIODevice::ReadOnly);
 
-  SongList old_sections = backend_->GetSongsByUrl(QUrl::fromLocalFile(file));
+  SongList old_sections = t->GetSongsByUrl(QUrl::fromLocalFile(file));
 
   QHash<quint64, Song> sections_map;
   for (const Song &song : old_sections) {
@@ -531,11 +713,11 @@ void CollectionWatcher::UpdateCueAssociatedSongs(const QString &file, const QStr
 
 }
 
-void CollectionWatcher::UpdateNonCueAssociatedSong(const QString &file, const Song &matching_song, const QUrl &image, bool cue_deleted, ScanTransaction *t) {
+void CollectionWatcher::UpdateNonCueAssociatedSong(const QString &file, const Song &matching_song, const QUrl &image, bool cue_deleted, const QHash<QString, Song> &songs_on_disk, ScanTransaction *t) {
 
   // If a cue got deleted, we turn it's first section into the new 'raw' (cueless) song and we just remove the rest of the sections from the collection
   if (cue_deleted) {
-    for (const Song &song : backend_->GetSongsByUrl(QUrl::fromLocalFile(file))) {
+    for (const Song &song : t->GetSongsByUrl(QUrl::fromLocalFile(file))) {
       if (!song.IsMetadataEqual(matching_song)) {
         t->deleted_songs << song;
       }
@@ -544,7 +726,12 @@ void CollectionWatcher::UpdateNonCueAssociatedSong(const QString &file, const So
 
   Song song_on_disk(source_);
   song_on_disk.set_directory_id(t->dir());
-  TagReaderClient::Instance()->ReadFileBlocking(file, &song_on_disk);
+  if (songs_on_disk.contains(file)) {
+    song_on_disk = songs_on_disk.value(file);
+  }
+  else {
+    TagReaderClient::Instance()->ReadFileBlocking(file, &song_on_disk);
+  }
 
   if (song_on_disk.is_valid()) {
     PreserveUserSetData(file, image, matching_song, &song_on_disk, t);
@@ -552,7 +739,7 @@ void CollectionWatcher::UpdateNonCueAssociatedSong(const QString &file, const So
 
 }
 
-SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path, const QString &matching_cue, QSet<QString> *cues_processed) {
+SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path, const QString &matching_cue, const QHash<QString, Song> &songs_on_disk, QSet<QString> *cues_processed) {
 
   SongList song_list;
 
@@ -586,7 +773,12 @@ SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path
   }
   else {
     Song song(source_);
-    TagReaderClient::Instance()->ReadFileBlocking(file, &song);
+    if (songs_on_disk.contains(file)) {
+      song = songs_on_disk.value(file);
+    }
+    else {
+      TagReaderClient::Instance()->ReadFileBlocking(file, &song);
+    }
     if (song.is_valid()) {
       song.set_source(source_);
       song_list << song;
@@ -597,6 +789,50 @@ SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path
 
 }
 
+QHash<QString, Song> CollectionWatcher::ReadNewOrChangedFiles(const QStringList &files_on_disk, const SongList &songs_in_db, ScanTransaction *t) {
+
+  // Files with a cue sheet are handled through the cue parser.
+  // Files already in the collection are only read ahead when every file is rescanned, otherwise they are read after checking whether they changed.
+  QSet<QString> files_on_disk_set;
+  for (const QString &file : files_on_disk) {
+    files_on_disk_set.insert(file);
+  }
+  QSet<QString> files_in_db;
+  QSet<QString> cue_files_in_db;
+  for (const Song &song : songs_in_db) {
+    const QString file = song.url().toLocalFile();
+    files_in_db.insert(file);
+    if (song.has_cue()) cue_files_in_db.insert(file);
+  }
+
+  QStringList filenames;
+  for (const QString &file : files_on_disk) {
+    if (files_on_disk_set.contains(NoExtensionPart(file) + ".cue")) continue;
+    if (files_in_db.contains(file) && (!t->ignores_mtime() || cue_files_in_db.contains(file))) continue;
+    filenames << file;
+  }
+
+  QHash<QString, Song> ret;
+  if (filenames.isEmpty()) return ret;
+
+  SongList songs;
+  for (int i = 0; i < filenames.count(); ++i) {
+    Song song(source_);
+    song.set_directory_id(t->dir());
+    songs << song;
+  }
+
+  const QList<bool> read = TagReaderClient::Instance()->ReadFilesBlocking(filenames, &songs);
+
+  // Files without a response are left out, so they're read one by one instead, like they were without the batches.
+  for (int i = 0; i < filenames.count(); ++i) {
+    if (read[i]) ret.insert(filenames[i], songs[i]);
+  }
+
+  return ret;
+
+}
+
 void CollectionWatcher::PreserveUserSetData(const QString &file, const QUrl &image, const Song &matching_song, Song *out, ScanTransaction *t) {
 
   out->set_id(matching_song.id());
@@ -668,6 +904,7 @@ void CollectionWatcher::RemoveDirectory(const Directory &dir) {
 
   rescan_queue_.remove(dir.id);
   watched_dirs_.remove(dir.id);
+  journaled_dirs_.remove(dir.id);
 
   // Stop watching the directory's subdirectories
   for (const QString &subdir_path : subdir_mapping_.keys(dir)) {
@@ -701,13 +938,24 @@ void CollectionWatcher::DirectoryChanged(const QString &subdir) {
 
   qLog(Debug) << "Subdir" << subdir << "changed under directory" << dir.path << "id" << dir.id;
 
-  // Queue the subdir for rescanning
-  if (!rescan_queue_[dir.id].contains(subdir)) rescan_queue_[dir.id] << subdir;
+  // Queue the subdir for rescanning, and record it in the journal so it's rescanned even if we exit first.
+  if (!rescan_queue_[dir.id].contains(subdir)) {
+    rescan_queue_[dir.id] << subdir;
+    backend_->AddToJournal(dir.id, subdir);
+  }
 
   if (!rescan_paused_) rescan_timer_->start();
 
 }
 
+void CollectionWatcher::FileSystemChangesLost() {
+
+  // We don't know what changed anymore, look at the mtimes of all subdirectories again.
+  journaled_dirs_.clear();
+  if (!rescan_paused_) IncrementalScanAsync();
+
+}
+
 void CollectionWatcher::RescanPathsNow() {
 
   for (int dir : rescan_queue_.keys()) {
@@ -723,6 +971,8 @@ void CollectionWatcher::RescanPathsNow() {
       subdir.path = path;
       ScanSubdirectory(path, subdir, &transaction);
     }
+
+    if (!stop_requested_) backend_->RemoveFromJournal(dir, rescan_queue_[dir]);
   }
 
   rescan_queue_.clear();
@@ -808,7 +1058,10 @@ void CollectionWatcher::ReloadSettings() {
   s.beginGroup(CollectionSettingsPage::kSettingsGroup);
   scan_on_startup_ = s.value("startup_scan", true).toBool();
   monitor_ = s.value("monitor", true).toBool();
+  use_journal_ = s.value("change_journal", false).toBool();
   mark_songs_unavailable_ = s.value("mark_songs_unavailable", false).toBool();
+  scan_threads_ = qBound(1, s.value("scan_threads", 1).toInt(), kMaxScanThreads);
+  scan_threadpool_.setMaxThreadCount(scan_threads_);
   QStringList filters = s.value("cover_art_patterns", QStringList() << "front" << "cover").toStringList();
   s.endGroup();
 
@@ -820,6 +1073,7 @@ void CollectionWatcher::ReloadSettings() {
 
   if (!monitor_ && was_monitoring_before) {
     fs_watcher_->Clear();
+    journaled_dirs_.clear();
   }
   else if (monitor_ && !was_monitoring_before) {
     // Add all directories to all QFileSystemWatchers again
@@ -908,16 +1162,52 @@ void CollectionWatcher::PerformScan(bool incremental, bool ignore_mtimes) {
 
     if (stop_requested_) break;
     ScanTransaction transaction(this, dir.id, incremental, ignore_mtimes, mark_songs_unavailable_);
+
+    if (incremental && !ignore_mtimes && JournalCovers(dir.id)) {
+      ScanJournaledSubdirs(&transaction);
+      continue;
+    }
+
     SubdirectoryList subdirs(transaction.GetAllSubdirs());
     transaction.AddToProgressMax(subdirs.count());
 
-    for (const Subdirectory &subdir : subdirs) {
-      if (stop_requested_) break;
-
-      ScanSubdirectory(subdir.path, subdir, &transaction);
+    ScanSubdirectories(subdirs, &transaction);
+    if (ignore_mtimes) {
+      if (!stop_requested_) backend_->RemoveFromJournal(dir.id, backend_->JournaledSubdirs(dir.id));
+    }
+    else {
+      ScanJournaledSubdirs(&transaction);
     }
+    if (!stop_requested_) journaled_dirs_ << dir.id;
   }
 
   emit CompilationsNeedUpdating();
 
 }
+
+bool CollectionWatcher::JournalCovers(const int dir) const {
+
+  return use_journal_ && monitor_ && backend_->has_journal() && fs_watcher_->ReportsAllChanges() && journaled_dirs_.contains(dir);
+
+}
+
+void CollectionWatcher::ScanJournaledSubdirs(ScanTransaction *t) {
+
+  const QStringList paths = backend_->JournaledSubdirs(t->dir());
+  if (paths.isEmpty()) return;
+
+  SubdirectoryList subdirs;
+  for (const QString &path : paths) {
+    Subdirectory subdir;
+    subdir.directory_id = t->dir();
+    subdir.path = path;
+    subdir.mtime = 0;
+    subdirs << subdir;
+  }
+
+  t->AddToProgressMax(subdirs.count());
+  ScanSubdirectories(subdirs, t, true);
+
+  if (!stop_requested_) backend_->RemoveFromJournal(t->dir(), paths);
+
+}
@@ -24,8 +24,12 @@
 
 #include "config.h"
 
+#include <memory>
+
 #include <QtGlobal>
 #include <QObject>
+#include <QMutex>
+#include <QThreadPool>
 #include <QHash>
 #include <QMap>
 #include <QSet>
@@ -34,6 +38,7 @@
 #include <QUrl>
 
 #include "directory.h"
+#include "collectionscanqueue.h"
 #include "core/song.h"
 
 class QThread;
@@ -50,6 +55,8 @@ class CollectionWatcher : public QObject {
  public:
   explicit CollectionWatcher(Song::Source source, QObject *parent = nullptr);
 
+  static const int kMaxScanThreads;
+
   void set_backend(CollectionBackend *backend) { backend_ = backend; }
   void set_task_manager(TaskManager *task_manager) { task_manager_ = task_manager; }
   void set_device_name(const QString& device_name) { device_name_ = device_name; }
@@ -84,33 +91,50 @@ class CollectionWatcher : public QObject {
   void SetRescanPaused(bool pause);
 
  private:
+  class ScanTransaction;
+  typedef CollectionScanQueue<std::shared_ptr<ScanTransaction>> ScanQueue;
+
   // This class encapsulates a full or partial scan of a directory.
   // Each directory has one or more subdirectories, and any number of subdirectories can be scanned during one transaction.
   // ScanSubdirectory() adds its results to the members of this transaction class,
   // and they are "committed" through calls to the CollectionBackend in the transaction's dtor.
   // The transaction also caches the list of songs in this directory according to the collection.
   // Multiple calls to FindSongsInSubdirectory during one transaction will only result in one call to CollectionBackend::FindSongsInDirectory.
+  // When scanning with several threads, each subdirectory taken from the scan queue gets a child transaction which shares the caches and progress of its parent.
+  // The results of the child transactions are merged back into the parent in scan order, and committed from there.
   class ScanTransaction {
    public:
     ScanTransaction(CollectionWatcher *watcher, const int dir, const bool incremental, const bool ignores_mtime, const bool mark_songs_unavailable);
+    ScanTransaction(ScanTransaction *parent, ScanQueue *scan_queue, const int worker, const ScanQueue::OrderKey &order);
     ~ScanTransaction();
 
     SongList FindSongsInSubdirectory(const QString &path);
+    SongList GetSongsByUrl(const QUrl &url);
     bool HasSeenSubdir(const QString &path);
     void SetKnownSubdirs(const SubdirectoryList &subdirs);
     SubdirectoryList GetImmediateSubdirs(const QString &path);
     SubdirectoryList GetAllSubdirs();
 
+    // Loads the songs and subdirectories caches, must be called before child transactions are used from other threads.
+    void PrimeCaches();
+
     void AddToProgress(int n = 1);
     void AddToProgressMax(int n);
 
     // Emits the signals for new & deleted songs etc and clears the lists. This causes the new stuff to be updated on UI.
     void CommitNewOrUpdatedSongs();
 
+    // Appends the results of a finished child transaction.
+    void Merge(ScanTransaction *child);
+
     int dir() const { return dir_; }
     bool is_incremental() const { return incremental_; }
     bool ignores_mtime() const { return ignores_mtime_; }
 
+    ScanQueue *scan_queue() const { return scan_queue_; }
+    int worker() const { return worker_; }
+    const ScanQueue::OrderKey &order() const { return order_; }
+
     SongList deleted_songs;
     SongList readded_songs;
     SongList new_songs;
@@ -141,21 +165,34 @@ class CollectionWatcher : public QObject {
 
     CollectionWatcher *watcher_;
 
+    ScanTransaction *parent_;
+    ScanQueue *scan_queue_;
+    int worker_;
+    ScanQueue::OrderKey order_;
+
+    QMutex progress_mutex_;
+
     SongList cached_songs_;
+    QHash<QString, SongList> cached_songs_by_path_;
     bool cached_songs_dirty_;
 
     SubdirectoryList known_subdirs_;
+    QSet<QString> known_subdir_paths_;
+    QHash<QString, SubdirectoryList> known_subdirs_by_parent_;
     bool known_subdirs_dirty_;
   };
 
  private slots:
   void Exit();
   void DirectoryChanged(const QString &subdir);
+  void FileSystemChangesLost();
   void IncrementalScanNow();
   void FullScanNow();
   void RescanTracksNow();
   void RescanPathsNow();
   void ScanSubdirectory(const QString &path, const Subdirectory &subdir, ScanTransaction *t, bool force_noincremental = false);
+  // Scans the given subdirectories, using the scan queue and worker threads when more than one scan thread is configured.
+  void ScanSubdirectories(const SubdirectoryList &subdirs, ScanTransaction *t, const bool force_noincremental = false);
 
  private:
   static bool FindSongByPath(const SongList &list, const QString &path, Song *out);
@@ -168,16 +205,23 @@ class CollectionWatcher : public QObject {
   void RemoveWatch(const Directory &dir, const Subdirectory &subdir);
   quint64 GetMtimeForCue(const QString &cue_path);
   void PerformScan(bool incremental, bool ignore_mtimes);
+  // Returns true if every change in the directory since it was last scanned is recorded in the journal.
+  bool JournalCovers(const int dir) const;
+  // Rescans the subdirectories recorded in the journal for the transaction's directory and removes them from the journal.
+  void ScanJournaledSubdirs(ScanTransaction *t);
+  void ScanWorker(ScanQueue *scan_queue, const int worker, ScanTransaction *t);
 
   // Updates the sections of a cue associated and altered (according to mtime) media file during a scan.
   void UpdateCueAssociatedSongs(const QString &file, const QString &path, const QString &matching_cue, const QUrl &image, ScanTransaction *t);
   // Updates a single non-cue associated and altered (according to mtime) song during a scan.
-  void UpdateNonCueAssociatedSong(const QString &file, const Song &matching_song, const QUrl &image, bool cue_deleted, ScanTransaction *t);
+  void UpdateNonCueAssociatedSong(const QString &file, const Song &matching_song, const QUrl &image, bool cue_deleted, const QHash<QString, Song> &songs_on_disk, ScanTransaction *t);
   // Updates a new song with some metadata taken from it's equivalent old song (for example rating and score).
   void PreserveUserSetData(const QString &file, const QUrl &image, const Song &matching_song, Song *out, ScanTransaction *t);
   // Scans a single media file that's present on the disk but not yet in the collection.
   // It may result in a multiple files added to the collection when the media file has many sections (like a CUE related media file).
-  SongList ScanNewFile(const QString &file, const QString &path, const QString &matching_cue, QSet<QString> *cues_processed);
+  SongList ScanNewFile(const QString &file, const QString &path, const QString &matching_cue, const QHash<QString, Song> &songs_on_disk, QSet<QString> *cues_processed);
+  // Reads the tags of the new files, and of the changed files when mtimes are ignored, in batches through the tag reader.
+  QHash<QString, Song> ReadNewOrChangedFiles(const QStringList &files_on_disk, const SongList &songs_in_db, ScanTransaction *t);
 
  private:
   Song::Source source_;
@@ -196,6 +240,11 @@ class CollectionWatcher : public QObject {
   bool monitor_;
   bool mark_songs_unavailable_;
   bool live_scanning_;
+  bool use_journal_;
+  int scan_threads_;
+
+  // Directories with all changes since their last scan recorded in the journal.
+  QSet<int> journaled_dirs_;
 
   bool stop_requested_;
   bool rescan_in_progress_; // True if RescanTracksNow() has been called and is working.
@@ -209,6 +258,8 @@ class CollectionWatcher : public QObject {
 
   CueParser *cue_parser_;
 
+  QThreadPool scan_threadpool_;
+
   static QStringList sValidImages;
 
   SongList song_rescan_queue_; // Set by ui thread
@@ -0,0 +1,392 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <gst/gst.h>
+
+#include <QtGlobal>
+#include <QtNumeric>
+#include <QObject>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QSettings>
+
+#include "core/application.h"
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/song.h"
+#include "core/tagreaderclient.h"
+#include "core/taskmanager.h"
+#include "engine/analysispipeline.h"
+#include "engine/ebur128meter.h"
+#include "engine/loudnessconsumer.h"
+#include "settings/backendsettingspage.h"
+#include "collectionbackend.h"
+#include "loudnessscanner.h"
+
+#ifdef HAVE_MOODBAR
+#  include "moodbar/moodbarconsumer.h"
+#  include "moodbar/moodbarloader.h"
+#endif
+
+const char *LoudnessScanner::kSettingsWriteTags = "rgwritetags";
+const char *LoudnessScanner::kSettingsAnalyseThreads = "rganalysethreads";
+const int LoudnessScanner::kDefaultAnalyseThreads = 2;
+const int LoudnessScanner::kMaxAnalyseThreads = 16;
+
+const int LoudnessScanner::kTimeoutSecs = 300;
+
+LoudnessScanner::LoudnessScanner(Application *app, QObject *parent)
+    : QObject(parent),
+      app_(app),
+      albums_watcher_(nullptr),
+      task_id_(-1),
+      next_album_id_(0),
+      done_(0),
+      total_(0),
+      write_tags_(false) {
+
+  connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
+  connect(app_->collection_backend(), SIGNAL(DatabaseReset()), SLOT(Stop()));
+  ReloadSettings();
+
+}
+
+LoudnessScanner::~LoudnessScanner() {
+
+  if (albums_watcher_) albums_watcher_->waitForFinished();
+
+  // The songs that are being decoded have to finish, the rest are skipped.
+  queue_.clear();
+  thread_pool_.waitForDone();
+
+}
+
+void LoudnessScanner::ReloadSettings() {
+
+  QSettings s;
+  s.beginGroup(BackendSettingsPage::kSettingsGroup);
+  write_tags_ = s.value(kSettingsWriteTags, false).toBool();
+  thread_pool_.setMaxThreadCount(qBound(1, s.value(kSettingsAnalyseThreads, kDefaultAnalyseThreads).toInt(), kMaxAnalyseThreads));
+  s.endGroup();
+
+}
+
+void LoudnessScanner::Scan(const SongList &songs) {
+
+  QSet<int> ids;
+  for (const Song &song : songs) {
+    if (song.id() != -1) ids << song.id();
+  }
+  if (ids.isEmpty()) return;
+
+  pending_scans_ << ids;
+  StartNext();
+
+}
+
+void LoudnessScanner::ScanCollection() {
+
+  // No IDs means every album that isn't analysed yet.
+  pending_scans_ << QSet<int>();
+  StartNext();
+
+}
+
+void LoudnessScanner::Stop() {
+
+  pending_scans_.clear();
+  queue_.clear();
+  albums_.clear();
+
+  // The songs that are being decoded finish in the background, their results are only used for the moodbars.
+  if (task_id_ != -1) {
+    app_->task_manager()->SetTaskFinished(task_id_);
+    task_id_ = -1;
+  }
+
+}
+
+LoudnessScanner::LoadedAlbums LoudnessScanner::LoadAlbums(CollectionBackend *backend, const QSet<int> &ids, const bool read_mood_files) {
+
+  // Only the songs that are scanned and the other songs on their albums are loaded.
+  const QList<int> scan_ids = ids.isEmpty() ? backend->GetSongIdsWithoutReplayGain() : ids.values();
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+  const QSet<int> scan_id_set(scan_ids.begin(), scan_ids.end());
+#else
+  const QSet<int> scan_id_set = QSet<int>::fromList(scan_ids);
+#endif
+
+  // Songs from CUE sheets share a file with the other tracks, decoding the file would measure all of them together.
+  QMap<QString, SongList> albums;
+  LoadedAlbums ret;
+  for (const Song &song : backend->GetSongsOnSameAlbums(scan_ids)) {
+    if (song.unavailable() || song.has_cue() || song.url().scheme() != "file") continue;
+    if (song.album().isEmpty()) {
+      if (scan_id_set.contains(song.id())) ret.albums << (SongList() << song);
+    }
+    else {
+      albums[song.AlbumKey()] << song;
+    }
+  }
+
+  for (const SongList &album : albums) {
+    for (const Song &song : album) {
+      if (scan_id_set.contains(song.id())) {
+        ret.albums << album;
+        break;
+      }
+    }
+  }
+
+#ifdef HAVE_MOODBAR
+  if (read_mood_files) {
+    for (const SongList &album : ret.albums) {
+      for (const Song &song : album) {
+        const QByteArray data = MoodbarLoader::ReadMoodFile(song.url());
+        if (!data.isEmpty()) ret.mood_files.insert(song.url(), data);
+      }
+    }
+  }
+#else
+  Q_UNUSED(read_mood_files);
+#endif
+
+  return ret;
+
+}
+
+void LoudnessScanner::StartNext() {
+
+  if (albums_watcher_) return;
+
+  if (queue_.isEmpty() && !pending_scans_.isEmpty()) {
+    if (task_id_ == -1) {
+      done_ = 0;
+      total_ = 0;
+      task_id_ = app_->task_manager()->StartTask(tr("Analysing loudness"));
+    }
+#ifdef HAVE_MOODBAR
+    const bool read_mood_files = app_->moodbar_loader()->enabled();
+#else
+    const bool read_mood_files = false;
+#endif
+    albums_watcher_ = new QFutureWatcher<LoadedAlbums>(this);
+    connect(albums_watcher_, SIGNAL(finished()), SLOT(AlbumsLoaded()));
+    albums_watcher_->setFuture(QtConcurrent::run(&LoudnessScanner::LoadAlbums, app_->collection_backend(), pending_scans_.takeFirst(), read_mood_files));
+    return;
+  }
+
+  // Only as many songs as there are threads are handed to the pool, so stopping doesn't have to wait for the whole queue.
+  while (!queue_.isEmpty() && running_.count() < thread_pool_.maxThreadCount()) {
+    const Track track = queue_.takeFirst();
+    QFutureWatcher<Result> *watcher = new QFutureWatcher<Result>(this);
+    running_.insert(watcher, track);
+    connect(watcher, SIGNAL(finished()), SLOT(TrackFinished()));
+    watcher->setFuture(QtConcurrent::run(&thread_pool_, &LoudnessScanner::AnalyseTrack, track));
+  }
+
+  if (running_.isEmpty() && task_id_ != -1) {
+    qLog(Info) << "Finished analysing the loudness of" << done_ << "songs";
+    app_->task_manager()->SetTaskFinished(task_id_);
+    task_id_ = -1;
+  }
+
+}
+
+void LoudnessScanner::AlbumsLoaded() {
+
+  const LoadedAlbums loaded = albums_watcher_->result();
+  albums_watcher_->deleteLater();
+  albums_watcher_ = nullptr;
+
+  // The scan was stopped, but another one might have been started since.
+  if (task_id_ == -1) {
+    StartNext();
+    return;
+  }
+
+#ifdef HAVE_MOODBAR
+  MoodbarLoader *moodbar_loader = app_->moodbar_loader();
+#endif
+
+  for (const SongList &songs : loaded.albums) {
+    const int id = next_album_id_++;
+    Album &album = albums_[id];
+    album.remaining = songs.count();
+    album.songs = songs;
+    for (const Song &song : songs) {
+      Track track;
+      track.song = song;
+      track.album = id;
+#ifdef HAVE_MOODBAR
+      if (moodbar_loader->enabled() && !moodbar_loader->IsStored(song.url())) {
+        if (loaded.mood_files.contains(song.url())) {
+          moodbar_loader->Import(song.url(), loaded.mood_files.value(song.url()));
+        }
+        else {
+          track.moodbar = true;
+        }
+      }
+#endif
+      queue_ << track;
+    }
+    total_ += songs.count();
+  }
+
+  app_->task_manager()->SetTaskProgress(task_id_, done_, total_);
+
+  StartNext();
+
+}
+
+LoudnessScanner::Result LoudnessScanner::AnalyseTrack(const Track &track) {
+
+  Result result;
+
+  AnalysisPipeline pipeline(track.song.url());
+  LoudnessConsumer loudness;
+  pipeline.AddConsumer(&loudness);
+
+#ifdef HAVE_MOODBAR
+  std::unique_ptr<MoodbarConsumer> moodbar;
+  if (track.moodbar) {
+    moodbar.reset(new MoodbarConsumer);
+    pipeline.AddConsumer(moodbar.get());
+  }
+#endif
+
+  pipeline.Run(kTimeoutSecs * GST_SECOND);
+
+  // Silence is below the gate, it doesn't have a loudness.
+  if (loudness.success() && std::isfinite(loudness.loudness())) {
+    result.success = true;
+    result.gain = static_cast<float>(EbuR128Meter::Gain(loudness.loudness()));
+    result.peak = loudness.peak();
+    result.blocks = loudness.blocks();
+  }
+  else {
+    qLog(Warning) << "Failed to analyse the loudness of" << track.song.url().toLocalFile();
+  }
+
+#ifdef HAVE_MOODBAR
+  if (moodbar && moodbar->success()) result.moodbar = moodbar->data();
+#endif
+
+  return result;
+
+}
+
+void LoudnessScanner::TrackFinished() {
+
+  QFutureWatcher<Result> *watcher = static_cast<QFutureWatcher<Result>*>(sender());
+  const Track track = running_.take(watcher);
+  const Result result = watcher->result();
+  watcher->deleteLater();
+
+  TrackAnalysed(track, result);
+  StartNext();
+
+}
+
+void LoudnessScanner::TrackAnalysed(const Track &track, const Result &result) {
+
+  ++done_;
+  if (task_id_ != -1) app_->task_manager()->SetTaskProgress(task_id_, done_, total_);
+
+#ifdef HAVE_MOODBAR
+  if (!result.moodbar.isEmpty()) app_->moodbar_loader()->Save(track.song.url(), result.moodbar);
+#endif
+
+  // The scan was stopped.
+  if (!albums_.contains(track.album)) return;
+
+  Album &album = albums_[track.album];
+  if (result.success) {
+    for (Song &song : album.songs) {
+      if (song.id() == track.song.id()) {
+        song.set_replaygain(result.gain, result.peak, qQNaN(), qQNaN());
+        break;
+      }
+    }
+    album.blocks.insert(album.blocks.end(), result.blocks.begin(), result.blocks.end());
+    album.peak = qMax(album.peak, result.peak);
+  }
+
+  if (--album.remaining == 0) AlbumFinished(track.album);
+
+}
+
+void LoudnessScanner::AlbumFinished(const int id) {
+
+  const Album album = albums_.take(id);
+
+  // Songs without an album only get a track gain.
+  float album_gain = qQNaN();
+  float album_peak = qQNaN();
+  if (!album.songs.isEmpty() && !album.songs.first().album().isEmpty()) {
+    const double loudness = EbuR128Meter::IntegratedLoudness(album.blocks);
+    if (std::isfinite(loudness)) {
+      album_gain = static_cast<float>(EbuR128Meter::Gain(loudness));
+      album_peak = album.peak;
+    }
+  }
+
+  SongList songs;
+  SongList failed_songs;
+  for (Song song : album.songs) {
+    if (!song.has_replaygain()) {
+      failed_songs << song;
+      continue;
+    }
+    song.set_replaygain(song.replaygain_track_gain(), song.replaygain_track_peak(), album_gain, album_peak);
+    songs << song;
+  }
+
+  // Files that can't be decoded or are silent aren't analysed again by collection scans until they change.
+  app_->collection_backend()->SetSongsReplayGainFailedAsync(failed_songs);
+
+  if (songs.isEmpty()) return;
+
+  app_->collection_backend()->UpdateSongsReplayGainAsync(songs);
+
+  if (write_tags_) {
+    for (const Song &song : songs) {
+      TagReaderReply *reply = TagReaderClient::Instance()->SaveReplayGain(song.url().toLocalFile(), song);
+      NewClosure(reply, SIGNAL(Finished(bool)), [reply]() {
+        if (!reply->message().save_replaygain_response().success()) {
+          qLog(Warning) << "Failed to write ReplayGain to" << QString::fromStdString(reply->request_message().save_replaygain_request().filename());
+        }
+        reply->deleteLater();
+      });
+    }
+  }
+
+}
@@ -0,0 +1,128 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LOUDNESSSCANNER_H
+#define LOUDNESSSCANNER_H
+
+#include "config.h"
+
+#include <vector>
+
+#include <QObject>
+#include <QThreadPool>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QByteArray>
+#include <QUrl>
+
+#include "core/song.h"
+
+template <typename T> class QFutureWatcher;
+class Application;
+class CollectionBackend;
+
+// Analyses the loudness of collection songs and stores their ReplayGain, so playback can be normalized for files without ReplayGain tags.
+// The songs are decoded in parallel on a thread pool of its own, one song per thread, so a long scan doesn't starve the rest of the application.
+// Albums are always analysed as a whole, the album gain is worked out from the loudness of all their tracks together once the last one is done.
+// Missing moodbars are created from the same decode, and the values can optionally be written to the files through the tag reader.
+class LoudnessScanner : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit LoudnessScanner(Application *app, QObject *parent = nullptr);
+  ~LoudnessScanner() override;
+
+  static const char *kSettingsWriteTags;
+  static const char *kSettingsAnalyseThreads;
+  static const int kDefaultAnalyseThreads;
+  static const int kMaxAnalyseThreads;
+
+  bool is_running() const { return task_id_ != -1; }
+
+ public slots:
+  // Analyses the albums of the given songs.
+  void Scan(const SongList &songs);
+  // Analyses the albums in the collection that have songs without ReplayGain, songs that failed before are skipped until they change.
+  void ScanCollection();
+  void Stop();
+
+ private slots:
+  void ReloadSettings();
+  void AlbumsLoaded();
+  void TrackFinished();
+
+ private:
+  struct Track {
+    Track() : album(-1), moodbar(false) {}
+    Song song;
+    int album;
+    bool moodbar;
+  };
+
+  struct Result {
+    Result() : success(false), gain(0.0F), peak(0.0F) {}
+    bool success;
+    float gain;
+    float peak;
+    std::vector<double> blocks;
+    QByteArray moodbar;
+  };
+
+  struct LoadedAlbums {
+    QList<SongList> albums;
+    // Mood files found next to the songs, read on the worker thread so the GUI thread doesn't touch the file system.
+    QMap<QUrl, QByteArray> mood_files;
+  };
+
+  struct Album {
+    Album() : remaining(0), peak(0.0F) {}
+    int remaining;
+    SongList songs;
+    std::vector<double> blocks;
+    float peak;
+  };
+
+  static const int kTimeoutSecs;
+
+  static LoadedAlbums LoadAlbums(CollectionBackend *backend, const QSet<int> &ids, const bool read_mood_files);
+  static Result AnalyseTrack(const Track &track);
+
+  void StartNext();
+  void TrackAnalysed(const Track &track, const Result &result);
+  void AlbumFinished(const int id);
+
+ private:
+  Application *app_;
+
+  QFutureWatcher<LoadedAlbums> *albums_watcher_;
+  QThreadPool thread_pool_;
+  QMap<QFutureWatcher<Result>*, Track> running_;
+  QList<QSet<int>> pending_scans_;
+  QList<Track> queue_;
+  QMap<int, Album> albums_;
+
+  int task_id_;
+  int next_album_id_;
+  int done_;
+  int total_;
+  bool write_tags_;
+};
+
+#endif  // LOUDNESSSCANNER_H
@@ -263,7 +263,7 @@ ContextAlbumsModel::QueryResult ContextAlbumsModel::RunQuery(CollectionItem *par
   }
 
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
+  QMutexLocker l(backend_->db()->ReadMutex());
 
   if (!backend_->ExecQuery(&q)) return result;
 
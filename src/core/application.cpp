@@ -86,9 +86,14 @@
 #  include "covermanager/qobuzcoverprovider.h"
 #endif
 
+#ifdef HAVE_GSTREAMER
+#  include "collection/loudnessscanner.h"
+#endif
+
 #ifdef HAVE_MOODBAR
 #  include "moodbar/moodbarcontroller.h"
 #  include "moodbar/moodbarloader.h"
+#  include "moodbar/moodbarprecomputer.h"
 #endif
 
 class ApplicationImpl {
@@ -172,9 +177,14 @@ class ApplicationImpl {
         scrobbler_([=]() { return new AudioScrobbler(app, app); }),
         lastfm_import_([=]() { return new LastFMImport(app); }),
 
+#ifdef HAVE_GSTREAMER
+        loudness_scanner_([=]() { return new LoudnessScanner(app, app); }),
+#endif
+
 #ifdef HAVE_MOODBAR
         moodbar_loader_([=]() { return new MoodbarLoader(app, app); }),
         moodbar_controller_([=]() { return new MoodbarController(app, app); }),
+        moodbar_precomputer_([=]() { return new MoodbarPrecomputer(app, app); }),
 #endif
        dummy_([=]() { return nullptr; })
 
@@ -199,9 +209,13 @@ class ApplicationImpl {
   Lazy<InternetServices> internet_services_;
   Lazy<AudioScrobbler> scrobbler_;
   Lazy<LastFMImport> lastfm_import_;
+#ifdef HAVE_GSTREAMER
+  Lazy<LoudnessScanner> loudness_scanner_;
+#endif
 #ifdef HAVE_MOODBAR
   Lazy<MoodbarLoader> moodbar_loader_;
   Lazy<MoodbarController> moodbar_controller_;
+  Lazy<MoodbarPrecomputer> moodbar_precomputer_;
 #endif
   Lazy<QVariant> dummy_;
 
@@ -328,7 +342,11 @@ PlaylistManager *Application::playlist_manager() const { return p_->playlist_man
 InternetServices *Application::internet_services() const { return p_->internet_services_.get(); }
 AudioScrobbler *Application::scrobbler() const { return p_->scrobbler_.get(); }
 LastFMImport *Application::lastfm_import() const { return p_->lastfm_import_.get(); }
+#ifdef HAVE_GSTREAMER
+LoudnessScanner *Application::loudness_scanner() const { return p_->loudness_scanner_.get(); }
+#endif
 #ifdef HAVE_MOODBAR
 MoodbarController *Application::moodbar_controller() const { return p_->moodbar_controller_.get(); }
 MoodbarLoader *Application::moodbar_loader() const { return p_->moodbar_loader_.get(); }
+MoodbarPrecomputer *Application::moodbar_precomputer() const { return p_->moodbar_precomputer_.get(); }
 #endif
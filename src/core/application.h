@@ -58,9 +58,13 @@ class LyricsProviders;
 class AudioScrobbler;
 class LastFMImport;
 class InternetServices;
+#ifdef HAVE_GSTREAMER
+class LoudnessScanner;
+#endif
 #ifdef HAVE_MOODBAR
 class MoodbarController;
 class MoodbarLoader;
+class MoodbarPrecomputer;
 #endif
 
 class Application : public QObject {
@@ -98,9 +102,14 @@ class Application : public QObject {
 
   InternetServices *internet_services() const;
 
+#ifdef HAVE_GSTREAMER
+  LoudnessScanner *loudness_scanner() const;
+#endif
+
 #ifdef HAVE_MOODBAR
   MoodbarController *moodbar_controller() const;
   MoodbarLoader *moodbar_loader() const;
+  MoodbarPrecomputer *moodbar_precomputer() const;
 #endif
 
   void Exit();
@@ -45,6 +45,7 @@
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QStandardPaths>
+#include <QSettings>
 #include <QtDebug>
 
 #include "core/logging.h"
@@ -54,8 +55,18 @@
 #include "scopedtransaction.h"
 
 const char *Database::kDatabaseFilename = "strawberry.db";
-const int Database::kSchemaVersion = 13;
+const int Database::kSchemaVersion = 17;
 const char *Database::kMagicAllSongsTables = "%allsongstables";
+const char *Database::kSettingsGroup = "Database";
+
+// WAL lets readers continue while the scanner writes, and with it only the checkpoints need to be synced.
+Database::Tuning::Tuning()
+    : journal_mode("WAL"),
+      synchronous("NORMAL"),
+      cache_size(16384),
+      mmap_size(268435456),
+      temp_store("MEMORY"),
+      busy_timeout(5000) {}
 
 int Database::sNextConnectionId = 1;
 QMutex Database::sNextConnectionIdMutex;
@@ -67,6 +78,7 @@ Database::Database(Application *app, QObject *parent, const QString &database_na
       mutex_(QMutex::Recursive),
 #endif
       injected_database_name_(database_name),
+      read_only_connections_(0),
       query_hash_(0),
       startup_schema_version_(-1),
       original_thread_(nullptr) {
@@ -80,9 +92,15 @@ Database::Database(Application *app, QObject *parent, const QString &database_na
 
   directory_ = QDir::toNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
 
+  LoadTuning();
+
   QMutexLocker l(&mutex_);
   Connect();
 
+  if (database_name != ":memory:" && ReadOnlyConnectionWorks()) {
+    read_only_connections_.storeRelease(1);
+  }
+
 }
 
 Database::~Database() {
@@ -119,7 +137,7 @@ QSqlDatabase Database::Connect() {
     }
   }
 
-  const QString connection_id = QString("%1_thread_%2").arg(connection_id_).arg(reinterpret_cast<quint64>(QThread::currentThread()));
+  const QString connection_id = ConnectionName();
 
   // Try to find an existing connection for this thread
   QSqlDatabase db;
@@ -134,16 +152,15 @@ QSqlDatabase Database::Connect() {
   }
   //qLog(Debug) << "Opened database with connection id" << connection_id;
 
-  if (!injected_database_name_.isNull())
-    db.setDatabaseName(injected_database_name_);
-  else
-    db.setDatabaseName(directory_ + "/" + kDatabaseFilename);
+  db.setDatabaseName(DatabaseName());
 
   if (!db.open()) {
     app_->AddError("Database: " + db.lastError().text());
     return db;
   }
 
+  ApplyTuning(db);
+
   if (db.tables().count() == 0) {
     // Set up initial schema
     qLog(Info) << "Creating initial database schema";
@@ -219,22 +236,220 @@ QSqlDatabase Database::Connect() {
 
 }
 
+QSqlDatabase Database::ConnectReadOnly() {
+
+  if (!read_only_connections_.loadAcquire()) return Connect();
+
+  {
+    QMutexLocker l(&connect_mutex_);
+
+    const QString connection_id = ConnectionName(true);
+
+    QSqlDatabase db;
+    if (QSqlDatabase::connectionNames().contains(connection_id)) {
+      db = QSqlDatabase::database(connection_id);
+    }
+    else {
+      db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
+    }
+    if (db.isOpen()) {
+      return db;
+    }
+
+    db.setDatabaseName(DatabaseName());
+    db.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+    if (db.open()) {
+      ApplyTuning(db, true);
+
+      bool attached = true;
+      for (const QString &key : attached_databases_.keys()) {
+        QSqlQuery q(db);
+        q.prepare("ATTACH DATABASE :filename AS :alias");
+        q.bindValue(":filename", injected_database_name_.isNull() ? attached_databases_[key].filename_ : injected_database_name_);
+        q.bindValue(":alias", key);
+        if (!q.exec()) {
+          qLog(Error) << "Couldn't attach external database" << key << "to read-only connection:" << q.lastError();
+          attached = false;
+          break;
+        }
+      }
+      if (attached) return db;
+      db.close();
+    }
+    else {
+      qLog(Error) << "Failed to open read-only database connection:" << db.lastError();
+    }
+
+  }
+
+  // Fall back to this thread's normal connection, SQLite's busy timeout serializes it with the writes.
+  return Connect();
+
+}
+
+bool Database::ReadOnlyConnectionWorks() {
+
+  const QString connection_id = ConnectionName(true) + "_test";
+
+  bool success = false;
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
+    db.setDatabaseName(DatabaseName());
+    db.setConnectOptions("QSQLITE_OPEN_READONLY");
+    success = db.open();
+    if (success) {
+      db.close();
+    }
+    else {
+      qLog(Error) << "Failed to open read-only database connection, reading on the normal connection:" << db.lastError();
+    }
+  }
+  QSqlDatabase::removeDatabase(connection_id);
+
+  return success;
+
+}
+
+QString Database::ConnectionName(const bool read_only) const {
+
+  QString connection_id = QString("%1_thread_%2").arg(connection_id_).arg(reinterpret_cast<quint64>(QThread::currentThread()));
+  if (read_only) connection_id += "_readonly";
+  return connection_id;
+
+}
+
+QString Database::DatabaseName() const {
+
+  if (!injected_database_name_.isNull()) return injected_database_name_;
+  return directory_ + "/" + kDatabaseFilename;
+
+}
+
+void Database::LoadTuning() {
+
+  const Tuning defaults;
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  tuning_.journal_mode = s.value("journal_mode", defaults.journal_mode).toString().toUpper();
+  tuning_.synchronous = s.value("synchronous", defaults.synchronous).toString().toUpper();
+  tuning_.cache_size = s.value("cache_size", defaults.cache_size).toInt();
+  tuning_.mmap_size = s.value("mmap_size", defaults.mmap_size).toLongLong();
+  tuning_.temp_store = s.value("temp_store", defaults.temp_store).toString().toUpper();
+  tuning_.busy_timeout = s.value("busy_timeout", defaults.busy_timeout).toInt();
+  s.endGroup();
+
+  // These end up in the PRAGMA statements, only allow the values SQLite knows.
+  if (!(QStringList() << "DELETE" << "TRUNCATE" << "PERSIST" << "MEMORY" << "WAL" << "OFF").contains(tuning_.journal_mode)) {
+    qLog(Error) << "Invalid database journal mode" << tuning_.journal_mode;
+    tuning_.journal_mode = defaults.journal_mode;
+  }
+  if (!(QStringList() << "OFF" << "NORMAL" << "FULL" << "EXTRA").contains(tuning_.synchronous)) {
+    qLog(Error) << "Invalid database synchronous setting" << tuning_.synchronous;
+    tuning_.synchronous = defaults.synchronous;
+  }
+  if (!(QStringList() << "DEFAULT" << "FILE" << "MEMORY").contains(tuning_.temp_store)) {
+    qLog(Error) << "Invalid database temp store" << tuning_.temp_store;
+    tuning_.temp_store = defaults.temp_store;
+  }
+
+}
+
+void Database::ApplyTuning(QSqlDatabase &db, const bool read_only) {
+
+  QStringList pragmas;
+  // The journal mode is stored in the database file, an in-memory database always uses its own.
+  if (injected_database_name_ != ":memory:") {
+    // Only the writer can change it, the read-only connections use whatever the database has.
+    if (!read_only) pragmas << QString("journal_mode = %1").arg(tuning_.journal_mode);
+    pragmas << QString("mmap_size = %1").arg(tuning_.mmap_size);
+  }
+  if (!read_only) pragmas << QString("synchronous = %1").arg(tuning_.synchronous);
+  // A negative cache size is in KiB instead of pages.
+  pragmas << QString("cache_size = %1").arg(-qAbs(tuning_.cache_size));
+  pragmas << QString("temp_store = %1").arg(tuning_.temp_store);
+  pragmas << QString("busy_timeout = %1").arg(tuning_.busy_timeout);
+
+  for (const QString &pragma : pragmas) {
+    QSqlQuery q(db);
+    if (!q.exec("PRAGMA " + pragma)) {
+      qLog(Error) << "Failed to set" << pragma << q.lastError();
+    }
+  }
+
+}
+
+sqlite3 *Database::Handle(QSqlDatabase &db) {
+
+  QVariant v = db.driver()->handle();
+  if (v.isValid() && qstrcmp(v.typeName(), "sqlite3*") == 0) {
+    return *static_cast<sqlite3**>(v.data());
+  }
+  return nullptr;
+
+}
+
+void Database::DiagnosticsAsync() {
+  metaObject()->invokeMethod(this, "EmitDiagnostics", Qt::QueuedConnection);
+}
+
+void Database::EmitDiagnostics() {
+  emit DiagnosticsReady(Diagnostics());
+}
+
+QString Database::Diagnostics() {
+
+  QMutexLocker l(&mutex_);
+  QSqlDatabase db(Connect());
+
+  QStringList lines;
+  lines << "Database: " + db.databaseName();
+
+  const QStringList pragmas = QStringList() << "journal_mode" << "synchronous" << "cache_size" << "mmap_size" << "temp_store" << "busy_timeout" << "page_size" << "page_count" << "freelist_count";
+  for (const QString &pragma : pragmas) {
+    QSqlQuery q(db);
+    if (q.exec("PRAGMA " + pragma) && q.next()) {
+      lines << QString("%1: %2").arg(pragma, q.value(0).toString());
+    }
+  }
+
+  sqlite3 *handle = Handle(db);
+  if (handle) {
+    int cache_hit = 0, cache_miss = 0, cache_write = 0, cache_used = 0, highwater = 0;
+    sqlite3_db_status(handle, SQLITE_DBSTATUS_CACHE_HIT, &cache_hit, &highwater, 0);
+    sqlite3_db_status(handle, SQLITE_DBSTATUS_CACHE_MISS, &cache_miss, &highwater, 0);
+    sqlite3_db_status(handle, SQLITE_DBSTATUS_CACHE_WRITE, &cache_write, &highwater, 0);
+    sqlite3_db_status(handle, SQLITE_DBSTATUS_CACHE_USED, &cache_used, &highwater, 0);
+    const int lookups = cache_hit + cache_miss;
+    lines << QString("page cache: %1 hits, %2 misses, %3% hit rate, %4 writes, %5 KiB used").arg(cache_hit).arg(cache_miss).arg(lookups > 0 ? 100.0 * cache_hit / lookups : 0.0, 0, 'f', 1).arg(cache_write).arg(cache_used / 1024);
+  }
+
+  return lines.join("\n");
+
+}
+
 void Database::Close() {
 
   QMutexLocker l(&connect_mutex_);
 
-  const QString connection_id = QString("%1_thread_%2").arg(connection_id_).arg(reinterpret_cast<quint64>(QThread::currentThread()));
+  for (const QString &connection_id : QStringList() << ConnectionName() << ConnectionName(true)) {
 
-  // Try to find an existing connection for this thread
-  if (QSqlDatabase::connectionNames().contains(connection_id)) {
-    {
-      QSqlDatabase db = QSqlDatabase::database(connection_id);
-      if (db.isOpen()) {
-        db.close();
-        //qLog(Debug) << "Closed database with connection id" << connection_id;
+    // The prepared queries must be gone before the connection is closed
+    prepared_queries_.remove(connection_id);
+
+    // Try to find an existing connection for this thread
+    if (QSqlDatabase::connectionNames().contains(connection_id)) {
+      {
+        QSqlDatabase db = QSqlDatabase::database(connection_id);
+        if (db.isOpen()) {
+          db.close();
+          //qLog(Debug) << "Closed database with connection id" << connection_id;
+        }
       }
+      QSqlDatabase::removeDatabase(connection_id);
     }
-    QSqlDatabase::removeDatabase(connection_id);
+
   }
 
 }
@@ -297,6 +512,9 @@ void Database::RecreateAttachedDb(const QString &database_name) {
 
   // We can't just re-attach the database now because it needs to be done for each thread.
   // Close all the database connections, so each thread will re-attach it when they next connect.
+  // The prepared queries must be gone before the connections are closed, or they would be used with the new ones.
+  QMutexLocker connect_lock(&connect_mutex_);
+  prepared_queries_.clear();
   for (const QString &name : QSqlDatabase::connectionNames()) {
     QSqlDatabase::removeDatabase(name);
   }
@@ -484,6 +702,22 @@ bool Database::CheckErrors(const QSqlQuery &query) {
 
 }
 
+QSqlQuery Database::PreparedQuery(QSqlDatabase &db, const QString &statement) {
+
+  QMutexLocker l(&connect_mutex_);
+
+  QHash<QString, QSqlQuery> &queries = prepared_queries_[db.connectionName()];
+  if (queries.contains(statement)) return queries.value(statement);
+
+  QSqlQuery q(db);
+  if (q.prepare(statement)) {
+    queries.insert(statement, q);
+  }
+
+  return q;
+
+}
+
 bool Database::IntegrityCheck(QSqlDatabase db) {
 
   qLog(Debug) << "Starting database integrity check";
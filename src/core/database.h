@@ -29,7 +29,9 @@
 #include <QtGlobal>
 #include <QObject>
 #include <QMutex>
+#include <QAtomicInt>
 #include <QMap>
+#include <QHash>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QString>
@@ -58,19 +60,50 @@ class Database : public QObject {
     bool is_temporary_;
   };
 
+  // SQLite settings applied to every connection when it's opened.
+  struct Tuning {
+    Tuning();
+    QString journal_mode;
+    QString synchronous;
+    int cache_size;  // KiB
+    qint64 mmap_size;  // Bytes
+    QString temp_store;
+    int busy_timeout;  // Milliseconds
+  };
+
   static const int kSchemaVersion;
   static const char *kDatabaseFilename;
   static const char *kMagicAllSongsTables;
+  static const char *kSettingsGroup;
 
   void ExitAsync();
   QSqlDatabase Connect();
+  // Returns a read-only connection for the calling thread.
+  // Reads on these connections don't need the database mutex, with WAL they run concurrently with each other and with the writer.
+  // Falls back to the normal connection when the database can't be shared between connections, like an in-memory database.
+  QSqlDatabase ConnectReadOnly();
+
+  const Tuning &tuning() const { return tuning_; }
+  // Returns the active settings and the page cache statistics of the calling thread's connection.
+  QString Diagnostics();
+  // Gets the diagnostics of the database thread's connection, which is the one the backends use, and emits DiagnosticsReady() with them.
+  void DiagnosticsAsync();
+
   void Close();
   bool CheckErrors(const QSqlQuery &query);
 
+  // Returns a query prepared with the given statement for the connection.
+  // The statement is only prepared the first time it's used on each connection, later calls return the same query.
+  // Queries that return rows should be finished when done, so they don't keep the read transaction open.
+  QSqlQuery PreparedQuery(QSqlDatabase &db, const QString &statement);
+
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
   QRecursiveMutex *Mutex() { return &mutex_; }
+  // The mutex to hold while reading from ConnectReadOnly(), nullptr when the reads don't need it.
+  QRecursiveMutex *ReadMutex() { return read_only_connections_.loadAcquire() ? nullptr : &mutex_; }
 #else
   QMutex *Mutex() { return &mutex_; }
+  QMutex *ReadMutex() { return read_only_connections_.loadAcquire() ? nullptr : &mutex_; }
 #endif
 
   void RecreateAttachedDb(const QString &database_name);
@@ -86,14 +119,23 @@ class Database : public QObject {
  signals:
   void ExitFinished();
   void Error(const QString &message);
+  void DiagnosticsReady(const QString &diagnostics);
 
  private slots:
   void Exit();
+  void EmitDiagnostics();
 
  public slots:
   void DoBackup();
 
  private:
+  QString ConnectionName(const bool read_only = false) const;
+  QString DatabaseName() const;
+  bool ReadOnlyConnectionWorks();
+  void LoadTuning();
+  void ApplyTuning(QSqlDatabase &db, const bool read_only = false);
+  static sqlite3 *Handle(QSqlDatabase &db);
+
   int SchemaVersion(QSqlDatabase *db);
   void UpdateMainSchema(QSqlDatabase *db);
 
@@ -112,7 +154,11 @@ class Database : public QObject {
   // Alias -> filename
   QMap<QString, AttachedDatabase> attached_databases_;
 
+  // Connection name -> statement -> prepared query
+  QHash<QString, QHash<QString, QSqlQuery>> prepared_queries_;
+
   QString directory_;
+  Tuning tuning_;
   QMutex connect_mutex_;
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
   QRecursiveMutex mutex_;
@@ -129,6 +175,9 @@ class Database : public QObject {
   // Used by tests
   QString injected_database_name_;
 
+  // Decided once in the constructor, before any other thread can connect, and never changed after that.
+  QAtomicInt read_only_connections_;
+
   uint query_hash_;
   QStringList query_cache_;
 
@@ -145,7 +194,7 @@ class MemoryDatabase : public Database {
       : Database(app, parent, ":memory:") {}
   ~MemoryDatabase() override {
     // Make sure Qt doesn't reuse the same database
-    QSqlDatabase::removeDatabase(Connect().connectionName());
+    Close();
   }
 };
 
@@ -29,6 +29,10 @@
 #include "macfslistener.h"
 #endif
 
+#ifdef Q_OS_LINUX
+#include "inotifyfslistener.h"
+#endif
+
 FileSystemWatcherInterface::FileSystemWatcherInterface(QObject *parent)
     : QObject(parent) {}
 
@@ -36,6 +40,8 @@ FileSystemWatcherInterface *FileSystemWatcherInterface::Create(QObject *parent)
   FileSystemWatcherInterface *ret;
 #ifdef Q_OS_MACOS
   ret = new MacFSListener(parent);
+#elif defined(Q_OS_LINUX)
+  ret = new InotifyFSListener(parent);
 #else
   ret = new QtFSListener(parent);
 #endif
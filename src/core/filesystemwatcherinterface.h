@@ -37,10 +37,15 @@ class FileSystemWatcherInterface : public QObject {
   virtual void RemovePath(const QString &path) = 0;
   virtual void Clear() = 0;
 
+  // Returns true if every change below the watched paths is reported, which makes it safe to replay a journal of the reported changes instead of checking every directory.
+  virtual bool ReportsAllChanges() const { return false; }
+
   static FileSystemWatcherInterface *Create(QObject *parent = nullptr);
 
  signals:
   void PathChanged(const QString &path);
+  // Emitted when changes might have been missed, e.g. when the kernel event queue overflowed.
+  void ChangesLost();
 };
 
 #endif
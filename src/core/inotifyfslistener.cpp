@@ -0,0 +1,160 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <QtGlobal>
+#include <QObject>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QStringList>
+
+#include "core/logging.h"
+#include "filesystemwatcherinterface.h"
+#include "inotifyfslistener.h"
+
+// Changes to the directory entries and files written in place.  Modifications are only reported once the file is closed.
+const quint32 InotifyFSListener::kEventMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+InotifyFSListener::InotifyFSListener(QObject *parent) : FileSystemWatcherInterface(parent), fd_(-1), notifier_(nullptr), watch_failed_(false) {}
+
+InotifyFSListener::~InotifyFSListener() {
+
+  if (fd_ != -1) close(fd_);
+
+}
+
+void InotifyFSListener::Init() {
+
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ == -1) {
+    qLog(Error) << "Failed to initialize inotify:" << strerror(errno);
+    return;
+  }
+
+  notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+  connect(notifier_, SIGNAL(activated(QSocketDescriptor, QSocketNotifier::Type)), SLOT(ReadEvents()));
+#else
+  connect(notifier_, SIGNAL(activated(int)), SLOT(ReadEvents()));
+#endif
+
+}
+
+void InotifyFSListener::AddPath(const QString &path) {
+
+  if (fd_ == -1) {
+    watch_failed_ = true;
+    return;
+  }
+
+  if (watches_.contains(path)) return;
+
+  const int wd = inotify_add_watch(fd_, QFile::encodeName(path).constData(), kEventMask);
+  if (wd == -1) {
+    if (errno == ENOSPC) {
+      if (!watch_failed_) qLog(Warning) << "Reached the inotify watch limit, increase fs.inotify.max_user_watches to monitor all collection directories.";
+    }
+    else {
+      qLog(Warning) << "Failed to watch" << path << strerror(errno);
+    }
+    watch_failed_ = true;
+    return;
+  }
+
+  // The same directory can be reached through more than one path, the kernel then returns the existing watch.
+  if (paths_.contains(wd)) return;
+
+  paths_.insert(wd, path);
+  watches_.insert(path, wd);
+
+}
+
+void InotifyFSListener::RemovePath(const QString &path) {
+
+  if (!watches_.contains(path)) return;
+
+  const int wd = watches_.take(path);
+  paths_.remove(wd);
+  inotify_rm_watch(fd_, wd);
+
+}
+
+void InotifyFSListener::Clear() {
+
+  for (const int wd : paths_.keys()) {
+    inotify_rm_watch(fd_, wd);
+  }
+  paths_.clear();
+  watches_.clear();
+  watch_failed_ = false;
+
+}
+
+bool InotifyFSListener::ReportsAllChanges() const {
+
+  return fd_ != -1 && !watch_failed_;
+
+}
+
+void InotifyFSListener::ReadEvents() {
+
+  QStringList changed_paths;
+  bool changes_lost = false;
+
+  char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  forever {
+    const ssize_t len = read(fd_, buffer, sizeof(buffer));
+    if (len <= 0) break;
+
+    for (const char *ptr = buffer; ptr < buffer + len;) {
+      const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        changes_lost = true;
+        continue;
+      }
+
+      // The watched directory was removed, its parent reports the change.
+      if (event->mask & IN_IGNORED) {
+        if (paths_.contains(event->wd)) watches_.remove(paths_.take(event->wd));
+        continue;
+      }
+
+      const QString path = paths_.value(event->wd);
+      if (!path.isEmpty() && !changed_paths.contains(path)) changed_paths << path;
+    }
+  }
+
+  if (changes_lost) {
+    qLog(Warning) << "The inotify event queue overflowed, some changes were missed.";
+    emit ChangesLost();
+  }
+
+  for (const QString &path : changed_paths) {
+    emit PathChanged(path);
+  }
+
+}
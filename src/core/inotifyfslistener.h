@@ -0,0 +1,63 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INOTIFYFSLISTENER_H
+#define INOTIFYFSLISTENER_H
+
+#include "config.h"
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+
+#include "filesystemwatcherinterface.h"
+
+class QSocketNotifier;
+
+// Watches directories with inotify directly.
+// Unlike QFileSystemWatcher it only asks for the events that matter for the collection, reports files written in place,
+// and it knows when the kernel ran out of watches or dropped events, so the collection watcher can tell whether its change journal is complete.
+class InotifyFSListener : public FileSystemWatcherInterface {
+  Q_OBJECT
+
+ public:
+  explicit InotifyFSListener(QObject *parent = nullptr);
+  ~InotifyFSListener() override;
+
+  void Init() override;
+  void AddPath(const QString &path) override;
+  void RemovePath(const QString &path) override;
+  void Clear() override;
+
+  bool ReportsAllChanges() const override;
+
+ private slots:
+  void ReadEvents();
+
+ private:
+  static const quint32 kEventMask;
+
+  int fd_;
+  QSocketNotifier *notifier_;
+  QHash<int, QString> paths_;
+  QHash<QString, int> watches_;
+  bool watch_failed_;
+};
+
+#endif  // INOTIFYFSLISTENER_H
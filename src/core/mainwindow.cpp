@@ -123,6 +123,9 @@
 #include "collection/collectionquery.h"
 #include "collection/collectionview.h"
 #include "collection/collectionviewcontainer.h"
+#ifdef HAVE_GSTREAMER
+#  include "collection/loudnessscanner.h"
+#endif
 #include "playlist/playlist.h"
 #include "playlist/playlistbackend.h"
 #include "playlist/playlistcontainer.h"
@@ -188,6 +191,7 @@
 #ifdef HAVE_MOODBAR
 #  include "moodbar/moodbarcontroller.h"
 #  include "moodbar/moodbarproxystyle.h"
+#  include "moodbar/moodbarprecomputer.h"
 #endif
 
 #include "smartplaylists/smartplaylistsviewcontainer.h"
@@ -507,6 +511,11 @@ MainWindow::MainWindow(Application *app, SystemTrayIcon *tray_icon, OSDBase *osd
   connect(ui_->action_update_collection, SIGNAL(triggered()), app_->collection(), SLOT(IncrementalScan()));
   connect(ui_->action_full_collection_scan, SIGNAL(triggered()), app_->collection(), SLOT(FullScan()));
   connect(ui_->action_abort_collection_scan, SIGNAL(triggered()), app_->collection(), SLOT(AbortScan()));
+#if defined(HAVE_GSTREAMER)
+  connect(ui_->action_analyse_loudness, SIGNAL(triggered()), app_->loudness_scanner(), SLOT(ScanCollection()));
+#else
+  ui_->action_analyse_loudness->setDisabled(true);
+#endif
 #if defined(HAVE_GSTREAMER)
   connect(ui_->action_add_files_to_transcoder, SIGNAL(triggered()), SLOT(AddFilesToTranscoder()));
   ui_->action_add_files_to_transcoder->setIcon(IconLoader::Load("tools-wizard"));
@@ -814,6 +823,7 @@ MainWindow::MainWindow(Application *app, SystemTrayIcon *tray_icon, OSDBase *osd
 #ifdef HAVE_MOODBAR
   // Moodbar connections
   connect(app_->moodbar_controller(), SIGNAL(CurrentMoodbarDataChanged(QByteArray)), ui_->track_slider->moodbar_style(), SLOT(SetMoodbarData(QByteArray)));
+  connect(app_->collection_backend(), SIGNAL(SongsDiscovered(SongList)), app_->moodbar_precomputer(), SLOT(SongsDiscovered(SongList)));
 #endif
 
   // Playing widget
@@ -2013,15 +2023,19 @@ void MainWindow::EditTracks() {
 
 void MainWindow::EditTagDialogAccepted() {
 
-  for (PlaylistItemPtr item : edit_tag_dialog_->playlist_items()) {
+  const PlaylistItemList items = edit_tag_dialog_->playlist_items();
+  for (PlaylistItemPtr item : items) {
     item->Reload();
   }
 
+  // The current playlist might have changed while the dialog was open, so save every playlist holding the items.
+  for (Playlist *playlist : app_->playlist_manager()->GetAllPlaylists()) {
+    if (playlist->ItemsChanged(items)) playlist->Save();
+  }
+
   // FIXME: This is really lame but we don't know what rows have changed.
   ui_->playlist->view()->update();
 
-  app_->playlist_manager()->current()->Save();
-
 }
 
 void MainWindow::RenumberTracks() {
@@ -55,6 +55,7 @@
 #endif
 #include "collection/directory.h"
 #include "playlist/playlistitem.h"
+#include "playlist/playlistbackend.h"
 #include "playlist/playlistsequence.h"
 #include "covermanager/albumcoverloaderresult.h"
 #include "covermanager/albumcoverfetcher.h"
@@ -111,6 +112,7 @@ void RegisterMetaTypes() {
   qRegisterMetaType<PlaylistItemList>("PlaylistItemList");
   qRegisterMetaType<PlaylistItemPtr>("PlaylistItemPtr");
   qRegisterMetaType<QList<PlaylistItemPtr> >("QList<PlaylistItemPtr>");
+  qRegisterMetaType<PlaylistBackend::PlaylistChanges>("PlaylistBackend::PlaylistChanges");
   qRegisterMetaType<PlaylistSequence::RepeatMode>("PlaylistSequence::RepeatMode");
   qRegisterMetaType<PlaylistSequence::ShuffleMode>("PlaylistSequence::ShuffleMode");
   qRegisterMetaType<AlbumCoverLoaderResult>("AlbumCoverLoaderResult");
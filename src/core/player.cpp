@@ -334,11 +334,13 @@ void Player::HandleLoadResult(const UrlHandler::LoadResult &result) {
 
       if (is_current) {
         qLog(Debug) << "Playing song" << item->Metadata().title() << result.stream_url_;
+        engine_->SetStoredReplayGain(result.original_url_, song.replaygain_track_gain(), song.replaygain_album_gain());
         engine_->Play(result.stream_url_, result.original_url_, stream_change_type_, song.has_cue(), song.beginning_nanosec(), song.end_nanosec());
         current_item_ = item;
       }
       else if (is_next) {
         qLog(Debug) << "Preloading next song" << next_item->Metadata().title() << result.stream_url_;
+        engine_->SetStoredReplayGain(next_item->Url(), song.replaygain_track_gain(), song.replaygain_album_gain());
         engine_->StartPreloading(result.stream_url_, next_item->Url(), song.has_cue(), song.beginning_nanosec(), song.end_nanosec());
       }
 
@@ -591,6 +593,7 @@ void Player::PlayAt(const int index, Engine::TrackChangeFlags change, const Play
   }
   else {
     qLog(Debug) << "Playing song" << current_item_->Metadata().title() << url;
+    engine_->SetStoredReplayGain(current_item_->Url(), current_item_->Metadata().replaygain_track_gain(), current_item_->Metadata().replaygain_album_gain());
     engine_->Play(url, current_item_->Url(), change, current_item_->Metadata().has_cue(), current_item_->effective_beginning_nanosec(), current_item_->effective_end_nanosec());
   }
 
@@ -761,6 +764,7 @@ void Player::TrackAboutToEnd() {
     }
   }
 
+  engine_->SetStoredReplayGain(next_item->Url(), next_item->Metadata().replaygain_track_gain(), next_item->Metadata().replaygain_album_gain());
   engine_->StartPreloading(url, next_item->Url(), next_item->Metadata().has_cue(), next_item->effective_beginning_nanosec(), next_item->effective_end_nanosec());
 
 }
@@ -36,12 +36,14 @@
 #endif
 
 #include <QtGlobal>
+#include <QtNumeric>
 #include <QObject>
 #include <QFile>
 #include <QFileInfo>
 #include <QDir>
 #include <QSharedData>
 #include <QHash>
+#include <QVector>
 #include <QByteArray>
 #include <QVariant>
 #include <QString>
@@ -61,6 +63,7 @@
 
 #include "engine/enginebase.h"
 #include "timeconstants.h"
+#include "stringpool.h"
 #include "utilities.h"
 #include "song.h"
 #include "application.h"
@@ -127,6 +130,11 @@ const QStringList Song::kColumns = QStringList() << "title"
 
                                                  << "rating"
 
+                                                 << "replaygain_track_gain"
+                                                 << "replaygain_track_peak"
+                                                 << "replaygain_album_gain"
+                                                 << "replaygain_album_peak"
+
 						 ;
 
 const QString Song::kColumnSpec = Song::kColumns.join(", ");
@@ -157,30 +165,24 @@ const QString Song::kVariousArtists("various artists");
 
 const QStringList Song::kArticles = QStringList() << "the " << "a " << "an ";
 
+// Fields are grouped by size so the struct has no padding holes.
+// The text that repeats across songs is interned, see the setters.
 struct Song::Private : public QSharedData {
 
   explicit Private(Source source = Source_Unknown);
 
-  bool valid_;
-  int id_;
-
   QString title_;
   QString title_sortable_;
-  QString album_;
-  QString album_sortable_;
-  QString artist_;
-  QString artist_sortable_;
-  QString albumartist_;
-  QString albumartist_sortable_;
-  int track_;
-  int disc_;
-  int year_;
-  int originalyear_;
-  QString genre_;
-  bool compilation_;		// From the file tag
-  QString composer_;
-  QString performer_;
-  QString grouping_;
+  QString album_;               // Interned
+  QString album_sortable_;      // Interned
+  QString artist_;              // Interned
+  QString artist_sortable_;     // Interned
+  QString albumartist_;         // Interned
+  QString albumartist_sortable_;  // Interned
+  QString genre_;               // Interned
+  QString composer_;            // Interned
+  QString performer_;           // Interned
+  QString grouping_;            // Interned
   QString comment_;
   QString lyrics_;
 
@@ -188,8 +190,30 @@ struct Song::Private : public QSharedData {
   QString album_id_;
   QString song_id_;
 
+  QString basefilename_;
+  QUrl url_;
+
+  // Filenames to album art for this song.
+  QUrl art_automatic_;          // Guessed by CollectionWatcher
+  QUrl art_manual_;             // Set by the user - should take priority
+
+  QString cue_path_;            // If the song has a CUE, this contains it's path.
+
+  QUrl stream_url_;             // Temporary stream url set by url handler.
+  QImage image_;                // Album Cover image set by album cover loader.
+
+  QString error_;               // Song load error set by song loader.
+
   qint64 beginning_;
   qint64 end_;
+  qint64 mtime_;
+  qint64 ctime_;
+
+  int id_;
+  int track_;
+  int disc_;
+  int year_;
+  int originalyear_;
 
   int bitrate_;
   int samplerate_;
@@ -197,51 +221,43 @@ struct Song::Private : public QSharedData {
 
   Source source_;
   int directory_id_;
-  QString basefilename_;
-  QUrl url_;
   FileType filetype_;
   int filesize_;
-  qint64 mtime_;
-  qint64 ctime_;
-  bool unavailable_;
 
   int playcount_;
   int skipcount_;
   int lastplayed_;
 
+  float rating_;                // Database rating, not read from tags.
+
+  // Analysed by the loudness scanner, NaN if the song wasn't analysed.
+  float replaygain_track_gain_;
+  float replaygain_track_peak_;
+  float replaygain_album_gain_;
+  float replaygain_album_peak_;
+
+  bool valid_;
+  bool compilation_;            // From the file tag
+  bool unavailable_;
   bool compilation_detected_;   // From the collection scanner
   bool compilation_on_;         // Set by the user
   bool compilation_off_;        // Set by the user
-
-  // Filenames to album art for this song.
-  QUrl art_automatic_;          // Guessed by CollectionWatcher
-  QUrl art_manual_;             // Set by the user - should take priority
-
-  QString cue_path_;            // If the song has a CUE, this contains it's path.
-
-  float rating_;                // Database rating, not read from tags.
-
-  QUrl stream_url_;             // Temporary stream url set by url handler.
-  QImage image_;                // Album Cover image set by album cover loader.
   bool init_from_file_;         // Whether this song was loaded from a file using taglib.
   bool suspicious_tags_;        // Whether our encoding guesser thinks these tags might be incorrectly encoded.
 
-  QString error_;               // Song load error set by song loader.
-
 };
 
 Song::Private::Private(Song::Source source)
-    : valid_(false),
-      id_(-1),
+    : beginning_(0),
+      end_(-1),
+      mtime_(-1),
+      ctime_(-1),
 
+      id_(-1),
       track_(-1),
       disc_(-1),
       year_(-1),
       originalyear_(-1),
-      compilation_(false),
-
-      beginning_(0),
-      end_(-1),
 
       bitrate_(-1),
       samplerate_(-1),
@@ -251,20 +267,24 @@ Song::Private::Private(Song::Source source)
       directory_id_(-1),
       filetype_(FileType_Unknown),
       filesize_(-1),
-      mtime_(-1),
-      ctime_(-1),
-      unavailable_(false),
 
       playcount_(0),
       skipcount_(0),
       lastplayed_(-1),
 
+      rating_(-1),
+
+      replaygain_track_gain_(qQNaN()),
+      replaygain_track_peak_(qQNaN()),
+      replaygain_album_gain_(qQNaN()),
+      replaygain_album_peak_(qQNaN()),
+
+      valid_(false),
+      compilation_(false),
+      unavailable_(false),
       compilation_detected_(false),
       compilation_on_(false),
       compilation_off_(false),
-
-      rating_(-1),
-
       init_from_file_(false),
       suspicious_tags_(false)
 
@@ -355,6 +375,12 @@ bool Song::has_cue() const { return !d->cue_path_.isEmpty(); }
 
 float Song::rating() const { return d->rating_; }
 
+float Song::replaygain_track_gain() const { return d->replaygain_track_gain_; }
+float Song::replaygain_track_peak() const { return d->replaygain_track_peak_; }
+float Song::replaygain_album_gain() const { return d->replaygain_album_gain_; }
+float Song::replaygain_album_peak() const { return d->replaygain_album_peak_; }
+bool Song::has_replaygain() const { return !qIsNaN(d->replaygain_track_gain_); }
+
 bool Song::is_collection_song() const { return d->source_ == Source_Collection; }
 bool Song::is_metadata_good() const { return !d->url_.isEmpty() && !d->artist_.isEmpty() && !d->title_.isEmpty(); }
 bool Song::is_stream() const { return d->source_ == Source_Stream || d->source_ == Source_Tidal || d->source_ == Source_Subsonic || d->source_ == Source_Qobuz; }
@@ -407,18 +433,18 @@ QString Song::sortable(const QString &v) const {
 }
 
 void Song::set_title(const QString &v) { d->title_sortable_ = sortable(v); d->title_ = v; }
-void Song::set_album(const QString &v) { d->album_sortable_ = sortable(v); d->album_ = v; }
-void Song::set_artist(const QString &v) { d->artist_sortable_ = sortable(v); d->artist_ = v; }
-void Song::set_albumartist(const QString &v) { d->albumartist_sortable_ = sortable(v); d->albumartist_ = v; }
+void Song::set_album(const QString &v) { d->album_sortable_ = StringPool::Intern(sortable(v)); d->album_ = StringPool::Intern(v); }
+void Song::set_artist(const QString &v) { d->artist_sortable_ = StringPool::Intern(sortable(v)); d->artist_ = StringPool::Intern(v); }
+void Song::set_albumartist(const QString &v) { d->albumartist_sortable_ = StringPool::Intern(sortable(v)); d->albumartist_ = StringPool::Intern(v); }
 void Song::set_track(int v) { d->track_ = v; }
 void Song::set_disc(int v) { d->disc_ = v; }
 void Song::set_year(int v) { d->year_ = v; }
 void Song::set_originalyear(int v) { d->originalyear_ = v; }
-void Song::set_genre(const QString &v) { d->genre_ = v; }
+void Song::set_genre(const QString &v) { d->genre_ = StringPool::Intern(v); }
 void Song::set_compilation(bool v) { d->compilation_ = v; }
-void Song::set_composer(const QString &v) { d->composer_ = v; }
-void Song::set_performer(const QString &v) { d->performer_ = v; }
-void Song::set_grouping(const QString &v) { d->grouping_ = v; }
+void Song::set_composer(const QString &v) { d->composer_ = StringPool::Intern(v); }
+void Song::set_performer(const QString &v) { d->performer_ = StringPool::Intern(v); }
+void Song::set_grouping(const QString &v) { d->grouping_ = StringPool::Intern(v); }
 void Song::set_comment(const QString &v) { d->comment_ = v; }
 void Song::set_lyrics(const QString &v) { d->lyrics_ = v; }
 
@@ -454,6 +480,13 @@ void Song::set_cue_path(const QString &v) { d->cue_path_ = v; }
 
 void Song::set_rating(float v) { d->rating_ = v; }
 
+void Song::set_replaygain(const float track_gain, const float track_peak, const float album_gain, const float album_peak) {
+  d->replaygain_track_gain_ = track_gain;
+  d->replaygain_track_peak_ = track_peak;
+  d->replaygain_album_gain_ = album_gain;
+  d->replaygain_album_peak_ = album_peak;
+}
+
 void Song::set_stream_url(const QUrl &v) { d->stream_url_ = v; }
 void Song::set_image(const QImage &i) { d->image_ = i; }
 
@@ -707,6 +740,8 @@ QString Song::ImageCacheDir(const Song::Source source) {
 
 }
 
+int Song::PrivateSize() { return sizeof(Private); }
+
 int Song::CompareSongsName(const Song &song1, const Song &song2) {
   return song1.PrettyTitleWithArtist().localeAwareCompare(song2.PrettyTitleWithArtist()) < 0;
 }
@@ -767,11 +802,11 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata &pb) {
   d->disc_ = pb.disc();
   d->year_ = pb.year();
   d->originalyear_ = pb.originalyear();
-  d->genre_ = QStringFromStdString(pb.genre());
+  set_genre(QStringFromStdString(pb.genre()));
   d->compilation_ = pb.compilation();
-  d->composer_ = QStringFromStdString(pb.composer());
-  d->performer_ = QStringFromStdString(pb.performer());
-  d->grouping_ = QStringFromStdString(pb.grouping());
+  set_composer(QStringFromStdString(pb.composer()));
+  set_performer(QStringFromStdString(pb.performer()));
+  set_grouping(QStringFromStdString(pb.grouping()));
   d->comment_ = QStringFromStdString(pb.comment());
   d->lyrics_ = QStringFromStdString(pb.lyrics());
   set_length_nanosec(pb.length_nanosec());
@@ -839,184 +874,129 @@ void Song::ToProtobuf(pb::tagreader::SongMetadata *pb) const {
 
 }
 
-#define tostr(n) (q.value(n).isNull() ? QString() : q.value(n).toString())
-#define toint(n) (q.value(n).isNull() ? -1 : q.value(n).toInt())
-#define tolonglong(n) (q.value(n).isNull() ? -1 : q.value(n).toLongLong())
-#define tofloat(n) (q.value(n).isNull() ? -1 : q.value(n).toDouble())
-
-void Song::InitFromQuery(const SqlRow &q, bool reliable_metadata, int col) {
-
-  //qLog(Debug) << "Song::kColumns.size():" << Song::kColumns.size() << "q.columns_.size():" << q.columns_.size() << "col:" << col;
+namespace {
 
-  int x = col;
-  d->id_ = toint(col);
+QString ColumnString(const QVariant &value) { return value.isNull() ? QString() : value.toString(); }
+int ColumnInt(const QVariant &value) { return value.isNull() ? -1 : value.toInt(); }
+qint64 ColumnLongLong(const QVariant &value) { return value.isNull() ? -1 : value.toLongLong(); }
+double ColumnFloat(const QVariant &value) { return value.isNull() ? -1 : value.toDouble(); }
+// A gain of -1 dB is valid, so missing values are NaN.
+float ColumnReplayGain(const QVariant &value) { return value.isNull() ? qQNaN() : value.toFloat(); }
 
-  for (int i = 0 ; i < Song::kColumns.size(); i++) {
-    x++;
+QUrl ColumnArtUrl(const QVariant &value) {
 
-    if (x >= q.columns_.size()) {
-      qLog(Error) << "Skipping" << Song::kColumns.value(i);
-      break;
-    }
-
-    //qLog(Debug) << "Index:" << i << x << Song::kColumns.value(i) << q.value(x).toString();
-
-    if (Song::kColumns.value(i) == "title") {
-      set_title(tostr(x));
-    }
-    else if (Song::kColumns.value(i) == "album") {
-      set_album(tostr(x));
-    }
-    else if (Song::kColumns.value(i) == "artist") {
-      set_artist(tostr(x));
-    }
-    else if (Song::kColumns.value(i) == "albumartist") {
-      set_albumartist(tostr(x));
-    }
-    else if (Song::kColumns.value(i) == "track") {
-      d->track_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "disc") {
-      d->disc_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "year") {
-      d->year_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "originalyear") {
-      d->originalyear_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "genre") {
-      d->genre_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "compilation") {
-      d->compilation_ = q.value(x).toBool();
-    }
-    else if (Song::kColumns.value(i) == "composer") {
-      d->composer_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "performer") {
-      d->performer_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "grouping") {
-      d->grouping_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "comment") {
-      d->comment_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "lyrics") {
-      d->lyrics_ = tostr(x);
-    }
+  QString art = ColumnString(value);
+  if (art.contains(QRegularExpression("..+:.*"))) {
+    return QUrl::fromEncoded(art.toUtf8());
+  }
+  else {
+    return QUrl::fromLocalFile(art);
+  }
 
-    else if (Song::kColumns.value(i) == "artist_id") {
-      d->artist_id_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "album_id") {
-      d->album_id_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "song_id") {
-      d->song_id_ = tostr(x);
-    }
+}
 
-    else if (Song::kColumns.value(i) == "beginning") {
-      d->beginning_ = q.value(x).isNull() ? 0 : q.value(x).toLongLong();
-    }
-    else if (Song::kColumns.value(i) == "length") {
-      set_length_nanosec(tolonglong(x));
+}  // namespace
+
+const QVector<Song::ColumnSetter> &Song::ColumnSetters() {
+
+  static const QVector<ColumnSetter> column_setters = []() {
+
+    QHash<QString, ColumnSetter> setters;
+
+    setters.insert("title", [](Song *song, const QVariant &value) { song->set_title(ColumnString(value)); });
+    setters.insert("album", [](Song *song, const QVariant &value) { song->set_album(ColumnString(value)); });
+    setters.insert("artist", [](Song *song, const QVariant &value) { song->set_artist(ColumnString(value)); });
+    setters.insert("albumartist", [](Song *song, const QVariant &value) { song->set_albumartist(ColumnString(value)); });
+    setters.insert("track", [](Song *song, const QVariant &value) { song->d->track_ = ColumnInt(value); });
+    setters.insert("disc", [](Song *song, const QVariant &value) { song->d->disc_ = ColumnInt(value); });
+    setters.insert("year", [](Song *song, const QVariant &value) { song->d->year_ = ColumnInt(value); });
+    setters.insert("originalyear", [](Song *song, const QVariant &value) { song->d->originalyear_ = ColumnInt(value); });
+    setters.insert("genre", [](Song *song, const QVariant &value) { song->set_genre(ColumnString(value)); });
+    setters.insert("compilation", [](Song *song, const QVariant &value) { song->d->compilation_ = value.toBool(); });
+    setters.insert("composer", [](Song *song, const QVariant &value) { song->set_composer(ColumnString(value)); });
+    setters.insert("performer", [](Song *song, const QVariant &value) { song->set_performer(ColumnString(value)); });
+    setters.insert("grouping", [](Song *song, const QVariant &value) { song->set_grouping(ColumnString(value)); });
+    setters.insert("comment", [](Song *song, const QVariant &value) { song->d->comment_ = ColumnString(value); });
+    setters.insert("lyrics", [](Song *song, const QVariant &value) { song->d->lyrics_ = ColumnString(value); });
+
+    setters.insert("artist_id", [](Song *song, const QVariant &value) { song->d->artist_id_ = ColumnString(value); });
+    setters.insert("album_id", [](Song *song, const QVariant &value) { song->d->album_id_ = ColumnString(value); });
+    setters.insert("song_id", [](Song *song, const QVariant &value) { song->d->song_id_ = ColumnString(value); });
+
+    setters.insert("beginning", [](Song *song, const QVariant &value) { song->d->beginning_ = value.isNull() ? 0 : value.toLongLong(); });
+    setters.insert("length", [](Song *song, const QVariant &value) { song->set_length_nanosec(ColumnLongLong(value)); });
+
+    setters.insert("bitrate", [](Song *song, const QVariant &value) { song->d->bitrate_ = ColumnInt(value); });
+    setters.insert("samplerate", [](Song *song, const QVariant &value) { song->d->samplerate_ = ColumnInt(value); });
+    setters.insert("bitdepth", [](Song *song, const QVariant &value) { song->d->bitdepth_ = ColumnInt(value); });
+
+    setters.insert("source", [](Song *song, const QVariant &value) { song->d->source_ = Source(value.toInt()); });
+    setters.insert("directory_id", [](Song *song, const QVariant &value) { song->d->directory_id_ = ColumnInt(value); });
+    setters.insert("url", [](Song *song, const QVariant &value) {
+      song->set_url(QUrl::fromEncoded(ColumnString(value).toUtf8()));
+      song->d->basefilename_ = QFileInfo(song->d->url_.toLocalFile()).fileName();
+    });
+    setters.insert("filetype", [](Song *song, const QVariant &value) { song->d->filetype_ = FileType(value.toInt()); });
+    setters.insert("filesize", [](Song *song, const QVariant &value) { song->d->filesize_ = ColumnInt(value); });
+    setters.insert("mtime", [](Song *song, const QVariant &value) { song->d->mtime_ = ColumnLongLong(value); });
+    setters.insert("ctime", [](Song *song, const QVariant &value) { song->d->ctime_ = ColumnLongLong(value); });
+    setters.insert("unavailable", [](Song *song, const QVariant &value) { song->d->unavailable_ = value.toBool(); });
+
+    setters.insert("playcount", [](Song *song, const QVariant &value) { song->d->playcount_ = value.isNull() ? 0 : value.toInt(); });
+    setters.insert("skipcount", [](Song *song, const QVariant &value) { song->d->skipcount_ = value.isNull() ? 0 : value.toInt(); });
+    setters.insert("lastplayed", [](Song *song, const QVariant &value) { song->d->lastplayed_ = ColumnInt(value); });
+
+    setters.insert("compilation_detected", [](Song *song, const QVariant &value) { song->d->compilation_detected_ = value.toBool(); });
+    setters.insert("compilation_on", [](Song *song, const QVariant &value) { song->d->compilation_on_ = value.toBool(); });
+    setters.insert("compilation_off", [](Song *song, const QVariant &value) { song->d->compilation_off_ = value.toBool(); });
+    setters.insert("compilation_effective", [](Song*, const QVariant&) {});
+
+    setters.insert("art_automatic", [](Song *song, const QVariant &value) { song->set_art_automatic(ColumnArtUrl(value)); });
+    setters.insert("art_manual", [](Song *song, const QVariant &value) { song->set_art_manual(ColumnArtUrl(value)); });
+
+    setters.insert("effective_albumartist", [](Song*, const QVariant&) {});
+    setters.insert("effective_originalyear", [](Song*, const QVariant&) {});
+
+    setters.insert("cue_path", [](Song *song, const QVariant &value) { song->d->cue_path_ = ColumnString(value); });
+
+    setters.insert("rating", [](Song *song, const QVariant &value) { song->d->rating_ = ColumnFloat(value); });
+
+    setters.insert("replaygain_track_gain", [](Song *song, const QVariant &value) { song->d->replaygain_track_gain_ = ColumnReplayGain(value); });
+    setters.insert("replaygain_track_peak", [](Song *song, const QVariant &value) { song->d->replaygain_track_peak_ = ColumnReplayGain(value); });
+    setters.insert("replaygain_album_gain", [](Song *song, const QVariant &value) { song->d->replaygain_album_gain_ = ColumnReplayGain(value); });
+    setters.insert("replaygain_album_peak", [](Song *song, const QVariant &value) { song->d->replaygain_album_peak_ = ColumnReplayGain(value); });
+
+    // Put the setters in the same order as the columns, so a row can be read with one indexed loop.
+    QVector<ColumnSetter> ret;
+    ret.reserve(Song::kColumns.count());
+    for (const QString &column : Song::kColumns) {
+      if (!setters.contains(column)) {
+        qLog(Error) << "Forgot to handle" << column;
+      }
+      ret << setters.value(column, nullptr);
     }
+    return ret;
 
-    else if (Song::kColumns.value(i) == "bitrate") {
-      d->bitrate_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "samplerate") {
-      d->samplerate_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "bitdepth") {
-      d->bitdepth_ = toint(x);
-    }
+  }();
 
-    else if (Song::kColumns.value(i) == "source") {
-      d->source_ = Source(q.value(x).toInt());
-    }
-    else if (Song::kColumns.value(i) == "directory_id") {
-      d->directory_id_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "url") {
-     set_url(QUrl::fromEncoded(tostr(x).toUtf8()));
-     d->basefilename_ = QFileInfo(d->url_.toLocalFile()).fileName();
-    }
-    else if (Song::kColumns.value(i) == "filetype") {
-      d->filetype_ = FileType(q.value(x).toInt());
-    }
-    else if (Song::kColumns.value(i) == "filesize") {
-      d->filesize_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "mtime") {
-      d->mtime_ = tolonglong(x);
-    }
-    else if (Song::kColumns.value(i) == "ctime") {
-      d->ctime_ = tolonglong(x);
-    }
-    else if (Song::kColumns.value(i) == "unavailable") {
-      d->unavailable_ = q.value(x).toBool();
-    }
+  return column_setters;
 
-    else if (Song::kColumns.value(i) == "playcount") {
-      d->playcount_ = q.value(x).isNull() ? 0 : q.value(x).toInt();
-    }
-    else if (Song::kColumns.value(i) == "skipcount") {
-      d->skipcount_ = q.value(x).isNull() ? 0 : q.value(x).toInt();
-    }
-    else if (Song::kColumns.value(i) == "lastplayed") {
-      d->lastplayed_ = toint(x);
-    }
-
-    else if (Song::kColumns.value(i) == "compilation_detected") {
-      d->compilation_detected_ = q.value(x).toBool();
-    }
-    else if (Song::kColumns.value(i) == "compilation_on") {
-      d->compilation_on_ = q.value(x).toBool();
-    }
-    else if (Song::kColumns.value(i) == "compilation_off") {
-      d->compilation_off_ = q.value(x).toBool();
-    }
-    else if (Song::kColumns.value(i) == "compilation_effective") {
-    }
+}
 
-    else if (Song::kColumns.value(i) == "art_automatic") {
-      QString art_automatic = tostr(x);
-      if (art_automatic.contains(QRegularExpression("..+:.*"))) {
-        set_art_automatic(QUrl::fromEncoded(art_automatic.toUtf8()));
-      }
-      else {
-        set_art_automatic(QUrl::fromLocalFile(art_automatic));
-      }
-    }
-    else if (Song::kColumns.value(i) == "art_manual") {
-      QString art_manual = tostr(x);
-      if (art_manual.contains(QRegularExpression("..+:.*"))) {
-        set_art_manual(QUrl::fromEncoded(art_manual.toUtf8()));
-      }
-      else {
-        set_art_manual(QUrl::fromLocalFile(art_manual));
-      }
-    }
+void Song::InitFromQuery(const SqlRow &q, bool reliable_metadata, int col) {
 
-    else if (Song::kColumns.value(i) == "effective_albumartist") {
-    }
-    else if (Song::kColumns.value(i) == "effective_originalyear") {
-    }
+  //qLog(Debug) << "Song::kColumns.size():" << Song::kColumns.size() << "q.columns_.size():" << q.columns_.size() << "col:" << col;
 
-    else if (Song::kColumns.value(i) == "cue_path") {
-      d->cue_path_ = tostr(x);
-    }
+  const QVector<ColumnSetter> &setters = ColumnSetters();
 
-    else if (Song::kColumns.value(i) == "rating") {
-      d->rating_ = tofloat(x);
-    }
+  d->id_ = ColumnInt(q.value(col));
 
-    else {
-      qLog(Error) << "Forgot to handle" << Song::kColumns.value(i);
+  for (int i = 0, x = col + 1; i < setters.count(); ++i, ++x) {
+    if (x >= q.columns_.size()) {
+      qLog(Error) << "Skipping" << Song::kColumns.value(i);
+      break;
     }
+    if (setters[i]) setters[i](this, q.value(x));
   }
 
   d->valid_ = true;
@@ -1024,11 +1004,6 @@ void Song::InitFromQuery(const SqlRow &q, bool reliable_metadata, int col) {
 
   InitArtManual();
 
-#undef tostr
-#undef toint
-#undef tolonglong
-#undef tofloat
-
 }
 
 void Song::InitFromFilePartial(const QString &filename) {
@@ -1087,10 +1062,10 @@ void Song::InitFromItdb(Itdb_Track *track, const QString &prefix) {
   d->track_ = track->track_nr;
   d->disc_ = track->cd_nr;
   d->year_ = track->year;
-  d->genre_ = QString::fromUtf8(track->genre);
+  set_genre(QString::fromUtf8(track->genre));
   d->compilation_ = track->compilation;
-  d->composer_ = QString::fromUtf8(track->composer);
-  d->grouping_ = QString::fromUtf8(track->grouping);
+  set_composer(QString::fromUtf8(track->composer));
+  set_grouping(QString::fromUtf8(track->grouping));
   d->comment_ = QString::fromUtf8(track->comment);
 
   set_length_nanosec(track->tracklen * kNsecPerMsec);
@@ -1179,8 +1154,8 @@ void Song::InitFromMTP(const LIBMTP_track_t *track, const QString &host) {
   set_title(QString::fromUtf8(track->title));
   set_artist(QString::fromUtf8(track->artist));
   set_album(QString::fromUtf8(track->album));
-  d->genre_ = QString::fromUtf8(track->genre);
-  d->composer_ = QString::fromUtf8(track->composer);
+  set_genre(QString::fromUtf8(track->genre));
+  set_composer(QString::fromUtf8(track->composer));
   d->track_ = track->tracknumber;
 
   d->url_ = QUrl(QString("mtp://%1/%2").arg(host, QString::number(track->item_id)));
@@ -1316,86 +1291,121 @@ bool Song::MergeFromSimpleMetaBundle(const Engine::SimpleMetaBundle &bundle) {
 
 }
 
-void Song::BindToQuery(QSqlQuery *query) const {
+QVariantList Song::ColumnValues() const {
+
+  QVariantList values;
+  values.reserve(kColumns.count());
 
 #define strval(x) ((x).isNull() ? "" : (x))
 #define intval(x) ((x) <= 0 ? -1 : (x))
 #define notnullintval(x) ((x) == -1 ? QVariant() : (x))
-
-  // Remember to bind these in the same order as kBindSpec
-
-  query->bindValue(":title", strval(d->title_));
-  query->bindValue(":album", strval(d->album_));
-  query->bindValue(":artist", strval(d->artist_));
-  query->bindValue(":albumartist", strval(d->albumartist_));
-  query->bindValue(":track", intval(d->track_));
-  query->bindValue(":disc", intval(d->disc_));
-  query->bindValue(":year", intval(d->year_));
-  query->bindValue(":originalyear", intval(d->originalyear_));
-  query->bindValue(":genre", strval(d->genre_));
-  query->bindValue(":compilation", d->compilation_ ? 1 : 0);
-  query->bindValue(":composer", strval(d->composer_));
-  query->bindValue(":performer", strval(d->performer_));
-  query->bindValue(":grouping", strval(d->grouping_));
-  query->bindValue(":comment", strval(d->comment_));
-  query->bindValue(":lyrics", strval(d->lyrics_));
-
-  query->bindValue(":artist_id", strval(d->artist_id_));
-  query->bindValue(":album_id", strval(d->album_id_));
-  query->bindValue(":song_id", strval(d->song_id_));
-
-  query->bindValue(":beginning", d->beginning_);
-  query->bindValue(":length", intval(length_nanosec()));
-
-  query->bindValue(":bitrate", intval(d->bitrate_));
-  query->bindValue(":samplerate", intval(d->samplerate_));
-  query->bindValue(":bitdepth", intval(d->bitdepth_));
-
-  query->bindValue(":source", d->source_);
-  query->bindValue(":directory_id", notnullintval(d->directory_id_));
-  query->bindValue(":url", d->url_.toString(QUrl::FullyEncoded));
-  query->bindValue(":filetype", d->filetype_);
-  query->bindValue(":filesize", notnullintval(d->filesize_));
-  query->bindValue(":mtime", notnullintval(d->mtime_));
-  query->bindValue(":ctime", notnullintval(d->ctime_));
-  query->bindValue(":unavailable", d->unavailable_ ? 1 : 0);
-
-  query->bindValue(":playcount", d->playcount_);
-  query->bindValue(":skipcount", d->skipcount_);
-  query->bindValue(":lastplayed", intval(d->lastplayed_));
-
-  query->bindValue(":compilation_detected", d->compilation_detected_ ? 1 : 0);
-  query->bindValue(":compilation_on", d->compilation_on_ ? 1 : 0);
-  query->bindValue(":compilation_off", d->compilation_off_ ? 1 : 0);
-  query->bindValue(":compilation_effective", is_compilation() ? 1 : 0);
-
-  query->bindValue(":art_automatic", d->art_automatic_.toString(QUrl::FullyEncoded));
-  query->bindValue(":art_manual", d->art_manual_.toString(QUrl::FullyEncoded));
-
-  query->bindValue(":effective_albumartist", this->effective_albumartist());
-  query->bindValue(":effective_originalyear", intval(this->effective_originalyear()));
-
-  query->bindValue(":cue_path", d->cue_path_);
-
-  query->bindValue(":rating", intval(d->rating_));
+#define replaygainval(x) (qIsNaN(x) ? QVariant() : QVariant(x))
+
+  // Remember to add these in the same order as kColumns
+
+  values << strval(d->title_);
+  values << strval(d->album_);
+  values << strval(d->artist_);
+  values << strval(d->albumartist_);
+  values << intval(d->track_);
+  values << intval(d->disc_);
+  values << intval(d->year_);
+  values << intval(d->originalyear_);
+  values << strval(d->genre_);
+  values << (d->compilation_ ? 1 : 0);
+  values << strval(d->composer_);
+  values << strval(d->performer_);
+  values << strval(d->grouping_);
+  values << strval(d->comment_);
+  values << strval(d->lyrics_);
+
+  values << strval(d->artist_id_);
+  values << strval(d->album_id_);
+  values << strval(d->song_id_);
+
+  values << d->beginning_;
+  values << intval(length_nanosec());
+
+  values << intval(d->bitrate_);
+  values << intval(d->samplerate_);
+  values << intval(d->bitdepth_);
+
+  values << d->source_;
+  values << notnullintval(d->directory_id_);
+  values << d->url_.toString(QUrl::FullyEncoded);
+  values << d->filetype_;
+  values << notnullintval(d->filesize_);
+  values << notnullintval(d->mtime_);
+  values << notnullintval(d->ctime_);
+  values << (d->unavailable_ ? 1 : 0);
+
+  values << d->playcount_;
+  values << d->skipcount_;
+  values << intval(d->lastplayed_);
+
+  values << (d->compilation_detected_ ? 1 : 0);
+  values << (d->compilation_on_ ? 1 : 0);
+  values << (d->compilation_off_ ? 1 : 0);
+  values << (is_compilation() ? 1 : 0);
+
+  values << d->art_automatic_.toString(QUrl::FullyEncoded);
+  values << d->art_manual_.toString(QUrl::FullyEncoded);
+
+  values << this->effective_albumartist();
+  values << intval(this->effective_originalyear());
+
+  values << d->cue_path_;
+
+  values << intval(d->rating_);
+
+  values << replaygainval(d->replaygain_track_gain_);
+  values << replaygainval(d->replaygain_track_peak_);
+  values << replaygainval(d->replaygain_album_gain_);
+  values << replaygainval(d->replaygain_album_peak_);
 
 #undef intval
+#undef replaygainval
 #undef notnullintval
 #undef strval
 
+  return values;
+
+}
+
+void Song::BindToQuery(QSqlQuery *query) const {
+
+  const QVariantList values = ColumnValues();
+  for (int i = 0; i < values.count(); ++i) {
+    query->bindValue(":" + kColumns[i], values[i]);
+  }
+
+}
+
+QVariantList Song::FtsColumnValues() const {
+
+  QVariantList values;
+  values.reserve(kFtsColumns.count());
+
+  values << d->title_;
+  values << d->album_;
+  values << d->artist_;
+  values << d->albumartist_;
+  values << d->composer_;
+  values << d->performer_;
+  values << d->grouping_;
+  values << d->genre_;
+  values << d->comment_;
+
+  return values;
+
 }
 
 void Song::BindToFtsQuery(QSqlQuery *query) const {
 
-  query->bindValue(":ftstitle", d->title_);
-  query->bindValue(":ftsalbum", d->album_);
-  query->bindValue(":ftsartist", d->artist_);
-  query->bindValue(":ftsalbumartist", d->albumartist_);
-  query->bindValue(":ftscomposer", d->composer_);
-  query->bindValue(":ftsperformer", d->performer_);
-  query->bindValue(":ftsgrouping", d->grouping_);
-  query->bindValue(":ftsgenre", d->genre_);
-  query->bindValue(":ftscomment", d->comment_);
+  const QVariantList values = FtsColumnValues();
+  for (int i = 0; i < values.count(); ++i) {
+    query->bindValue(":" + kFtsColumns[i], values[i]);
+  }
 
 }
 
@@ -1574,5 +1584,6 @@ void Song::MergeUserSetData(const Song &other) {
   set_compilation_on(other.compilation_on());
   set_compilation_off(other.compilation_off());
   set_rating(other.rating());
+  set_replaygain(other.replaygain_track_gain(), other.replaygain_track_peak(), other.replaygain_album_gain(), other.replaygain_album_peak());
 
 }
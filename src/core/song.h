@@ -30,6 +30,7 @@
 #include <QMetaType>
 #include <QList>
 #include <QSet>
+#include <QVector>
 #include <QVariant>
 #include <QString>
 #include <QStringList>
@@ -153,6 +154,9 @@ class Song {
   static int CompareSongsName(const Song &song1, const Song &song2);
   static void SortSongsListAlphabetically(QList<Song> *songs);
 
+  // Bytes of the data every song allocates, not counting the text it points to.
+  static int PrivateSize();
+
   // Constructors
   void Init(const QString &title, const QString &artist, const QString &album, qint64 length_nanosec);
   void Init(const QString &title, const QString &artist, const QString &album, qint64 beginning, qint64 end);
@@ -180,6 +184,9 @@ class Song {
   static QString Decode(const QString &tag, const QTextCodec *codec = nullptr);
 
   // Save
+  // The values of kColumns and kFtsColumns as stored in the database, in the same order.
+  QVariantList ColumnValues() const;
+  QVariantList FtsColumnValues() const;
   void BindToQuery(QSqlQuery *query) const;
   void BindToFtsQuery(QSqlQuery *query) const;
   void ToXesam(QVariantMap *map) const;
@@ -247,6 +254,13 @@ class Song {
 
   float rating() const;
 
+  // ReplayGain in dB and peak as a linear sample value, from the loudness scanner.
+  float replaygain_track_gain() const;
+  float replaygain_track_peak() const;
+  float replaygain_album_gain() const;
+  float replaygain_album_peak() const;
+  bool has_replaygain() const;
+
   const QString &effective_album() const;
   int effective_originalyear() const;
   const QString &effective_albumartist() const;
@@ -351,6 +365,7 @@ class Song {
   void set_cue_path(const QString &v);
 
   void set_rating(const float v);
+  void set_replaygain(const float track_gain, const float track_peak, const float album_gain, const float album_peak);
 
   void set_stream_url(const QUrl &v);
   void set_image(const QImage &i);
@@ -372,6 +387,10 @@ class Song {
  private:
   struct Private;
 
+  // Setters for the columns in kColumns, in the same order, so InitFromQuery() doesn't need to compare column names for every row.
+  typedef void (*ColumnSetter)(Song *song, const QVariant &value);
+  static const QVector<ColumnSetter> &ColumnSetters();
+
   QString sortable(const QString &v) const;
 
   QSharedDataPointer<Private> d;
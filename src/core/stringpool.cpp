@@ -0,0 +1,96 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+#include "stringpool.h"
+
+namespace {
+
+// The pool is split in shards with their own lock, so threads creating songs at the same time rarely wait for each other.
+const int kShardCount = 16;
+
+struct Shard {
+  QMutex mutex;
+  QSet<QString> strings;
+};
+
+Shard *Shards() {
+  static Shard shards[kShardCount];
+  return shards;
+}
+
+}  // namespace
+
+QString StringPool::Intern(const QString &str) {
+
+  if (str.isEmpty()) return str;
+
+  Shard &shard = Shards()[qHash(str) % kShardCount];
+  QMutexLocker l(&shard.mutex);
+  QSet<QString>::const_iterator it = shard.strings.constFind(str);
+  if (it != shard.strings.constEnd()) return *it;
+
+  // Don't keep the unused capacity of strings that were built by appending.
+  QString copy = str.capacity() > str.size() ? QString(str.constData(), str.size()) : str;
+  shard.strings.insert(copy);
+  return copy;
+
+}
+
+int StringPool::Prune() {
+
+  int removed = 0;
+  for (int i = 0; i < kShardCount; ++i) {
+    Shard &shard = Shards()[i];
+    QMutexLocker l(&shard.mutex);
+    for (QSet<QString>::iterator it = shard.strings.begin(); it != shard.strings.end();) {
+      // Only the pool holds a reference.
+      if (it->isDetached()) {
+        it = shard.strings.erase(it);
+        ++removed;
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+  return removed;
+
+}
+
+StringPool::Statistics StringPool::statistics() {
+
+  Statistics statistics;
+  for (int i = 0; i < kShardCount; ++i) {
+    Shard &shard = Shards()[i];
+    QMutexLocker l(&shard.mutex);
+    statistics.strings += shard.strings.count();
+    for (const QString &str : shard.strings) {
+      statistics.bytes += str.size() * static_cast<qint64>(sizeof(QChar));
+    }
+  }
+  return statistics;
+
+}
@@ -0,0 +1,52 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QString>
+
+// Process wide pool of interned strings.
+// Intern() returns a copy that shares its data with every other interned string of the same value,
+// so text that repeats across many songs, like artist, album and genre names, is only stored once.
+// Can be used from any thread.
+class StringPool {
+ public:
+  struct Statistics {
+    Statistics() : strings(0), bytes(0) {}
+    int strings;
+    qint64 bytes;
+  };
+
+  static QString Intern(const QString &str);
+
+  // Removes the strings nothing else refers to anymore.  Returns the number of strings removed.
+  static int Prune();
+
+  static Statistics statistics();
+
+ private:
+  StringPool() {}
+  Q_DISABLE_COPY(StringPool)
+};
+
+#endif  // STRINGPOOL_H
@@ -24,10 +24,13 @@
 #include <cassert>
 
 #include <QtGlobal>
+#include <QtNumeric>
 #include <QObject>
 #include <QThread>
 #include <QByteArray>
+#include <QList>
 #include <QString>
+#include <QStringList>
 #include <QImage>
 #include <QtDebug>
 
@@ -38,6 +41,9 @@
 #include "tagreaderclient.h"
 
 const char *TagReaderClient::kWorkerExecutableName = "strawberry-tagreader";
+const int TagReaderClient::kReadFilesBatchSize = 100;
+const int TagReaderClient::kMaxMessagesPerWorker = 4;
+const int TagReaderClient::kWorkerIdleTimeout = 60000;
 TagReaderClient *TagReaderClient::sInstance = nullptr;
 
 TagReaderClient::TagReaderClient(QObject *parent) : QObject(parent), worker_pool_(new WorkerPool<HandlerType>(this)) {
@@ -46,7 +52,10 @@ TagReaderClient::TagReaderClient(QObject *parent) : QObject(parent), worker_pool
   original_thread_ = thread();
 
   worker_pool_->SetExecutableName(kWorkerExecutableName);
-  worker_pool_->SetWorkerCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+  // Start with one tag reader, and start more while a collection scan or organize job keeps them busy.
+  worker_pool_->SetWorkerCount(1, qBound(1, QThread::idealThreadCount(), 8));
+  worker_pool_->SetMaxMessagesPerWorker(kMaxMessagesPerWorker);
+  worker_pool_->SetIdleTimeout(kWorkerIdleTimeout);
   connect(worker_pool_, SIGNAL(WorkerFailedToStart()), SLOT(WorkerFailedToStart()));
 
 }
@@ -80,6 +89,19 @@ TagReaderReply *TagReaderClient::ReadFile(const QString &filename) {
 
 }
 
+TagReaderReply *TagReaderClient::ReadFiles(const QStringList &filenames) {
+
+  pb::tagreader::Message message;
+  pb::tagreader::ReadFilesRequest *req = message.mutable_read_files_request();
+
+  for (const QString &filename : filenames) {
+    req->add_filenames(DataCommaSizeFromQString(filename));
+  }
+
+  return worker_pool_->SendMessageWithReply(&message);
+
+}
+
 TagReaderReply *TagReaderClient::SaveFile(const QString &filename, const Song &metadata) {
 
   pb::tagreader::Message message;
@@ -94,6 +116,23 @@ TagReaderReply *TagReaderClient::SaveFile(const QString &filename, const Song &m
 
 }
 
+TagReaderReply *TagReaderClient::SaveReplayGain(const QString &filename, const Song &metadata) {
+
+  pb::tagreader::Message message;
+  pb::tagreader::SaveReplayGainRequest *req = message.mutable_save_replaygain_request();
+
+  req->set_filename(DataCommaSizeFromQString(filename));
+  req->set_track_gain(metadata.replaygain_track_gain());
+  req->set_track_peak(metadata.replaygain_track_peak());
+  if (!qIsNaN(metadata.replaygain_album_gain())) {
+    req->set_album_gain(metadata.replaygain_album_gain());
+    req->set_album_peak(metadata.replaygain_album_peak());
+  }
+
+  return worker_pool_->SendMessageWithReply(&message);
+
+}
+
 TagReaderReply *TagReaderClient::IsMediaFile(const QString &filename) {
 
   pb::tagreader::Message message;
@@ -128,6 +167,39 @@ void TagReaderClient::ReadFileBlocking(const QString &filename, Song *song) {
 
 }
 
+QList<bool> TagReaderClient::ReadFilesBlocking(const QStringList &filenames, SongList *songs) {
+
+  Q_ASSERT(QThread::currentThread() != thread());
+  Q_ASSERT(filenames.count() == songs->count());
+
+  QList<bool> read;
+  read.reserve(filenames.count());
+  for (int i = 0; i < filenames.count(); ++i) read << false;
+
+  // Send all batches before waiting, so they are read by all workers at the same time.
+  QList<TagReaderReply*> replies;
+  for (int i = 0; i < filenames.count(); i += kReadFilesBatchSize) {
+    replies << ReadFiles(filenames.mid(i, kReadFilesBatchSize));
+  }
+
+  for (int i = 0; i < replies.count(); ++i) {
+    TagReaderReply *reply = replies[i];
+    if (reply->WaitForFinished()) {
+      const pb::tagreader::ReadFilesResponse &response = reply->message().read_files_response();
+      for (int j = 0; j < response.files_size(); ++j) {
+        const int index = i * kReadFilesBatchSize + j;
+        if (index >= songs->count() || j >= kReadFilesBatchSize) break;
+        (*songs)[index].InitFromProtobuf(response.files(j).metadata());
+        read[index] = true;
+      }
+    }
+    reply->deleteLater();
+  }
+
+  return read;
+
+}
+
 bool TagReaderClient::SaveFileBlocking(const QString &filename, const Song &metadata) {
 
   Q_ASSERT(QThread::currentThread() != thread());
@@ -26,6 +26,7 @@
 #include <QObject>
 #include <QList>
 #include <QString>
+#include <QStringList>
 #include <QImage>
 
 #include "core/messagehandler.h"
@@ -48,18 +49,28 @@ class TagReaderClient : public QObject {
   typedef HandlerType::ReplyType ReplyType;
 
   static const char *kWorkerExecutableName;
+  static const int kReadFilesBatchSize;
+  static const int kMaxMessagesPerWorker;
+  static const int kWorkerIdleTimeout;
 
   void Start();
   void ExitAsync();
 
   ReplyType *ReadFile(const QString &filename);
+  ReplyType *ReadFiles(const QStringList &filenames);
   ReplyType *SaveFile(const QString &filename, const Song &metadata);
+  // Writes the song's ReplayGain values to the file's tags.
+  ReplyType *SaveReplayGain(const QString &filename, const Song &metadata);
   ReplyType *IsMediaFile(const QString &filename);
   ReplyType *LoadEmbeddedArt(const QString &filename);
 
   // Convenience functions that call the above functions and wait for a response.
   // These block the calling thread with a semaphore, and must NOT be called from the TagReaderClient's thread.
   void ReadFileBlocking(const QString &filename, Song *song);
+  // Reads the tags of several files with one request for each batch of files instead of one request per file.
+  // songs must contain one song for each filename, they are filled in the same way as ReadFileBlocking() does.
+  // Returns which of the files got a response, the others are left untouched, for example because the tagreader crashed on a file of their batch.
+  QList<bool> ReadFilesBlocking(const QStringList &filenames, SongList *songs);
   bool SaveFileBlocking(const QString &filename, const Song &metadata);
   bool IsMediaFileBlocking(const QString &filename);
   QImage LoadEmbeddedArtBlocking(const QString &filename);
@@ -46,6 +46,8 @@ Console::Console(Application *app, QWidget *parent) : QDialog(parent), app_(app)
   setWindowFlags(windowFlags()|Qt::WindowMaximizeButtonHint);
 
   connect(ui_.run, SIGNAL(clicked()), SLOT(RunQuery()));
+  connect(ui_.diagnostics, SIGNAL(clicked()), SLOT(RequestDatabaseDiagnostics()));
+  connect(app_->database(), SIGNAL(DiagnosticsReady(QString)), SLOT(ShowDatabaseDiagnostics(QString)));
 
   QFont font("Monospace");
   font.setStyleHint(QFont::TypeWriter);
@@ -80,3 +82,23 @@ void Console::RunQuery() {
   ui_.output->verticalScrollBar()->setValue(ui_.output->verticalScrollBar()->maximum());
 
 }
+
+void Console::RequestDatabaseDiagnostics() {
+
+  // The database thread might be busy with a long write, don't wait for it here.
+  ui_.diagnostics->setEnabled(false);
+  app_->database()->DiagnosticsAsync();
+
+}
+
+void Console::ShowDatabaseDiagnostics(const QString &diagnostics) {
+
+  ui_.diagnostics->setEnabled(true);
+
+  for (const QString &line : diagnostics.split("\n")) {
+    ui_.output->append(line.toHtmlEscaped());
+  }
+
+  ui_.output->verticalScrollBar()->setValue(ui_.output->verticalScrollBar()->maximum());
+
+}
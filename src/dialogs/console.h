@@ -40,6 +40,8 @@ class Console : public QDialog {
 
  private slots:
   void RunQuery();
+  void RequestDatabaseDiagnostics();
+  void ShowDatabaseDiagnostics(const QString &diagnostics);
 
  private:
   Ui::Console ui_;
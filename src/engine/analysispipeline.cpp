@@ -0,0 +1,252 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib-object.h>
+#include <cstdlib>
+#include <cstring>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+#include <QtGlobal>
+#include <QCoreApplication>
+#include <QThread>
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+
+#include "core/logging.h"
+#include "core/signalchecker.h"
+#include "analysispipeline.h"
+
+void AnalysisPipeline::Consumer::SetDone() {
+
+  done_.storeRelease(1);
+  if (pipeline_) pipeline_->CheckDone();
+
+}
+
+AnalysisPipeline::AnalysisPipeline(const QUrl &url)
+    : url_(url),
+      pipeline_(nullptr),
+      tee_(nullptr),
+      stopping_(0) {}
+
+AnalysisPipeline::~AnalysisPipeline() {
+
+  if (pipeline_) {
+    gst_element_set_state(pipeline_, GST_STATE_NULL);
+    gst_object_unref(pipeline_);
+  }
+
+}
+
+void AnalysisPipeline::AddConsumer(Consumer *consumer) {
+
+  consumer->pipeline_ = this;
+  consumers_ << consumer;
+
+}
+
+GstElement *AnalysisPipeline::CreateElement(const QString &factory_name, GstElement *bin) {
+
+  // Leave the naming to GStreamer, a branch can have more than one element of a kind.
+  GstElement *ret = gst_element_factory_make(factory_name.toLatin1().constData(), nullptr);
+
+  if (ret) {
+    gst_bin_add(GST_BIN(bin), ret);
+  }
+  else {
+    qLog(Warning) << "Couldn't create the gstreamer element" << factory_name;
+  }
+
+  return ret;
+
+}
+
+bool AnalysisPipeline::Run(const GstClockTime timeout) {
+
+  Q_ASSERT(QThread::currentThread() != qApp->thread());
+
+  if (consumers_.isEmpty() || pipeline_) return false;
+
+  pipeline_ = gst_pipeline_new("analysis-pipeline");
+  GstElement *decodebin = CreateElement("uridecodebin", pipeline_);
+  tee_ = CreateElement("tee", pipeline_);
+
+  bool success = decodebin && tee_;
+  for (Consumer *consumer : consumers_) {
+    if (!success) break;
+    // Every branch needs its own queue, so one branch doesn't hold up the others.
+    GstElement *queue = CreateElement("queue", pipeline_);
+    GstElement *branch = consumer->CreateBranch(pipeline_);
+    if (!queue || !branch || !gst_element_link(tee_, queue) || !gst_element_link(queue, branch)) {
+      qLog(Error) << "Failed to link the analysis pipeline for" << url_;
+      success = false;
+    }
+  }
+
+  if (success) {
+    g_object_set(decodebin, "uri", url_.toEncoded().constData(), nullptr);
+    CHECKED_GCONNECT(decodebin, "pad-added", &NewPadCallback, this);
+
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+    gst_element_set_state(pipeline_, GST_STATE_PLAYING);
+
+    // Wait until the end of the file, an error, or all consumers are done.
+    success = false;
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, timeout, static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_APPLICATION));
+    if (msg) {
+      if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        GError *error = nullptr;
+        gchar *debugs = nullptr;
+        gst_message_parse_error(msg, &error, &debugs);
+        qLog(Error) << "Error analysing" << url_ << ":" << QString::fromLocal8Bit(error->message);
+        g_error_free(error);
+        free(debugs);
+      }
+      else {
+        success = true;
+      }
+      gst_message_unref(msg);
+    }
+    else {
+      qLog(Warning) << "Timeout analysing" << url_;
+    }
+    gst_object_unref(bus);
+  }
+
+  // Setting the state to null waits for the streaming threads, the consumers get no more audio after this.
+  stopping_.storeRelease(1);
+  gst_element_set_state(pipeline_, GST_STATE_NULL);
+  gst_object_unref(pipeline_);
+  pipeline_ = nullptr;
+  tee_ = nullptr;
+
+  for (Consumer *consumer : consumers_) {
+    consumer->Finish(success);
+  }
+
+  return success;
+
+}
+
+void AnalysisPipeline::NewPadCallback(GstElement*, GstPad *pad, gpointer data) {
+
+  AnalysisPipeline *self = reinterpret_cast<AnalysisPipeline*>(data);
+
+  GstCaps *caps = gst_pad_get_current_caps(pad);
+  if (!caps) caps = gst_pad_query_caps(pad, nullptr);
+  if (!caps) return;
+
+  int rate = 0;
+  int channels = 0;
+  bool audio = false;
+  if (gst_caps_get_size(caps) > 0) {
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    audio = g_str_has_prefix(gst_structure_get_name(structure), "audio/");
+    gst_structure_get_int(structure, "rate", &rate);
+    gst_structure_get_int(structure, "channels", &channels);
+  }
+  gst_caps_unref(caps);
+
+  if (!audio) return;
+
+  // Only the first audio stream is analysed.
+  GstPad *const sinkpad = gst_element_get_static_pad(self->tee_, "sink");
+  if (GST_PAD_IS_LINKED(sinkpad)) {
+    gst_object_unref(sinkpad);
+    return;
+  }
+
+  for (Consumer *consumer : self->consumers_) {
+    consumer->Start(rate, channels);
+  }
+
+  gst_pad_link(pad, sinkpad);
+  gst_object_unref(sinkpad);
+
+}
+
+void AnalysisPipeline::CheckDone() {
+
+  for (Consumer *consumer : consumers_) {
+    if (!consumer->is_done()) return;
+  }
+
+  // Post a message only once, Run() stops the pipeline when it gets it.
+  if (!stopping_.testAndSetOrdered(0, 1)) return;
+  gst_element_post_message(pipeline_, gst_message_new_application(GST_OBJECT(pipeline_), gst_structure_new_empty("analysis-done")));
+
+}
+
+AnalysisPcmConsumer::AnalysisPcmConsumer(const QString &format, const int rate, const int channels)
+    : format_(format),
+      rate_(rate),
+      channels_(channels) {}
+
+GstElement *AnalysisPcmConsumer::CreateBranch(GstElement *pipeline) {
+
+  GstElement *convert = AnalysisPipeline::CreateElement("audioconvert", pipeline);
+  GstElement *resample = AnalysisPipeline::CreateElement("audioresample", pipeline);
+  GstElement *sink = AnalysisPipeline::CreateElement("appsink", pipeline);
+  if (!convert || !resample || !sink) return nullptr;
+
+  GstCaps *caps = gst_caps_new_simple("audio/x-raw", "format", G_TYPE_STRING, format_.toLatin1().constData(), "layout", G_TYPE_STRING, "interleaved", nullptr);
+  if (rate_ > 0) gst_caps_set_simple(caps, "rate", G_TYPE_INT, rate_, nullptr);
+  if (channels_ > 0) gst_caps_set_simple(caps, "channels", G_TYPE_INT, channels_, nullptr);
+
+  const bool linked = gst_element_link(convert, resample) && gst_element_link_filtered(resample, sink, caps);
+  gst_caps_unref(caps);
+  if (!linked) return nullptr;
+
+  GstAppSinkCallbacks callbacks;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.new_sample = NewSampleCallback;
+  gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink*>(sink), &callbacks, this, nullptr);
+  g_object_set(G_OBJECT(sink), "sync", FALSE, nullptr);
+
+  return convert;
+
+}
+
+GstFlowReturn AnalysisPcmConsumer::NewSampleCallback(GstAppSink *app_sink, gpointer self) {
+
+  AnalysisPcmConsumer *me = reinterpret_cast<AnalysisPcmConsumer*>(self);
+
+  GstSample *sample = gst_app_sink_pull_sample(app_sink);
+  if (!sample) return GST_FLOW_ERROR;
+
+  // Keep taking the audio after we're done, so the other branches aren't held up.
+  GstBuffer *buffer = gst_sample_get_buffer(sample);
+  if (buffer && !me->is_done()) {
+    GstMapInfo map;
+    if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+      me->ProcessSamples(reinterpret_cast<const char*>(map.data), static_cast<int>(map.size));
+      gst_buffer_unmap(buffer, &map);
+    }
+  }
+  gst_sample_unref(sample);
+
+  return GST_FLOW_OK;
+
+}
@@ -0,0 +1,115 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ANALYSISPIPELINE_H
+#define ANALYSISPIPELINE_H
+
+#include "config.h"
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include <QAtomicInt>
+
+// Decodes a file once and tees the decoded audio into any number of consumers, like the moodbar, Chromaprint and loudness analyzers.
+// Every consumer adds its own branch of elements after the tee, so each can convert the audio to the format it needs.
+// Decoding stops at the end of the file, or as soon as every consumer has seen enough of it.
+// Run() blocks, so call it from another thread.
+class AnalysisPipeline {
+ public:
+  class Consumer {
+   public:
+    Consumer() : pipeline_(nullptr), done_(0) {}
+    virtual ~Consumer() {}
+
+    // Creates the consumer's elements in the pipeline and returns the first one, which is linked to the decoded audio.
+    virtual GstElement *CreateBranch(GstElement *pipeline) = 0;
+
+    // Called from the streaming thread with the rate and channels of the decoded audio, before any audio arrives.
+    virtual void Start(const int rate, const int channels) { Q_UNUSED(rate); Q_UNUSED(channels); }
+
+    // Called after decoding finished, success is false if the file couldn't be decoded.
+    virtual void Finish(const bool success) = 0;
+
+    // Consumers that don't need the whole file call SetDone() once they have enough.
+    bool is_done() const { return done_.loadAcquire() != 0; }
+
+   protected:
+    void SetDone();
+
+   private:
+    friend class AnalysisPipeline;
+    AnalysisPipeline *pipeline_;
+    QAtomicInt done_;
+
+    Q_DISABLE_COPY(Consumer)
+  };
+
+  explicit AnalysisPipeline(const QUrl &url);
+  ~AnalysisPipeline();
+
+  // The consumer is not owned by the pipeline.
+  void AddConsumer(Consumer *consumer);
+
+  // Decodes the file, blocks until it's done. Returns false if the file couldn't be decoded.
+  bool Run(const GstClockTime timeout = GST_CLOCK_TIME_NONE);
+
+  static GstElement *CreateElement(const QString &factory_name, GstElement *bin);
+
+ private:
+  static void NewPadCallback(GstElement*, GstPad *pad, gpointer data);
+  // Stops decoding once all consumers are done.
+  void CheckDone();
+
+  QUrl url_;
+  QList<Consumer*> consumers_;
+  GstElement *pipeline_;
+  GstElement *tee_;
+  QAtomicInt stopping_;
+
+  Q_DISABLE_COPY(AnalysisPipeline)
+};
+
+// A consumer that gets the raw samples in a fixed format from an appsink.
+class AnalysisPcmConsumer : public AnalysisPipeline::Consumer {
+ public:
+  // The format is a GStreamer audio format, like S16LE or F32LE.  A rate or channel count of 0 keeps those of the file.
+  explicit AnalysisPcmConsumer(const QString &format, const int rate = 0, const int channels = 0);
+
+  GstElement *CreateBranch(GstElement *pipeline) override;
+
+ protected:
+  // Called from the streaming thread with interleaved samples.
+  virtual void ProcessSamples(const char *data, const int size) = 0;
+
+ private:
+  static GstFlowReturn NewSampleCallback(GstAppSink *app_sink, gpointer self);
+
+  QString format_;
+  int rate_;
+  int channels_;
+};
+
+#endif  // ANALYSISPIPELINE_H
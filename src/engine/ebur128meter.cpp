@@ -0,0 +1,149 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "config.h"
+
+#include <cmath>
+#include <vector>
+
+#include <QtGlobal>
+
+#include "ebur128meter.h"
+
+const double EbuR128Meter::kReferenceLoudness = -18.0;
+
+namespace {
+const double kAbsoluteGate = -70.0;
+const double kRelativeGate = -10.0;
+}
+
+EbuR128Meter::EbuR128Meter(const int channels, const int rate)
+    : channels_(qMax(1, channels)),
+      rate_(qMax(1, rate)),
+      step_frames_(qMax(1, rate_ / 10)),
+      state_(channels_ * 4, 0.0),
+      step_count_(0),
+      step_frame_(0),
+      peak_(0.0F) {
+
+  for (int i = 0; i < 4; ++i) steps_[i] = 0.0;
+
+  // The K-weighting filters from BS.1770, worked out for the sample rate.
+  // Stage 1: high shelf modelling the acoustic effect of the head.
+  {
+    const double f0 = 1681.974450955533;
+    const double G = 3.999843853973347;
+    const double Q = 0.7071752369554196;
+    const double K = tan(M_PI * f0 / rate_);
+    const double Vh = pow(10.0, G / 20.0);
+    const double Vb = pow(Vh, 0.4996667741545416);
+    const double a0 = 1.0 + K / Q + K * K;
+    shelf_.b0 = (Vh + Vb * K / Q + K * K) / a0;
+    shelf_.b1 = 2.0 * (K * K - Vh) / a0;
+    shelf_.b2 = (Vh - Vb * K / Q + K * K) / a0;
+    shelf_.a1 = 2.0 * (K * K - 1.0) / a0;
+    shelf_.a2 = (1.0 - K / Q + K * K) / a0;
+  }
+
+  // Stage 2: RLB high pass.
+  {
+    const double f0 = 38.13547087602444;
+    const double Q = 0.5003270373238773;
+    const double K = tan(M_PI * f0 / rate_);
+    const double a0 = 1.0 + K / Q + K * K;
+    highpass_.b0 = 1.0;
+    highpass_.b1 = -2.0;
+    highpass_.b2 = 1.0;
+    highpass_.a1 = 2.0 * (K * K - 1.0) / a0;
+    highpass_.a2 = (1.0 - K / Q + K * K) / a0;
+  }
+
+}
+
+void EbuR128Meter::AddFrames(const float *samples, const int frames) {
+
+  for (int frame = 0; frame < frames; ++frame) {
+    double sum = 0.0;
+    for (int channel = 0; channel < channels_; ++channel) {
+      const float sample = samples[frame * channels_ + channel];
+      peak_ = qMax(peak_, std::fabs(sample));
+
+      // Transposed direct form II.
+      double *state = &state_[channel * 4];
+      const double x = sample;
+      const double y1 = shelf_.b0 * x + state[0];
+      state[0] = shelf_.b1 * x - shelf_.a1 * y1 + state[1];
+      state[1] = shelf_.b2 * x - shelf_.a2 * y1;
+      const double y2 = highpass_.b0 * y1 + state[2];
+      state[2] = highpass_.b1 * y1 - highpass_.a1 * y2 + state[3];
+      state[3] = highpass_.b2 * y1 - highpass_.a2 * y2;
+
+      sum += y2 * y2;
+    }
+
+    steps_[step_count_ % 4] += sum;
+    if (++step_frame_ < step_frames_) continue;
+
+    // A step is complete, a block is made of the last four steps.
+    step_frame_ = 0;
+    ++step_count_;
+    if (step_count_ >= 4) {
+      blocks_.push_back((steps_[0] + steps_[1] + steps_[2] + steps_[3]) / (4.0 * step_frames_));
+    }
+    steps_[step_count_ % 4] = 0.0;
+  }
+
+}
+
+double EbuR128Meter::BlockLoudness(const double power) {
+  return -0.691 + 10.0 * log10(power);
+}
+
+double EbuR128Meter::IntegratedLoudness() const {
+  return IntegratedLoudness(blocks_);
+}
+
+double EbuR128Meter::IntegratedLoudness(const std::vector<double> &blocks) {
+
+  const double absolute_gate_power = pow(10.0, (kAbsoluteGate + 0.691) / 10.0);
+
+  double sum = 0.0;
+  int count = 0;
+  for (const double power : blocks) {
+    if (power <= absolute_gate_power) continue;
+    sum += power;
+    ++count;
+  }
+  if (count == 0) return -HUGE_VAL;
+
+  const double relative_gate_power = pow(10.0, (BlockLoudness(sum / count) + kRelativeGate + 0.691) / 10.0);
+
+  sum = 0.0;
+  count = 0;
+  for (const double power : blocks) {
+    if (power <= absolute_gate_power || power <= relative_gate_power) continue;
+    sum += power;
+    ++count;
+  }
+  if (count == 0) return -HUGE_VAL;
+
+  return BlockLoudness(sum / count);
+
+}
@@ -0,0 +1,84 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef EBUR128METER_H
+#define EBUR128METER_H
+
+#include "config.h"
+
+#include <vector>
+
+#include <QtGlobal>
+
+// Measures the integrated loudness of audio as described in ITU-R BS.1770 and EBU R128.
+// The samples are K-weighted, the mean square is taken over 400 ms blocks overlapping by 75%,
+// and the blocks are gated first at -70 LUFS and then at 10 LU below the loudness of the remaining blocks.
+// The block powers are kept, so the loudness of several tracks together, like an album, can be worked out afterwards.
+class EbuR128Meter {
+ public:
+  explicit EbuR128Meter(const int channels, const int rate);
+
+  // ReplayGain 2.0 reference loudness.
+  static const double kReferenceLoudness;
+
+  int channels() const { return channels_; }
+  int rate() const { return rate_; }
+
+  // Adds interleaved float samples.
+  void AddFrames(const float *samples, const int frames);
+
+  // Returns the integrated loudness in LUFS, or -HUGE_VAL if everything was below the gate.
+  double IntegratedLoudness() const;
+  // Returns the largest absolute sample value.
+  float peak() const { return peak_; }
+
+  // Mean square power of every 400 ms block.
+  const std::vector<double> &blocks() const { return blocks_; }
+
+  static double IntegratedLoudness(const std::vector<double> &blocks);
+  // Gain in dB needed to bring the loudness to the reference loudness.
+  static double Gain(const double loudness) { return kReferenceLoudness - loudness; }
+
+ private:
+  struct Biquad {
+    double b0, b1, b2, a1, a2;
+  };
+
+  static double BlockLoudness(const double power);
+
+  const int channels_;
+  const int rate_;
+  const int step_frames_;
+
+  Biquad shelf_;
+  Biquad highpass_;
+  // Two filter state values for each of the two filters of every channel.
+  std::vector<double> state_;
+
+  // Sum of the squared weighted samples of the current 100 ms step and the three before it.
+  double steps_[4];
+  int step_count_;
+  int step_frame_;
+
+  float peak_;
+  std::vector<double> blocks_;
+};
+
+#endif  // EBUR128METER_H
@@ -26,6 +26,7 @@
 #include <cmath>
 
 #include <QtGlobal>
+#include <QtNumeric>
 #include <QVariant>
 #include <QUrl>
 #include <QSettings>
@@ -46,9 +47,12 @@ Engine::Base::Base()
       rg_mode_(0),
       rg_preamp_(0),
       rg_compression_(true),
+      stored_rg_track_gain_(qQNaN()),
+      stored_rg_album_gain_(qQNaN()),
       buffer_duration_nanosec_(BackendSettingsPage::kDefaultBufferDuration * kNsecPerMsec),
       buffer_low_watermark_(BackendSettingsPage::kDefaultBufferLowWatermark),
       buffer_high_watermark_(BackendSettingsPage::kDefaultBufferHighWatermark),
+      preroll_enabled_(true),
       fadeout_enabled_(true),
       crossfade_enabled_(true),
       autocrossfade_enabled_(false),
@@ -95,6 +99,27 @@ uint Engine::Base::MakeVolumeLogarithmic(uint volume) {
   return static_cast<uint>( 100 - 100.0 * std::log10( ( 100 - volume ) * 0.09 + 1.0 ) );
 }
 
+void Engine::Base::SetStoredReplayGain(const QUrl &original_url, const float track_gain, const float album_gain) {
+
+  stored_rg_url_ = original_url;
+  stored_rg_track_gain_ = track_gain;
+  stored_rg_album_gain_ = album_gain;
+
+}
+
+double Engine::Base::StoredReplayGain(const QUrl &original_url) const {
+
+  if (original_url != stored_rg_url_) return 0.0;
+
+  // Songs without an album only have a track gain.
+  float gain = rg_mode_ == 1 ? stored_rg_album_gain_ : stored_rg_track_gain_;
+  if (qIsNaN(gain)) gain = stored_rg_track_gain_;
+  if (qIsNaN(gain)) return 0.0;
+
+  return gain + rg_preamp_;
+
+}
+
 void Engine::Base::ReloadSettings() {
 
   QSettings s;
@@ -109,6 +134,7 @@ void Engine::Base::ReloadSettings() {
   buffer_duration_nanosec_ = s.value("bufferduration", BackendSettingsPage::kDefaultBufferDuration).toLongLong() * kNsecPerMsec;
   buffer_low_watermark_ = s.value("bufferlowwatermark", BackendSettingsPage::kDefaultBufferLowWatermark).toDouble();
   buffer_high_watermark_ = s.value("bufferhighwatermark", BackendSettingsPage::kDefaultBufferHighWatermark).toDouble();
+  preroll_enabled_ = s.value("preroll", true).toBool();
 
   rg_enabled_ = s.value("rgenabled", false).toBool();
   rg_mode_ = s.value("rgmode", 0).toInt();
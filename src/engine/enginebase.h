@@ -101,6 +101,9 @@ public:
   void SetVolume(const uint value);
   static uint MakeVolumeLogarithmic(const uint volume);
 
+  // The ReplayGain stored in the collection for the song that's played or preloaded next, used when its stream has no ReplayGain tags.
+  void SetStoredReplayGain(const QUrl &original_url, const float track_gain, const float album_gain);
+
  public slots:
   virtual void ReloadSettings();
 
@@ -183,11 +186,18 @@ public:
   int rg_mode_;
   float rg_preamp_;
   bool rg_compression_;
+  QUrl stored_rg_url_;
+  float stored_rg_track_gain_;
+  float stored_rg_album_gain_;
+
+  // Returns the stored gain for the mode with the pre-amp added, in dB, 0 if there is none.
+  double StoredReplayGain(const QUrl &original_url) const;
 
   // Buffering
   quint64 buffer_duration_nanosec_;
   double buffer_low_watermark_;
   double buffer_high_watermark_;
+  bool preroll_enabled_;
 
   // Fadeout
   bool fadeout_enabled_;
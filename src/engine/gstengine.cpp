@@ -27,6 +27,7 @@
 #include <gio/gio.h>
 #include <memory>
 #include <vector>
+#include <algorithm>
 #include <cmath>
 #include <string>
 
@@ -44,7 +45,6 @@
 #include <QUrl>
 #include <QTimeLine>
 #include <QEasingCurve>
-#include <QMetaObject>
 #include <QFlags>
 #include <QTimerEvent>
 #include <QtDebug>
@@ -75,7 +75,6 @@ const char *GstEngine::kOSXAudioSink = "osxaudiosink";
 GstEngine::GstEngine(TaskManager *task_manager)
     : task_manager_(task_manager),
       buffering_task_id_(-1),
-      latest_buffer_(nullptr),
       stereo_balancer_enabled_(false),
       stereo_balance_(0.0f),
       equalizer_enabled_(false),
@@ -84,9 +83,7 @@ GstEngine::GstEngine(TaskManager *task_manager)
       timer_id_(-1),
       next_element_id_(0),
       is_fading_out_to_pause_(false),
-      has_faded_out_(false),
-      scope_chunk_(0),
-      have_new_buffer_(false) {
+      has_faded_out_(false) {
 
   type_ = Engine::GStreamer;
   seek_timer_->setSingleShot(true);
@@ -100,12 +97,13 @@ GstEngine::GstEngine(TaskManager *task_manager)
 GstEngine::~GstEngine() {
 
   EnsureInitialized();
+  preroll_pipeline_.reset();
+  fadeout_pause_pipeline_.reset();
+  fadeout_pipeline_.reset();
   current_pipeline_.reset();
 
-  if (latest_buffer_) {
-    gst_buffer_unref(latest_buffer_);
-    latest_buffer_ = nullptr;
-  }
+  qDeleteAll(pipeline_pool_);
+  pipeline_pool_.clear();
 
 }
 
@@ -140,9 +138,18 @@ void GstEngine::StartPreloading(const QUrl &stream_url, const QUrl &original_url
 
   QByteArray gst_url = FixupUrl(stream_url);
 
+  preroll_pipeline_.reset();
+
+  // For network streams playbin would only connect at the track boundary, so open the next stream in a pipeline of its own instead.
+  if (current_pipeline_ && preroll_enabled_ && beginning_nanosec == 0 && (stream_url.scheme() == "http" || stream_url.scheme() == "https")) {
+    if (StartPreroll(gst_url, original_url, force_stop_at_end ? end_nanosec : 0)) return;
+  }
+
   // No crossfading, so we can just queue the new URL in the existing pipeline and get gapless playback (hopefully)
-  if (current_pipeline_)
+  if (current_pipeline_) {
     current_pipeline_->SetNextUrl(gst_url, original_url, beginning_nanosec, force_stop_at_end ? end_nanosec : 0);
+    current_pipeline_->SetNextReplayGainFallback(StoredReplayGain(original_url));
+  }
 
 }
 
@@ -164,7 +171,20 @@ bool GstEngine::Load(const QUrl &stream_url, const QUrl &original_url, Engine::T
     return true;
   }
 
-  std::shared_ptr<GstEnginePipeline> pipeline = CreatePipeline(gst_url, original_url, force_stop_at_end ? end_nanosec : 0);
+  std::shared_ptr<GstEnginePipeline> pipeline;
+  // Match on the original URL, services like Tidal and Qobuz resolve a new stream URL every time the song is loaded.
+  if (preroll_pipeline_ && preroll_pipeline_->original_url() == original_url && beginning_nanosec == 0) {
+    // Already connected and buffered, going to PLAYING only has to start the sink.
+    // It keeps playing the stream URL that was resolved for the preroll.
+    pipeline = preroll_pipeline_;
+    for (GstBufferConsumer *consumer : buffer_consumers_) {
+      pipeline->AddBufferConsumer(consumer);
+    }
+  }
+  else {
+    pipeline = CreatePipeline(gst_url, original_url, force_stop_at_end ? end_nanosec : 0);
+  }
+  preroll_pipeline_.reset();
   if (!pipeline) return false;
 
   if (crossfade) StartFadeout();
@@ -221,6 +241,7 @@ void GstEngine::Stop(const bool stop_after) {
 
   if (fadeout_enabled_ && current_pipeline_ && !stop_after) StartFadeout();
 
+  preroll_pipeline_.reset();
   current_pipeline_.reset();
   BufferingFinished();
   emit StateChanged(Engine::Empty);
@@ -319,23 +340,11 @@ qint64 GstEngine::length_nanosec() const {
 
 const Engine::Scope &GstEngine::scope(const int chunk_length) {
 
-  // The new buffer could have a different size
-  if (have_new_buffer_) {
-    if (latest_buffer_) {
-      scope_chunks_ = ceil((static_cast<double>(GST_BUFFER_DURATION(latest_buffer_) / static_cast<double>(chunk_length * kNsecPerMsec))));
-    }
-
-    // if the buffer is shorter than the chunk length
-    if (scope_chunks_ <= 0) {
-      scope_chunks_ = 1;
-    }
-
-    scope_chunk_ = 0;
-    have_new_buffer_ = false;
-  }
+  Q_UNUSED(chunk_length);
 
-  if (latest_buffer_) {
-    UpdateScope(chunk_length);
+  // The pipeline's streaming thread keeps the ring buffer filled, pick the frames that are playing right now.
+  if (!current_pipeline_ || !current_pipeline_->scope_buffer().Read(current_pipeline_->position(), scope_.data(), static_cast<int>(scope_.size() / 2))) {
+    std::fill(scope_.begin(), scope_.end(), 0);
   }
 
   return scope_;
@@ -393,6 +402,8 @@ void GstEngine::ReloadSettings() {
 
   if (output_.isEmpty()) output_ = kAutoSink;
 
+  PrunePipelinePool();
+
 }
 
 GstElement *GstEngine::CreateElement(const QString &factoryName, GstElement *bin, const bool showerror) {
@@ -414,20 +425,11 @@ GstElement *GstEngine::CreateElement(const QString &factoryName, GstElement *bin
   return element;
 }
 
-void GstEngine::ConsumeBuffer(GstBuffer *buffer, const int pipeline_id, const QString &format) {
-
-  // Schedule this to run in the GUI thread.  The buffer gets added to the queue and unreffed by UpdateScope.
-  if (!QMetaObject::invokeMethod(this, "AddBufferToScope", Q_ARG(GstBuffer*, buffer), Q_ARG(int, pipeline_id), Q_ARG(QString, format))) {
-    qLog(Warning) << "Failed to invoke AddBufferToScope on GstEngine";
-    gst_buffer_unref(buffer);
-  }
-
-}
-
 void GstEngine::SetStereoBalancerEnabled(const bool enabled) {
 
   stereo_balancer_enabled_ = enabled;
   if (current_pipeline_) current_pipeline_->set_stereo_balancer_enabled(enabled);
+  PrunePipelinePool();
 
 }
 
@@ -442,6 +444,7 @@ void GstEngine::SetEqualizerEnabled(const bool enabled) {
 
   equalizer_enabled_ = enabled;
   if (current_pipeline_) current_pipeline_->set_equalizer_enabled(enabled);
+  PrunePipelinePool();
 
 }
 
@@ -479,7 +482,9 @@ void GstEngine::timerEvent(QTimerEvent *e) {
     const qint64 remaining = current_length - current_position;
 
     const qint64 fudge = kTimerIntervalNanosec + 100 * kNsecPerMsec;  // Mmm fudge
-    const qint64 gap = buffer_duration_nanosec_ + (autocrossfade_enabled_ ? fadeout_duration_nanosec_ : kPreloadGapNanosec);
+    qint64 gap = buffer_duration_nanosec_ + (autocrossfade_enabled_ ? fadeout_duration_nanosec_ : kPreloadGapNanosec);
+    // Give a pre-rolled stream time to fill its buffer over a slow connection.
+    if (preroll_enabled_ && !autocrossfade_enabled_) gap += kPrerollNanosec;
 
     // only if we know the length of the current stream...
     if (current_length > 0) {
@@ -507,6 +512,13 @@ void GstEngine::EndOfStreamReached(const int pipeline_id, const bool has_next_tr
 
 void GstEngine::HandlePipelineError(const int pipeline_id, const QString &message, const int domain, const int error_code) {
 
+  // Let the next track fail again when it's loaded, so the error is handled like for any other track.
+  if (preroll_pipeline_ && preroll_pipeline_->id() == pipeline_id) {
+    qLog(Warning) << "Failed to pre-roll" << preroll_pipeline_->stream_url() << message;
+    preroll_pipeline_.reset();
+    return;
+  }
+
   if (!current_pipeline_.get() || current_pipeline_->id() != pipeline_id) return;
 
   qLog(Error) << "GStreamer error:" << domain << error_code << message;
@@ -533,23 +545,6 @@ void GstEngine::NewMetaData(const int pipeline_id, const Engine::SimpleMetaBundl
 
 }
 
-void GstEngine::AddBufferToScope(GstBuffer *buf, const int pipeline_id, const QString &format) {
-
-  if (!current_pipeline_ || current_pipeline_->id() != pipeline_id) {
-    gst_buffer_unref(buf);
-    return;
-  }
-
-  if (latest_buffer_) {
-    gst_buffer_unref(latest_buffer_);
-  }
-
-  buffer_format_ = format;
-  latest_buffer_ = buf;
-  have_new_buffer_ = true;
-
-}
-
 void GstEngine::FadeoutFinished() {
   fadeout_pipeline_.reset();
   emit FadeoutFinishedSignal();
@@ -747,21 +742,35 @@ void GstEngine::StopTimers() {
   }
 }
 
-std::shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
+std::shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(const quint64 buffer_duration_nanosec) {
 
   EnsureInitialized();
 
-  std::shared_ptr<GstEnginePipeline> ret(new GstEnginePipeline(this));
-  ret->set_output_device(output_, device_);
-  ret->set_volume_enabled(volume_control_);
-  ret->set_stereo_balancer_enabled(stereo_balancer_enabled_);
-  ret->set_equalizer_enabled(equalizer_enabled_);
-  ret->set_replaygain(rg_enabled_, rg_mode_, rg_preamp_, rg_compression_);
-  ret->set_buffer_duration_nanosec(buffer_duration_nanosec_);
-  ret->set_buffer_low_watermark(buffer_low_watermark_);
-  ret->set_buffer_high_watermark(buffer_high_watermark_);
-
-  ret->AddBufferConsumer(this);
+  // Building and linking the elements is most of the work of starting a stream, so take a stopped pipeline with the same elements if there is one.
+  const QString key = PipelineKey(buffer_duration_nanosec);
+  GstEnginePipeline *pipeline = nullptr;
+  for (int i = 0; i < pipeline_pool_.count(); ++i) {
+    if (pipeline_pool_[i]->pool_key() == key) {
+      pipeline = pipeline_pool_.takeAt(i);
+      break;
+    }
+  }
+
+  if (!pipeline) {
+    pipeline = new GstEnginePipeline(this);
+    pipeline->set_pool_key(key);
+    pipeline->set_output_device(output_, device_);
+    pipeline->set_volume_enabled(volume_control_);
+    pipeline->set_replaygain(rg_enabled_, rg_mode_, rg_preamp_, rg_compression_);
+    pipeline->set_buffer_duration_nanosec(buffer_duration_nanosec);
+    pipeline->set_buffer_low_watermark(buffer_low_watermark_);
+    pipeline->set_buffer_high_watermark(buffer_high_watermark_);
+  }
+  pipeline->set_stereo_balancer_enabled(stereo_balancer_enabled_);
+  pipeline->set_equalizer_enabled(equalizer_enabled_);
+
+  std::shared_ptr<GstEnginePipeline> ret(pipeline, [this](GstEnginePipeline *p) { ReleasePipeline(p); });
+
   for (GstBufferConsumer *consumer : buffer_consumers_) {
     ret->AddBufferConsumer(consumer);
   }
@@ -779,69 +788,82 @@ std::shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
 
 std::shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(const QByteArray &gst_url, const QUrl &original_url, const qint64 end_nanosec) {
 
-  std::shared_ptr<GstEnginePipeline> ret = CreatePipeline();
+  std::shared_ptr<GstEnginePipeline> ret = CreatePipeline(buffer_duration_nanosec_);
   if (!ret->InitFromUrl(gst_url, original_url, end_nanosec)) ret.reset();
+  else ret->SetReplayGainFallback(StoredReplayGain(original_url));
   return ret;
 
 }
 
-void GstEngine::UpdateScope(const int chunk_length) {
+bool GstEngine::StartPreroll(const QByteArray &gst_url, const QUrl &original_url, const qint64 end_nanosec) {
 
-  typedef Engine::Scope::value_type sample_type;
+  std::shared_ptr<GstEnginePipeline> pipeline = CreatePipeline(preroll_buffer_duration_nanosec());
+  // The buffer consumers get the audio once the pipeline is playing.
+  pipeline->RemoveAllBufferConsumers();
+  if (!pipeline->InitFromUrl(gst_url, original_url, end_nanosec)) return false;
+  pipeline->SetReplayGainFallback(StoredReplayGain(original_url));
 
-  // Prevent dbz or invalid chunk size
-  if (!GST_CLOCK_TIME_IS_VALID(GST_BUFFER_DURATION(latest_buffer_))) return;
-  if (GST_BUFFER_DURATION(latest_buffer_) == 0) return;
+  qLog(Debug) << "Pre-rolling" << gst_url;
+  pipeline->SetState(GST_STATE_PAUSED);
+  preroll_pipeline_ = pipeline;
 
-  GstMapInfo map;
-  gst_buffer_map(latest_buffer_, &map, GST_MAP_READ);
+  return true;
 
-  // Determine where to split the buffer
-  int chunk_density = (map.size * kNsecPerMsec) / GST_BUFFER_DURATION(latest_buffer_);
+}
 
-  int chunk_size = chunk_length * chunk_density;
+quint64 GstEngine::preroll_buffer_duration_nanosec() const {
 
-  // In case a buffer doesn't arrive in time
-  if (scope_chunk_ >= scope_chunks_) {
-    scope_chunk_ = 0;
-    gst_buffer_unmap(latest_buffer_, &map);
-    return;
-  }
+  // The audio queue keeps filling while the sink holds the first buffer, so this is how much is decoded ahead.
+  return qMax(buffer_duration_nanosec_, static_cast<quint64>(kPrerollNanosec));
 
-  const sample_type *source = reinterpret_cast<sample_type*>(map.data);
-  sample_type *dest = scope_.data();
-  source += (chunk_size / sizeof(sample_type)) * scope_chunk_;
+}
 
-  int bytes = 0;
+QString GstEngine::PipelineKey(const quint64 buffer_duration_nanosec) const {
 
-  // Make sure we don't go beyond the end of the buffer
-  if (scope_chunk_ == scope_chunks_ - 1) {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(map.size - (chunk_size  * scope_chunk_)), scope_.size() * sizeof(sample_type));
-  }
-  else {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(chunk_size), scope_.size() * sizeof(sample_type));
-  }
+  // Everything InitAudioBin() decides the elements and their fixed properties from.
+  return (QStringList() << output_
+                        << device_.toString()
+                        << QString::number(volume_control_)
+                        << QString::number(stereo_balancer_enabled_)
+                        << QString::number(equalizer_enabled_)
+                        << QString::number(rg_enabled_)
+                        << QString::number(rg_mode_)
+                        << QString::number(rg_preamp_)
+                        << QString::number(rg_compression_)
+                        << QString::number(buffer_duration_nanosec)
+                        << QString::number(buffer_low_watermark_)
+                        << QString::number(buffer_high_watermark_)).join(";");
 
-  scope_chunk_++;
+}
+
+bool GstEngine::IsCurrentPipelineKey(const QString &key) const {
 
-  if (buffer_format_.startsWith("S16LE") ||
-      buffer_format_.startsWith("U16LE") ||
-      buffer_format_.startsWith("S24LE") ||
-      buffer_format_.startsWith("S32LE") ||
-      buffer_format_.startsWith("F32LE")
-  ) {
-    memcpy(dest, source, bytes);
+  return key == PipelineKey(buffer_duration_nanosec_) || key == PipelineKey(preroll_buffer_duration_nanosec());
+
+}
+
+void GstEngine::ReleasePipeline(GstEnginePipeline *pipeline) {
+
+  if (pipeline->is_valid() && pipeline_pool_.count() < kPipelinePoolSize && IsCurrentPipelineKey(pipeline->pool_key())) {
+    pipeline->Reset();
+    pipeline_pool_ << pipeline;
   }
   else {
-    memset(dest, 0, bytes);
+    delete pipeline;
   }
 
-  gst_buffer_unmap(latest_buffer_, &map);
+}
+
+void GstEngine::PrunePipelinePool() {
 
-  if (scope_chunk_ == scope_chunks_) {
-    gst_buffer_unref(latest_buffer_);
-    latest_buffer_ = nullptr;
-    buffer_format_.clear();
+  for (QList<GstEnginePipeline*>::iterator it = pipeline_pool_.begin(); it != pipeline_pool_.end();) {
+    if (IsCurrentPipelineKey((*it)->pool_key())) {
+      ++it;
+    }
+    else {
+      delete *it;
+      it = pipeline_pool_.erase(it);
+    }
   }
 
 }
@@ -53,7 +53,7 @@ class GstEnginePipeline;
  * @short GStreamer engine plugin
  * @author Mark Kretschmann <markey@web.de>
  */
-class GstEngine : public Engine::Base, public GstBufferConsumer {
+class GstEngine : public Engine::Base {
   Q_OBJECT
 
  public:
@@ -88,7 +88,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   void EnsureInitialized() { gst_startup_->EnsureInitialized(); }
 
   GstElement *CreateElement(const QString &factoryName, GstElement *bin = nullptr, const bool showerror = true);
-  void ConsumeBuffer(GstBuffer *buffer, const int pipeline_id, const QString &format) override;
 
  public slots:
   void ReloadSettings() override;
@@ -115,7 +114,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   void EndOfStreamReached(const int pipeline_id, const bool has_next_track);
   void HandlePipelineError(const int pipeline_id, const QString &message, const int domain, const int error_code);
   void NewMetaData(const int pipeline_id, const Engine::SimpleMetaBundle &bundle);
-  void AddBufferToScope(GstBuffer *buf, const int pipeline_id, const QString &format);
   void FadeoutFinished();
   void FadeoutPauseFinished();
   void SeekNow();
@@ -148,14 +146,22 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   void StartTimers();
   void StopTimers();
 
-  std::shared_ptr<GstEnginePipeline> CreatePipeline();
+  std::shared_ptr<GstEnginePipeline> CreatePipeline(const quint64 buffer_duration_nanosec);
   std::shared_ptr<GstEnginePipeline> CreatePipeline(const QByteArray &gst_url, const QUrl &original_url, const qint64 end_nanosec);
+  quint64 preroll_buffer_duration_nanosec() const;
 
-  void UpdateScope(int chunk_length);
+  // Pipelines are kept for reuse by the settings their elements were built with.
+  QString PipelineKey(const quint64 buffer_duration_nanosec) const;
+  bool IsCurrentPipelineKey(const QString &key) const;
+  void ReleasePipeline(GstEnginePipeline *pipeline);
+  void PrunePipelinePool();
+  bool StartPreroll(const QByteArray &gst_url, const QUrl &original_url, const qint64 end_nanosec);
 
  private:
   static const qint64 kTimerIntervalNanosec = 1000 * kNsecPerMsec;  // 1s
   static const qint64 kPreloadGapNanosec = 5000 * kNsecPerMsec;     // 5s
+  static const qint64 kPrerollNanosec = 10000 * kNsecPerMsec;       // 10s
+  static const int kPipelinePoolSize = 2;
   static const qint64 kSeekDelayNanosec = 100 * kNsecPerMsec;       // 100msec
 
   TaskManager *task_manager_;
@@ -165,12 +171,14 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   std::shared_ptr<GstEnginePipeline> current_pipeline_;
   std::shared_ptr<GstEnginePipeline> fadeout_pipeline_;
   std::shared_ptr<GstEnginePipeline> fadeout_pause_pipeline_;
+  // The next network stream, opened and paused with its first seconds decoded until Load() swaps it in.
+  std::shared_ptr<GstEnginePipeline> preroll_pipeline_;
+  // Stopped pipelines that can be given the next stream, enough for a crossfade.
+  QList<GstEnginePipeline*> pipeline_pool_;
   QUrl preloaded_url_;
 
   QList<GstBufferConsumer*> buffer_consumers_;
 
-  GstBuffer *latest_buffer_;
-
   bool stereo_balancer_enabled_;
   float stereo_balance_;
 
@@ -192,11 +200,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   bool is_fading_out_to_pause_;
   bool has_faded_out_;
 
-  int scope_chunk_;
-  bool have_new_buffer_;
-  int scope_chunks_;
-  QString buffer_format_;
-
 };
 
 #endif  /* GSTENGINE_H */
@@ -56,6 +56,7 @@
 #include "gstenginepipeline.h"
 #include "gstbufferconsumer.h"
 #include "gstelementdeleter.h"
+#include "sampleconverter.h"
 
 const int GstEnginePipeline::kGstStateTimeoutNanosecs = 10000000;
 const int GstEnginePipeline::kFaderFudgeMsec = 2000;
@@ -81,6 +82,8 @@ GstEnginePipeline::GstEnginePipeline(GstEngine *engine)
       rg_mode_(0),
       rg_preamp_(0.0),
       rg_compression_(true),
+      rg_fallback_gain_(0.0),
+      next_rg_fallback_gain_(0.0),
       buffer_duration_nanosec_(BackendSettingsPage::kDefaultBufferDuration * kNsecPerMsec),
       buffer_low_watermark_(BackendSettingsPage::kDefaultBufferLowWatermark),
       buffer_high_watermark_(BackendSettingsPage::kDefaultBufferHighWatermark),
@@ -107,6 +110,7 @@ GstEnginePipeline::GstEnginePipeline(GstEngine *engine)
       audiopanorama_(nullptr),
       equalizer_(nullptr),
       equalizer_preamp_(nullptr),
+      rgvolume_(nullptr),
       discoverer_(nullptr),
       pad_added_cb_id_(-1),
       notify_source_cb_id_(-1),
@@ -114,7 +118,15 @@ GstEnginePipeline::GstEnginePipeline(GstEngine *engine)
       bus_cb_id_(-1),
       discovery_finished_cb_id_(-1),
       discovery_discovered_cb_id_(-1),
-      unsupported_analyzer_(false)
+      handoff_caps_(nullptr),
+      handoff_format_(SampleConverter::Format_Unknown),
+      handoff_channels_(0),
+      handoff_rate_(0),
+      handoff_pool_(nullptr),
+      handoff_pool_size_(0),
+      unsupported_analyzer_(false),
+      reused_(false),
+      first_sample_received_(false)
       {
 
   if (!sElementDeleter) {
@@ -168,6 +180,17 @@ GstEnginePipeline::~GstEnginePipeline() {
 
   }
 
+  if (handoff_caps_) {
+    gst_caps_unref(handoff_caps_);
+    handoff_caps_ = nullptr;
+  }
+
+  if (handoff_pool_) {
+    gst_buffer_pool_set_active(handoff_pool_, FALSE);
+    gst_object_unref(handoff_pool_);
+    handoff_pool_ = nullptr;
+  }
+
 }
 
 void GstEnginePipeline::set_output_device(const QString &output, const QVariant &device) {
@@ -215,15 +238,33 @@ void GstEnginePipeline::set_buffer_high_watermark(const double value) {
 
 bool GstEnginePipeline::InitFromUrl(const QByteArray &stream_url, const QUrl original_url, const qint64 end_nanosec) {
 
+  first_sample_timer_.start();
+  first_sample_received_ = false;
+
+  if (!pipeline_ && !Init()) return false;
+
   stream_url_ = stream_url;
   original_url_ = original_url;
   end_offset_nanosec_ = end_nanosec;
 
+  g_object_set(G_OBJECT(pipeline_), "uri", stream_url.constData(), nullptr);
+
+  // Add request to discover the stream
+  if (discoverer_) {
+    if (!gst_discoverer_discover_uri_async(discoverer_, stream_url_.toStdString().c_str())) {
+      qLog(Error) << "Failed to start stream discovery for" << stream_url_;
+    }
+  }
+
+  return true;
+
+}
+
+bool GstEnginePipeline::Init() {
+
   pipeline_ = engine_->CreateElement("playbin");
   if (!pipeline_) return false;
 
-  g_object_set(G_OBJECT(pipeline_), "uri", stream_url.constData(), nullptr);
-
   gint flags;
   g_object_get(G_OBJECT(pipeline_), "flags", &flags, nullptr);
   flags |= 0x00000002;
@@ -247,11 +288,60 @@ bool GstEnginePipeline::InitFromUrl(const QByteArray &stream_url, const QUrl ori
   // Set playbin's sink to be our custom audio-sink.
   g_object_set(GST_OBJECT(pipeline_), "audio-sink", audiobin_, nullptr);
   pipeline_is_connected_ = true;
+  valid_ = true;
 
   return true;
 
 }
 
+void GstEnginePipeline::Reset() {
+
+  // Let state changes that are still running finish before taking the pipeline down.
+  set_state_threadpool_.waitForDone();
+
+  // This also flushes the bus, and stops the streaming threads, so the callbacks won't run for the last stream anymore.
+  if (pipeline_) gst_element_set_state(pipeline_, GST_STATE_NULL);
+
+  // Seeks queued for the last stream.
+  QCoreApplication::removePostedEvents(this);
+  disconnect(this, nullptr, nullptr, nullptr);
+
+  id_ = sId++;
+
+  fader_.reset();
+  fader_fudge_timer_.stop();
+  volume_modifier_ = 1.0;
+  UpdateVolume();
+
+  RemoveAllBufferConsumers();
+  scope_buffer_.Clear();
+
+  stream_url_.clear();
+  original_url_.clear();
+  next_stream_url_.clear();
+  next_original_url_.clear();
+  end_offset_nanosec_ = -1;
+  next_beginning_offset_nanosec_ = -1;
+  next_end_offset_nanosec_ = -1;
+  ignore_next_seek_ = false;
+  ignore_tags_ = false;
+  redirect_url_.clear();
+  source_device_.clear();
+  buffering_ = false;
+  segment_start_ = 0;
+  segment_start_received_ = false;
+  pipeline_is_initialized_ = false;
+  pending_seek_nanosec_ = -1;
+  last_known_position_ns_ = 0;
+  next_uri_set_ = false;
+  gst_segment_init(&last_playbin_segment_, GST_FORMAT_TIME);
+  next_rg_fallback_gain_ = 0.0;
+  SetReplayGainFallback(0.0);
+
+  reused_ = true;
+
+}
+
 bool GstEnginePipeline::InitAudioBin() {
 
   gst_segment_init(&last_playbin_segment_, GST_FORMAT_TIME);
@@ -367,6 +457,8 @@ bool GstEnginePipeline::InitAudioBin() {
       // Set replaygain settings
       g_object_set(G_OBJECT(rgvolume), "album-mode", rg_mode_, nullptr);
       g_object_set(G_OBJECT(rgvolume), "pre-amp", double(rg_preamp_), nullptr);
+      g_object_set(G_OBJECT(rgvolume), "fallback-gain", rg_fallback_gain_, nullptr);
+      rgvolume_ = rgvolume;
       g_object_set(G_OBJECT(rglimiter), "enabled", int(rg_compression_), nullptr);
     }
   }
@@ -440,13 +532,6 @@ bool GstEnginePipeline::InitAudioBin() {
   bus_cb_id_ = gst_bus_add_watch(bus, BusCallback, this);
   gst_object_unref(bus);
 
-  // Add request to discover the stream
-  if (discoverer_) {
-    if (!gst_discoverer_discover_uri_async(discoverer_, stream_url_.toStdString().c_str())) {
-      qLog(Error) << "Failed to start stream discovery for" << stream_url_;
-    }
-  }
-
   unsupported_analyzer_ = false;
 
   return true;
@@ -587,13 +672,19 @@ GstPadProbeReturn GstEnginePipeline::HandoffCallback(GstPad *pad, GstPadProbeInf
 
   GstEnginePipeline *instance = reinterpret_cast<GstEnginePipeline*>(self);
 
+  if (!instance->first_sample_received_) {
+    instance->first_sample_received_ = true;
+    qLog(Debug) << instance->id() << "time to first sample" << instance->first_sample_timer_.elapsed() << "ms," << (instance->reused_ ? "reused pipeline" : "new pipeline");
+  }
+
+  // The caps only change between streams, so only parse them when we get different caps.
   GstCaps *caps = gst_pad_get_current_caps(pad);
-  GstStructure *structure = gst_caps_get_structure(caps, 0);
-  QString format = QString(gst_structure_get_string(structure, "format"));
-  int channels = 0;
-  int rate = 0;
-  gst_structure_get_int(structure, "channels", &channels);
-  gst_structure_get_int(structure, "rate", &rate);
+  if (caps != instance->handoff_caps_) {
+    instance->SetHandoffCaps(caps);
+  }
+  else if (caps) {
+    gst_caps_unref(caps);
+  }
 
   GstBuffer *buf = gst_pad_probe_info_get_buffer(info);
   GstBuffer *buf16 = nullptr;
@@ -602,77 +693,36 @@ GstPadProbeReturn GstEnginePipeline::HandoffCallback(GstPad *pad, GstPadProbeInf
   quint64 duration = GST_BUFFER_DURATION(buf);
   qint64 end_time = start_time + duration;
 
-  if (format.startsWith("S16LE")) {
-    instance->unsupported_analyzer_ = false;
-  }
-  else if (format.startsWith("S32LE")) {
-
-    GstMapInfo map_info;
-    gst_buffer_map(buf, &map_info, GST_MAP_READ);
-
-    int32_t *s = reinterpret_cast<int32_t*>(map_info.data);
-    int samples = (map_info.size / sizeof(int32_t)) / channels;
-    int buf16_size = samples * sizeof(int16_t) * channels;
-    int16_t *d = static_cast<int16_t*>(g_malloc(buf16_size));
-    memset(d, 0, buf16_size);
-    for (int i = 0 ; i < (samples * channels) ; ++i) {
-      d[i] = static_cast<int16_t>((s[i] >> 16));
-    }
-    gst_buffer_unmap(buf, &map_info);
-    buf16 = gst_buffer_new_wrapped(d, buf16_size);
-    GST_BUFFER_DURATION(buf16) = GST_FRAMES_TO_CLOCK_TIME(samples * sizeof(int16_t) * channels, rate);
-    buf = buf16;
-
-    instance->unsupported_analyzer_ = false;
-  }
-
-  else if (format.startsWith("F32LE")) {
+  const SampleConverter::Format format = instance->handoff_format_;
+  if (format != SampleConverter::Format_Unknown) {
 
     GstMapInfo map_info;
-    gst_buffer_map(buf, &map_info, GST_MAP_READ);
-
-    float *s = reinterpret_cast<float*>(map_info.data);
-    int samples = (map_info.size / sizeof(float)) / channels;
-    int buf16_size = samples * sizeof(int16_t) * channels;
-    int16_t *d = static_cast<int16_t*>(g_malloc(buf16_size));
-    memset(d, 0, buf16_size);
-    for (int i = 0 ; i < (samples * channels) ; ++i) {
-      float sample_float = (s[i] * 32768.0);
-      d[i] = static_cast<int16_t>(sample_float);
-    }
-    gst_buffer_unmap(buf, &map_info);
-    buf16 = gst_buffer_new_wrapped(d, buf16_size);
-    GST_BUFFER_DURATION(buf16) = GST_FRAMES_TO_CLOCK_TIME(samples * sizeof(int16_t) * channels, rate);
-    buf = buf16;
-
-    instance->unsupported_analyzer_ = false;
-  }
-  else if (format.startsWith("S24LE")) {
-
-    GstMapInfo map_info;
-    gst_buffer_map(buf, &map_info, GST_MAP_READ);
-
-    char *s24 = reinterpret_cast<char*>(map_info.data);
-    char *s24e = s24 + map_info.size;
-    int samples = (map_info.size / sizeof(char)) / channels;
-    int buf16_size = samples * sizeof(int16_t) * channels;
-    int16_t *s16 = static_cast<int16_t*>(g_malloc(buf16_size));
-    memset(s16, 0, buf16_size);
-    for (int i = 0 ; i < (samples * channels) ; ++i) {
-      s16[i] = *(reinterpret_cast<int16_t*>(s24+1));
-      s24 += 3;
-      if (s24 >= s24e) break;
+    if (gst_buffer_map(buf, &map_info, GST_MAP_READ)) {
+      const int samples = map_info.size / SampleConverter::BytesPerSample(format);
+      const int frames = instance->handoff_channels_ > 0 ? samples / instance->handoff_channels_ : 0;
+      if (format == SampleConverter::Format_S16LE) {
+        instance->scope_buffer_.Write(reinterpret_cast<const qint16*>(map_info.data), frames, instance->handoff_channels_, instance->handoff_rate_, start_time);
+      }
+      else {
+        buf16 = instance->AcquireHandoffBuffer(samples * sizeof(int16_t));
+        if (buf16) {
+          GstMapInfo map_info16;
+          gst_buffer_map(buf16, &map_info16, GST_MAP_WRITE);
+          SampleConverter::Convert(format, map_info.data, reinterpret_cast<qint16*>(map_info16.data), samples);
+          instance->scope_buffer_.Write(reinterpret_cast<const qint16*>(map_info16.data), frames, instance->handoff_channels_, instance->handoff_rate_, start_time);
+          gst_buffer_unmap(buf16, &map_info16);
+          GST_BUFFER_DURATION(buf16) = GST_BUFFER_DURATION(buf);
+        }
+      }
+      gst_buffer_unmap(buf, &map_info);
+      if (buf16) buf = buf16;
     }
-    gst_buffer_unmap(buf, &map_info);
-    buf16 = gst_buffer_new_wrapped(s16, buf16_size);
-    GST_BUFFER_DURATION(buf16) = GST_FRAMES_TO_CLOCK_TIME(samples * sizeof(int16_t) * channels, rate);
-    buf = buf16;
 
     instance->unsupported_analyzer_ = false;
   }
   else if (!instance->unsupported_analyzer_) {
     instance->unsupported_analyzer_ = true;
-    qLog(Debug) << "Unsupported audio format for the analyzer" << format;
+    qLog(Debug) << "Unsupported audio format for the analyzer" << instance->handoff_format_string_;
   }
 
   QList<GstBufferConsumer*> consumers;
@@ -683,7 +733,7 @@ GstPadProbeReturn GstEnginePipeline::HandoffCallback(GstPad *pad, GstPadProbeInf
 
   for (GstBufferConsumer *consumer : consumers) {
     gst_buffer_ref(buf);
-    consumer->ConsumeBuffer(buf, instance->id(), format);
+    consumer->ConsumeBuffer(buf, instance->id(), instance->handoff_format_string_);
   }
 
   if (buf16) {
@@ -714,6 +764,56 @@ GstPadProbeReturn GstEnginePipeline::HandoffCallback(GstPad *pad, GstPadProbeInf
 
 }
 
+void GstEnginePipeline::SetHandoffCaps(GstCaps *caps) {
+
+  if (handoff_caps_) gst_caps_unref(handoff_caps_);
+  handoff_caps_ = caps;
+
+  handoff_format_string_.clear();
+  handoff_channels_ = 0;
+  handoff_rate_ = 0;
+  if (caps) {
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    handoff_format_string_ = QString(gst_structure_get_string(structure, "format"));
+    gst_structure_get_int(structure, "channels", &handoff_channels_);
+    gst_structure_get_int(structure, "rate", &handoff_rate_);
+  }
+  handoff_format_ = SampleConverter::FormatFromString(handoff_format_string_);
+
+}
+
+GstBuffer *GstEnginePipeline::AcquireHandoffBuffer(const guint size) {
+
+  // The pool hands out buffers of one size, replace it when a larger buffer is needed.
+  // Buffers still held by the consumers keep the old pool alive until they're returned.
+  if (!handoff_pool_ || size > handoff_pool_size_) {
+    if (handoff_pool_) {
+      gst_buffer_pool_set_active(handoff_pool_, FALSE);
+      gst_object_unref(handoff_pool_);
+    }
+    handoff_pool_ = gst_buffer_pool_new();
+    GstStructure *config = gst_buffer_pool_get_config(handoff_pool_);
+    gst_buffer_pool_config_set_params(config, nullptr, size, 0, 0);
+    if (!gst_buffer_pool_set_config(handoff_pool_, config) || !gst_buffer_pool_set_active(handoff_pool_, TRUE)) {
+      qLog(Error) << "Failed to set up the analyzer buffer pool";
+      gst_object_unref(handoff_pool_);
+      handoff_pool_ = nullptr;
+      handoff_pool_size_ = 0;
+      return nullptr;
+    }
+    handoff_pool_size_ = size;
+  }
+
+  GstBuffer *buffer = nullptr;
+  if (gst_buffer_pool_acquire_buffer(handoff_pool_, &buffer, nullptr) != GST_FLOW_OK) return nullptr;
+
+  // The pool restores the full size when the buffer is returned.
+  gst_buffer_set_size(buffer, size);
+
+  return buffer;
+
+}
+
 void GstEnginePipeline::AboutToFinishCallback(GstPlayBin*, gpointer self) {
 
   GstEnginePipeline *instance = reinterpret_cast<GstEnginePipeline*>(self);
@@ -829,6 +929,8 @@ void GstEnginePipeline::StreamStartMessageReceived() {
     next_original_url_.clear();
     next_beginning_offset_nanosec_ = 0;
     next_end_offset_nanosec_ = 0;
+    SetReplayGainFallback(next_rg_fallback_gain_);
+    next_rg_fallback_gain_ = 0.0;
 
     emit EndOfStreamReached(id(), true);
   }
@@ -901,6 +1003,9 @@ void GstEnginePipeline::ErrorMessageReceived(GstMessage *msg) {
   }
 #endif
 
+  // Don't reuse the elements, the error might have left them in a bad state.
+  valid_ = false;
+
   emit Error(id(), message, static_cast<int>(domain), code);
 
 }
@@ -1254,6 +1359,14 @@ void GstEnginePipeline::RemoveAllBufferConsumers() {
   buffer_consumers_.clear();
 }
 
+void GstEnginePipeline::SetReplayGainFallback(const double gain) {
+
+  rg_fallback_gain_ = gain;
+  // rgvolume only uses this when the stream has no ReplayGain tags.
+  if (rgvolume_) g_object_set(G_OBJECT(rgvolume_), "fallback-gain", rg_fallback_gain_, nullptr);
+
+}
+
 void GstEnginePipeline::SetNextUrl(const QByteArray &stream_url, const QUrl &original_url, const qint64 beginning_nanosec, const qint64 end_nanosec) {
 
   next_stream_url_ = stream_url;
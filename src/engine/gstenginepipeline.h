@@ -39,12 +39,16 @@
 #include <QTimeLine>
 #include <QEasingCurve>
 #include <QBasicTimer>
+#include <QElapsedTimer>
 #include <QList>
 #include <QByteArray>
 #include <QVariant>
 #include <QString>
 #include <QUrl>
 
+#include "sampleconverter.h"
+#include "scoperingbuffer.h"
+
 class QTimerEvent;
 class GstEngine;
 class GstBufferConsumer;
@@ -75,9 +79,17 @@ class GstEnginePipeline : public QObject {
   void set_buffer_low_watermark(const double value);
   void set_buffer_high_watermark(const double value);
 
-  // Creates the pipeline, returns false on error
+  // Creates the pipeline, or reuses its elements after Reset(), returns false on error
   bool InitFromUrl(const QByteArray &stream_url, const QUrl original_url, const qint64 end_nanosec);
 
+  // Stops the pipeline and forgets the last stream, so it can be given a new one with InitFromUrl() without building the elements again.
+  // The pipeline gets a new ID, signals still queued for the last stream carry the old one.
+  void Reset();
+
+  // Identifies the settings the elements were built with, the engine only reuses pipelines with the same key.
+  QString pool_key() const { return pool_key_; }
+  void set_pool_key(const QString &key) { pool_key_ = key; }
+
   // GstBufferConsumers get fed audio data.  Thread-safe.
   void AddBufferConsumer(GstBufferConsumer *consumer);
   void RemoveBufferConsumer(GstBufferConsumer *consumer);
@@ -94,6 +106,10 @@ class GstEnginePipeline : public QObject {
 
   // If this is set then it will be loaded automatically when playback finishes for gapless playback
   void SetNextUrl(const QByteArray &stream_url, const QUrl &original_url, qint64 beginning_nanosec, qint64 end_nanosec);
+
+  // Gain in dB for streams without ReplayGain tags, like the ones the loudness scanner only stored in the collection.
+  void SetReplayGainFallback(const double gain);
+  void SetNextReplayGainFallback(const double gain) { next_rg_fallback_gain_ = gain; }
   bool has_next_valid_url() const { return !next_stream_url_.isEmpty(); }
 
   void SetSourceDevice(QString device) { source_device_ = device; }
@@ -118,6 +134,9 @@ class GstEnginePipeline : public QObject {
 
   QString source_device() const { return source_device_; }
 
+  // The most recent samples for the analyzer, written by the streaming thread and read by the GUI thread.
+  const ScopeRingBuffer &scope_buffer() const { return scope_buffer_; }
+
  public slots:
   void SetVolumeModifier(qreal mod);
 
@@ -137,6 +156,7 @@ class GstEnginePipeline : public QObject {
   void timerEvent(QTimerEvent*) override;
 
  private:
+  bool Init();
   bool InitAudioBin();
 
   // Static callbacks.  The GstEnginePipeline instance is passed in the last argument.
@@ -164,6 +184,10 @@ class GstEnginePipeline : public QObject {
   QString ParseStrTag(GstTagList *list, const char *tag) const;
   guint ParseUIntTag(GstTagList *list, const char *tag) const;
 
+  // Called from the streaming thread.
+  void SetHandoffCaps(GstCaps *caps);
+  GstBuffer *AcquireHandoffBuffer(const guint size);
+
   void UpdateVolume();
   void UpdateStereoBalance();
   void UpdateEqualizer();
@@ -209,6 +233,8 @@ class GstEnginePipeline : public QObject {
   int rg_mode_;
   float rg_preamp_;
   bool rg_compression_;
+  double rg_fallback_gain_;
+  double next_rg_fallback_gain_;
 
   // Buffering
   quint64 buffer_duration_nanosec_;
@@ -275,6 +301,7 @@ class GstEnginePipeline : public QObject {
   GstElement *audiopanorama_;
   GstElement *equalizer_;
   GstElement *equalizer_preamp_;
+  GstElement *rgvolume_;
   GstDiscoverer *discoverer_;
 
   int pad_added_cb_id_;
@@ -288,8 +315,27 @@ class GstEnginePipeline : public QObject {
 
   GstSegment last_playbin_segment_;
 
+  // Format of the buffers in HandoffCallback, only parsed again when the caps change.
+  GstCaps *handoff_caps_;
+  SampleConverter::Format handoff_format_;
+  QString handoff_format_string_;
+  int handoff_channels_;
+  int handoff_rate_;
+  // Buffers for the samples converted to 16 bit for the analyzer.
+  GstBufferPool *handoff_pool_;
+  guint handoff_pool_size_;
+
+  ScopeRingBuffer scope_buffer_;
+
   bool unsupported_analyzer_;
 
+  QString pool_key_;
+  bool reused_;
+
+  // Time from InitFromUrl() to the first decoded buffer, for comparing new and reused pipelines.
+  QElapsedTimer first_sample_timer_;
+  bool first_sample_received_;
+
 };
 
 #endif  // GSTENGINEPIPELINE_H
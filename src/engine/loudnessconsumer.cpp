@@ -0,0 +1,61 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "config.h"
+
+#include <cmath>
+#include <vector>
+
+#include "loudnessconsumer.h"
+
+namespace {
+const std::vector<double> kNoBlocks;
+}
+
+LoudnessConsumer::LoudnessConsumer() : AnalysisPcmConsumer("F32LE"), success_(false) {}
+
+LoudnessConsumer::~LoudnessConsumer() {}
+
+void LoudnessConsumer::Start(const int rate, const int channels) {
+  meter_.reset(new EbuR128Meter(channels, rate));
+}
+
+void LoudnessConsumer::ProcessSamples(const char *data, const int size) {
+
+  if (!meter_) return;
+  meter_->AddFrames(reinterpret_cast<const float*>(data), size / static_cast<int>(sizeof(float) * meter_->channels()));
+
+}
+
+void LoudnessConsumer::Finish(const bool success) {
+  success_ = success && meter_ && !meter_->blocks().empty();
+}
+
+double LoudnessConsumer::loudness() const {
+  return meter_ ? meter_->IntegratedLoudness() : -HUGE_VAL;
+}
+
+float LoudnessConsumer::peak() const {
+  return meter_ ? meter_->peak() : 0.0F;
+}
+
+const std::vector<double> &LoudnessConsumer::blocks() const {
+  return meter_ ? meter_->blocks() : kNoBlocks;
+}
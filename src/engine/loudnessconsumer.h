@@ -0,0 +1,55 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LOUDNESSCONSUMER_H
+#define LOUDNESSCONSUMER_H
+
+#include "config.h"
+
+#include <memory>
+#include <vector>
+
+#include "analysispipeline.h"
+#include "ebur128meter.h"
+
+// Measures the EBU R128 loudness and the peak of a file in an analysis pipeline.
+class LoudnessConsumer : public AnalysisPcmConsumer {
+ public:
+  LoudnessConsumer();
+  ~LoudnessConsumer() override;
+
+  void Start(const int rate, const int channels) override;
+  void Finish(const bool success) override;
+
+  // The results are only valid after a successful run.
+  bool success() const { return success_; }
+  double loudness() const;
+  float peak() const;
+  const std::vector<double> &blocks() const;
+
+ protected:
+  void ProcessSamples(const char *data, const int size) override;
+
+ private:
+  std::unique_ptr<EbuR128Meter> meter_;
+  bool success_;
+};
+
+#endif  // LOUDNESSCONSUMER_H
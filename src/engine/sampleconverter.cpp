@@ -0,0 +1,339 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define HAVE_SSE2_KERNELS
+#  include <emmintrin.h>
+#endif
+
+// The AVX2 versions are compiled for AVX2 with a function attribute and only used when the CPU has it, so the build needs no special flags.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define HAVE_AVX2_KERNELS
+#  include <immintrin.h>
+#  define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define HAVE_NEON_KERNELS
+#  include <arm_neon.h>
+#endif
+
+#include "sampleconverter.h"
+
+namespace {
+
+typedef void (*Kernel)(const void *src, qint16 *dest, const int count);
+
+struct Kernels {
+  Kernel s24;
+  Kernel s32;
+  Kernel f32;
+};
+
+// The 16 most significant bits of each sample.
+void S24ToS16Scalar(const void *src, qint16 *dest, const int count) {
+  const quint8 *s = static_cast<const quint8*>(src);
+  for (int i = 0; i < count; ++i, s += 3) {
+    dest[i] = static_cast<qint16>(static_cast<quint16>(s[1] | (s[2] << 8)));
+  }
+}
+
+void S32ToS16Scalar(const void *src, qint16 *dest, const int count) {
+  const qint32 *s = static_cast<const qint32*>(src);
+  for (int i = 0; i < count; ++i) {
+    dest[i] = static_cast<qint16>(s[i] >> 16);
+  }
+}
+
+// Clips and truncates like the SIMD versions do, NaN ends up as the maximum.
+inline qint16 FloatToS16(const float sample) {
+  float f = sample * 32768.0F;
+  f = f < 32767.0F ? f : 32767.0F;
+  f = f > -32768.0F ? f : -32768.0F;
+  return static_cast<qint16>(f);
+}
+
+void F32ToS16Scalar(const void *src, qint16 *dest, const int count) {
+  const float *s = static_cast<const float*>(src);
+  for (int i = 0; i < count; ++i) {
+    dest[i] = FloatToS16(s[i]);
+  }
+}
+
+#ifdef HAVE_SSE2_KERNELS
+
+void S32ToS16SSE2(const void *src, qint16 *dest, const int count) {
+  const qint32 *s = static_cast<const qint32*>(src);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i a = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)), 16);
+    const __m128i b = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 4)), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(a, b));
+  }
+  S32ToS16Scalar(s + i, dest + i, count - i);
+}
+
+void F32ToS16SSE2(const void *src, qint16 *dest, const int count) {
+  const float *s = static_cast<const float*>(src);
+  const __m128 scale = _mm_set1_ps(32768.0F);
+  const __m128 max = _mm_set1_ps(32767.0F);
+  const __m128 min = _mm_set1_ps(-32768.0F);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128 a = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(s + i), scale), max), min);
+    const __m128 b = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(s + i + 4), scale), max), min);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+  }
+  F32ToS16Scalar(s + i, dest + i, count - i);
+}
+
+#endif  // HAVE_SSE2_KERNELS
+
+#ifdef HAVE_AVX2_KERNELS
+
+AVX2_TARGET void S24ToS16AVX2(const void *src, qint16 *dest, const int count) {
+  const quint8 *s = static_cast<const quint8*>(src);
+  const __m128i shuffle = _mm_setr_epi8(1, 2, 4, 5, 7, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1);
+  int i = 0;
+  // Each load takes 4 samples from 16 bytes, so stop while the second load can still read all of its bytes.
+  for (; count - i >= 10; i += 8) {
+    const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * 3)), shuffle);
+    const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + (i + 4) * 3)), shuffle);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_unpacklo_epi64(a, b));
+  }
+  S24ToS16Scalar(s + i * 3, dest + i, count - i);
+}
+
+AVX2_TARGET void S32ToS16AVX2(const void *src, qint16 *dest, const int count) {
+  const qint32 *s = static_cast<const qint32*>(src);
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m256i a = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i)), 16);
+    const __m256i b = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + 8)), 16);
+    // The pack works within each 128 bit lane, put the 64 bit quarters back in order.
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+  }
+  S32ToS16Scalar(s + i, dest + i, count - i);
+}
+
+AVX2_TARGET void F32ToS16AVX2(const void *src, qint16 *dest, const int count) {
+  const float *s = static_cast<const float*>(src);
+  const __m256 scale = _mm256_set1_ps(32768.0F);
+  const __m256 max = _mm256_set1_ps(32767.0F);
+  const __m256 min = _mm256_set1_ps(-32768.0F);
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m256 a = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(s + i), scale), max), min);
+    const __m256 b = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(s + i + 8), scale), max), min);
+    const __m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+  F32ToS16Scalar(s + i, dest + i, count - i);
+}
+
+#endif  // HAVE_AVX2_KERNELS
+
+#ifdef HAVE_NEON_KERNELS
+
+void S24ToS16NEON(const void *src, qint16 *dest, const int count) {
+  const quint8 *s = static_cast<const quint8*>(src);
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    // Split the three bytes of 16 samples, the two high bytes are the little endian 16 bit samples.
+    const uint8x16x3_t bytes = vld3q_u8(s + i * 3);
+    const uint8x16x2_t samples = vzipq_u8(bytes.val[1], bytes.val[2]);
+    vst1q_s16(dest + i, vreinterpretq_s16_u8(samples.val[0]));
+    vst1q_s16(dest + i + 8, vreinterpretq_s16_u8(samples.val[1]));
+  }
+  S24ToS16Scalar(s + i * 3, dest + i, count - i);
+}
+
+void S32ToS16NEON(const void *src, qint16 *dest, const int count) {
+  const qint32 *s = static_cast<const qint32*>(src);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    vst1q_s16(dest + i, vcombine_s16(vshrn_n_s32(vld1q_s32(s + i), 16), vshrn_n_s32(vld1q_s32(s + i + 4), 16)));
+  }
+  S32ToS16Scalar(s + i, dest + i, count - i);
+}
+
+// vminq_f32 and vmaxq_f32 return NaN if either value is NaN, so clip with comparisons like FloatToS16 does, which turns NaN into the maximum.
+inline float32x4_t ClipNEON(const float32x4_t f, const float32x4_t max, const float32x4_t min) {
+  const float32x4_t upper = vbslq_f32(vcltq_f32(f, max), f, max);
+  return vbslq_f32(vcgtq_f32(upper, min), upper, min);
+}
+
+void F32ToS16NEON(const void *src, qint16 *dest, const int count) {
+  const float *s = static_cast<const float*>(src);
+  const float32x4_t scale = vdupq_n_f32(32768.0F);
+  const float32x4_t max = vdupq_n_f32(32767.0F);
+  const float32x4_t min = vdupq_n_f32(-32768.0F);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const float32x4_t a = ClipNEON(vmulq_f32(vld1q_f32(s + i), scale), max, min);
+    const float32x4_t b = ClipNEON(vmulq_f32(vld1q_f32(s + i + 4), scale), max, min);
+    vst1q_s16(dest + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b))));
+  }
+  F32ToS16Scalar(s + i, dest + i, count - i);
+}
+
+#endif  // HAVE_NEON_KERNELS
+
+Kernels KernelsFor(const SampleConverter::Instructions instructions) {
+
+  Kernels kernels = { &S24ToS16Scalar, &S32ToS16Scalar, &F32ToS16Scalar };
+
+  switch (instructions) {
+    case SampleConverter::Instructions_Scalar:
+      break;
+    case SampleConverter::Instructions_SSE2:
+#ifdef HAVE_SSE2_KERNELS
+      kernels.s32 = &S32ToS16SSE2;
+      kernels.f32 = &F32ToS16SSE2;
+#endif
+      break;
+    case SampleConverter::Instructions_AVX2:
+#ifdef HAVE_AVX2_KERNELS
+      kernels.s24 = &S24ToS16AVX2;
+      kernels.s32 = &S32ToS16AVX2;
+      kernels.f32 = &F32ToS16AVX2;
+#endif
+      break;
+    case SampleConverter::Instructions_NEON:
+#ifdef HAVE_NEON_KERNELS
+      kernels.s24 = &S24ToS16NEON;
+      kernels.s32 = &S32ToS16NEON;
+      kernels.f32 = &F32ToS16NEON;
+#endif
+      break;
+  }
+
+  return kernels;
+
+}
+
+bool ConvertWith(const Kernels &kernels, const SampleConverter::Format format, const void *src, qint16 *dest, const int count) {
+
+  switch (format) {
+    case SampleConverter::Format_S24LE:
+      kernels.s24(src, dest, count);
+      return true;
+    case SampleConverter::Format_S32LE:
+      kernels.s32(src, dest, count);
+      return true;
+    case SampleConverter::Format_F32LE:
+      kernels.f32(src, dest, count);
+      return true;
+    case SampleConverter::Format_S16LE:
+    case SampleConverter::Format_Unknown:
+      break;
+  }
+
+  return false;
+
+}
+
+}  // namespace
+
+SampleConverter::Format SampleConverter::FormatFromString(const QString &format) {
+
+  if (format.startsWith("S16LE")) return Format_S16LE;
+  if (format.startsWith("S24LE")) return Format_S24LE;
+  if (format.startsWith("S32LE")) return Format_S32LE;
+  if (format.startsWith("F32LE")) return Format_F32LE;
+  return Format_Unknown;
+
+}
+
+int SampleConverter::BytesPerSample(const Format format) {
+
+  switch (format) {
+    case Format_S16LE:
+      return 2;
+    case Format_S24LE:
+      return 3;
+    case Format_S32LE:
+    case Format_F32LE:
+      return 4;
+    case Format_Unknown:
+      break;
+  }
+  return 0;
+
+}
+
+QList<SampleConverter::Instructions> SampleConverter::SupportedInstructions() {
+
+  QList<Instructions> instructions;
+  instructions << Instructions_Scalar;
+#ifdef HAVE_SSE2_KERNELS
+  instructions << Instructions_SSE2;
+#endif
+#ifdef HAVE_AVX2_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) instructions << Instructions_AVX2;
+#endif
+#ifdef HAVE_NEON_KERNELS
+  instructions << Instructions_NEON;
+#endif
+  return instructions;
+
+}
+
+SampleConverter::Instructions SampleConverter::BestInstructions() {
+
+  static const Instructions best = SupportedInstructions().last();
+  return best;
+
+}
+
+QString SampleConverter::InstructionsName(const Instructions instructions) {
+
+  switch (instructions) {
+    case Instructions_Scalar:
+      return "scalar";
+    case Instructions_SSE2:
+      return "SSE2";
+    case Instructions_AVX2:
+      return "AVX2";
+    case Instructions_NEON:
+      return "NEON";
+  }
+  return QString();
+
+}
+
+bool SampleConverter::Convert(const Format format, const void *src, qint16 *dest, const int count) {
+
+  static const Kernels kernels = KernelsFor(BestInstructions());
+  return ConvertWith(kernels, format, src, dest, count);
+
+}
+
+bool SampleConverter::Convert(const Instructions instructions, const Format format, const void *src, qint16 *dest, const int count) {
+
+  return ConvertWith(KernelsFor(instructions), format, src, dest, count);
+
+}
@@ -0,0 +1,63 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SAMPLECONVERTER_H
+#define SAMPLECONVERTER_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+
+// Converts interleaved samples to signed 16 bit for the analyzer.
+// Every conversion has a plain C++ version and, where the CPU supports them, SSE2, AVX2 or NEON versions which give the same results.
+// The fastest supported version is picked once at runtime.
+class SampleConverter {
+ public:
+  enum Format {
+    Format_Unknown,
+    Format_S16LE,
+    Format_S24LE,
+    Format_S32LE,
+    Format_F32LE
+  };
+
+  enum Instructions {
+    Instructions_Scalar,
+    Instructions_SSE2,
+    Instructions_AVX2,
+    Instructions_NEON
+  };
+
+  // Takes the format field of the audio/x-raw caps.
+  static Format FormatFromString(const QString &format);
+  static int BytesPerSample(const Format format);
+
+  static QList<Instructions> SupportedInstructions();
+  static Instructions BestInstructions();
+  static QString InstructionsName(const Instructions instructions);
+
+  // Converts count samples from src to dest with the best supported instructions.
+  // Returns false when the format can't be converted, S16LE needs no conversion.
+  static bool Convert(const Format format, const void *src, qint16 *dest, const int count);
+  static bool Convert(const Instructions instructions, const Format format, const void *src, qint16 *dest, const int count);
+};
+
+#endif  // SAMPLECONVERTER_H
@@ -0,0 +1,157 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <atomic>
+#include <cstring>
+
+#include <QtGlobal>
+
+#include "core/timeconstants.h"
+#include "scoperingbuffer.h"
+
+const int ScopeRingBuffer::kDefaultCapacityFrames = 65536;
+
+ScopeRingBuffer::ScopeRingBuffer(const int capacity_frames)
+    : mask_(0),
+      written_(0),
+      reserved_(0),
+      anchor_sequence_(0),
+      anchor_frame_(0),
+      anchor_timestamp_(0),
+      anchor_rate_(0) {
+
+  quint64 capacity = 2;
+  while (capacity < static_cast<quint64>(capacity_frames)) capacity <<= 1;
+  mask_ = capacity - 1;
+  samples_.resize(capacity * 2, 0);
+
+}
+
+void ScopeRingBuffer::Write(const qint16 *samples, const int frames, const int channels, const int rate, const qint64 timestamp_nanosec) {
+
+  if (!samples || frames <= 0 || channels <= 0 || rate <= 0) return;
+
+  const quint64 start = written_.load(std::memory_order_relaxed);
+  const quint64 end = start + frames;
+
+  reserved_.store(end, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  // Only the newest frames fit when a single buffer is larger than the ring.
+  const int skip = qMax(0, frames - capacity());
+  quint64 frame = start + skip;
+  if (channels == 2) {
+    const qint16 *source = samples + skip * 2;
+    int remaining = frames - skip;
+    while (remaining > 0) {
+      const quint64 index = frame & mask_;
+      const int count = qMin(remaining, static_cast<int>(mask_ + 1 - index));
+      memcpy(&samples_[index * 2], source, count * 2 * sizeof(qint16));
+      source += count * 2;
+      frame += count;
+      remaining -= count;
+    }
+  }
+  else {
+    for (int i = skip; i < frames; ++i, ++frame) {
+      const qint16 *source = samples + i * channels;
+      const quint64 index = (frame & mask_) * 2;
+      samples_[index] = source[0];
+      samples_[index + 1] = channels > 1 ? source[1] : source[0];
+    }
+  }
+
+  const quint32 sequence = anchor_sequence_.load(std::memory_order_relaxed);
+  anchor_sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  anchor_frame_.store(start, std::memory_order_relaxed);
+  anchor_timestamp_.store(timestamp_nanosec, std::memory_order_relaxed);
+  anchor_rate_.store(rate, std::memory_order_relaxed);
+  anchor_sequence_.store(sequence + 2, std::memory_order_release);
+
+  written_.store(end, std::memory_order_release);
+
+}
+
+bool ScopeRingBuffer::LoadAnchor(Anchor *anchor) const {
+
+  // The writer updates the anchor once per buffer, so it is rarely caught in the middle of an update.
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    const quint32 sequence = anchor_sequence_.load(std::memory_order_acquire);
+    if (sequence & 1) continue;
+    anchor->frame = anchor_frame_.load(std::memory_order_relaxed);
+    anchor->timestamp_nanosec = anchor_timestamp_.load(std::memory_order_relaxed);
+    anchor->rate = anchor_rate_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (anchor_sequence_.load(std::memory_order_relaxed) == sequence) return true;
+  }
+
+  return false;
+
+}
+
+bool ScopeRingBuffer::Read(const qint64 position_nanosec, qint16 *dest, const int frames) const {
+
+  if (!dest || frames <= 0 || frames > capacity() / 2) return false;
+
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    const quint64 written = written_.load(std::memory_order_acquire);
+    if (written < static_cast<quint64>(frames)) return false;
+
+    // Only use the newer half of the ring, the oldest frames are the next ones to be overwritten.
+    const quint64 history = (mask_ + 1) / 2;
+    const quint64 oldest = written > history ? written - history : 0;
+
+    quint64 end = written;
+    Anchor anchor;
+    if (position_nanosec >= 0 && LoadAnchor(&anchor) && anchor.rate > 0) {
+      const qint64 offset = static_cast<qint64>(static_cast<double>(position_nanosec - anchor.timestamp_nanosec) * anchor.rate / kNsecPerSec);
+      const qint64 center = static_cast<qint64>(anchor.frame) + offset;
+      const qint64 candidate = center + frames / 2;
+      if (candidate - frames >= static_cast<qint64>(oldest) && candidate <= static_cast<qint64>(written)) {
+        end = static_cast<quint64>(candidate);
+      }
+    }
+
+    const quint64 start = end - frames;
+    const quint64 index = start & mask_;
+    const int first = qMin(frames, static_cast<int>(mask_ + 1 - index));
+    memcpy(dest, &samples_[index * 2], first * 2 * sizeof(qint16));
+    if (first < frames) {
+      memcpy(dest + first * 2, &samples_[0], (frames - first) * 2 * sizeof(qint16));
+    }
+
+    // The copy is only good if the writer didn't get around the ring to the copied frames in the meantime.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (reserved_.load(std::memory_order_relaxed) <= start + mask_ + 1) return true;
+  }
+
+  return false;
+
+}
+
+void ScopeRingBuffer::Clear() {
+
+  written_.store(0, std::memory_order_relaxed);
+  reserved_.store(0, std::memory_order_relaxed);
+  anchor_rate_.store(0, std::memory_order_relaxed);
+
+}
@@ -0,0 +1,81 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SCOPERINGBUFFER_H
+#define SCOPERINGBUFFER_H
+
+#include "config.h"
+
+#include <atomic>
+#include <vector>
+
+#include <QtGlobal>
+
+// Keeps the most recent stereo 16 bit frames for the analyzer.
+// Written by one GStreamer streaming thread and read by the GUI thread without locks: the writer never waits, it overwrites the oldest frames,
+// and the reader checks afterwards that the frames it copied weren't overwritten while it was copying.
+// Every write also records the stream time of its first frame, so the reader can pick the frames that are playing right now
+// instead of the ones that just left the queue.
+class ScopeRingBuffer {
+ public:
+  // The capacity is rounded up to a power of two.
+  explicit ScopeRingBuffer(const int capacity_frames = kDefaultCapacityFrames);
+
+  static const int kDefaultCapacityFrames;
+
+  int capacity() const { return static_cast<int>(mask_ + 1); }
+
+  // Called from the streaming thread.  Mono samples are duplicated to both channels, channels beyond the first two are dropped.
+  void Write(const qint16 *samples, const int frames, const int channels, const int rate, const qint64 timestamp_nanosec);
+
+  // Called from the GUI thread.  Copies the given number of interleaved stereo frames to dest, centered on the frame playing at position_nanosec.
+  // When the position is outside the buffered frames, like right after a seek, the newest frames are used.
+  // Returns false when there is nothing to read yet.
+  bool Read(const qint64 position_nanosec, qint16 *dest, const int frames) const;
+
+  // Forgets the buffered frames.  Only call this while nothing is writing.
+  void Clear();
+
+ private:
+  struct Anchor {
+    quint64 frame;
+    qint64 timestamp_nanosec;
+    int rate;
+  };
+
+  bool LoadAnchor(Anchor *anchor) const;
+
+  quint64 mask_;
+  std::vector<qint16> samples_;
+
+  // Total number of frames written, and the number of frames written once the write in progress finishes.
+  // The reader compares the latter against the frames it copied to find out whether they were overwritten.
+  std::atomic<quint64> written_;
+  std::atomic<quint64> reserved_;
+
+  // The anchor is published with a sequence lock, the sequence is odd while the writer is updating it.
+  std::atomic<quint32> anchor_sequence_;
+  std::atomic<quint64> anchor_frame_;
+  std::atomic<qint64> anchor_timestamp_;
+  std::atomic<int> anchor_rate_;
+
+  Q_DISABLE_COPY(ScopeRingBuffer)
+};
+
+#endif  // SCOPERINGBUFFER_H
@@ -0,0 +1,75 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <gst/gst.h>
+
+#include <QtGlobal>
+#include <QByteArray>
+
+#include "core/logging.h"
+#include "engine/analysispipeline.h"
+#include "moodbarbuilder.h"
+#include "moodbarconsumer.h"
+
+#include "ext/gstmoodbar/gstfastspectrum.h"
+
+const int MoodbarConsumer::kBands = 128;
+
+MoodbarConsumer::MoodbarConsumer() : builder_(new MoodbarBuilder), success_(false) {}
+
+MoodbarConsumer::~MoodbarConsumer() {}
+
+GstElement* MoodbarConsumer::CreateBranch(GstElement* pipeline) {
+
+  GstElement* convert = AnalysisPipeline::CreateElement("audioconvert", pipeline);
+  GstElement* spectrum = AnalysisPipeline::CreateElement("fastspectrum", pipeline);
+  GstElement* fakesink = AnalysisPipeline::CreateElement("fakesink", pipeline);
+  if (!convert || !spectrum || !fakesink) return nullptr;
+
+  if (!gst_element_link(convert, spectrum) || !gst_element_link(spectrum, fakesink)) {
+    qLog(Error) << "Failed to link elements";
+    return nullptr;
+  }
+
+  g_object_set(spectrum, "bands", kBands, nullptr);
+
+  GstFastSpectrum* fast_spectrum = reinterpret_cast<GstFastSpectrum*>(spectrum);
+  fast_spectrum->output_callback = [this](double* magnitudes, int size) { builder_->AddFrame(magnitudes, size); };
+
+  return convert;
+
+}
+
+void MoodbarConsumer::Start(const int rate, const int channels) {
+
+  Q_UNUSED(channels);
+  builder_->Init(kBands, rate);
+
+}
+
+void MoodbarConsumer::Finish(const bool success) {
+
+  success_ = success;
+  if (success_) data_ = builder_->Finish(1000);
+
+}
@@ -0,0 +1,56 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef MOODBARCONSUMER_H
+#define MOODBARCONSUMER_H
+
+#include "config.h"
+
+#include <memory>
+
+#include <QByteArray>
+
+#include "engine/analysispipeline.h"
+
+class MoodbarBuilder;
+
+// Creates moodbar data in an analysis pipeline, together with the other analyzers.
+class MoodbarConsumer : public AnalysisPipeline::Consumer {
+ public:
+  MoodbarConsumer();
+  ~MoodbarConsumer() override;
+
+  GstElement* CreateBranch(GstElement* pipeline) override;
+  void Start(const int rate, const int channels) override;
+  void Finish(const bool success) override;
+
+  bool success() const { return success_; }
+  const QByteArray& data() const { return data_; }
+
+ private:
+  static const int kBands;
+
+  std::unique_ptr<MoodbarBuilder> builder_;
+
+  bool success_;
+  QByteArray data_;
+};
+
+#endif  // MOODBARCONSUMER_H
@@ -28,8 +28,6 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
-#include <QAbstractNetworkCache>
-#include <QNetworkDiskCache>
 #include <QTimer>
 #include <QVariant>
 #include <QByteArray>
@@ -43,6 +41,7 @@
 #include "core/logging.h"
 
 #include "moodbarpipeline.h"
+#include "moodbarstore.h"
 
 #include "settings/moodbarsettingspage.h"
 
@@ -52,14 +51,14 @@
 
 MoodbarLoader::MoodbarLoader(Application* app, QObject* parent)
     : QObject(parent),
-      cache_(new QNetworkDiskCache(this)),
       thread_(new QThread(this)),
       kMaxActiveRequests(qMax(1, QThread::idealThreadCount() / 2)),
       enabled_(false),
       save_(false) {
 
-  cache_->setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/moodbar");
-  cache_->setMaximumCacheSize(60 * 1024 * 1024);  // 60MB - enough for 20,000 moodbars
+  // Moodbars used to be kept in a network disk cache, they are in the moodbar store now.
+  QDir old_cache_dir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/moodbar");
+  if (old_cache_dir.exists()) old_cache_dir.removeRecursively();
 
   connect(app, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
   ReloadSettings();
@@ -77,8 +76,15 @@ void MoodbarLoader::ReloadSettings() {
   s.beginGroup(MoodbarSettingsPage::kSettingsGroup);
   enabled_ = s.value("enabled", false).toBool();
   save_ = s.value("save", false).toBool();
+  const qint64 store_size = s.value("store_size", MoodbarStore::kDefaultDataSize / (1024 * 1024)).toLongLong() * 1024 * 1024;
   s.endGroup();
 
+  if (!store_ || store_->data_size() != store_size) {
+    // A store with a different size is created from scratch.
+    store_.reset(new MoodbarStore(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/moodbar.store", store_size));
+    store_->Open();
+  }
+
   MaybeTakeNextRequest();
 
 }
@@ -93,6 +99,57 @@ QStringList MoodbarLoader::MoodFilenames(const QString& song_filename) {
 
 }
 
+QByteArray MoodbarLoader::ReadMoodFile(const QUrl& url) {
+
+  for (const QString& possible_mood_file : MoodFilenames(url.toLocalFile())) {
+    QFile f(possible_mood_file);
+    if (f.open(QIODevice::ReadOnly)) {
+      const QByteArray data = f.readAll();
+      if (data.isEmpty()) continue;
+      qLog(Info) << "Importing moodbar data from" << possible_mood_file;
+      return data;
+    }
+  }
+
+  return QByteArray();
+
+}
+
+bool MoodbarLoader::ImportMoodFile(const QUrl& url, QByteArray* data) {
+
+  *data = ReadMoodFile(url);
+  if (data->isEmpty()) return false;
+
+  store_->Insert(url, *data);
+  return true;
+
+}
+
+bool MoodbarLoader::IsStored(const QUrl& url) const {
+
+  return store_->Contains(url);
+
+}
+
+void MoodbarLoader::Import(const QUrl& url, const QByteArray& data) {
+
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
+
+  store_->Insert(url, data);
+
+}
+
+bool MoodbarLoader::HasMoodbar(const QUrl& url) {
+
+  if (url.scheme() != "file") return false;
+
+  if (store_->Contains(url)) return true;
+
+  QByteArray data;
+  return ImportMoodFile(url, &data);
+
+}
+
 MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data, MoodbarPipeline** async_pipeline) {
 
   if (url.scheme() != "file") {
@@ -105,26 +162,15 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data, Moo
     return WillLoadAsync;
   }
 
-  // Check if a mood file exists for this file already
-  const QString filename(url.toLocalFile());
-
-  for (const QString& possible_mood_file : MoodFilenames(filename)) {
-    QFile f(possible_mood_file);
-    if (f.open(QIODevice::ReadOnly)) {
-      qLog(Info) << "Loading moodbar data from" << possible_mood_file;
-      *data = f.readAll();
-      return Loaded;
-    }
+  // Is it in the store?
+  *data = store_->Get(url);
+  if (!data->isEmpty()) {
+    return Loaded;
   }
 
-  // Maybe it exists in the cache?
-  std::unique_ptr<QIODevice> cache_device(cache_->data(url));
-  if (cache_device) {
-    qLog(Info) << "Loading cached moodbar data for" << filename;
-    *data = cache_device->readAll();
-    if (!data->isEmpty()) {
-      return Loaded;
-    }
+  // Check if a mood file exists for this file already
+  if (ImportMoodFile(url, data)) {
+    return Loaded;
   }
 
   if (!thread_->isRunning()) thread_->start(QThread::IdlePriority);
@@ -160,41 +206,41 @@ void MoodbarLoader::MaybeTakeNextRequest() {
 
 }
 
-void MoodbarLoader::RequestFinished(MoodbarPipeline *request, const QUrl &url) {
+void MoodbarLoader::Save(const QUrl& url, const QByteArray& data) {
 
   Q_ASSERT(QThread::currentThread() == qApp->thread());
 
-  if (request->success()) {
-    qLog(Info) << "Moodbar data generated successfully for" << url.toLocalFile();
-
-    // Save the data in the cache
-    QNetworkCacheMetaData metadata;
-    metadata.setUrl(url);
-
-    QIODevice* cache_file = cache_->prepare(metadata);
-    if (cache_file) {
-      cache_file->write(request->data());
-      cache_->insert(cache_file);
-    }
+  // Save the data in the store
+  store_->Insert(url, data);
 
-    // Save the data alongside the original as well if we're configured to.
-    if (save_) {
-      const QString mood_filename(MoodFilenames(url.toLocalFile())[0]);
-      QFile mood_file(mood_filename);
-      if (mood_file.open(QIODevice::WriteOnly)) {
-        mood_file.write(request->data());
+  // Save the data alongside the original as well if we're configured to.
+  if (save_) {
+    const QString mood_filename(MoodFilenames(url.toLocalFile())[0]);
+    QFile mood_file(mood_filename);
+    if (mood_file.open(QIODevice::WriteOnly)) {
+      mood_file.write(data);
 
 #ifdef Q_OS_WIN32
-        if (!SetFileAttributes((LPCTSTR)mood_filename.utf16(), FILE_ATTRIBUTE_HIDDEN)) {
-          qLog(Warning) << "Error setting hidden attribute for file" << mood_filename;
-        }
+      if (!SetFileAttributes((LPCTSTR)mood_filename.utf16(), FILE_ATTRIBUTE_HIDDEN)) {
+        qLog(Warning) << "Error setting hidden attribute for file" << mood_filename;
+      }
 #endif
 
-      }
-      else {
-        qLog(Warning) << "Error opening mood file for writing" << mood_filename;
-      }
     }
+    else {
+      qLog(Warning) << "Error opening mood file for writing" << mood_filename;
+    }
+  }
+
+}
+
+void MoodbarLoader::RequestFinished(MoodbarPipeline *request, const QUrl &url) {
+
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
+
+  if (request->success()) {
+    qLog(Info) << "Moodbar data generated successfully for" << url.toLocalFile();
+    Save(url, request->data());
   }
 
   // Remove the request from the active list and delete it
@@ -18,6 +18,8 @@
 #ifndef MOODBARLOADER_H
 #define MOODBARLOADER_H
 
+#include <memory>
+
 #include <QObject>
 #include <QList>
 #include <QMap>
@@ -28,9 +30,9 @@
 
 class QThread;
 class QByteArray;
-class QNetworkDiskCache;
 class Application;
 class MoodbarPipeline;
+class MoodbarStore;
 
 class MoodbarLoader : public QObject {
   Q_OBJECT
@@ -54,6 +56,21 @@ class MoodbarLoader : public QObject {
 
   Result Load(const QUrl& url, QByteArray* data, MoodbarPipeline** async_pipeline);
 
+  // Returns true if moodbar data for the URL is stored already.  Mood files found next to the song are imported into the store.
+  bool HasMoodbar(const QUrl& url);
+  // Only looks in the store, doesn't touch the file system.
+  bool IsStored(const QUrl& url) const;
+
+  // Returns the data of a mood file next to the song, or an empty QByteArray.  Can be called from any thread.
+  static QByteArray ReadMoodFile(const QUrl& url);
+  // Stores data read from a mood file.
+  void Import(const QUrl& url, const QByteArray& data);
+
+  // Stores moodbar data that was created elsewhere, like by the loudness scanner.
+  void Save(const QUrl& url, const QByteArray& data);
+
+  bool enabled() const { return enabled_; }
+
  private slots:
   void ReloadSettings();
 
@@ -62,9 +79,10 @@ class MoodbarLoader : public QObject {
 
  private:
   static QStringList MoodFilenames(const QString& song_filename);
+  bool ImportMoodFile(const QUrl& url, QByteArray* data);
 
  private:
-  QNetworkDiskCache* cache_;
+  std::unique_ptr<MoodbarStore> store_;
   QThread* thread_;
 
   const int kMaxActiveRequests;
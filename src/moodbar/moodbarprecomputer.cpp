@@ -0,0 +1,328 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "config.h"
+
+#include <functional>
+
+#include <QObject>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+#include <QList>
+#include <QMap>
+#include <QByteArray>
+#include <QUrl>
+#include <QSettings>
+
+#include "core/application.h"
+#include "core/logging.h"
+#include "core/song.h"
+#include "core/taskmanager.h"
+#include "core/utilities.h"
+#include "collection/collectionbackend.h"
+#include "engine/analysispipeline.h"
+#include "settings/moodbarsettingspage.h"
+
+#include "moodbarconsumer.h"
+#include "moodbarloader.h"
+#include "moodbarprecomputer.h"
+
+const char* MoodbarPrecomputer::kSettingsPrecompute = "precompute";
+const char* MoodbarPrecomputer::kSettingsLastId = "precompute_last_id";
+
+const int MoodbarPrecomputer::kBatchSize = 100;
+const int MoodbarPrecomputer::kStartDelayMsec = 30000;
+const int MoodbarPrecomputer::kIntervalMsec = 250;
+const int MoodbarPrecomputer::kTimeoutSecs = 300;
+
+MoodbarPrecomputer::MoodbarPrecomputer(Application* app, QObject* parent)
+    : QObject(parent),
+      app_(app),
+      timer_(new QTimer(this)),
+      batch_watcher_(nullptr),
+      analysis_watcher_(nullptr),
+      enabled_(false),
+      task_id_(-1),
+      last_id_(0),
+      current_id_(0),
+      walk_finished_(false),
+      done_(0),
+      total_(0) {
+
+  thread_pool_.setMaxThreadCount(1);
+
+  timer_->setSingleShot(true);
+  connect(timer_, SIGNAL(timeout()), SLOT(ProcessNext()));
+
+  connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
+  connect(app_->task_manager(), SIGNAL(TasksChanged()), SLOT(TasksChanged()));
+
+  ReloadSettings();
+
+}
+
+MoodbarPrecomputer::~MoodbarPrecomputer() {
+
+  if (batch_watcher_) batch_watcher_->waitForFinished();
+  Stop();
+
+}
+
+void MoodbarPrecomputer::ReloadSettings() {
+
+  QSettings s;
+  s.beginGroup(MoodbarSettingsPage::kSettingsGroup);
+  const bool enabled = s.value("enabled", false).toBool() && s.value(kSettingsPrecompute, false).toBool();
+  const int last_id = s.value(kSettingsLastId, 0).toInt();
+  s.endGroup();
+
+  if (enabled == enabled_) return;
+  enabled_ = enabled;
+
+  if (enabled_) {
+    // Give the collection and the playlists time to load first.
+    last_id_ = last_id;
+    walk_finished_ = false;
+    timer_->start(kStartDelayMsec);
+  }
+  else {
+    Stop();
+  }
+
+}
+
+void MoodbarPrecomputer::SongsDiscovered(const SongList& songs) {
+
+  if (!enabled_) return;
+
+  // New songs come after the last one that was done, songs that changed have to be done again.
+  bool found = false;
+  for (const Song& song : songs) {
+    if (song.url().scheme() != "file") continue;
+    if (song.id() <= last_id_ && !rescanned_.contains(song.url())) rescanned_ << song.url();
+    found = true;
+  }
+  if (!found) return;
+
+  walk_finished_ = false;
+  if (task_id_ == -1 && !timer_->isActive()) timer_->start(kStartDelayMsec);
+
+}
+
+void MoodbarPrecomputer::TasksChanged() {
+
+  // Pick up where we left off once the other tasks are done.
+  // This also starts the precompute if other tasks were still running when the start delay ran out.
+  if (enabled_ && !analysis_watcher_ && !batch_watcher_ && !timer_->isActive() && HasWork() && !OtherTasksRunning()) {
+    timer_->start(kIntervalMsec);
+  }
+
+}
+
+bool MoodbarPrecomputer::OtherTasksRunning() {
+
+  for (const TaskManager::Task& task : app_->task_manager()->GetTasks()) {
+    if (task.id != task_id_) return true;
+  }
+  return false;
+
+}
+
+bool MoodbarPrecomputer::HasWork() const {
+
+  return task_id_ != -1 || !walk_finished_ || !rescanned_.isEmpty();
+
+}
+
+void MoodbarPrecomputer::Start() {
+
+  if (task_id_ != -1) return;
+
+  done_ = 0;
+  total_ = rescanned_.count();
+  task_id_ = app_->task_manager()->StartTask(tr("Creating moodbars"));
+
+}
+
+void MoodbarPrecomputer::Stop() {
+
+  timer_->stop();
+  batch_.clear();
+  rescanned_.clear();
+  SaveLastId();
+
+  if (task_id_ != -1) {
+    app_->task_manager()->SetTaskFinished(task_id_);
+    task_id_ = -1;
+  }
+
+}
+
+MoodbarPrecomputer::Batch MoodbarPrecomputer::LoadBatch(CollectionBackend* backend, const int id, const bool walk, const QList<QUrl>& rescanned) {
+
+  Batch batch;
+
+  for (const QUrl& url : rescanned) {
+    Item item;
+    item.url = url;
+    batch.items << item;
+  }
+
+  if (walk) {
+    const QMap<int, QUrl> urls = backend->GetSongUrlsAfterId(id, kBatchSize);
+    for (QMap<int, QUrl>::const_iterator it = urls.begin(); it != urls.end(); ++it) {
+      Item item;
+      item.id = it.key();
+      item.url = it.value();
+      batch.items << item;
+    }
+    batch.walk_finished = urls.isEmpty();
+    batch.remaining = backend->GetSongCountAfterId(id) - urls.count();
+  }
+
+  // A mood file next to a rescanned song might have been saved for the old contents.
+  for (Item& item : batch.items) {
+    if (item.id != 0 && item.url.scheme() == "file") item.mood_data = MoodbarLoader::ReadMoodFile(item.url);
+  }
+
+  return batch;
+
+}
+
+void MoodbarPrecomputer::ProcessNext() {
+
+  if (!enabled_ || analysis_watcher_ || batch_watcher_) return;
+
+  // Don't compete with collection scans or anything else the user is waiting for.
+  if (OtherTasksRunning()) return;
+
+  if (!HasWork()) return;
+
+  Start();
+
+  MoodbarLoader* loader = app_->moodbar_loader();
+
+  while (!batch_.isEmpty()) {
+    const Item item = batch_.takeFirst();
+
+    ++done_;
+    app_->task_manager()->SetTaskProgress(task_id_, done_, total_);
+
+    // The stored moodbar of a rescanned song is for the old contents, it's replaced.
+    if (item.url.scheme() == "file" && (item.id == 0 || !loader->IsStored(item.url))) {
+      if (!item.mood_data.isEmpty()) {
+        loader->Import(item.url, item.mood_data);
+      }
+      else {
+        current_id_ = item.id;
+        current_url_ = item.url;
+        qLog(Info) << "Creating moodbar data for" << item.url.toLocalFile();
+        analysis_watcher_ = new QFutureWatcher<QByteArray>(this);
+        connect(analysis_watcher_, SIGNAL(finished()), SLOT(AnalysisFinished()));
+        analysis_watcher_->setFuture(QtConcurrent::run(&thread_pool_, &MoodbarPrecomputer::Analyse, item.url));
+        return;
+      }
+    }
+
+    last_id_ = qMax(last_id_, item.id);
+  }
+
+  // Saved once per batch, writing the settings for every song would slow down the GUI thread.
+  SaveLastId();
+
+  if (walk_finished_ && rescanned_.isEmpty()) {
+    qLog(Info) << "Finished creating moodbars for the collection";
+    Stop();
+    return;
+  }
+
+  batch_watcher_ = new QFutureWatcher<Batch>(this);
+  connect(batch_watcher_, SIGNAL(finished()), SLOT(BatchLoaded()));
+  batch_watcher_->setFuture(QtConcurrent::run(&MoodbarPrecomputer::LoadBatch, app_->collection_backend(), last_id_, !walk_finished_, rescanned_));
+  rescanned_.clear();
+
+}
+
+void MoodbarPrecomputer::BatchLoaded() {
+
+  const Batch batch = batch_watcher_->result();
+  batch_watcher_->deleteLater();
+  batch_watcher_ = nullptr;
+
+  if (task_id_ == -1) return;
+
+  batch_ = batch.items;
+  if (batch.walk_finished) walk_finished_ = true;
+  total_ = done_ + batch_.count() + rescanned_.count() + batch.remaining;
+
+  ProcessNext();
+
+}
+
+QByteArray MoodbarPrecomputer::Analyse(const QUrl& url) {
+
+  // The threads GStreamer starts for the pipeline inherit the priorities.
+  QThread::currentThread()->setPriority(QThread::IdlePriority);
+  Utilities::SetThreadIOPriority(Utilities::IOPRIO_CLASS_IDLE);
+
+  AnalysisPipeline pipeline(url);
+  MoodbarConsumer moodbar;
+  pipeline.AddConsumer(&moodbar);
+  pipeline.Run(kTimeoutSecs * GST_SECOND);
+
+  if (!moodbar.success()) return QByteArray();
+  return moodbar.data();
+
+}
+
+void MoodbarPrecomputer::AnalysisFinished() {
+
+  const QByteArray data = analysis_watcher_->result();
+  analysis_watcher_->deleteLater();
+  analysis_watcher_ = nullptr;
+
+  // Stored like the moodbars the loader creates, and saved next to the song if that's enabled.
+  if (data.isEmpty()) {
+    qLog(Warning) << "Failed to create moodbar data for" << current_url_.toLocalFile();
+  }
+  else if (enabled_) {
+    app_->moodbar_loader()->Save(current_url_, data);
+  }
+
+  last_id_ = qMax(last_id_, current_id_);
+  current_id_ = 0;
+  current_url_.clear();
+
+  if (task_id_ != -1) timer_->start(kIntervalMsec);
+
+}
+
+void MoodbarPrecomputer::SaveLastId() {
+
+  QSettings s;
+  s.beginGroup(MoodbarSettingsPage::kSettingsGroup);
+  s.setValue(kSettingsLastId, last_id_);
+  s.endGroup();
+
+}
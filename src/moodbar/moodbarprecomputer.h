@@ -0,0 +1,121 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef MOODBARPRECOMPUTER_H
+#define MOODBARPRECOMPUTER_H
+
+#include "config.h"
+
+#include <QObject>
+#include <QThreadPool>
+#include <QList>
+#include <QMap>
+#include <QByteArray>
+#include <QUrl>
+
+#include "core/song.h"
+
+class QTimer;
+template <typename T> class QFutureWatcher;
+class Application;
+class CollectionBackend;
+
+// Walks the collection in the background and creates the moodbars that are missing, one song at a time,
+// so the playlist doesn't have to start a pipeline for every row it paints.
+// The songs are decoded in an analysis pipeline, like the loudness scan does.
+// It yields to every other running task and remembers how far it got, so it continues where it left off after a restart.
+class MoodbarPrecomputer : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit MoodbarPrecomputer(Application* app, QObject* parent = nullptr);
+  ~MoodbarPrecomputer() override;
+
+  static const char* kSettingsPrecompute;
+  static const char* kSettingsLastId;
+
+ public slots:
+  void SongsDiscovered(const SongList& songs);
+
+ private slots:
+  void ReloadSettings();
+  void TasksChanged();
+  void ProcessNext();
+  void BatchLoaded();
+  void AnalysisFinished();
+
+ private:
+  struct Item {
+    Item() : id(0) {}
+    // ROWID of the song, 0 for songs that were rescanned.
+    int id;
+    QUrl url;
+    // The mood file found next to the song.
+    QByteArray mood_data;
+  };
+
+  struct Batch {
+    Batch() : remaining(0), walk_finished(false) {}
+    QList<Item> items;
+    int remaining;
+    bool walk_finished;
+  };
+
+  static const int kBatchSize;
+  static const int kStartDelayMsec;
+  static const int kIntervalMsec;
+  static const int kTimeoutSecs;
+
+  // Also looks for mood files, so the GUI thread doesn't have to touch the file system for every song.
+  static Batch LoadBatch(CollectionBackend* backend, const int id, const bool walk, const QList<QUrl>& rescanned);
+  // Runs in the idle priority thread, returns the moodbar data or nothing if the file couldn't be decoded.
+  static QByteArray Analyse(const QUrl& url);
+
+  void Start();
+  void Stop();
+  bool OtherTasksRunning();
+  bool HasWork() const;
+  void SaveLastId();
+
+ private:
+  Application* app_;
+  QTimer* timer_;
+  QFutureWatcher<Batch>* batch_watcher_;
+  QFutureWatcher<QByteArray>* analysis_watcher_;
+  // A thread of its own, its CPU and I/O priorities are lowered.
+  QThreadPool thread_pool_;
+
+  bool enabled_;
+  int task_id_;
+
+  // ROWID of the last song in the collection that was done.
+  int last_id_;
+  // The song being analysed, its ROWID is 0 for songs that were rescanned.
+  int current_id_;
+  QUrl current_url_;
+  bool walk_finished_;
+  int done_;
+  int total_;
+
+  QList<Item> batch_;
+  QList<QUrl> rescanned_;
+};
+
+#endif  // MOODBARPRECOMPUTER_H
@@ -0,0 +1,245 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "config.h"
+
+#include <cstring>
+
+#include <QtGlobal>
+#include <QIODevice>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+#include <QCryptographicHash>
+
+#include "core/logging.h"
+
+#include "moodbarstore.h"
+
+const qint64 MoodbarStore::kDefaultDataSize = 60 * 1024 * 1024;  // 60MB - enough for 20,000 moodbars
+const char MoodbarStore::kMagic[8] = { 'S', 'M', 'O', 'O', 'D', 'B', 'A', 'R' };
+const quint32 MoodbarStore::kVersion = 1;
+const int MoodbarStore::kMaxProbes = 16;
+
+MoodbarStore::MoodbarStore(const QString& filename, const qint64 data_size)
+    : file_(filename),
+      data_size_(data_size),
+      map_(nullptr),
+      header_(nullptr),
+      slots_(nullptr),
+      data_(nullptr) {}
+
+MoodbarStore::~MoodbarStore() {
+  Close();
+}
+
+quint32 MoodbarStore::SlotCount(const qint64 data_size) {
+
+  // A moodbar is about 3KB, this keeps the table less than half full.
+  quint32 count = 256;
+  while (count < data_size / 1024 && count < (1U << 30)) count <<= 1;
+  return count;
+
+}
+
+qint64 MoodbarStore::FileSize() const {
+  return sizeof(Header) + SlotCount(data_size_) * sizeof(Slot) + data_size_;
+}
+
+bool MoodbarStore::Open() {
+
+  if (is_open()) return true;
+
+  QDir().mkpath(QFileInfo(file_.fileName()).path());
+
+  if (!file_.open(QIODevice::ReadWrite)) {
+    qLog(Error) << "Failed to open moodbar store" << file_.fileName() << file_.errorString();
+    return false;
+  }
+
+  bool valid = file_.size() == FileSize();
+  if (valid) {
+    Header header;
+    valid = file_.read(reinterpret_cast<char*>(&header), sizeof(header)) == sizeof(header) &&
+            memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+            header.version == kVersion &&
+            header.slot_count == SlotCount(data_size_) &&
+            header.data_size == static_cast<quint64>(data_size_);
+  }
+
+  if (!valid) {
+    qLog(Info) << "Creating moodbar store" << file_.fileName();
+    // Resizing fills the file with zeros, which is an empty index.
+    if (!file_.resize(0) || !file_.resize(FileSize())) {
+      qLog(Error) << "Failed to create moodbar store" << file_.fileName() << file_.errorString();
+      file_.close();
+      return false;
+    }
+  }
+
+  map_ = file_.map(0, FileSize());
+  if (!map_) {
+    qLog(Error) << "Failed to map moodbar store" << file_.fileName() << file_.errorString();
+    file_.close();
+    return false;
+  }
+
+  header_ = reinterpret_cast<Header*>(map_);
+  slots_ = reinterpret_cast<Slot*>(map_ + sizeof(Header));
+  data_ = map_ + sizeof(Header) + SlotCount(data_size_) * sizeof(Slot);
+
+  if (!valid) Initialize();
+
+  return true;
+
+}
+
+void MoodbarStore::Close() {
+
+  if (map_) {
+    file_.unmap(map_);
+    map_ = nullptr;
+    header_ = nullptr;
+    slots_ = nullptr;
+    data_ = nullptr;
+  }
+
+  file_.close();
+
+}
+
+bool MoodbarStore::Initialize() {
+
+  memset(header_, 0, sizeof(Header));
+  memcpy(header_->magic, kMagic, sizeof(kMagic));
+  header_->version = kVersion;
+  header_->slot_count = SlotCount(data_size_);
+  header_->data_size = data_size_;
+  header_->write_pos = 0;
+
+  return true;
+
+}
+
+void MoodbarStore::Clear() {
+
+  if (!is_open()) return;
+
+  memset(slots_, 0, header_->slot_count * sizeof(Slot));
+  header_->write_pos = 0;
+
+}
+
+quint64 MoodbarStore::Key(const QUrl& url) {
+
+  const QByteArray hash = QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Md5);
+  quint64 key = 0;
+  memcpy(&key, hash.constData(), sizeof(key));
+
+  // 0 marks an empty slot.
+  return key == 0 ? 1 : key;
+
+}
+
+bool MoodbarStore::IsValid(const Slot& slot) const {
+
+  // The file might be damaged, a slot must never point outside the data area.
+  if (slot.key == 0 || slot.size == 0 || slot.pos % data_size_ + slot.size > static_cast<quint64>(data_size_)) return false;
+
+  // Still there unless the write position went all the way around the data area since the moodbar was written.
+  const quint64 write_pos = header_->write_pos;
+  return slot.pos + slot.size <= write_pos && write_pos <= slot.pos + data_size_;
+
+}
+
+const MoodbarStore::Slot* MoodbarStore::Find(const quint64 key) const {
+
+  const quint32 mask = header_->slot_count - 1;
+  for (int i = 0; i < kMaxProbes; ++i) {
+    const Slot& slot = slots_[(key + i) & mask];
+    if (slot.key == 0) return nullptr;
+    if (slot.key == key) return IsValid(slot) ? &slot : nullptr;
+  }
+
+  return nullptr;
+
+}
+
+bool MoodbarStore::Contains(const QUrl& url) const {
+
+  if (!is_open()) return false;
+
+  return Find(Key(url)) != nullptr;
+
+}
+
+QByteArray MoodbarStore::Get(const QUrl& url) const {
+
+  if (!is_open()) return QByteArray();
+
+  const Slot* slot = Find(Key(url));
+  if (!slot) return QByteArray();
+
+  return QByteArray(reinterpret_cast<const char*>(data_ + slot->pos % data_size_), slot->size);
+
+}
+
+bool MoodbarStore::Insert(const QUrl& url, const QByteArray& data) {
+
+  if (!is_open() || data.isEmpty() || data.size() > data_size_) return false;
+
+  const quint64 key = Key(url);
+  const quint32 mask = header_->slot_count - 1;
+
+  // Use the slot that has this key already, otherwise the first empty one or one with a moodbar that was overwritten.
+  Slot* target = nullptr;
+  for (int i = 0; i < kMaxProbes; ++i) {
+    Slot* slot = &slots_[(key + i) & mask];
+    if (slot->key == key) {
+      target = slot;
+      break;
+    }
+    if (!target && (slot->key == 0 || !IsValid(*slot))) target = slot;
+    if (slot->key == 0) break;
+  }
+  // Everything around is still valid, replace the moodbar in the first slot.
+  if (!target) target = &slots_[key & mask];
+
+  // Moodbars are never split at the end of the data area.
+  const quint64 size = data.size();
+  quint64 pos = header_->write_pos;
+  if (pos % data_size_ + size > static_cast<quint64>(data_size_)) {
+    pos += data_size_ - pos % data_size_;
+  }
+
+  // Move the write position first, so the moodbars that are overwritten are no longer valid.
+  header_->write_pos = pos + size;
+  memcpy(data_ + pos % data_size_, data.constData(), size);
+
+  target->pos = pos;
+  target->size = static_cast<quint32>(size);
+  target->key = key;
+
+  return true;
+
+}
@@ -0,0 +1,102 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef MOODBARSTORE_H
+#define MOODBARSTORE_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+
+// Keeps the moodbar data for all songs in one memory mapped file.
+// The file has a fixed size index, a hash table keyed by a hash of the song URL, and a data area that is used as a ring:
+// when it is full the oldest moodbars are overwritten, so the file never grows beyond the size it was created with.
+// Looking up a moodbar is a hash table probe in mapped memory, without opening any files.
+// Not thread safe.
+class MoodbarStore {
+ public:
+  explicit MoodbarStore(const QString& filename, const qint64 data_size = kDefaultDataSize);
+  ~MoodbarStore();
+
+  static const qint64 kDefaultDataSize;
+
+  // Opens the store, creating it if the file is missing or was created with a different size.
+  bool Open();
+  void Close();
+  bool is_open() const { return map_ != nullptr; }
+
+  QString filename() const { return file_.fileName(); }
+  qint64 data_size() const { return data_size_; }
+
+  bool Contains(const QUrl& url) const;
+  // Returns a null QByteArray if there is no moodbar for the URL.
+  QByteArray Get(const QUrl& url) const;
+  bool Insert(const QUrl& url, const QByteArray& data);
+
+  void Clear();
+
+  static quint64 Key(const QUrl& url);
+
+ private:
+  struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 slot_count;
+    quint64 data_size;
+    // Total number of bytes written, the position in the data area is write_pos % data_size.
+    quint64 write_pos;
+    quint64 reserved[4];
+  };
+
+  struct Slot {
+    quint64 key;
+    quint64 pos;
+    quint32 size;
+    quint32 reserved;
+  };
+
+  static const char kMagic[8];
+  static const quint32 kVersion;
+  static const int kMaxProbes;
+
+  static quint32 SlotCount(const qint64 data_size);
+  qint64 FileSize() const;
+
+  bool Initialize();
+  bool IsValid(const Slot& slot) const;
+  const Slot* Find(const quint64 key) const;
+
+ private:
+  QFile file_;
+  qint64 data_size_;
+
+  uchar* map_;
+  Header* header_;
+  Slot* slots_;
+  uchar* data_;
+
+  Q_DISABLE_COPY(MoodbarStore)
+};
+
+#endif  // MOODBARSTORE_H
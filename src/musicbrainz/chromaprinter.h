@@ -23,18 +23,17 @@
 
 #include "config.h"
 
-#include <glib.h>
-#include <gst/gst.h>
-#include <gst/app/gstappsink.h>
-
-#include <QBuffer>
+#include <QByteArray>
 #include <QString>
 
-class Chromaprinter {
+#include "engine/analysispipeline.h"
+
+class Chromaprinter : public AnalysisPcmConsumer {
   // Creates a Chromaprint fingerprint from a song.
   // Uses GStreamer to open and decode the file as PCM data and passes this to Chromaprint's code generator.
   // The generated code can be used to identify a song via Acoustid.
   // You should create one Chromaprinter for each file you want to fingerprint.
+  // It can also be added to an AnalysisPipeline together with other analyzers, so the file is only decoded once.
   // This class works well with QtConcurrentMap.
 
  public:
@@ -45,18 +44,19 @@ class Chromaprinter {
   // Returns an empty string if no fingerprint could be created.
   QString CreateFingerprint();
 
- private:
-  GstElement *CreateElement(const QString &factory_name, GstElement *bin = nullptr);
+  // The fingerprint after the pipeline finished.
+  QString fingerprint() const { return fingerprint_; }
 
-  static void NewPadCallback(GstElement*, GstPad *pad, gpointer data);
-  static GstFlowReturn NewBufferCallback(GstAppSink *app_sink, gpointer self);
+  void Finish(const bool success) override;
+
+ protected:
+  void ProcessSamples(const char *data, const int size) override;
 
  private:
   QString filename_;
 
-  GstElement *convert_element_;
-
-  QBuffer buffer_;
+  QByteArray samples_;
+  QString fingerprint_;
 
 };
 
@@ -75,6 +75,7 @@
 #include "playlistitem.h"
 #include "playlistview.h"
 #include "playlistsequence.h"
+#include "playlistsorter.h"
 #include "playlistbackend.h"
 #include "playlistfilter.h"
 #include "playlistitemmimedata.h"
@@ -108,9 +109,12 @@ const char *Playlist::kSettingsGroup = "Playlist";
 
 const char *Playlist::kPathType = "path_type";
 const char *Playlist::kWriteMetadata = "write_metadata";
+const char *Playlist::kUndoMemoryLimit = "undo_memory_limit";
 
 const int Playlist::kUndoStackSize = 20;
 const int Playlist::kUndoItemLimit = 500;
+const int Playlist::kUndoMemoryLimitDefault = 16;
+const int Playlist::kRestorePageSize = 1000;
 
 const qint64 Playlist::kMinScrobblePointNsecs = 31ll * kNsecPerSec;
 const qint64 Playlist::kMaxScrobblePointNsecs = 240ll * kNsecPerSec;
@@ -133,6 +137,9 @@ Playlist::Playlist(PlaylistBackend *backend, TaskManager *task_manager, Collecti
       undo_stack_(new QUndoStack(this)),
       special_type_(special_type),
       cancel_restore_(false),
+      restore_started_(false),
+      is_restoring_(false),
+      restore_row_(0),
       scrobbled_(false),
       scrobble_point_(-1),
       editing_(-1),
@@ -146,7 +153,14 @@ Playlist::Playlist(PlaylistBackend *backend, TaskManager *task_manager, Collecti
   connect(this, SIGNAL(rowsInserted(QModelIndex, int, int)), SIGNAL(PlaylistChanged()));
   connect(this, SIGNAL(rowsRemoved(QModelIndex, int, int)), SIGNAL(PlaylistChanged()));
 
-  Restore();
+  connect(this, SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(ItemsChangedForSave()));
+  connect(this, SIGNAL(rowsRemoved(QModelIndex, int, int)), SLOT(ItemsChangedForSave()));
+  connect(this, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), SLOT(ItemsChangedForSave()));
+  connect(this, SIGNAL(layoutChanged()), SLOT(ItemsChangedForSave()));
+  connect(this, SIGNAL(modelReset()), SLOT(ItemsChangedForSave()));
+
+  connect(this, SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(RowsInsertedWhileRestoring(QModelIndex, int, int)));
+  connect(this, SIGNAL(rowsRemoved(QModelIndex, int, int)), SLOT(RowsRemovedWhileRestoring(QModelIndex, int, int)));
 
   proxy_->setSourceModel(this);
   queue_->setSourceModel(this);
@@ -160,6 +174,8 @@ Playlist::Playlist(PlaylistBackend *backend, TaskManager *task_manager, Collecti
 
   column_alignments_ = PlaylistView::DefaultColumnAlignment();
 
+  if (backend_) connect(backend_, SIGNAL(PlaylistSaveFailed(int)), SLOT(SaveFailed(int)));
+
 }
 
 Playlist::~Playlist() {
@@ -287,7 +303,7 @@ QVariant Playlist::data(const QModelIndex &idx, int role) const {
       PlaylistItemPtr item = items_[idx.row()];
       Song song = item->Metadata();
 
-      // Don't forget to change Playlist::CompareItems when adding new columns
+      // Don't forget to change PlaylistSorter when adding new columns
       switch (idx.column()) {
         case Column_Title:              return song.PrettyTitle();
         case Column_Artist:             return song.artist();
@@ -424,6 +440,7 @@ void Playlist::ItemReloadComplete(const QPersistentModelIndex &idx) {
     if (item && item->HasTemporaryMetadata()) {  // Update temporary metadata.
       item->UpdateTemporaryMetadata(item->OriginalMetadata());
     }
+    save_state_.MetadataChanged(item);
 
     emit dataChanged(idx, idx);
     emit EditingFinished(idx);
@@ -963,6 +980,9 @@ void Playlist::InsertItems(const PlaylistItemList &itemsIn, const int pos, const
   if (itemsIn.isEmpty())
     return;
 
+  // The items are added after the ones that were saved.
+  Restore();
+
   PlaylistItemList items = itemsIn;
 
   // exercise vetoes
@@ -1149,6 +1169,7 @@ void Playlist::UpdateItems(SongList songs) {
       }
     }
   }
+  save_state_.ItemsChanged();
   Save();
 
 }
@@ -1190,72 +1211,6 @@ QMimeData *Playlist::mimeData(const QModelIndexList &indexes) const {
 
 }
 
-bool Playlist::CompareItems(const int column, const Qt::SortOrder order, std::shared_ptr<PlaylistItem> _a, std::shared_ptr<PlaylistItem> _b) {
-
-  std::shared_ptr<PlaylistItem> a = order == Qt::AscendingOrder ? _a : _b;
-  std::shared_ptr<PlaylistItem> b = order == Qt::AscendingOrder ? _b : _a;
-
-#define cmp(field) return a->Metadata().field() < b->Metadata().field()
-#define strcmp(field) return QString::localeAwareCompare(a->Metadata().field().toLower(), b->Metadata().field().toLower()) < 0;
-
-  switch (column) {
-
-    case Column_Title:        strcmp(title_sortable);
-    case Column_Artist:       strcmp(artist_sortable);
-    case Column_Album:        strcmp(album_sortable);
-    case Column_Length:       cmp(length_nanosec);
-    case Column_Track:        cmp(track);
-    case Column_Disc:         cmp(disc);
-    case Column_Year:         cmp(year);
-    case Column_OriginalYear: cmp(originalyear);
-    case Column_Genre:        strcmp(genre);
-    case Column_AlbumArtist:  strcmp(playlist_albumartist_sortable);
-    case Column_Composer:     strcmp(composer);
-    case Column_Performer:    strcmp(performer);
-    case Column_Grouping:     strcmp(grouping);
-
-    case Column_PlayCount:    cmp(playcount);
-    case Column_SkipCount:    cmp(skipcount);
-    case Column_LastPlayed:   cmp(lastplayed);
-
-    case Column_Bitrate:      cmp(bitrate);
-    case Column_Samplerate:   cmp(samplerate);
-    case Column_Bitdepth:     cmp(bitdepth);
-    case Column_Filename:
-      return (QString::localeAwareCompare(a->Url().path().toLower(), b->Url().path().toLower()) < 0);
-    case Column_BaseFilename: cmp(basefilename);
-    case Column_Filesize:     cmp(filesize);
-    case Column_Filetype:     cmp(filetype);
-    case Column_DateModified: cmp(mtime);
-    case Column_DateCreated:  cmp(ctime);
-
-    case Column_Comment:      strcmp(comment);
-    case Column_Source:       cmp(source);
-
-    case Column_Rating:       cmp(rating);
-
-    default: qLog(Error) << "No such column" << column;
-  }
-
-#undef cmp
-#undef strcmp
-
-  return false;
-
-}
-
-bool Playlist::ComparePathDepths(const Qt::SortOrder order, std::shared_ptr<PlaylistItem> _a, std::shared_ptr<PlaylistItem> _b) {
-
-  std::shared_ptr<PlaylistItem> a = order == Qt::AscendingOrder ? _a : _b;
-  std::shared_ptr<PlaylistItem> b = order == Qt::AscendingOrder ? _b : _a;
-
-  int a_dir_level = a->Url().path().count('/');
-  int b_dir_level = b->Url().path().count('/');
-
-  return a_dir_level < b_dir_level;
-
-}
-
 QString Playlist::column_name(Column column) {
 
   switch (column) {
@@ -1328,24 +1283,42 @@ void Playlist::sort(int column, Qt::SortOrder order) {
   if (dynamic_playlist_ && current_item_index_.isValid())
     begin += current_item_index_.row() + 1;
 
-  if (column == Column_Album) {
-    // When sorting by album, also take into account discs and tracks.
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Track, order, _1, _2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Disc, order, _1, _2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Album, order, _1, _2));
-  }
-  else if (column == Column_Filename) {
-    // When sorting by full paths we also expect a hierarchical order. This returns a breath-first ordering of paths.
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Filename, order, _1, _2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::ComparePathDepths, order, _1, _2));
+  PlaylistSorter::Sort(begin, new_items.end(), column, order);
+
+  PushReOrder(new PlaylistUndoCommands::SortItems(this, column, order, new_items));
+
+  ReshuffleIndices();
+
+}
+
+void Playlist::PushReOrder(PlaylistUndoCommands::ReOrderItems *command) {
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  const qint64 limit = s.value(kUndoMemoryLimit, kUndoMemoryLimitDefault).toLongLong() * 1024 * 1024;
+  s.endGroup();
+
+  if (command->memory_usage() > limit) {
+    // Too big to keep in the undo stack. Also clear the stack because it might have been invalidated.
+    command->redo();
+    delete command;
+    undo_stack_->clear();
+    return;
   }
-  else {
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, column, order, _1, _2));
+
+  // The commands after the current index are dropped by the push.
+  qint64 usage = command->memory_usage();
+  for (int i = 0; i < undo_stack_->index(); ++i) {
+    const QUndoCommand *undo_command = undo_stack_->command(i);
+    if (undo_command->id() == PlaylistUndoCommands::Type_ReOrderItems) {
+      usage += static_cast<const PlaylistUndoCommands::ReOrderItems*>(undo_command)->memory_usage();
+    }
   }
 
-  undo_stack_->push(new PlaylistUndoCommands::SortItems(this, column, order, new_items));
+  // QUndoStack can't drop its oldest commands, so the history starts over instead of growing past the limit.
+  if (usage > limit) undo_stack_->clear();
 
-  ReshuffleIndices();
+  undo_stack_->push(command);
 
 }
 
@@ -1389,33 +1362,61 @@ void Playlist::SetCurrentIsPaused(const bool paused) {
     dataChanged(index(current_item_index_.row(), 0), index(current_item_index_.row(), ColumnCount - 1));
 }
 
-void Playlist::Save() const {
+void Playlist::Save() {
 
-  if (!backend_ || is_loading_) return;
+  // Until all the pages are restored, the rows that aren't loaded yet would look like they were removed.
+  if (!backend_ || is_loading_ || !restore_started_ || is_restoring_) return;
 
-  backend_->SavePlaylistAsync(id_, items_, last_played_row(), dynamic_playlist_);
+  backend_->SavePlaylistAsync(id_, save_state_.Update(items_), last_played_row(), dynamic_playlist_);
 
 }
 
-void Playlist::Restore() {
+void Playlist::SaveFailed(const int playlist) {
 
-  if (!backend_) return;
+  // None of the rows from the last save were stored, the next save has to rewrite them all.
+  if (playlist == id_) save_state_.Invalidate();
 
-  items_.clear();
-  virtual_items_.clear();
-  collection_items_by_id_.clear();
+}
 
+void Playlist::ItemsChangedForSave() {
+
+  save_state_.ItemsChanged();
+
+}
+
+void Playlist::Restore() {
+
+  // Playlists are restored when they are first shown or played, not all of them on startup.
+  if (!backend_ || restore_started_) return;
+
+  restore_started_ = true;
+  is_restoring_ = true;
+  restore_row_ = 0;
   cancel_restore_ = false;
-  QFuture<QList<PlaylistItemPtr>> future = QtConcurrent::run(std::bind(&PlaylistBackend::GetPlaylistItems, backend_, id_));
-  NewClosure(future, this, SLOT(ItemsLoaded(QFuture<PlaylistItemList>)), future);
+
+  // Items inserted before the playlist got restored are kept after the restored ones.
+  save_state_.Reset(PlaylistItemList(), QList<qint64>());
+
+  RestorePage(-1);
+
+}
+
+void Playlist::RestorePage(const qint64 after_position) {
+
+  QFuture<PlaylistBackend::PlaylistRows> future = QtConcurrent::run(std::bind(&PlaylistBackend::GetPlaylistRows, backend_, id_, after_position, kRestorePageSize));
+  NewClosure(future, this, SLOT(ItemsLoaded(QFuture<PlaylistBackend::PlaylistRows>)), future);
 
 }
 
-void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
+void Playlist::ItemsLoaded(QFuture<PlaylistBackend::PlaylistRows> future) {
 
   if (cancel_restore_) return;
 
-  PlaylistItemList items = future.result();
+  const PlaylistBackend::PlaylistRows rows = future.result();
+  PlaylistItemList items = rows.items;
+
+  // The rows of the items removed below are deleted when the playlist is saved after restoring.
+  save_state_.Append(rows.items, rows.positions);
 
   // Backend returns empty elements for collection items which it couldn't match (because they got deleted); we don't need those
   QMutableListIterator<PlaylistItemPtr> it(items);
@@ -1427,9 +1428,28 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
     }
   }
 
+  // Each page is shown as soon as it's loaded, restoring isn't something that can be undone.
+  restore_row_ = qMin(restore_row_, rowCount());
   is_loading_ = true;
-  InsertItems(items, 0);
+  InsertItemsWithoutUndo(items, restore_row_);
   is_loading_ = false;
+  restore_row_ += items.count();
+
+  // Commands pushed while restoring refer to rows from before this page was inserted.
+  if (!items.isEmpty()) undo_stack_->clear();
+
+  if (rows.items.count() == kRestorePageSize) {
+    RestorePage(rows.positions.last());
+  }
+  else {
+    FinishRestore();
+  }
+
+}
+
+void Playlist::FinishRestore() {
+
+  is_restoring_ = false;
 
   PlaylistBackend::Playlist p = backend_->GetPlaylist(id_);
 
@@ -1466,6 +1486,21 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
 
   emit PlaylistLoaded();
 
+  // Saves the items added while restoring, and removes the rows of deleted collection items.
+  Save();
+
+}
+
+void Playlist::RowsInsertedWhileRestoring(const QModelIndex&, const int begin, const int end) {
+
+  if (is_restoring_ && !is_loading_ && begin < restore_row_) restore_row_ += end - begin + 1;
+
+}
+
+void Playlist::RowsRemovedWhileRestoring(const QModelIndex&, const int begin, const int end) {
+
+  if (is_restoring_ && !is_loading_ && begin < restore_row_) restore_row_ -= qMin(end, restore_row_ - 1) - begin + 1;
+
 }
 
 static bool DescendingIntLessThan(int a, int b) { return a > b; }
@@ -1660,6 +1695,12 @@ void Playlist::Clear() {
 
   // If loading songs from session restore async, don't insert them
   cancel_restore_ = true;
+  if (is_restoring_) {
+    // The pages that aren't loaded yet are still in the database, they are replaced by the items below.
+    is_restoring_ = false;
+    save_state_.Invalidate();
+  }
+  restore_started_ = true;
 
   const int count = items_.count();
 
@@ -1733,6 +1774,7 @@ void Playlist::ReloadItems(const QList<int> &rows) {
     Song old_metadata = item->Metadata();
 
     item->Reload();
+    save_state_.MetadataChanged(item);
 
     if (row == current_row()) {
       const bool minor = old_metadata.title() == item->Metadata().title() &&
@@ -1785,7 +1827,7 @@ void Playlist::Shuffle() {
     std::swap(new_items[i], new_items[new_pos]);
   }
 
-  undo_stack_->push(new PlaylistUndoCommands::ShuffleItems(this, new_items));
+  PushReOrder(new PlaylistUndoCommands::ShuffleItems(this, new_items));
 
 }
 
@@ -1949,6 +1991,7 @@ void Playlist::ItemChanged(const int row) {
 
   QModelIndex idx = index(row, ColumnCount - 1);
   if (idx.isValid()) {
+    save_state_.MetadataChanged(items_[row]);
     emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
   }
 
@@ -1964,6 +2007,23 @@ void Playlist::ItemChanged(PlaylistItemPtr item) {
 
 }
 
+bool Playlist::ItemsChanged(const PlaylistItemList &items) {
+
+  QSet<PlaylistItem*> changed;
+  for (const PlaylistItemPtr &item : items) changed.insert(item.get());
+
+  bool found = false;
+  for (int row = 0; row < items_.count(); ++row) {
+    if (changed.contains(items_[row].get())) {
+      ItemChanged(row);
+      found = true;
+    }
+  }
+
+  return found;
+
+}
+
 void Playlist::InformOfCurrentSongChange(const AutoScroll autoscroll, const bool minor) {
 
   // if the song is invalid, we won't play it - there's no point in informing anybody about the change
@@ -2171,6 +2231,7 @@ void Playlist::AlbumCoverLoaded(const Song &song, const AlbumCoverLoaderResult &
     if (item && item->Metadata() == song && (!item->Metadata().art_manual_is_valid() || (result.type == AlbumCoverLoaderResult::Type_ManuallyUnset && !item->Metadata().has_manually_unset_cover()))) {
       qLog(Debug) << "Updating art manual for local song" << song.title() << song.album() << song.title() << "to" << result.cover_url << "in playlist.";
       item->SetArtManual(result.cover_url);
+      save_state_.MetadataChanged(item);
       Save();
     }
   }
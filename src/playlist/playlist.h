@@ -45,6 +45,8 @@
 #include "core/tagreaderclient.h"
 #include "covermanager/albumcoverloaderresult.h"
 #include "playlistitem.h"
+#include "playlistbackend.h"
+#include "playlistsavestate.h"
 #include "playlistsequence.h"
 #include "smartplaylists/playlistgenerator_fwd.h"
 
@@ -168,14 +170,17 @@ class Playlist : public QAbstractListModel {
 
   static const char *kPathType;
   static const char *kWriteMetadata;
+  static const char *kUndoMemoryLimit;
 
   static const int kUndoStackSize;
   static const int kUndoItemLimit;
+  // In MB
+  static const int kUndoMemoryLimitDefault;
+  static const int kRestorePageSize;
 
   static const qint64 kMinScrobblePointNsecs;
   static const qint64 kMaxScrobblePointNsecs;
 
-  static bool CompareItems(const int column, const Qt::SortOrder order, PlaylistItemPtr a, PlaylistItemPtr b);
 
   static QString column_name(Column column);
   static QString abbreviated_column_name(Column column);
@@ -184,8 +189,11 @@ class Playlist : public QAbstractListModel {
   static bool set_column_value(Song &song, Column column, const QVariant &value);
 
   // Persistence
-  void Save() const;
+  void Save();
+  // Loads the items from the database in pages, only the first time it's called.
   void Restore();
+  bool is_restoring() const { return is_restoring_; }
+  bool is_restored() const { return restore_started_ && !is_restoring_; }
 
   // Accessors
   QSortFilterProxyModel *proxy() const;
@@ -286,10 +294,11 @@ class Playlist : public QAbstractListModel {
   void sort(int column, Qt::SortOrder order) override;
   bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
 
-  static bool ComparePathDepths(Qt::SortOrder, PlaylistItemPtr, PlaylistItemPtr);
 
   void ItemChanged(PlaylistItemPtr item);
   void ItemChanged(const int row);
+  // Returns false if none of the items are in this playlist.
+  bool ItemsChanged(const PlaylistItemList &items);
 
   // Changes rating of a song to the given value asynchronously
   void RateSong(const QModelIndex &idx, const double rating);
@@ -368,6 +377,12 @@ class Playlist : public QAbstractListModel {
   void TurnOnDynamicPlaylist(PlaylistGeneratorPtr gen);
   void InsertDynamicItems(const int count);
 
+  // Pushes a sort or shuffle, keeping the memory used by the undo history within the limit.
+  void PushReOrder(PlaylistUndoCommands::ReOrderItems *command);
+
+  void RestorePage(const qint64 after_position);
+  void FinishRestore();
+
  private slots:
   void TracksAboutToBeDequeued(const QModelIndex&, const int begin, const int end);
   void TracksDequeued();
@@ -375,7 +390,11 @@ class Playlist : public QAbstractListModel {
   void QueueLayoutChanged();
   void SongSaveComplete(TagReaderReply *reply, const QPersistentModelIndex &index);
   void ItemReloadComplete(const QPersistentModelIndex &index);
-  void ItemsLoaded(QFuture<PlaylistItemList> future);
+  void ItemsLoaded(QFuture<PlaylistBackend::PlaylistRows> future);
+  void ItemsChangedForSave();
+  void SaveFailed(const int playlist);
+  void RowsInsertedWhileRestoring(const QModelIndex&, const int begin, const int end);
+  void RowsRemovedWhileRestoring(const QModelIndex&, const int begin, const int end);
   void SongInsertVetoListenerDestroyed();
   void AlbumCoverLoaded(const Song &song, const AlbumCoverLoaderResult &result);
 
@@ -395,6 +414,9 @@ class Playlist : public QAbstractListModel {
 
   PlaylistItemList items_;
 
+  // The rows in the database, so saving only writes what changed.
+  PlaylistSaveState save_state_;
+
   // Contains the indices into items_ in the order that they will be played.
   QList<int> virtual_items_;
 
@@ -424,6 +446,10 @@ class Playlist : public QAbstractListModel {
 
   // Cancel async restore if songs are already replaced
   bool cancel_restore_;
+  bool restore_started_;
+  bool is_restoring_;
+  // Where the next restored page goes, items added while restoring stay after the restored ones.
+  int restore_row_;
 
   bool scrobbled_;
   qint64 scrobble_point_;
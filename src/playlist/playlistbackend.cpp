@@ -35,6 +35,7 @@
 #include <QByteArray>
 #include <QHash>
 #include <QList>
+#include <QPair>
 #include <QVariant>
 #include <QString>
 #include <QStringBuilder>
@@ -173,7 +174,7 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
 
 }
 
-QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
+QSqlQuery PlaylistBackend::GetPlaylistQuery(int playlist, const qint64 after_position, const int limit) {
 
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
@@ -183,16 +184,22 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "       p.ROWID, " +
                   Song::JoinSpec("p") +
                   ","
-                  "       p.type"
+                  "       p.type,"
+                  "       p.position"
                   " FROM playlist_items AS p"
                   " LEFT JOIN songs"
                   "    ON p.collection_id = songs.ROWID"
-                  " WHERE p.playlist = :playlist";
+                  " WHERE p.playlist = :playlist"
+                  "   AND p.position > :position"
+                  " ORDER BY p.position"
+                  " LIMIT :limit";
   QSqlQuery q(db);
   // Forward iterations only may be faster
   q.setForwardOnly(true);
   q.prepare(query);
   q.bindValue(":playlist", playlist);
+  q.bindValue(":position", after_position);
+  q.bindValue(":limit", limit);
   q.exec();
 
   return q;
@@ -201,18 +208,30 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
 
 QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
 
-  QList<PlaylistItemPtr> playlistitems;
+  return GetPlaylistRows(playlist).items;
+
+}
+
+PlaylistBackend::PlaylistRows PlaylistBackend::GetPlaylistRows(int playlist, const qint64 after_position, const int limit) {
+
+  PlaylistRows rows;
 
   {
 
-    QSqlQuery q = GetPlaylistRows(playlist);
+    // Pages continue after the last position of the previous page, the index on the position finds it without skipping over the rows before.
+    QSqlQuery q = GetPlaylistQuery(playlist, after_position, limit);
     // Note that as this only accesses the query, not the db, we don't need the mutex.
-    if (db_->CheckErrors(q)) return QList<PlaylistItemPtr>();
+    if (db_->CheckErrors(q)) return PlaylistRows();
+
+    // The position comes after the type
+    const int position_column = (Song::kColumns.count() + 1) * kSongTableJoins + 1;
 
     // it's probable that we'll have a few songs associated with the same CUE so we're caching results of parsing CUEs
     std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
     while (q.next()) {
-      playlistitems << NewPlaylistItemFromQuery(SqlRow(q), state_ptr);
+      const SqlRow row(q);
+      rows.items << NewPlaylistItemFromQuery(row, state_ptr);
+      rows.positions << row.value(position_column).toLongLong();
     }
 
   }
@@ -221,7 +240,7 @@ QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
     Close();
   }
 
-  return playlistitems;
+  return rows;
 
 }
 
@@ -231,7 +250,7 @@ QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
 
   {
 
-    QSqlQuery q = GetPlaylistRows(playlist);
+    QSqlQuery q = GetPlaylistQuery(playlist);
     // Note that as this only accesses the query, not the db, we don't need the mutex.
     if (db_->CheckErrors(q)) return QList<Song>();
 
@@ -322,40 +341,111 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, std::share
 
 }
 
-void PlaylistBackend::SavePlaylistAsync(int playlist, const PlaylistItemList &items, int last_played, PlaylistGeneratorPtr dynamic) {
+void PlaylistBackend::SavePlaylistAsync(int playlist, const PlaylistChanges &changes, int last_played, PlaylistGeneratorPtr dynamic) {
 
-  metaObject()->invokeMethod(this, "SavePlaylist", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(PlaylistItemList, items), Q_ARG(int, last_played), Q_ARG(PlaylistGeneratorPtr, dynamic));
+  metaObject()->invokeMethod(this, "SavePlaylist", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(PlaylistBackend::PlaylistChanges, changes), Q_ARG(int, last_played), Q_ARG(PlaylistGeneratorPtr, dynamic));
 
 }
 
-void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList &items, int last_played, PlaylistGeneratorPtr dynamic) {
+void PlaylistBackend::SavePlaylist(int playlist, const PlaylistBackend::PlaylistChanges &changes, int last_played, PlaylistGeneratorPtr dynamic) {
+
+  // After a failed save the stored rows no longer match what the playlist expects, wait for it to rewrite them.
+  if (!changes.rewrite && failed_playlists_.contains(playlist)) {
+    qLog(Debug) << "Skipping changes to playlist" << playlist << "until it is rewritten";
+    return;
+  }
 
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  qLog(Debug) << "Saving playlist" << playlist;
+  qLog(Debug) << "Saving playlist" << playlist << (changes.rewrite ? "completely:" : "changes:") << changes.removed.count() << "removed," << changes.moved.count() << "moved," << changes.added.count() << "added," << changes.changed.count() << "changed";
 
   QSqlQuery clear(db);
   clear.prepare("DELETE FROM playlist_items WHERE playlist = :playlist");
+  QSqlQuery remove(db);
+  remove.prepare("DELETE FROM playlist_items WHERE playlist = :playlist AND position = :position");
+  QSqlQuery move(db);
+  move.prepare("UPDATE playlist_items SET position = :new_position WHERE playlist = :playlist AND position = :position");
+  QSqlQuery finish_move(db);
+  finish_move.prepare("UPDATE playlist_items SET position = -position - 1 WHERE playlist = :playlist AND position < 0");
   QSqlQuery insert(db);
-  insert.prepare("INSERT INTO playlist_items (playlist, type, collection_id, " + Song::kColumnSpec + ") VALUES (:playlist, :type, :collection_id, " + Song::kBindSpec + ")");
+  insert.prepare("INSERT INTO playlist_items (playlist, position, type, collection_id, " + Song::kColumnSpec + ") VALUES (:playlist, :position, :type, :collection_id, " + Song::kBindSpec + ")");
+  QSqlQuery insert_collection(db);
+  insert_collection.prepare("INSERT INTO playlist_items (playlist, position, type, collection_id) VALUES (:playlist, :position, :type, :collection_id)");
+  QSqlQuery change(db);
+  change.prepare("UPDATE playlist_items SET type = :type, collection_id = :collection_id, " + Song::kUpdateSpec + " WHERE playlist = :playlist AND position = :position");
   QSqlQuery update(db);
   update.prepare("UPDATE playlists SET last_played=:last_played, dynamic_playlist_type=:dynamic_type, dynamic_playlist_data=:dynamic_data, dynamic_playlist_backend=:dynamic_backend WHERE ROWID=:playlist");
 
   ScopedTransaction transaction(&db);
 
-  // Clear the existing items in the playlist
-  clear.bindValue(":playlist", playlist);
-  clear.exec();
-  if (db_->CheckErrors(clear)) return;
+  if (changes.rewrite) {
+    // Clear the existing items in the playlist
+    clear.bindValue(":playlist", playlist);
+    clear.exec();
+    if (db_->CheckErrors(clear)) {
+      SavePlaylistFailed(playlist);
+      return;
+    }
+  }
+
+  for (const qint64 position : changes.removed) {
+    remove.bindValue(":playlist", playlist);
+    remove.bindValue(":position", position);
+    remove.exec();
+    if (db_->CheckErrors(remove)) {
+      SavePlaylistFailed(playlist);
+      return;
+    }
+  }
+
+  // The moved rows get negative positions first, so they can't collide with the positions of rows that haven't been moved yet.
+  if (!changes.moved.isEmpty()) {
+    for (const QPair<qint64, qint64> &moved : changes.moved) {
+      move.bindValue(":new_position", -moved.second - 1);
+      move.bindValue(":playlist", playlist);
+      move.bindValue(":position", moved.first);
+      move.exec();
+      if (db_->CheckErrors(move)) {
+        SavePlaylistFailed(playlist);
+        return;
+      }
+    }
+    finish_move.bindValue(":playlist", playlist);
+    finish_move.exec();
+    if (db_->CheckErrors(finish_move)) {
+      SavePlaylistFailed(playlist);
+      return;
+    }
+  }
 
   // Save the new ones
-  for (PlaylistItemPtr item : items) {
-    insert.bindValue(":playlist", playlist);
-    item->BindToQuery(&insert);
+  for (const QPair<qint64, PlaylistItemPtr> &added : changes.added) {
+    QSqlQuery &q = added.second->IsLocalCollectionItem() ? insert_collection : insert;
+    q.bindValue(":playlist", playlist);
+    q.bindValue(":position", added.first);
+    if (added.second->IsLocalCollectionItem()) {
+      added.second->BindSourceToQuery(&q);
+    }
+    else {
+      added.second->BindToQuery(&q);
+    }
+    q.exec();
+    if (db_->CheckErrors(q)) {
+      SavePlaylistFailed(playlist);
+      return;
+    }
+  }
 
-    insert.exec();
-    db_->CheckErrors(insert);
+  for (const QPair<qint64, PlaylistItemPtr> &changed : changes.changed) {
+    changed.second->BindToQuery(&change);
+    change.bindValue(":playlist", playlist);
+    change.bindValue(":position", changed.first);
+    change.exec();
+    if (db_->CheckErrors(change)) {
+      SavePlaylistFailed(playlist);
+      return;
+    }
   }
 
   // Update the last played track number
@@ -372,9 +462,22 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList &items,
   }
   update.bindValue(":playlist", playlist);
   update.exec();
-  if (db_->CheckErrors(update)) return;
+  if (db_->CheckErrors(update)) {
+    SavePlaylistFailed(playlist);
+    return;
+  }
 
   transaction.Commit();
+  failed_playlists_.remove(playlist);
+
+}
+
+void PlaylistBackend::SavePlaylistFailed(const int playlist) {
+
+  // Returning rolls back the transaction, so none of the changes are stored.
+  qLog(Error) << "Failed to save playlist" << playlist << ", it will be rewritten on the next save";
+  failed_playlists_.insert(playlist);
+  emit PlaylistSaveFailed(playlist);
 
 }
 
@@ -28,8 +28,10 @@
 
 #include <QObject>
 #include <QMutex>
+#include <QMetaType>
 #include <QHash>
 #include <QList>
+#include <QPair>
 #include <QSet>
 #include <QString>
 #include <QSqlQuery>
@@ -64,6 +66,26 @@ class PlaylistBackend : public QObject {
   };
   typedef QList<Playlist> PlaylistList;
 
+  // The items of a playlist with the position keys of their rows.
+  struct PlaylistRows {
+    PlaylistItemList items;
+    QList<qint64> positions;
+  };
+
+  // What changed in a playlist since it was last saved, the rows are identified by their position keys.
+  struct PlaylistChanges {
+    PlaylistChanges() : rewrite(false) {}
+
+    // All rows are replaced by the added ones.
+    bool rewrite;
+    QList<qint64> removed;
+    // Old and new position.
+    QList<QPair<qint64, qint64>> moved;
+    QList<QPair<qint64, PlaylistItemPtr>> added;
+    // Items with new metadata, at their new position.
+    QList<QPair<qint64, PlaylistItemPtr>> changed;
+  };
+
   static const int kSongTableJoins;
 
   void Close();
@@ -75,13 +97,15 @@ class PlaylistBackend : public QObject {
   PlaylistBackend::Playlist GetPlaylist(int id);
 
   QList<PlaylistItemPtr> GetPlaylistItems(int playlist);
+  // Loads the rows after the given position, all of them when no limit is given.
+  PlaylistRows GetPlaylistRows(int playlist, const qint64 after_position = -1, const int limit = -1);
   QList<Song> GetPlaylistSongs(int playlist);
 
   void SetPlaylistOrder(const QList<int> &ids);
   void SetPlaylistUiPath(int id, const QString &path);
 
   int CreatePlaylist(const QString &name, const QString &special_type);
-  void SavePlaylistAsync(int playlist, const PlaylistItemList &items, int last_played, PlaylistGeneratorPtr dynamic);
+  void SavePlaylistAsync(int playlist, const PlaylistChanges &changes, int last_played, PlaylistGeneratorPtr dynamic);
   void RenamePlaylist(int id, const QString &new_name);
   void FavoritePlaylist(int id, bool is_favorite);
   void RemovePlaylist(int id);
@@ -90,10 +114,12 @@ class PlaylistBackend : public QObject {
 
  public slots:
   void Exit();
-  void SavePlaylist(int playlist, const PlaylistItemList &items, int last_played, PlaylistGeneratorPtr dynamic);
+  void SavePlaylist(int playlist, const PlaylistBackend::PlaylistChanges &changes, int last_played, PlaylistGeneratorPtr dynamic);
 
 signals:
   void ExitFinished();
+  // Nothing of the save was stored, changes to this playlist are ignored until it is saved completely.
+  void PlaylistSaveFailed(int playlist);
 
  private:
   struct NewSongFromQueryState {
@@ -101,7 +127,7 @@ signals:
     QMutex mutex_;
   };
 
-  QSqlQuery GetPlaylistRows(int playlist);
+  QSqlQuery GetPlaylistQuery(int playlist, const qint64 after_position = -1, const int limit = -1);
 
   Song NewSongFromQuery(const SqlRow &row, std::shared_ptr<NewSongFromQueryState> state);
   PlaylistItemPtr NewPlaylistItemFromQuery(const SqlRow &row, std::shared_ptr<NewSongFromQueryState> state);
@@ -114,9 +140,16 @@ signals:
   };
   PlaylistList GetPlaylists(GetPlaylistsFlags flags);
 
+  void SavePlaylistFailed(const int playlist);
+
   Application *app_;
   Database *db_;
   QThread *original_thread_;
+
+  // Playlists whose last save failed, only used on the database thread.
+  QSet<int> failed_playlists_;
 };
 
+Q_DECLARE_METATYPE(PlaylistBackend::PlaylistChanges)
+
 #endif  // PLAYLISTBACKEND_H
@@ -20,7 +20,9 @@
 
 #include "config.h"
 
+#include <QtGlobal>
 #include <QObject>
+#include <QVector>
 #include <QString>
 #include <QRegularExpression>
 #include <QAbstractItemModel>
@@ -28,6 +30,7 @@
 
 #include "playlist/playlist.h"
 #include "playlistfilter.h"
+#include "playlistfilterindex.h"
 #include "playlistfilterparser.h"
 
 PlaylistFilter::PlaylistFilter(QObject *parent)
@@ -66,6 +69,9 @@ PlaylistFilter::PlaylistFilter(QObject *parent)
                      << Playlist::Column_Samplerate
                      << Playlist::Column_Bitdepth
                      << Playlist::Column_Bitrate;
+
+  index_.reset(new PlaylistFilterIndex(column_names_.values()));
+
 }
 
 PlaylistFilter::~PlaylistFilter() {
@@ -76,8 +82,79 @@ void PlaylistFilter::sort(int column, Qt::SortOrder order) {
   sourceModel()->sort(column, order);
 }
 
+void PlaylistFilter::setSourceModel(QAbstractItemModel *source_model) {
+
+  if (sourceModel()) {
+    disconnect(sourceModel(), SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(SourceRowsInserted(QModelIndex, int, int)));
+    disconnect(sourceModel(), SIGNAL(rowsRemoved(QModelIndex, int, int)), this, SLOT(SourceRowsRemoved(QModelIndex, int, int)));
+    disconnect(sourceModel(), SIGNAL(dataChanged(QModelIndex, QModelIndex)), this, SLOT(SourceDataChanged(QModelIndex, QModelIndex)));
+    disconnect(sourceModel(), SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(SourceLayoutChanged()));
+    disconnect(sourceModel(), SIGNAL(layoutChanged()), this, SLOT(SourceLayoutChanged()));
+    disconnect(sourceModel(), SIGNAL(modelReset()), this, SLOT(SourceLayoutChanged()));
+  }
+
+  SourceLayoutChanged();
+
+  if (source_model) {
+    connect(source_model, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(SourceRowsInserted(QModelIndex, int, int)));
+    connect(source_model, SIGNAL(rowsRemoved(QModelIndex, int, int)), this, SLOT(SourceRowsRemoved(QModelIndex, int, int)));
+    connect(source_model, SIGNAL(dataChanged(QModelIndex, QModelIndex)), this, SLOT(SourceDataChanged(QModelIndex, QModelIndex)));
+    connect(source_model, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(SourceLayoutChanged()));
+    connect(source_model, SIGNAL(layoutChanged()), this, SLOT(SourceLayoutChanged()));
+    connect(source_model, SIGNAL(modelReset()), this, SLOT(SourceLayoutChanged()));
+  }
+
+  QSortFilterProxyModel::setSourceModel(source_model);
+
+}
+
+void PlaylistFilter::SourceRowsInserted(const QModelIndex &parent, const int first, const int last) {
+
+  Q_UNUSED(parent);
+
+  index_->InsertRows(sourceModel(), first, last);
+
+  const int count = last - first + 1;
+  if (!matches_.isEmpty()) matches_.insert(first, count, Match_Unknown);
+  if (!previous_matches_.isEmpty()) previous_matches_.insert(first, count, Match_Unknown);
+
+}
+
+void PlaylistFilter::SourceRowsRemoved(const QModelIndex &parent, const int first, const int last) {
+
+  Q_UNUSED(parent);
+
+  index_->RemoveRows(first, last);
+
+  const int count = last - first + 1;
+  if (!matches_.isEmpty()) matches_.remove(first, count);
+  if (!previous_matches_.isEmpty()) previous_matches_.remove(first, count);
+
+}
+
+void PlaylistFilter::SourceDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right) {
+
+  index_->UpdateRows(sourceModel(), top_left.row(), bottom_right.row());
+
+  // The changed rows might match now even if they didn't match the previous query.
+  for (int row = top_left.row(); row <= bottom_right.row() && row < previous_matches_.count(); ++row) {
+    previous_matches_[row] = Match_Unknown;
+  }
+
+}
+
+void PlaylistFilter::SourceLayoutChanged() {
+
+  index_->Clear();
+  matches_.clear();
+  previous_matches_.clear();
+
+}
+
 bool PlaylistFilter::filterAcceptsRow(int row, const QModelIndex &parent) const {
 
+  Q_UNUSED(parent);
+
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
   QString filter = filterRegularExpression().pattern();
 #else
@@ -88,12 +165,31 @@ bool PlaylistFilter::filterAcceptsRow(int row, const QModelIndex &parent) const
   if (hash != query_hash_) {
     // Parse the query
     FilterParser p(filter, column_names_, numerical_columns_);
-    filter_tree_.reset(p.parse());
+    FilterTree *filter_tree = p.parse();
+
+    // When the query only got narrower, like while typing, the rows that didn't match before can't match now.
+    if (!matches_.isEmpty() && FilterParser::IsRefinement(filter_tree_.data(), filter_tree)) {
+      previous_matches_ = matches_;
+    }
+    else {
+      previous_matches_.clear();
+    }
+    filter_tree_.reset(filter_tree);
+    matches_.clear();
 
     query_hash_ = hash;
   }
 
+  if (filter_tree_->type() == FilterTree::Nop) return true;
+
+  if (!index_->is_built()) index_->Build(sourceModel());
+  if (row < 0 || row >= index_->row_count()) return false;
+
   // Test the row
-  return filter_tree_->accept(row, parent, sourceModel());
+  const bool match = (row >= previous_matches_.count() || previous_matches_[row] != Match_No) && filter_tree_->accept(row, *index_);
+  if (matches_.count() != index_->row_count()) matches_.fill(Match_Unknown, index_->row_count());
+  matches_[row] = match ? Match_Yes : Match_No;
+
+  return match;
 
 }
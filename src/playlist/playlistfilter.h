@@ -27,11 +27,15 @@
 #include <QObject>
 #include <QMap>
 #include <QSet>
+#include <QVector>
 #include <QScopedPointer>
 #include <QString>
 #include <QSortFilterProxyModel>
 
+class QAbstractItemModel;
+class QModelIndex;
 class FilterTree;
+class PlaylistFilterIndex;
 
 class PlaylistFilter : public QSortFilterProxyModel {
   Q_OBJECT
@@ -43,14 +47,35 @@ class PlaylistFilter : public QSortFilterProxyModel {
   // QAbstractItemModel
   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
+  // QAbstractProxyModel
+  void setSourceModel(QAbstractItemModel *source_model) override;
+
   // QSortFilterProxyModel
   // public so Playlist::NextVirtualIndex and friends can get at it
   bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
 
-private:
+ private slots:
+  // Connected before the proxy model's own slots, so the index is up to date when the rows are filtered again.
+  void SourceRowsInserted(const QModelIndex &parent, const int first, const int last);
+  void SourceRowsRemoved(const QModelIndex &parent, const int first, const int last);
+  void SourceDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right);
+  void SourceLayoutChanged();
+
+ private:
+  enum Match {
+    Match_Unknown = -1,
+    Match_No = 0,
+    Match_Yes = 1
+  };
+
+ private:
   // Mutable because they're modified from filterAcceptsRow() const
   mutable QScopedPointer<FilterTree> filter_tree_;
   mutable uint query_hash_;
+  mutable QScopedPointer<PlaylistFilterIndex> index_;
+  // Whether each row matched the current query, and the query before it when the current one only narrows it down.
+  mutable QVector<qint8> matches_;
+  mutable QVector<qint8> previous_matches_;
 
   QMap<QString, int> column_names_;
   QSet<int> numerical_columns_;
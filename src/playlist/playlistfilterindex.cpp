@@ -0,0 +1,126 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include <QVariant>
+#include <QString>
+#include <QAbstractItemModel>
+
+#include "playlistfilterindex.h"
+
+PlaylistFilterIndex::PlaylistFilterIndex(const QList<int> &columns) : row_count_(0), built_(false) {
+
+  for (const int column : columns) {
+    if (column < 0 || columns_.contains(column)) continue;
+    if (column >= column_slots_.count()) column_slots_.resize(column + 1);
+    column_slots_[column] = columns_.count();
+    columns_ << column;
+  }
+  for (int i = 0; i < column_slots_.count(); ++i) {
+    if (!columns_.contains(i)) column_slots_[i] = -1;
+  }
+  text_.resize(columns_.count());
+
+}
+
+const QString &PlaylistFilterIndex::text(const int row, const int column) const {
+
+  static const QString empty;
+
+  if (column < 0 || column >= column_slots_.count() || column_slots_[column] == -1) return empty;
+  return text_[column_slots_[column]][row];
+
+}
+
+QString PlaylistFilterIndex::Normalize(const QAbstractItemModel *model, const int row, const int column) {
+
+  // Same text as the model shows, the filter terms are lowercased by the parser.
+  return model->index(row, column).data().toString().toLower();
+
+}
+
+void PlaylistFilterIndex::Build(const QAbstractItemModel *model) {
+
+  row_count_ = model->rowCount();
+  for (int i = 0; i < columns_.count(); ++i) {
+    QVector<QString> &text = text_[i];
+    text.resize(row_count_);
+    for (int row = 0; row < row_count_; ++row) {
+      text[row] = Normalize(model, row, columns_[i]);
+    }
+  }
+  built_ = true;
+
+}
+
+void PlaylistFilterIndex::Clear() {
+
+  for (QVector<QString> &text : text_) {
+    text.clear();
+    text.squeeze();
+  }
+  row_count_ = 0;
+  built_ = false;
+
+}
+
+void PlaylistFilterIndex::InsertRows(const QAbstractItemModel *model, const int first, const int last) {
+
+  if (!built_) return;
+
+  const int count = last - first + 1;
+  for (int i = 0; i < columns_.count(); ++i) {
+    QVector<QString> &text = text_[i];
+    text.insert(first, count, QString());
+    for (int row = first; row <= last; ++row) {
+      text[row] = Normalize(model, row, columns_[i]);
+    }
+  }
+  row_count_ += count;
+
+}
+
+void PlaylistFilterIndex::RemoveRows(const int first, const int last) {
+
+  if (!built_) return;
+
+  const int count = last - first + 1;
+  for (QVector<QString> &text : text_) {
+    text.remove(first, count);
+  }
+  row_count_ -= count;
+
+}
+
+void PlaylistFilterIndex::UpdateRows(const QAbstractItemModel *model, const int first, const int last) {
+
+  if (!built_) return;
+
+  for (int i = 0; i < columns_.count(); ++i) {
+    QVector<QString> &text = text_[i];
+    for (int row = qMax(first, 0); row <= last && row < row_count_; ++row) {
+      text[row] = Normalize(model, row, columns_[i]);
+    }
+  }
+
+}
@@ -0,0 +1,63 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PLAYLISTFILTERINDEX_H
+#define PLAYLISTFILTERINDEX_H
+
+#include "config.h"
+
+#include <QList>
+#include <QVector>
+#include <QString>
+
+class QAbstractItemModel;
+
+// The text of the searchable playlist columns, lowercased the way the filter compares it.
+// Each column is stored in its own vector, so evaluating a filter doesn't have to go through QModelIndex and QVariant for every field of every row on each keystroke.
+// The owner has to keep it in sync with the model, or clear it when the model changes in a way it can't follow.
+class PlaylistFilterIndex {
+ public:
+  explicit PlaylistFilterIndex(const QList<int> &columns);
+
+  bool is_built() const { return built_; }
+  int row_count() const { return row_count_; }
+
+  // Returns an empty string for a column that isn't indexed.
+  const QString &text(const int row, const int column) const;
+
+  void Build(const QAbstractItemModel *model);
+  void Clear();
+
+  void InsertRows(const QAbstractItemModel *model, const int first, const int last);
+  void RemoveRows(const int first, const int last);
+  void UpdateRows(const QAbstractItemModel *model, const int first, const int last);
+
+ private:
+  static QString Normalize(const QAbstractItemModel *model, const int row, const int column);
+
+ private:
+  QList<int> columns_;
+  // Indexed by column, -1 for the columns without text.
+  QVector<int> column_slots_;
+  QVector<QVector<QString>> text_;
+  int row_count_;
+  bool built_;
+};
+
+#endif  // PLAYLISTFILTERINDEX_H
@@ -20,7 +20,9 @@
 
 #include "config.h"
 
+#include <QtGlobal>
 #include <QList>
+#include <QPair>
 #include <QMap>
 #include <QSet>
 #include <QChar>
@@ -28,15 +30,17 @@
 #include <QVariant>
 #include <QString>
 #include <QtAlgorithms>
-#include <QAbstractItemModel>
 
 #include "playlist.h"
+#include "playlistfilterindex.h"
 #include "playlistfilterparser.h"
 
 class SearchTermComparator {
  public:
   virtual ~SearchTermComparator() {}
   virtual bool Matches(const QString &element) const = 0;
+  // The term for comparators that only check whether the field contains it.
+  virtual QString substring() const { return QString(); }
 };
 
 // "compares" by checking if the field contains the search term
@@ -46,6 +50,7 @@ class DefaultComparator : public SearchTermComparator {
   bool Matches(const QString &element) const override {
     return element.contains(search_term_);
   }
+  QString substring() const override { return search_term_; }
  private:
   QString search_term_;
 };
@@ -183,13 +188,18 @@ class FilterTerm : public FilterTree {
  public:
   explicit FilterTerm(SearchTermComparator *comparator, const QList<int> &columns) : cmp_(comparator), columns_(columns) {}
 
-  bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override {
+  bool accept(int row, const PlaylistFilterIndex &index) const override {
     for (int i : columns_) {
-      QModelIndex idx(model->index(row, i, parent));
-      if (cmp_->Matches(idx.data().toString().toLower())) return true;
+      if (cmp_->Matches(index.text(row, i))) return true;
     }
     return false;
   }
+  bool substrings(QList<QPair<int, QString>> *terms) const override {
+    const QString substring = cmp_->substring();
+    if (substring.isEmpty()) return false;
+    *terms << qMakePair(-1, substring);
+    return true;
+  }
   FilterType type() override { return Term; }
  private:
   QScopedPointer<SearchTermComparator> cmp_;
@@ -201,9 +211,14 @@ class FilterColumnTerm : public FilterTree {
  public:
   FilterColumnTerm(int column, SearchTermComparator *comparator) : col(column), cmp_(comparator) {}
 
-  bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override {
-    QModelIndex idx(model->index(row, col, parent));
-    return cmp_->Matches(idx.data().toString().toLower());
+  bool accept(int row, const PlaylistFilterIndex &index) const override {
+    return cmp_->Matches(index.text(row, col));
+  }
+  bool substrings(QList<QPair<int, QString>> *terms) const override {
+    const QString substring = cmp_->substring();
+    if (substring.isEmpty()) return false;
+    *terms << qMakePair(col, substring);
+    return true;
   }
   FilterType type() override { return Column; }
  private:
@@ -215,8 +230,8 @@ class NotFilter : public FilterTree {
  public:
   explicit NotFilter(const FilterTree *inv) : child_(inv) {}
 
-  bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override {
-    return !child_->accept(row, parent, model);
+  bool accept(int row, const PlaylistFilterIndex &index) const override {
+    return !child_->accept(row, index);
   }
   FilterType type() override { return Not; }
  private:
@@ -227,12 +242,15 @@ class OrFilter : public FilterTree {
  public:
   ~OrFilter() override { qDeleteAll(children_); }
   virtual void add(FilterTree *child) { children_.append(child); }
-  bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override {
+  bool accept(int row, const PlaylistFilterIndex &index) const override {
     for (FilterTree *child : children_) {
-      if (child->accept(row, parent, model)) return true;
+      if (child->accept(row, index)) return true;
     }
     return false;
   }
+  bool substrings(QList<QPair<int, QString>> *terms) const override {
+    return children_.count() == 1 && children_.first()->substrings(terms);
+  }
   FilterType type() override { return Or; }
  private:
   QList<FilterTree*> children_;
@@ -242,9 +260,15 @@ class AndFilter : public FilterTree {
  public:
   ~AndFilter() override { qDeleteAll(children_); }
   virtual void add(FilterTree *child) { children_.append(child); }
-  bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override {
+  bool accept(int row, const PlaylistFilterIndex &index) const override {
     for (FilterTree *child : children_) {
-      if (!child->accept(row, parent, model)) return false;
+      if (!child->accept(row, index)) return false;
+    }
+    return true;
+  }
+  bool substrings(QList<QPair<int, QString>> *terms) const override {
+    for (FilterTree *child : children_) {
+      if (!child->substrings(terms)) return false;
     }
     return true;
   }
@@ -261,6 +285,31 @@ FilterTree *FilterParser::parse() {
   return parseOrGroup();
 }
 
+bool FilterParser::IsRefinement(const FilterTree *previous, const FilterTree *next) {
+
+  // Only plain substring searches are compared, a row that contains a longer term also contains the shorter one.
+  QList<QPair<int, QString>> previous_terms;
+  QList<QPair<int, QString>> next_terms;
+  if (!previous->substrings(&previous_terms) || !next->substrings(&next_terms)) return false;
+
+  // Every row matched an empty filter, nothing would be gained.
+  if (previous_terms.isEmpty()) return false;
+
+  for (const QPair<int, QString> &previous_term : previous_terms) {
+    bool found = false;
+    for (const QPair<int, QString> &next_term : next_terms) {
+      if (next_term.first == previous_term.first && next_term.second.contains(previous_term.second)) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) return false;
+  }
+
+  return true;
+
+}
+
 void FilterParser::advance() {
   while (iter_ != end_ && iter_->isSpace()) {
     ++iter_;
@@ -493,7 +542,12 @@ FilterTree *FilterParser::createSearchTermTreeNode(const QString &col, const QSt
     return new FilterColumnTerm(columns_[col], cmp);
   }
   else {
-    return new FilterTerm(cmp, columns_.values());
+    // Title is there twice, as title and name.
+    QList<int> columns;
+    for (const int column : columns_) {
+      if (!columns.contains(column)) columns << column;
+    }
+    return new FilterTerm(cmp, columns);
   }
 }
 
@@ -23,18 +23,23 @@
 
 #include "config.h"
 
+#include <QtGlobal>
+#include <QList>
+#include <QPair>
 #include <QSet>
 #include <QMap>
 #include <QString>
 
-class QAbstractItemModel;
-class QModelIndex;
+class PlaylistFilterIndex;
 
 // structure for filter parse tree
 class FilterTree {
  public:
   virtual ~FilterTree() {}
-  virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const = 0;
+  virtual bool accept(int row, const PlaylistFilterIndex &index) const = 0;
+  // Adds the substrings a row has to contain to be accepted, as column and search term pairs, with -1 for any column.
+  // Returns false if the filter can't be reduced to that, then it can't be compared with another filter.
+  virtual bool substrings(QList<QPair<int, QString>> *terms) const { Q_UNUSED(terms); return false; }
   enum FilterType {
     Nop = 0,
     Or,
@@ -49,7 +54,8 @@ class FilterTree {
 // trivial filter that accepts *anything*
 class NopFilter : public FilterTree {
  public:
-  bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override { Q_UNUSED(row); Q_UNUSED(parent); Q_UNUSED(model); return true; }
+  bool accept(int row, const PlaylistFilterIndex &index) const override { Q_UNUSED(row); Q_UNUSED(index); return true; }
+  bool substrings(QList<QPair<int, QString>> *terms) const override { Q_UNUSED(terms); return true; }
   FilterType type() override { return Nop; }
 };
 
@@ -73,6 +79,9 @@ class FilterParser {
 
   FilterTree *parse();
 
+  // Whether every row accepted by next is also accepted by previous, so only the rows that matched previous have to be checked again.
+  static bool IsRefinement(const FilterTree *previous, const FilterTree *next);
+
  private:
   void advance();
   FilterTree *parseOrGroup();
@@ -84,11 +84,16 @@ PlaylistItem::~PlaylistItem() {}
 
 void PlaylistItem::BindToQuery(QSqlQuery *query) const {
 
+  BindSourceToQuery(query);
+  DatabaseSongMetadata().BindToQuery(query);
+
+}
+
+void PlaylistItem::BindSourceToQuery(QSqlQuery *query) const {
+
   query->bindValue(":type", source_);
   query->bindValue(":collection_id", DatabaseValue(Column_CollectionId));
 
-  DatabaseSongMetadata().BindToQuery(query);
-
 }
 
 void PlaylistItem::SetTemporaryMetadata(const Song &metadata) {
@@ -70,6 +70,8 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
 
   virtual bool InitFromQuery(const SqlRow &query) = 0;
   void BindToQuery(QSqlQuery* query) const;
+  // Only the type and collection ID, collection items are saved by ID without their metadata.
+  void BindSourceToQuery(QSqlQuery* query) const;
   virtual void Reload() {}
   QFuture<void> BackgroundReload();
 
@@ -97,11 +97,17 @@ void PlaylistManager::Init(CollectionBackend *collection_backend, PlaylistBacken
   connect(collection_backend_, SIGNAL(SongsDiscovered(SongList)), SLOT(SongsDiscovered(SongList)));
   connect(collection_backend_, SIGNAL(SongsStatisticsChanged(SongList)), SLOT(SongsDiscovered(SongList)));
   connect(collection_backend_, SIGNAL(SongsRatingChanged(SongList)), SLOT(SongsDiscovered(SongList)));
+  connect(collection_backend_, SIGNAL(SongsReplayGainChanged(SongList)), SLOT(SongsDiscovered(SongList)));
 
   for (const PlaylistBackend::Playlist &p : playlist_backend->GetAllOpenPlaylists()) {
+    AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+  }
+
+  // Only the current and active playlists are restored now, the others are restored when they are first shown.
+  for (const Data &data : playlists_) {
+    if (!data.p->is_restoring()) continue;
     ++playlists_loading_;
-    Playlist *ret = AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
-    connect(ret, SIGNAL(PlaylistLoaded()), SLOT(PlaylistLoaded()));
+    connect(data.p, SIGNAL(PlaylistLoaded()), SLOT(PlaylistLoaded()));
   }
 
   // If no playlist exists then make a new one
@@ -209,11 +215,12 @@ void PlaylistManager::Load(const QString &filename) {
 
 void PlaylistManager::Save(const int id, const QString &filename, const Playlist::Path path_type) {
 
-  if (playlists_.contains(id)) {
+  if (playlists_.contains(id) && playlist(id)->is_restored()) {
     parser_->Save(playlist(id)->GetAllSongs(), filename, path_type);
   }
   else {
     // Playlist is not in the playlist manager: probably save action was triggered from the left side bar and the playlist isn't loaded.
+    // Or it's a tab that wasn't shown yet, so it isn't restored.
     QFuture<QList<Song>> future = QtConcurrent::run(std::bind(&PlaylistBackend::GetPlaylistSongs, playlist_backend_, id));
     NewClosure(future, this, SLOT(ItemsLoadedForSavePlaylist(QFuture<SongList>, QString, Playlist::Path)), future, filename, path_type);
   }
@@ -375,6 +382,7 @@ void PlaylistManager::SetCurrentPlaylist(const int id) {
   }
 
   current_ = id;
+  playlists_[id].p->Restore();
   emit CurrentChanged(current(), playlists_[id].scroll_position);
   UpdateSummaryText();
 
@@ -388,6 +396,7 @@ void PlaylistManager::SetActivePlaylist(const int id) {
   if (active_ != -1 && active_ != id) active()->set_current_row(-1);
 
   active_ = id;
+  playlists_[id].p->Restore();
 
   emit ActiveChanged(active());
 
@@ -0,0 +1,180 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include <QMultiHash>
+#include <QSet>
+#include <QPair>
+
+#include "playlistitem.h"
+#include "playlistbackend.h"
+#include "playlistsavestate.h"
+
+const qint64 PlaylistSaveState::kPositionStep = 65536;
+
+PlaylistSaveState::PlaylistSaveState() : valid_(false), items_changed_(false) {}
+
+void PlaylistSaveState::Reset(const PlaylistItemList &items, const QList<qint64> &positions) {
+
+  rows_.clear();
+  changed_items_.clear();
+  for (int i = 0; i < items.count() && i < positions.count(); ++i) {
+    rows_.insert(items[i].get(), Row(items[i], positions[i]));
+  }
+  valid_ = true;
+  items_changed_ = false;
+
+}
+
+void PlaylistSaveState::Append(const PlaylistItemList &items, const QList<qint64> &positions) {
+
+  for (int i = 0; i < items.count() && i < positions.count(); ++i) {
+    rows_.insert(items[i].get(), Row(items[i], positions[i]));
+  }
+
+}
+
+void PlaylistSaveState::Invalidate() {
+
+  rows_.clear();
+  changed_items_.clear();
+  valid_ = false;
+
+}
+
+void PlaylistSaveState::MetadataChanged(const PlaylistItemPtr &item) {
+
+  if (item) changed_items_.insert(item.get());
+
+}
+
+QVector<bool> PlaylistSaveState::LongestIncreasing(const QVector<qint64> &positions) {
+
+  // tails[n] is the index of the smallest position that ends an increasing sequence of n + 1 positions.
+  QVector<int> tails;
+  QVector<int> previous(positions.count(), -1);
+  for (int i = 0; i < positions.count(); ++i) {
+    if (positions[i] == -1) continue;
+    int low = 0;
+    int high = tails.count();
+    while (low < high) {
+      const int middle = (low + high) / 2;
+      if (positions[tails[middle]] < positions[i]) low = middle + 1;
+      else high = middle;
+    }
+    if (low > 0) previous[i] = tails[low - 1];
+    if (low == tails.count()) tails << i;
+    else tails[low] = i;
+  }
+
+  QVector<bool> ret(positions.count(), false);
+  for (int i = tails.isEmpty() ? -1 : tails.last(); i != -1; i = previous[i]) {
+    ret[i] = true;
+  }
+  return ret;
+
+}
+
+PlaylistBackend::PlaylistChanges PlaylistSaveState::Update(const PlaylistItemList &items) {
+
+  PlaylistBackend::PlaylistChanges changes;
+  if (valid_ && !items_changed_ && changed_items_.isEmpty()) return changes;
+
+  const int count = items.count();
+
+  // The stored position of each item, -1 for new items.
+  QVector<qint64> old_positions(count, -1);
+  if (valid_) {
+    for (int i = 0; i < count; ++i) {
+      PlaylistItem *item = items[i].get();
+      for (QMultiHash<PlaylistItem*, Row>::iterator it = rows_.find(item); it != rows_.end() && it.key() == item; ++it) {
+        if (!it->used) {
+          it->used = true;
+          old_positions[i] = it->position;
+          break;
+        }
+      }
+    }
+    for (const Row &row : rows_) {
+      if (!row.used) changes.removed << row.position;
+    }
+  }
+  else {
+    changes.rewrite = true;
+  }
+
+  // The longest sequence of items that are still in order keep their positions, the others get new ones between them.
+  const QVector<bool> kept = LongestIncreasing(old_positions);
+  QVector<qint64> new_positions(count);
+  bool renumber = false;
+  for (int i = 0; i < count && !renumber;) {
+    if (kept[i]) {
+      new_positions[i] = old_positions[i];
+      ++i;
+      continue;
+    }
+    int end = i;
+    while (end < count && !kept[end]) ++end;
+    const int run = end - i;
+    const qint64 lower = i == 0 ? -1 : new_positions[i - 1];
+    if (end == count) {
+      const qint64 start = i == 0 ? 0 : lower;
+      for (int n = 0; n < run; ++n) new_positions[i + n] = start + (n + 1) * kPositionStep;
+    }
+    else {
+      const qint64 upper = old_positions[end];
+      if (upper - lower - 1 < run) {
+        renumber = true;
+      }
+      else {
+        for (int n = 0; n < run; ++n) new_positions[i + n] = lower + (n + 1) * (upper - lower) / (run + 1);
+      }
+    }
+    i = end;
+  }
+
+  // No room left between the positions, all rows are moved.
+  if (renumber) {
+    for (int i = 0; i < count; ++i) new_positions[i] = (i + 1) * kPositionStep;
+  }
+
+  rows_.clear();
+  for (int i = 0; i < count; ++i) {
+    const PlaylistItemPtr &item = items[i];
+    if (old_positions[i] == -1) {
+      changes.added << qMakePair(new_positions[i], item);
+    }
+    else {
+      if (old_positions[i] != new_positions[i]) changes.moved << qMakePair(old_positions[i], new_positions[i]);
+      if (changed_items_.contains(item.get())) changes.changed << qMakePair(new_positions[i], item);
+    }
+    rows_.insert(item.get(), Row(item, new_positions[i]));
+  }
+
+  changed_items_.clear();
+  valid_ = true;
+  items_changed_ = false;
+
+  return changes;
+
+}
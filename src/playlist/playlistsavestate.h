@@ -0,0 +1,80 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PLAYLISTSAVESTATE_H
+#define PLAYLISTSAVESTATE_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include <QMultiHash>
+#include <QSet>
+
+#include "playlistitem.h"
+#include "playlistbackend.h"
+
+// Remembers how the items of a playlist are stored, so saving it only writes the rows that changed since the last save.
+// Rows are ordered by a position key, the keys are spread out so items can be inserted or moved without renumbering the rows around them.
+class PlaylistSaveState {
+ public:
+  PlaylistSaveState();
+
+  static const qint64 kPositionStep;
+
+  bool is_valid() const { return valid_; }
+
+  // The items as they are stored, in playlist order.
+  void Reset(const PlaylistItemList &items, const QList<qint64> &positions);
+  // More stored items, after the ones that are already known.
+  void Append(const PlaylistItemList &items, const QList<qint64> &positions);
+  // Forgets the stored rows, the next update replaces all of them.
+  void Invalidate();
+
+  // Items were added, removed, moved or replaced.
+  void ItemsChanged() { items_changed_ = true; }
+  // The metadata of an item changed in place.
+  void MetadataChanged(const PlaylistItemPtr &item);
+
+  // Works out what changed since the last update, and assumes that gets saved.
+  // The playlist invalidates the state when the backend reports that the save failed.
+  PlaylistBackend::PlaylistChanges Update(const PlaylistItemList &items);
+
+ private:
+  struct Row {
+    Row() : position(0), used(false) {}
+    Row(const PlaylistItemPtr &_item, const qint64 _position) : item(_item), position(_position), used(false) {}
+    // Keeps the item alive, so another item can't get the same address while this one still has a row.
+    PlaylistItemPtr item;
+    qint64 position;
+    bool used;
+  };
+
+  // Which of the positions, -1 for none, are in the longest increasing sequence.
+  static QVector<bool> LongestIncreasing(const QVector<qint64> &positions);
+
+ private:
+  bool valid_;
+  bool items_changed_;
+  QMultiHash<PlaylistItem*, Row> rows_;
+  QSet<PlaylistItem*> changed_items_;
+};
+
+#endif  // PLAYLISTSAVESTATE_H
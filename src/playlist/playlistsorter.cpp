@@ -0,0 +1,223 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include <QtGlobal>
+#include <QtConcurrentRun>
+#include <QThread>
+#include <QThreadPool>
+#include <QFuture>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include <QCollator>
+#include <QCollatorSortKey>
+
+#include "core/song.h"
+#include "playlist.h"
+#include "playlistitem.h"
+#include "playlistsorter.h"
+
+using std::placeholders::_1;
+using std::placeholders::_2;
+
+const int PlaylistSorter::kMinChunkSize = 1000;
+
+void PlaylistSorter::Sort(const PlaylistItemList::iterator begin, const PlaylistItemList::iterator end, const int column, const Qt::SortOrder order) {
+
+  const int count = static_cast<int>(std::distance(begin, end));
+  if (count < 2) return;
+
+  // Collators aren't thread-safe, so every chunk gets its own.
+  const int threads = qMax(1, ThreadPool()->maxThreadCount());
+  const int chunk_size = qMax(kMinChunkSize, (count + threads - 1) / threads);
+  QList<Chunk> chunks;
+  for (int i = 0; i < count; i += chunk_size) {
+    Chunk chunk;
+    chunk.column = column;
+    chunk.begin = begin + i;
+    chunk.end = begin + qMin(count, i + chunk_size);
+    chunks << chunk;
+  }
+  if (chunks.count() == 1) {
+    MakeKeys(chunks.first());
+  }
+  else {
+    QList<QFuture<void>> futures;
+    for (Chunk &chunk : chunks) {
+      futures << QtConcurrent::run(ThreadPool(), std::bind(&PlaylistSorter::MakeKeys, std::ref(chunk)));
+    }
+    for (QFuture<void> &future : futures) {
+      future.waitForFinished();
+    }
+  }
+
+  std::vector<Entry> entries;
+  entries.reserve(count);
+  for (const Chunk &chunk : chunks) {
+    entries.insert(entries.end(), chunk.entries.begin(), chunk.entries.end());
+  }
+
+  // Descending keeps equal items in their current order too, like sorting with the arguments swapped did.
+  if (order == Qt::AscendingOrder) {
+    std::stable_sort(entries.begin(), entries.end(), std::bind(&PlaylistSorter::Less, column, _1, _2));
+  }
+  else {
+    std::stable_sort(entries.begin(), entries.end(), std::bind(&PlaylistSorter::Less, column, _2, _1));
+  }
+
+  PlaylistItemList::iterator it = begin;
+  for (const Entry &entry : entries) {
+    *it++ = entry.item;
+  }
+
+}
+
+QThreadPool *PlaylistSorter::ThreadPool() {
+
+  // The global pool also runs things like the loudness scan, which would hold up the sort for as long as they take.
+  static QThreadPool *thread_pool = []() {
+    QThreadPool *pool = new QThreadPool;
+    pool->setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    return pool;
+  }();
+  return thread_pool;
+
+}
+
+bool PlaylistSorter::IsTextColumn(const int column) {
+
+  switch (column) {
+    case Playlist::Column_Title:
+    case Playlist::Column_Artist:
+    case Playlist::Column_Album:
+    case Playlist::Column_Genre:
+    case Playlist::Column_AlbumArtist:
+    case Playlist::Column_Composer:
+    case Playlist::Column_Performer:
+    case Playlist::Column_Grouping:
+    case Playlist::Column_Filename:
+    case Playlist::Column_Comment:
+      return true;
+    default:
+      return false;
+  }
+
+}
+
+void PlaylistSorter::MakeKeys(Chunk &chunk) {
+
+  QCollator collator;
+  const bool text_column = IsTextColumn(chunk.column);
+  // Shared by the items of other columns, which only compare numbers.
+  const QCollatorSortKey empty_key = collator.sortKey(QString());
+
+  chunk.entries.reserve(static_cast<size_t>(std::distance(chunk.begin, chunk.end)));
+
+  for (PlaylistItemList::const_iterator it = chunk.begin; it != chunk.end; ++it) {
+    const PlaylistItemPtr &item = *it;
+    const Song song = item->Metadata();
+
+    QString text;
+    if (text_column) {
+      switch (chunk.column) {
+        case Playlist::Column_Title:       text = song.title_sortable();                 break;
+        case Playlist::Column_Artist:      text = song.artist_sortable();                break;
+        case Playlist::Column_Album:       text = song.album_sortable();                 break;
+        case Playlist::Column_Genre:       text = song.genre();                          break;
+        case Playlist::Column_AlbumArtist: text = song.playlist_albumartist_sortable();  break;
+        case Playlist::Column_Composer:    text = song.composer();                       break;
+        case Playlist::Column_Performer:   text = song.performer();                      break;
+        case Playlist::Column_Grouping:    text = song.grouping();                       break;
+        case Playlist::Column_Filename:    text = item->Url().path();                    break;
+        case Playlist::Column_Comment:     text = song.comment();                        break;
+        default:                                                                         break;
+      }
+    }
+
+    Entry entry(item, text_column ? collator.sortKey(text.toLower()) : empty_key);
+
+    switch (chunk.column) {
+      // When sorting by album, also take into account discs and tracks.
+      case Playlist::Column_Album:
+        entry.number1 = song.disc();
+        entry.number2 = song.track();
+        break;
+      // When sorting by full paths we also expect a hierarchical order, this gives a breadth-first ordering of paths.
+      case Playlist::Column_Filename:
+        entry.number1 = text.count('/');
+        break;
+
+      case Playlist::Column_Length:       entry.number1 = song.length_nanosec();  break;
+      case Playlist::Column_Track:        entry.number1 = song.track();           break;
+      case Playlist::Column_Disc:         entry.number1 = song.disc();            break;
+      case Playlist::Column_Year:         entry.number1 = song.year();            break;
+      case Playlist::Column_OriginalYear: entry.number1 = song.originalyear();    break;
+
+      case Playlist::Column_PlayCount:    entry.number1 = song.playcount();       break;
+      case Playlist::Column_SkipCount:    entry.number1 = song.skipcount();       break;
+      case Playlist::Column_LastPlayed:   entry.number1 = song.lastplayed();      break;
+
+      case Playlist::Column_Bitrate:      entry.number1 = song.bitrate();         break;
+      case Playlist::Column_Samplerate:   entry.number1 = song.samplerate();      break;
+      case Playlist::Column_Bitdepth:     entry.number1 = song.bitdepth();        break;
+      case Playlist::Column_BaseFilename: entry.plain = song.basefilename();      break;
+      case Playlist::Column_Filesize:     entry.number1 = song.filesize();        break;
+      case Playlist::Column_Filetype:     entry.number1 = song.filetype();        break;
+      case Playlist::Column_DateModified: entry.number1 = song.mtime();           break;
+      case Playlist::Column_DateCreated:  entry.number1 = song.ctime();           break;
+
+      case Playlist::Column_Source:       entry.number1 = song.source();          break;
+
+      case Playlist::Column_Rating:       entry.number1 = song.rating();          break;
+
+      default: break;
+    }
+
+    chunk.entries.push_back(entry);
+  }
+
+}
+
+bool PlaylistSorter::Less(const int column, const Entry &a, const Entry &b) {
+
+  switch (column) {
+    case Playlist::Column_Album: {
+      const int result = a.text.compare(b.text);
+      if (result != 0) return result < 0;
+      if (a.number1 != b.number1) return a.number1 < b.number1;
+      return a.number2 < b.number2;
+    }
+    case Playlist::Column_Filename:
+      if (a.number1 != b.number1) return a.number1 < b.number1;
+      return a.text.compare(b.text) < 0;
+    case Playlist::Column_BaseFilename:
+      return a.plain < b.plain;
+    default:
+      if (IsTextColumn(column)) return a.text.compare(b.text) < 0;
+      return a.number1 < b.number1;
+  }
+
+}
@@ -0,0 +1,70 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PLAYLISTSORTER_H
+#define PLAYLISTSORTER_H
+
+#include "config.h"
+
+#include <vector>
+
+#include <QtGlobal>
+#include <QString>
+#include <QCollator>
+#include <QCollatorSortKey>
+
+#include "playlistitem.h"
+
+class QThreadPool;
+
+// Sorts playlist items by a column the way the playlist header does.
+// Every item gets its sort key once, text is lowercased and turned into a collation key, so the comparisons don't have to do that each time.
+// The keys are worked out in parallel on a thread pool of its own, so a sort doesn't wait behind long running jobs on the global pool.
+// Then the items are sorted with a single stable sort.
+class PlaylistSorter {
+ public:
+  static void Sort(const PlaylistItemList::iterator begin, const PlaylistItemList::iterator end, const int column, const Qt::SortOrder order);
+
+ private:
+  struct Entry {
+    Entry(const PlaylistItemPtr &_item, const QCollatorSortKey &_text) : item(_item), text(_text), number1(0), number2(0) {}
+    PlaylistItemPtr item;
+    QCollatorSortKey text;
+    QString plain;
+    double number1;
+    double number2;
+  };
+
+  struct Chunk {
+    Chunk() : column(-1) {}
+    int column;
+    PlaylistItemList::const_iterator begin;
+    PlaylistItemList::const_iterator end;
+    std::vector<Entry> entries;
+  };
+
+  static QThreadPool *ThreadPool();
+  static bool IsTextColumn(const int column);
+  static void MakeKeys(Chunk &chunk);
+  static bool Less(const int column, const Entry &a, const Entry &b);
+
+  static const int kMinChunkSize;
+};
+
+#endif  // PLAYLISTSORTER_H
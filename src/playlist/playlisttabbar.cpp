@@ -204,7 +204,7 @@ void PlaylistTabBar::Close() {
 
   const bool ask_for_delete = s.value("warn_close_playlist", true).toBool();
 
-  if (ask_for_delete && !manager_->IsPlaylistFavorite(playlist_id) && !manager_->playlist(playlist_id)->GetAllSongs().empty()) {
+  if (ask_for_delete && !manager_->IsPlaylistFavorite(playlist_id) && (!manager_->playlist(playlist_id)->is_restored() || !manager_->playlist(playlist_id)->GetAllSongs().empty())) {
     QMessageBox confirmation_box;
     confirmation_box.setWindowIcon(QIcon(":/icons/64x64/strawberry.png"));
     confirmation_box.setWindowTitle(tr("Remove playlist"));
@@ -24,6 +24,8 @@
 
 #include <QtGlobal>
 #include <QList>
+#include <QVector>
+#include <QMultiHash>
 #include <QUrl>
 #include <QUndoStack>
 
@@ -112,11 +114,60 @@ void MoveItems::undo() {
 }
 
 ReOrderItems::ReOrderItems(Playlist* playlist, const PlaylistItemList &new_items)
-    : Base(playlist), old_items_(playlist->items_), new_items_(new_items) {}
+    : Base(playlist), begin_(0) {
 
-void ReOrderItems::undo() { playlist_->ReOrderWithoutUndo(old_items_); }
+  const PlaylistItemList &old_items = playlist->items_;
 
-void ReOrderItems::redo() { playlist_->ReOrderWithoutUndo(new_items_); }
+  // Sorting after the current item of a dynamic playlist or shuffling after the first item leaves the other rows where they are.
+  int end = qMin(old_items.count(), new_items.count());
+  while (begin_ < end && old_items[begin_] == new_items[begin_]) ++begin_;
+  while (end > begin_ && old_items[end - 1] == new_items[end - 1]) --end;
+
+  QMultiHash<const PlaylistItem*, int> old_rows;
+  old_rows.reserve(end - begin_);
+  for (int row = begin_; row < end; ++row) {
+    old_rows.insert(old_items[row].get(), row);
+  }
+
+  // The same item can be in the playlist more than once, each of its rows is used once.
+  order_.reserve(end - begin_);
+  for (int row = begin_; row < end; ++row) {
+    QMultiHash<const PlaylistItem*, int>::iterator it = old_rows.find(new_items[row].get());
+    if (it == old_rows.end()) {
+      order_.clear();
+      break;
+    }
+    order_ << it.value();
+    old_rows.erase(it);
+  }
+
+}
+
+void ReOrderItems::undo() {
+
+  const PlaylistItemList &items = playlist_->items_;
+  if (order_.isEmpty() || items.count() < begin_ + order_.count()) return;
+
+  PlaylistItemList old_items = items;
+  for (int i = 0; i < order_.count(); ++i) {
+    old_items[order_[i]] = items[begin_ + i];
+  }
+  playlist_->ReOrderWithoutUndo(old_items);
+
+}
+
+void ReOrderItems::redo() {
+
+  const PlaylistItemList &items = playlist_->items_;
+  if (order_.isEmpty() || items.count() < begin_ + order_.count()) return;
+
+  PlaylistItemList new_items = items;
+  for (int i = 0; i < order_.count(); ++i) {
+    new_items[begin_ + i] = items[order_[i]];
+  }
+  playlist_->ReOrderWithoutUndo(new_items);
+
+}
 
 SortItems::SortItems(Playlist* playlist, int column, Qt::SortOrder order, const PlaylistItemList &new_items)
   : ReOrderItems(playlist, new_items) {
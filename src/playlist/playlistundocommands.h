@@ -23,8 +23,10 @@
 
 #include "config.h"
 
+#include <QtGlobal>
 #include <QCoreApplication>
 #include <QList>
+#include <QVector>
 #include <QUndoStack>
 
 #include "playlistitem.h"
@@ -35,6 +37,7 @@ namespace PlaylistUndoCommands {
 
   enum Types {
     Type_RemoveItems = 0,
+    Type_ReOrderItems,
   };
 
   class Base : public QUndoCommand {
@@ -98,16 +101,21 @@ namespace PlaylistUndoCommands {
     int pos_;
   };
 
+  // Stores the new order as the old rows of the items, only for the rows between the first and last one that moved.
   class ReOrderItems : public Base {
    public:
     explicit ReOrderItems(Playlist *playlist, const PlaylistItemList &new_items);
 
+    int id() const override { return Type_ReOrderItems; }
+    // The memory used by the stored order, in bytes.
+    qint64 memory_usage() const { return order_.count() * static_cast<qint64>(sizeof(qint32)); }
+
     void undo() override;
     void redo() override;
 
    private:
-    PlaylistItemList old_items_;
-    PlaylistItemList new_items_;
+    int begin_;
+    QVector<qint32> order_;
   };
 
   class SortItems : public ReOrderItems {
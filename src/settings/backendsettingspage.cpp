@@ -112,11 +112,14 @@ void BackendSettingsPage::Load() {
 
   ui_->spinbox_low_watermark->setValue(s.value("bufferlowwatermark", kDefaultBufferLowWatermark).toDouble());
   ui_->spinbox_high_watermark->setValue(s.value("bufferhighwatermark", kDefaultBufferHighWatermark).toDouble());
+  ui_->checkbox_preroll->setChecked(s.value("preroll", true).toBool());
 
   ui_->checkbox_replaygain->setChecked(s.value("rgenabled", false).toBool());
   ui_->combobox_replaygainmode->setCurrentIndex(s.value("rgmode", 0).toInt());
   ui_->stickslider_replaygainpreamp->setValue(s.value("rgpreamp", 0.0).toDouble() * 10 + 150);
   ui_->checkbox_replaygaincompression->setChecked(s.value("rgcompression", true).toBool());
+  ui_->checkbox_replaygainwritetags->setChecked(s.value("rgwritetags", false).toBool());
+  ui_->spinbox_replaygainanalysethreads->setValue(s.value("rganalysethreads", 2).toInt());
 
 #if defined(HAVE_ALSA)
   bool fade_default = false;
@@ -412,11 +415,14 @@ void BackendSettingsPage::Save() {
   s.setValue("bufferduration", ui_->spinbox_bufferduration->value());
   s.setValue("bufferlowwatermark", ui_->spinbox_low_watermark->value());
   s.setValue("bufferhighwatermark", ui_->spinbox_high_watermark->value());
+  s.setValue("preroll", ui_->checkbox_preroll->isChecked());
 
   s.setValue("rgenabled", ui_->checkbox_replaygain->isChecked());
   s.setValue("rgmode", ui_->combobox_replaygainmode->currentIndex());
   s.setValue("rgpreamp", float(ui_->stickslider_replaygainpreamp->value()) / 10 - 15);
   s.setValue("rgcompression", ui_->checkbox_replaygaincompression->isChecked());
+  s.setValue("rgwritetags", ui_->checkbox_replaygainwritetags->isChecked());
+  s.setValue("rganalysethreads", ui_->spinbox_replaygainanalysethreads->value());
 
   s.setValue("FadeoutEnabled", ui_->checkbox_fadeout_stop->isChecked());
   s.setValue("CrossfadeEnabled", ui_->checkbox_fadeout_cross->isChecked());
@@ -669,5 +675,6 @@ void BackendSettingsPage::BufferDefaults() {
   ui_->spinbox_bufferduration->setValue(kDefaultBufferDuration);
   ui_->spinbox_low_watermark->setValue(kDefaultBufferLowWatermark);
   ui_->spinbox_high_watermark->setValue(kDefaultBufferHighWatermark);
+  ui_->checkbox_preroll->setChecked(true);
 
 }
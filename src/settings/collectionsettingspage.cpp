@@ -156,8 +156,10 @@ void CollectionSettingsPage::Load() {
   ui_->show_dividers->setChecked(s.value("show_dividers", true).toBool());
   ui_->startup_scan->setChecked(s.value("startup_scan", true).toBool());
   ui_->monitor->setChecked(s.value("monitor", true).toBool());
+  ui_->change_journal->setChecked(s.value("change_journal", false).toBool());
   ui_->mark_songs_unavailable->setChecked(s.value("mark_songs_unavailable", false).toBool());
   ui_->live_scanning->setChecked(s.value("live_scanning", false).toBool());
+  ui_->spinbox_scan_threads->setValue(s.value("scan_threads", 1).toInt());
 
   QStringList filters = s.value("cover_art_patterns", QStringList() << "front" << "cover").toStringList();
   ui_->cover_art_patterns->setText(filters.join(","));
@@ -208,8 +210,10 @@ void CollectionSettingsPage::Save() {
   s.setValue("show_dividers", ui_->show_dividers->isChecked());
   s.setValue("startup_scan", ui_->startup_scan->isChecked());
   s.setValue("monitor", ui_->monitor->isChecked());
+  s.setValue("change_journal", ui_->change_journal->isChecked());
   s.setValue("mark_songs_unavailable", ui_->mark_songs_unavailable->isChecked());
   s.setValue("live_scanning", ui_->live_scanning->isChecked());
+  s.setValue("scan_threads", ui_->spinbox_scan_threads->value());
 
   QString filter_text = ui_->cover_art_patterns->text();
 
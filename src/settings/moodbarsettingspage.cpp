@@ -29,6 +29,7 @@
 #include <QSettings>
 #include <QCheckBox>
 #include <QComboBox>
+#include <QSpinBox>
 #include <QSize>
 
 #include "core/iconloader.h"
@@ -71,6 +72,8 @@ void MoodbarSettingsPage::Load() {
   ui_->moodbar_show->setChecked(s.value("show", false).toBool());
   ui_->moodbar_style->setCurrentIndex(s.value("style", 0).toInt());
   ui_->moodbar_save->setChecked(s.value("save", false).toBool());
+  ui_->moodbar_precompute->setChecked(s.value("precompute", false).toBool());
+  ui_->moodbar_store_size->setValue(s.value("store_size", 60).toInt());
   s.endGroup();
 
   InitMoodbarPreviews();
@@ -89,6 +92,8 @@ void MoodbarSettingsPage::Save() {
   s.setValue("show", ui_->moodbar_show->isChecked());
   s.setValue("style", ui_->moodbar_style->currentIndex());
   s.setValue("save", ui_->moodbar_save->isChecked());
+  s.setValue("precompute", ui_->moodbar_precompute->isChecked());
+  s.setValue("store_size", ui_->moodbar_store_size->value());
   s.endGroup();
 }
 
@@ -24,6 +24,7 @@
 #include <QSettings>
 #include <QCheckBox>
 #include <QRadioButton>
+#include <QSpinBox>
 
 #include "core/iconloader.h"
 #include "playlist/playlist.h"
@@ -65,6 +66,7 @@ void PlaylistSettingsPage::Load() {
   ui_->checkbox_select_track->setChecked(s.value("select_track", false).toBool());
   ui_->checkbox_playlist_clear->setChecked(s.value("playlist_clear", true).toBool());
   ui_->checkbox_auto_sort->setChecked(s.value("auto_sort", false).toBool());
+  ui_->spinbox_undo_memory_limit->setValue(s.value(Playlist::kUndoMemoryLimit, Playlist::kUndoMemoryLimitDefault).toInt());
 
   Playlist::Path path = Playlist::Path(s.value(Playlist::kPathType, Playlist::Path_Automatic).toInt());
   switch (path) {
@@ -130,6 +132,7 @@ void PlaylistSettingsPage::Save() {
   s.setValue(Playlist::kWriteMetadata, ui_->checkbox_writemetadata->isChecked());
   s.setValue("delete_files", ui_->checkbox_delete_files->isChecked());
   s.setValue("auto_sort", ui_->checkbox_auto_sort->isChecked());
+  s.setValue(Playlist::kUndoMemoryLimit, ui_->spinbox_undo_memory_limit->value());
   s.endGroup();
 
 }
@@ -0,0 +1,162 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "core/timeconstants.h"
+#include "engine/enginebase.h"
+#include "analyzer/fht.h"
+#include "analyzer/analyzerbase.h"
+#include "analyzer/blockanalyzer.h"
+#include "analyzer/boomanalyzer.h"
+#include "analyzer/rainbowanalyzer.h"
+
+namespace {
+
+// Does the work of a paint event apart from the drawing, so the analyzers can be driven without showing them.
+template <typename T>
+class AnalyzerHarness : public T {
+ public:
+  AnalyzerHarness() : T(nullptr) {}
+
+  float Frame(const Engine::Scope &scope) {
+    this->convertScope(scope);
+    this->transform(this->lastscope_);
+    float sum = 0;
+    for (const float value : this->lastscope_) sum += value;
+    this->lastscope_.resize(this->fht_->size());
+    return sum;
+  }
+
+  const float *scope_data() const { return this->lastscope_.data(); }
+};
+
+class AnalyzerTest : public ::testing::Test {
+ protected:
+  // Interleaved stereo samples of a few tones, as the engine hands them out.
+  static Engine::Scope MakeSamples(const int frames) {
+    Engine::Scope samples(frames * 2);
+    for (int i = 0; i < frames; ++i) {
+      const double t = static_cast<double>(i) / 44100;
+      const double value = 0.4 * sin(2 * M_PI * 440 * t) + 0.2 * sin(2 * M_PI * 2500 * t) + 0.1 * sin(2 * M_PI * 9000 * t);
+      samples[i * 2] = static_cast<qint16>(value * 32767);
+      samples[i * 2 + 1] = static_cast<qint16>(value * 0.8 * 32767);
+    }
+    return samples;
+  }
+
+  template <typename T>
+  static void Benchmark(const char *name) {
+
+    const int kFrames = 600;  // 10 seconds at 60 frames per second
+    const int kWindowSize = 1024;
+
+    const Engine::Scope samples = MakeSamples(kFrames * 64 + kWindowSize / 2);
+    Engine::Scope window(kWindowSize);
+
+    std::unique_ptr<AnalyzerHarness<T>> analyzer(new AnalyzerHarness<T>);
+
+    // The first frame sizes the buffers, after that no frame should need to allocate.
+    std::copy(samples.begin(), samples.begin() + kWindowSize, window.begin());
+    analyzer->Frame(window);
+    const float *scope_data = analyzer->scope_data();
+
+    float sum = 0;
+    qint64 slowest_nsec = 0;
+    QElapsedTimer timer;
+    QElapsedTimer frame_timer;
+    timer.start();
+    for (int frame = 0; frame < kFrames; ++frame) {
+      frame_timer.start();
+      std::copy(samples.begin() + frame * 128, samples.begin() + frame * 128 + kWindowSize, window.begin());
+      sum += analyzer->Frame(window);
+      slowest_nsec = qMax(slowest_nsec, frame_timer.nsecsElapsed());
+    }
+    const qint64 average_nsec = timer.nsecsElapsed() / kFrames;
+
+    EXPECT_GT(sum, 0);
+    EXPECT_EQ(scope_data, analyzer->scope_data());
+    EXPECT_LT(average_nsec, kNsecPerSec / 60);
+
+    qLog(Info) << name << "transform:" << average_nsec << "ns per frame on average," << slowest_nsec << "ns for the slowest frame";
+
+  }
+};
+
+TEST_F(AnalyzerTest, HartleyTransform) {
+
+  for (int exp = 3; exp <= 9; ++exp) {
+    FHT fht(exp);
+    const int size = fht.size();
+    ASSERT_EQ(1 << exp, size);
+
+    std::vector<float> values(size);
+    for (int i = 0; i < size; ++i) values[i] = static_cast<float>(sin(i * 0.37) + cos(i * 1.91) * 0.5);
+    std::vector<float> transformed(values);
+    fht.transform(transformed.data());
+
+    // Compare against the definition: H(k) = sum of x(n) * (cos(2 pi k n / N) + sin(2 pi k n / N)).
+    for (int k = 0; k < size; ++k) {
+      double expected = 0;
+      for (int n = 0; n < size; ++n) {
+        const double angle = 2 * M_PI * k * n / size;
+        expected += values[n] * (cos(angle) + sin(angle));
+      }
+      EXPECT_NEAR(expected, transformed[k], 1e-4 * size) << "size " << size << " index " << k;
+    }
+  }
+
+}
+
+TEST_F(AnalyzerTest, SpectrumPeak) {
+
+  FHT fht(9);
+  std::vector<float> values(fht.size());
+  for (int i = 0; i < fht.size(); ++i) values[i] = static_cast<float>(sin(2 * M_PI * 32 * i / fht.size()));
+  fht.spectrum(values.data());
+
+  int peak = 0;
+  for (int i = 1; i < fht.size() / 2; ++i) {
+    if (values[i] > values[peak]) peak = i;
+  }
+  EXPECT_EQ(32, peak);
+
+}
+
+TEST_F(AnalyzerTest, BlockAnalyzerBenchmark) {
+  Benchmark<BlockAnalyzer>("Block analyzer");
+}
+
+TEST_F(AnalyzerTest, BoomAnalyzerBenchmark) {
+  Benchmark<BoomAnalyzer>("Boom analyzer");
+}
+
+TEST_F(AnalyzerTest, RainbowAnalyzerBenchmark) {
+  Benchmark<Rainbow::NyanCatAnalyzer>("Rainbow analyzer");
+}
+
+}  // namespace
@@ -23,9 +23,17 @@
 
 #include <gtest/gtest.h>
 
+#include <QtNumeric>
 #include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QTemporaryDir>
 #include <QSignalSpy>
 #include <QThread>
+#include <QMap>
+#include <QUrl>
 #include <QtDebug>
 
 #include "test_utils.h"
@@ -143,6 +151,235 @@ TEST_F(CollectionBackendTest, AddInvalidSong) {
 TEST_F(CollectionBackendTest, GetAlbumArtNonExistent) {
 }
 
+TEST_F(CollectionBackendTest, DatabaseTuning) {
+
+  QSqlDatabase db(database_->Connect());
+  QSqlQuery q(db);
+
+  // NORMAL
+  ASSERT_TRUE(q.exec("PRAGMA synchronous"));
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(1, q.value(0).toInt());
+
+  // MEMORY
+  ASSERT_TRUE(q.exec("PRAGMA temp_store"));
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(2, q.value(0).toInt());
+
+  ASSERT_TRUE(q.exec("PRAGMA cache_size"));
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(-database_->tuning().cache_size, q.value(0).toInt());
+  q.finish();
+
+  const QString diagnostics = database_->Diagnostics();
+  EXPECT_TRUE(diagnostics.contains("busy_timeout: " + QString::number(database_->tuning().busy_timeout)));
+  EXPECT_TRUE(diagnostics.contains("page cache:"));
+
+}
+
+TEST_F(CollectionBackendTest, ReadOnlyConnections) {
+
+  // An in-memory database can't be shared between connections.
+  EXPECT_EQ(database_->Mutex(), database_->ReadMutex());
+  EXPECT_EQ(database_->Connect().connectionName(), database_->ConnectReadOnly().connectionName());
+
+  QTemporaryDir dir;
+  ASSERT_TRUE(dir.isValid());
+  std::unique_ptr<Database> database(new Database(nullptr, nullptr, dir.filePath("strawberry.db")));
+  {
+    std::unique_ptr<CollectionBackend> backend(new CollectionBackend);
+    backend->Init(database.get(), Song::Source_Collection, SCollection::kSongsTable, SCollection::kDirsTable, SCollection::kSubdirsTable, SCollection::kFtsTable);
+    backend->AddDirectory("/tmp");
+
+    Song song = MakeDummySong(1);
+    song.set_title("Title");
+    backend->AddOrUpdateSongs(SongList() << song);
+
+    EXPECT_EQ(nullptr, database->ReadMutex());
+    QSqlDatabase db(database->ConnectReadOnly());
+    EXPECT_NE(database->Connect().connectionName(), db.connectionName());
+
+    // Reads go through the read-only connection and see what the writer committed.
+    SongList songs = backend->GetAllSongs();
+    ASSERT_EQ(1, songs.count());
+    EXPECT_EQ("Title", songs[0].title());
+
+    QSqlQuery q(db);
+    EXPECT_FALSE(q.exec(QString("DELETE FROM %1").arg(SCollection::kSongsTable)));
+    EXPECT_EQ(1, backend->GetAllSongs().count());
+  }
+  database->Close();
+
+}
+
+TEST_F(CollectionBackendTest, UpgradeFromSchema14) {
+
+  QTemporaryDir dir;
+  ASSERT_TRUE(dir.isValid());
+  const QString filename = dir.filePath("strawberry.db");
+
+  // Only the tables the later schema updates touch, as they were in version 14.
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "schema14");
+    db.setDatabaseName(filename);
+    ASSERT_TRUE(db.open());
+    QSqlQuery q(db);
+    ASSERT_TRUE(q.exec("CREATE TABLE schema_version (version INTEGER NOT NULL)"));
+    ASSERT_TRUE(q.exec("INSERT INTO schema_version (version) VALUES (14)"));
+    ASSERT_TRUE(q.exec("CREATE TABLE songs (title TEXT, url TEXT NOT NULL)"));
+    ASSERT_TRUE(q.exec("CREATE TABLE playlist_items (playlist INTEGER NOT NULL, type TEXT, collection_id INTEGER, title TEXT)"));
+    ASSERT_TRUE(q.exec("INSERT INTO playlist_items (playlist, type, title) VALUES (1, 'Stream', 'One')"));
+    ASSERT_TRUE(q.exec("INSERT INTO playlist_items (playlist, type, title) VALUES (1, 'Stream', 'Two')"));
+    q.finish();
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("schema14");
+
+  std::unique_ptr<Database> database(new Database(nullptr, nullptr, filename));
+  EXPECT_EQ(14, database->startup_schema_version());
+  {
+    QSqlDatabase db(database->Connect());
+    QSqlQuery q(db);
+    ASSERT_TRUE(q.exec("SELECT version FROM schema_version"));
+    ASSERT_TRUE(q.next());
+    EXPECT_EQ(Database::kSchemaVersion, q.value(0).toInt());
+
+    for (const QString &table : QStringList() << "songs" << "playlist_items") {
+      EXPECT_TRUE(db.record(table).contains("replaygain_track_gain")) << table.toStdString();
+      EXPECT_TRUE(db.record(table).contains("replaygain_album_peak")) << table.toStdString();
+    }
+
+    ASSERT_TRUE(q.exec("SELECT title FROM playlist_items ORDER BY position"));
+    ASSERT_TRUE(q.next());
+    EXPECT_EQ("One", q.value(0).toString());
+    ASSERT_TRUE(q.next());
+    EXPECT_EQ("Two", q.value(0).toString());
+    q.finish();
+  }
+  database->Close();
+
+}
+
+TEST_F(CollectionBackendTest, UpdateManySongs) {
+
+  backend_->AddDirectory("/tmp");
+
+  // More songs than fit in one multi-row statement
+  const int count = 2 * CollectionBackend::kMaxSqlVariables / Song::kColumns.count() + 3;
+
+  SongList songs;
+  for (int i = 0; i < count; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_title(QString("Title %1").arg(i));
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  songs = backend_->FindSongsInDirectory(1);
+  ASSERT_EQ(count, songs.count());
+
+  for (Song &song : songs) {
+    song.set_title("Updated " + song.title());
+  }
+
+  QSignalSpy deleted_spy(backend_.get(), SIGNAL(SongsDeleted(SongList)));
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+
+  backend_->AddOrUpdateSongs(songs);
+
+  ASSERT_EQ(1, deleted_spy.size());
+  ASSERT_EQ(1, added_spy.size());
+  EXPECT_EQ(count, reinterpret_cast<SongList*>(deleted_spy[0][0].data())->count());
+  EXPECT_EQ(count, reinterpret_cast<SongList*>(added_spy[0][0].data())->count());
+
+  songs = backend_->FindSongsInDirectory(1);
+  ASSERT_EQ(count, songs.count());
+  for (const Song &song : songs) {
+    EXPECT_TRUE(song.title().startsWith("Updated "));
+  }
+
+  // The FTS index has one row per song, with the new titles
+  QSqlDatabase db(database_->Connect());
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT COUNT(*) FROM %1 WHERE ftstitle MATCH 'Updated'").arg(SCollection::kFtsTable));
+  q.exec();
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(count, q.value(0).toInt());
+
+  q.prepare(QString("SELECT COUNT(*) FROM %1").arg(SCollection::kFtsTable));
+  q.exec();
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(count, q.value(0).toInt());
+
+}
+
+TEST_F(CollectionBackendTest, UpdateSameSongTwiceInBatch) {
+
+  backend_->AddDirectory("/tmp");
+
+  Song song = MakeDummySong(1);
+  song.set_title("Title");
+  song.set_url(QUrl::fromLocalFile("/tmp/song.flac"));
+  backend_->AddOrUpdateSongs(SongList() << song);
+
+  song = backend_->GetSongById(1);
+  ASSERT_TRUE(song.is_valid());
+
+  Song first = song;
+  first.set_title("First");
+  Song second = song;
+  second.set_title("Second");
+
+  QSignalSpy deleted_spy(backend_.get(), SIGNAL(SongsDeleted(SongList)));
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+
+  backend_->AddOrUpdateSongs(SongList() << first << second);
+
+  // The row is written once, with the last version of the song
+  ASSERT_EQ(1, deleted_spy.size());
+  ASSERT_EQ(1, added_spy.size());
+  EXPECT_EQ(1, reinterpret_cast<SongList*>(deleted_spy[0][0].data())->count());
+  SongList added = *reinterpret_cast<SongList*>(added_spy[0][0].data());
+  ASSERT_EQ(1, added.count());
+  EXPECT_EQ("Second", added[0].title());
+
+  SongList songs = backend_->FindSongsInDirectory(1);
+  ASSERT_EQ(1, songs.count());
+  EXPECT_EQ("Second", songs[0].title());
+
+}
+
+TEST_F(CollectionBackendTest, GetSongUrlsAfterId) {
+
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i = 0; i < 5; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_title(QString("Title %1").arg(i));
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song %1.flac").arg(i)));
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  // Unavailable songs are skipped
+  Song unavailable = backend_->GetSongById(2);
+  backend_->MarkSongsUnavailable(SongList() << unavailable);
+
+  QMap<int, QUrl> urls = backend_->GetSongUrlsAfterId(0, 2);
+  ASSERT_EQ(2, urls.count());
+  EXPECT_EQ(QList<int>() << 1 << 3, urls.keys());
+  EXPECT_EQ(QUrl::fromLocalFile("/tmp/song 0.flac"), urls[1]);
+  EXPECT_EQ(3, backend_->GetSongCountAfterId(1));
+
+  urls = backend_->GetSongUrlsAfterId(3, 10);
+  EXPECT_EQ(QList<int>() << 4 << 5, urls.keys());
+  EXPECT_EQ(QUrl::fromLocalFile("/tmp/song 4.flac"), urls[5]);
+  EXPECT_EQ(0, backend_->GetSongCountAfterId(5));
+
+}
+
 // Test adding a single song to the database, then getting various information back about it.
 class SingleSong : public CollectionBackendTest {
  protected:
@@ -304,6 +541,53 @@ TEST_F(SingleSong, UpdateSong) {
 
 }
 
+TEST_F(SingleSong, UpdateSongsReplayGain) {
+
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  Song song = backend_->GetSongById(1);
+  EXPECT_FALSE(song.has_replaygain());
+
+  song.set_replaygain(-6.5F, 0.95F, -7.25F, 1.0F);
+
+  QSignalSpy changed_spy(backend_.get(), SIGNAL(SongsReplayGainChanged(SongList)));
+  backend_->UpdateSongsReplayGain(SongList() << song);
+  ASSERT_EQ(1, changed_spy.size());
+
+  song = backend_->GetSongById(1);
+  EXPECT_TRUE(song.has_replaygain());
+  EXPECT_FLOAT_EQ(-6.5F, song.replaygain_track_gain());
+  EXPECT_FLOAT_EQ(0.95F, song.replaygain_track_peak());
+  EXPECT_FLOAT_EQ(-7.25F, song.replaygain_album_gain());
+  EXPECT_FLOAT_EQ(1.0F, song.replaygain_album_peak());
+
+  // Songs without an album only get a track gain, the album values stay empty.
+  song.set_replaygain(2.0F, 0.5F, qQNaN(), qQNaN());
+  backend_->UpdateSongsReplayGain(SongList() << song);
+  song = backend_->GetSongById(1);
+  EXPECT_FLOAT_EQ(2.0F, song.replaygain_track_gain());
+  EXPECT_TRUE(qIsNaN(song.replaygain_album_gain()));
+
+}
+
+TEST_F(SingleSong, SongIdsWithoutReplayGain) {
+
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  EXPECT_EQ(QList<int>() << 1, backend_->GetSongIdsWithoutReplayGain());
+  EXPECT_EQ(1, backend_->GetSongsOnSameAlbums(QList<int>() << 1).count());
+
+  // Songs that couldn't be analysed are skipped until the file changes.
+  Song song = backend_->GetSongById(1);
+  backend_->SetSongsReplayGainFailed(SongList() << song);
+  EXPECT_TRUE(backend_->GetSongIdsWithoutReplayGain().isEmpty());
+
+  song.set_mtime(2);
+  backend_->UpdateMTimesOnly(SongList() << song);
+  EXPECT_EQ(QList<int>() << 1, backend_->GetSongIdsWithoutReplayGain());
+
+}
+
 TEST_F(SingleSong, DeleteSongs) {
 
   AddDummySong();  if (HasFatalFailure()) return;
@@ -0,0 +1,106 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+
+#include "engine/ebur128meter.h"
+
+namespace {
+
+// Interleaved samples of a sine with the same amplitude in every channel.
+std::vector<float> MakeSine(const int channels, const int rate, const double frequency, const double amplitude, const double seconds) {
+  const int frames = static_cast<int>(rate * seconds);
+  std::vector<float> samples(frames * channels);
+  for (int i = 0; i < frames; ++i) {
+    const float value = static_cast<float>(amplitude * sin(2 * M_PI * frequency * i / rate));
+    for (int channel = 0; channel < channels; ++channel) samples[i * channels + channel] = value;
+  }
+  return samples;
+}
+
+TEST(EbuR128MeterTest, Sine) {
+
+  // A 1 kHz sine at -20 dBFS in both stereo channels measures -20 LUFS.
+  for (const int rate : { 44100, 48000, 96000 }) {
+    EbuR128Meter meter(2, rate);
+    const std::vector<float> samples = MakeSine(2, rate, 997, 0.1, 10);
+    meter.AddFrames(samples.data(), samples.size() / 2);
+    EXPECT_NEAR(-20.0, meter.IntegratedLoudness(), 0.1) << rate;
+    EXPECT_NEAR(0.1, meter.peak(), 0.001);
+    EXPECT_NEAR(2.0, EbuR128Meter::Gain(meter.IntegratedLoudness()), 0.1);
+  }
+
+  // In one channel only it's 3 dB lower.
+  EbuR128Meter mono(1, 48000);
+  const std::vector<float> samples = MakeSine(1, 48000, 997, 1.0, 5);
+  mono.AddFrames(samples.data(), samples.size());
+  EXPECT_NEAR(-3.01, mono.IntegratedLoudness(), 0.1);
+
+}
+
+TEST(EbuR128MeterTest, Gating) {
+
+  const int rate = 48000;
+  EbuR128Meter meter(2, rate);
+
+  // Silence is below the absolute gate.
+  std::vector<float> silence(rate * 2 * 5, 0.0F);
+  meter.AddFrames(silence.data(), rate * 5);
+  EXPECT_EQ(-HUGE_VAL, meter.IntegratedLoudness());
+
+  // A part 30 dB quieter is below the relative gate.
+  const std::vector<float> loud = MakeSine(2, rate, 997, 0.1, 10);
+  const std::vector<float> quiet = MakeSine(2, rate, 997, 0.1 / 31.6, 10);
+  meter.AddFrames(loud.data(), loud.size() / 2);
+  meter.AddFrames(quiet.data(), quiet.size() / 2);
+  // The few blocks that span the changes still count.
+  EXPECT_NEAR(-20.0, meter.IntegratedLoudness(), 0.2);
+
+  // 400 ms blocks every 100 ms.
+  EXPECT_EQ(static_cast<size_t>(25 * 10 - 3), meter.blocks().size());
+
+}
+
+TEST(EbuR128MeterTest, Album) {
+
+  const int rate = 44100;
+  EbuR128Meter loud(2, rate);
+  EbuR128Meter quiet(2, rate);
+
+  const std::vector<float> loud_samples = MakeSine(2, rate, 997, 0.1, 10);
+  const std::vector<float> quiet_samples = MakeSine(2, rate, 997, 0.05, 10);
+  loud.AddFrames(loud_samples.data(), loud_samples.size() / 2);
+  quiet.AddFrames(quiet_samples.data(), quiet_samples.size() / 2);
+
+  std::vector<double> blocks = loud.blocks();
+  blocks.insert(blocks.end(), quiet.blocks().begin(), quiet.blocks().end());
+
+  // The mean power of -20 and -26 LUFS.
+  const double album = EbuR128Meter::IntegratedLoudness(blocks);
+  EXPECT_NEAR(10 * log10((pow(10, -2.0) + pow(10, -2.6)) / 2), album, 0.1);
+  EXPECT_GT(album, quiet.IntegratedLoudness());
+  EXPECT_LT(album, loud.IntegratedLoudness());
+
+}
+
+}  // namespace
@@ -0,0 +1,164 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "moodbar/moodbarstore.h"
+
+namespace {
+
+class MoodbarStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(dir_.isValid());
+    filename_ = dir_.path() + "/moodbar.store";
+  }
+
+  static QUrl MakeUrl(const int i) {
+    return QUrl::fromLocalFile(QString("/music/song %1.flac").arg(i));
+  }
+
+  // Moodbar data is three bytes per sample.
+  static QByteArray MakeMoodbar(const int i, const int size = 3000) {
+    QByteArray data(size, 0);
+    for (int j = 0; j < size; ++j) data[j] = static_cast<char>((i + j) & 0xff);
+    return data;
+  }
+
+  QTemporaryDir dir_;
+  QString filename_;
+};
+
+TEST_F(MoodbarStoreTest, InsertAndGet) {
+
+  MoodbarStore store(filename_);
+  ASSERT_TRUE(store.Open());
+
+  EXPECT_FALSE(store.Contains(MakeUrl(1)));
+  EXPECT_TRUE(store.Get(MakeUrl(1)).isNull());
+
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(store.Insert(MakeUrl(i), MakeMoodbar(i)));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(store.Contains(MakeUrl(i)));
+    EXPECT_EQ(MakeMoodbar(i), store.Get(MakeUrl(i)));
+  }
+  EXPECT_FALSE(store.Contains(MakeUrl(100)));
+
+  // Replacing a moodbar
+  ASSERT_TRUE(store.Insert(MakeUrl(5), MakeMoodbar(50, 1500)));
+  EXPECT_EQ(MakeMoodbar(50, 1500), store.Get(MakeUrl(5)));
+
+  store.Clear();
+  EXPECT_FALSE(store.Contains(MakeUrl(1)));
+
+}
+
+TEST_F(MoodbarStoreTest, Reopen) {
+
+  {
+    MoodbarStore store(filename_);
+    ASSERT_TRUE(store.Open());
+    ASSERT_TRUE(store.Insert(MakeUrl(1), MakeMoodbar(1)));
+  }
+
+  {
+    MoodbarStore store(filename_);
+    ASSERT_TRUE(store.Open());
+    EXPECT_EQ(MakeMoodbar(1), store.Get(MakeUrl(1)));
+  }
+
+  // A different size starts over.
+  MoodbarStore store(filename_, 1024 * 1024);
+  ASSERT_TRUE(store.Open());
+  EXPECT_FALSE(store.Contains(MakeUrl(1)));
+  EXPECT_EQ(store.data_size() + 1024 * 24 + 64, QFile(filename_).size());
+
+}
+
+TEST_F(MoodbarStoreTest, OldestOverwritten) {
+
+  // 21 moodbars fit in the data area.
+  MoodbarStore store(filename_, 64 * 1024);
+  ASSERT_TRUE(store.Open());
+
+  const int count = 40;
+  for (int i = 0; i < count; ++i) {
+    ASSERT_TRUE(store.Insert(MakeUrl(i), MakeMoodbar(i)));
+  }
+
+  // The newest ones are all there, the ones that were written over are gone.
+  for (int i = 0; i < count; ++i) {
+    if (i >= count - 21) {
+      EXPECT_EQ(MakeMoodbar(i), store.Get(MakeUrl(i))) << i;
+    }
+    else {
+      EXPECT_FALSE(store.Contains(MakeUrl(i))) << i;
+    }
+  }
+
+  EXPECT_FALSE(store.Insert(MakeUrl(count), QByteArray(65 * 1024, 1)));
+  EXPECT_EQ(64 * 1024 + 256 * 24 + 64, QFile(filename_).size());
+
+}
+
+TEST_F(MoodbarStoreTest, DamagedSlotIgnored) {
+
+  const qint64 data_size = 64 * 1024;
+  {
+    MoodbarStore store(filename_, data_size);
+    ASSERT_TRUE(store.Open());
+    ASSERT_TRUE(store.Insert(MakeUrl(1), MakeMoodbar(1)));
+  }
+
+  // Point the slot past the end of the data area, with a write position that otherwise makes it look valid.
+  QFile file(filename_);
+  ASSERT_TRUE(file.open(QIODevice::ReadWrite));
+  QByteArray contents = file.readAll();
+  for (int i = 0; i < 256; ++i) {
+    const int offset = 64 + i * 24;
+    quint64 key = 0;
+    memcpy(&key, contents.constData() + offset, sizeof(key));
+    if (key == 0) continue;
+    const quint64 pos = data_size - 10;
+    const quint64 write_pos = pos + 3000;
+    memcpy(contents.data() + offset + 8, &pos, sizeof(pos));
+    memcpy(contents.data() + 24, &write_pos, sizeof(write_pos));
+  }
+  ASSERT_TRUE(file.seek(0));
+  ASSERT_EQ(contents.size(), file.write(contents));
+  file.close();
+
+  MoodbarStore store(filename_, data_size);
+  ASSERT_TRUE(store.Open());
+  EXPECT_FALSE(store.Contains(MakeUrl(1)));
+  EXPECT_TRUE(store.Get(MakeUrl(1)).isNull());
+
+}
+
+}  // namespace
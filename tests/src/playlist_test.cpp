@@ -20,21 +20,31 @@
  */
 
 #include <memory>
+#include <algorithm>
+#include <functional>
 
 #include <gtest/gtest.h>
 
 #include "test_utils.h"
 
+#include "core/logging.h"
 #include "collection/collectionplaylistitem.h"
 #include "playlist/playlist.h"
+#include "playlist/playlistsorter.h"
+#include "playlist/songplaylistitem.h"
 #include "mock_settingsprovider.h"
 #include "mock_playlistitem.h"
 
 #include <QtDebug>
+#include <QElapsedTimer>
+#include <QSortFilterProxyModel>
 #include <QUndoStack>
 
 using ::testing::Return;
 
+using std::placeholders::_1;
+using std::placeholders::_2;
+
 namespace {
 
 class PlaylistTest : public ::testing::Test {
@@ -63,6 +73,41 @@ class PlaylistTest : public ::testing::Test {
     return PlaylistItemPtr(MakeMockItem(title, artist, album, length));
   }
 
+  static PlaylistItemPtr MakeSongItem(const QString &title, const QString &album, const int disc, const int track) {
+    Song song;
+    song.Init(title, "Artist", album, 123);
+    song.set_disc(disc);
+    song.set_track(track);
+    return PlaylistItemPtr(new SongPlaylistItem(song));
+  }
+
+  // A synthetic playlist of albums with several discs, in shuffled order.
+  static PlaylistItemList MakeSortItems(const int count) {
+    PlaylistItemList items;
+    items.reserve(count);
+    for (int i = 0; i < count; ++i) {
+      const int n = static_cast<int>((static_cast<quint64>(i) * 7919) % count);
+      items << MakeSongItem(QString("Title %1").arg(n), QString("Album %1").arg(n / 24), n % 24 / 12 + 1, n % 12 + 1);
+    }
+    return items;
+  }
+
+  // Sorting by album the way it was done before the sort keys, for comparison.
+  static bool CompareItemsReference(const int column, const PlaylistItemPtr &a, const PlaylistItemPtr &b) {
+    switch (column) {
+      case Playlist::Column_Album: return QString::localeAwareCompare(a->Metadata().album_sortable().toLower(), b->Metadata().album_sortable().toLower()) < 0;
+      case Playlist::Column_Disc:  return a->Metadata().disc() < b->Metadata().disc();
+      case Playlist::Column_Track: return a->Metadata().track() < b->Metadata().track();
+      default: return false;
+    }
+  }
+
+  static void SortByAlbumReference(PlaylistItemList *items) {
+    std::stable_sort(items->begin(), items->end(), std::bind(&PlaylistTest::CompareItemsReference, Playlist::Column_Track, _1, _2));
+    std::stable_sort(items->begin(), items->end(), std::bind(&PlaylistTest::CompareItemsReference, Playlist::Column_Disc, _1, _2));
+    std::stable_sort(items->begin(), items->end(), std::bind(&PlaylistTest::CompareItemsReference, Playlist::Column_Album, _1, _2));
+  }
+
   Playlist playlist_;
   PlaylistSequence sequence_;
 
@@ -541,4 +586,160 @@ TEST_F(PlaylistTest, CollectionIdMapMulti) {
 }
 
 
+TEST_F(PlaylistTest, SortByAlbum) {
+
+  playlist_.InsertItems(PlaylistItemList()
+    << MakeSongItem("c", "Album b", 1, 2)
+    << MakeSongItem("a", "album A", 2, 1)
+    << MakeSongItem("b", "Album b", 1, 1)
+    << MakeSongItem("d", "Album A", 1, 1)
+    << MakeSongItem("e", "Album b", 1, 1));
+
+  playlist_.sort(Playlist::Column_Album, Qt::AscendingOrder);
+  ASSERT_EQ(5, playlist_.rowCount(QModelIndex()));
+  EXPECT_EQ("d", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("a", playlist_.item_at(1)->Metadata().title());
+  EXPECT_EQ("b", playlist_.item_at(2)->Metadata().title());
+  EXPECT_EQ("e", playlist_.item_at(3)->Metadata().title());
+  EXPECT_EQ("c", playlist_.item_at(4)->Metadata().title());
+
+  // Equal items keep their order.
+  playlist_.sort(Playlist::Column_Album, Qt::DescendingOrder);
+  EXPECT_EQ("c", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("b", playlist_.item_at(1)->Metadata().title());
+  EXPECT_EQ("e", playlist_.item_at(2)->Metadata().title());
+  EXPECT_EQ("a", playlist_.item_at(3)->Metadata().title());
+  EXPECT_EQ("d", playlist_.item_at(4)->Metadata().title());
+
+  playlist_.sort(Playlist::Column_Title, Qt::AscendingOrder);
+  EXPECT_EQ("a", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("e", playlist_.item_at(4)->Metadata().title());
+
+}
+
+TEST_F(PlaylistTest, UndoSort) {
+
+  // The same item twice.
+  PlaylistItemPtr b = MakeSongItem("b", "Album", 1, 1);
+  playlist_.InsertItems(PlaylistItemList() << MakeSongItem("c", "Album", 1, 1) << b << MakeSongItem("a", "Album", 1, 1) << b);
+
+  playlist_.sort(Playlist::Column_Title, Qt::AscendingOrder);
+  ASSERT_EQ(4, playlist_.rowCount(QModelIndex()));
+  EXPECT_EQ("a", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("b", playlist_.item_at(1)->Metadata().title());
+  EXPECT_EQ("b", playlist_.item_at(2)->Metadata().title());
+  EXPECT_EQ("c", playlist_.item_at(3)->Metadata().title());
+
+  ASSERT_TRUE(playlist_.undo_stack()->canUndo());
+  EXPECT_EQ("sort songs", playlist_.undo_stack()->undoText());
+  playlist_.undo_stack()->undo();
+  EXPECT_EQ("c", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ(b, playlist_.item_at(1));
+  EXPECT_EQ("a", playlist_.item_at(2)->Metadata().title());
+  EXPECT_EQ(b, playlist_.item_at(3));
+
+  playlist_.undo_stack()->redo();
+  EXPECT_EQ("a", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ(b, playlist_.item_at(1));
+  EXPECT_EQ(b, playlist_.item_at(2));
+  EXPECT_EQ("c", playlist_.item_at(3)->Metadata().title());
+
+}
+
+TEST_F(PlaylistTest, UndoShuffle) {
+
+  PlaylistItemList items;
+  for (int i = 0; i < 100; ++i) {
+    items << MakeMockItemP("Item " + QString::number(i));
+  }
+  playlist_.InsertItems(items);
+
+  playlist_.Shuffle();
+  const PlaylistItemList shuffled = playlist_.GetAllItems();
+  ASSERT_EQ(items.count(), shuffled.count());
+
+  ASSERT_TRUE(playlist_.undo_stack()->canUndo());
+  EXPECT_EQ("shuffle songs", playlist_.undo_stack()->undoText());
+  playlist_.undo_stack()->undo();
+  EXPECT_EQ(items, playlist_.GetAllItems());
+
+  playlist_.undo_stack()->redo();
+  EXPECT_EQ(shuffled, playlist_.GetAllItems());
+
+}
+
+TEST_F(PlaylistTest, SortBenchmark) {
+
+  QList<int> counts = QList<int>() << 10000;
+  // A million items takes a few GB of memory, so the large sorts only when asked for.
+  if (qEnvironmentVariableIsSet("STRAWBERRY_LARGE_BENCHMARKS")) counts << 100000 << 1000000;
+
+  for (const int count : counts) {
+    const PlaylistItemList items = MakeSortItems(count);
+
+    PlaylistItemList reference_items = items;
+    QElapsedTimer timer;
+    timer.start();
+    SortByAlbumReference(&reference_items);
+    const qint64 reference_msec = timer.elapsed();
+
+    PlaylistItemList sorted_items = items;
+    timer.restart();
+    PlaylistSorter::Sort(sorted_items.begin(), sorted_items.end(), Playlist::Column_Album, Qt::AscendingOrder);
+    const qint64 sorted_msec = timer.elapsed();
+
+    ASSERT_EQ(reference_items.count(), sorted_items.count());
+    for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(reference_items[i], sorted_items[i]) << "at row" << i;
+    }
+
+    qLog(Info) << "Sorting" << count << "items by album:" << reference_msec << "ms comparing strings," << sorted_msec << "ms with sort keys";
+  }
+
+}
+
+TEST_F(PlaylistTest, FilterRefine) {
+
+  playlist_.InsertItems(PlaylistItemList()
+    << MakeSongItem("Foo", "Album a", 1, 1)
+    << MakeSongItem("Foobar", "Album a", 1, 2)
+    << MakeSongItem("Bar", "Album b", 1, 1)
+    << MakeSongItem("Baz", "Album b", 1, 2));
+
+  QSortFilterProxyModel *proxy = playlist_.proxy();
+
+  proxy->setFilterFixedString("fo");
+  EXPECT_EQ(2, proxy->rowCount());
+
+  // Narrowed down, only the rows that matched "fo" are checked again.
+  proxy->setFilterFixedString("foob");
+  ASSERT_EQ(1, proxy->rowCount());
+  EXPECT_EQ("Foobar", proxy->index(0, Playlist::Column_Title).data().toString());
+
+  proxy->setFilterFixedString("foob album");
+  EXPECT_EQ(1, proxy->rowCount());
+
+  // Rows added while filtering are indexed too.
+  playlist_.InsertItems(PlaylistItemList() << MakeSongItem("FOOBAZ", "Album c", 1, 1));
+  EXPECT_EQ(2, proxy->rowCount());
+
+  playlist_.removeRows(1, 1);
+  ASSERT_EQ(1, proxy->rowCount());
+  EXPECT_EQ("FOOBAZ", proxy->index(0, Playlist::Column_Title).data().toString());
+
+  // Wider again, everything is checked.
+  proxy->setFilterFixedString("ba");
+  EXPECT_EQ(3, proxy->rowCount());
+
+  proxy->setFilterFixedString("album:\"album b\"");
+  EXPECT_EQ(2, proxy->rowCount());
+
+  proxy->setFilterFixedString("-album:\"album b\"");
+  EXPECT_EQ(2, proxy->rowCount());
+
+  proxy->setFilterFixedString(QString());
+  EXPECT_EQ(4, proxy->rowCount());
+
+}
+
 }  // namespace
@@ -0,0 +1,205 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QtDebug>
+
+#include "test_utils.h"
+
+#include "core/song.h"
+#include "playlist/playlistitem.h"
+#include "playlist/playlistbackend.h"
+#include "playlist/playlistsavestate.h"
+#include "playlist/songplaylistitem.h"
+
+namespace {
+
+class PlaylistSaveStateTest : public ::testing::Test {
+ protected:
+  static PlaylistItemPtr MakeItem(const int n) {
+    Song song;
+    song.Init(QString("Title %1").arg(n), "Artist", "Album", 123);
+    return PlaylistItemPtr(new SongPlaylistItem(song));
+  }
+
+  static PlaylistItemList MakeItems(const int count) {
+    PlaylistItemList items;
+    for (int i = 0; i < count; ++i) items << MakeItem(i);
+    return items;
+  }
+
+  // Applies the changes the way PlaylistBackend::SavePlaylist writes them to the playlist_items table.
+  void Apply(const PlaylistBackend::PlaylistChanges &changes) {
+    if (changes.rewrite) table_.clear();
+    for (const qint64 position : changes.removed) {
+      ASSERT_TRUE(table_.contains(position));
+      table_.remove(position);
+    }
+    for (const QPair<qint64, qint64> &moved : changes.moved) {
+      ASSERT_TRUE(table_.contains(moved.first));
+      table_.insert(-moved.second - 1, table_.take(moved.first));
+    }
+    while (!table_.isEmpty() && table_.firstKey() < 0) {
+      const qint64 position = table_.firstKey();
+      ASSERT_FALSE(table_.contains(-position - 1));
+      table_.insert(-position - 1, table_.take(position));
+    }
+    for (const QPair<qint64, PlaylistItemPtr> &added : changes.added) {
+      ASSERT_FALSE(table_.contains(added.first));
+      table_.insert(added.first, added.second);
+    }
+    for (const QPair<qint64, PlaylistItemPtr> &changed : changes.changed) {
+      ASSERT_EQ(changed.second, table_.value(changed.first));
+    }
+  }
+
+  void Save(const PlaylistItemList &items) {
+    state_.ItemsChanged();
+    changes_ = state_.Update(items);
+    Apply(changes_);
+    EXPECT_EQ(items, table_.values());
+  }
+
+  PlaylistSaveState state_;
+  PlaylistBackend::PlaylistChanges changes_;
+  QMap<qint64, PlaylistItemPtr> table_;
+};
+
+TEST_F(PlaylistSaveStateTest, FirstSaveRewrites) {
+
+  Save(MakeItems(3));
+  EXPECT_TRUE(changes_.rewrite);
+  EXPECT_EQ(3, changes_.added.count());
+
+}
+
+TEST_F(PlaylistSaveStateTest, NothingChanged) {
+
+  const PlaylistItemList items = MakeItems(3);
+  Save(items);
+
+  const PlaylistBackend::PlaylistChanges changes = state_.Update(items);
+  EXPECT_FALSE(changes.rewrite);
+  EXPECT_TRUE(changes.removed.isEmpty());
+  EXPECT_TRUE(changes.moved.isEmpty());
+  EXPECT_TRUE(changes.added.isEmpty());
+  EXPECT_TRUE(changes.changed.isEmpty());
+
+}
+
+TEST_F(PlaylistSaveStateTest, MoveOne) {
+
+  PlaylistItemList items = MakeItems(1000);
+  Save(items);
+
+  items.move(10, 900);
+  Save(items);
+  EXPECT_FALSE(changes_.rewrite);
+  EXPECT_EQ(1, changes_.moved.count());
+  EXPECT_TRUE(changes_.added.isEmpty());
+  EXPECT_TRUE(changes_.removed.isEmpty());
+
+}
+
+TEST_F(PlaylistSaveStateTest, InsertAndRemove) {
+
+  PlaylistItemList items = MakeItems(100);
+  Save(items);
+
+  items.insert(0, MakeItem(100));
+  items.insert(50, MakeItem(101));
+  items << MakeItem(102);
+  items.removeAt(20);
+  Save(items);
+  EXPECT_FALSE(changes_.rewrite);
+  EXPECT_EQ(3, changes_.added.count());
+  EXPECT_EQ(1, changes_.removed.count());
+  EXPECT_TRUE(changes_.moved.isEmpty());
+
+}
+
+TEST_F(PlaylistSaveStateTest, MetadataChanged) {
+
+  const PlaylistItemList items = MakeItems(10);
+  Save(items);
+
+  state_.MetadataChanged(items[4]);
+  Save(items);
+  ASSERT_EQ(1, changes_.changed.count());
+  EXPECT_EQ(items[4], changes_.changed[0].second);
+  EXPECT_TRUE(changes_.moved.isEmpty());
+
+}
+
+TEST_F(PlaylistSaveStateTest, RenumbersWhenFull) {
+
+  PlaylistItemList items = MakeItems(2);
+  Save(items);
+
+  // Keep inserting between the same two items until the positions run out.
+  for (int i = 0; i < 20; ++i) {
+    items.insert(1, MakeItem(100 + i));
+    Save(items);
+  }
+
+}
+
+TEST_F(PlaylistSaveStateTest, Reset) {
+
+  const PlaylistItemList items = MakeItems(5);
+  Save(items);
+
+  // Loaded from the database, with one item that couldn't be restored.
+  PlaylistSaveState state;
+  state.Reset(table_.values(), table_.keys());
+  PlaylistItemList loaded = items;
+  loaded.removeAt(2);
+  state.ItemsChanged();
+  const PlaylistBackend::PlaylistChanges changes = state.Update(loaded);
+  EXPECT_FALSE(changes.rewrite);
+  ASSERT_EQ(1, changes.removed.count());
+  EXPECT_EQ(table_.keys()[2], changes.removed[0]);
+  EXPECT_TRUE(changes.added.isEmpty());
+  EXPECT_TRUE(changes.moved.isEmpty());
+
+}
+
+TEST_F(PlaylistSaveStateTest, Shuffle) {
+
+  PlaylistItemList items = MakeItems(500);
+  Save(items);
+
+  for (int i = 0; i < 20; ++i) {
+    for (int j = 0; j < items.count(); ++j) {
+      qSwap(items[j], items[(j * 7919 + i * 31) % items.count()]);
+    }
+    if (i % 3 == 0) items.removeAt(i);
+    if (i % 4 == 0) items.insert(i * 5, MakeItem(1000 + i));
+    Save(items);
+  }
+
+}
+
+}  // namespace
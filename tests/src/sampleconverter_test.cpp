@@ -0,0 +1,166 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <random>
+#include <cmath>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QVector>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "engine/sampleconverter.h"
+
+namespace {
+
+class SampleConverterTest : public ::testing::Test {
+ protected:
+  // Random samples in the given format, the floats go a bit beyond full scale so the clipping is covered.
+  static QByteArray MakeSamples(const SampleConverter::Format format, const int count) {
+    std::mt19937 random(count);
+    QByteArray data(count * SampleConverter::BytesPerSample(format), 0);
+    if (format == SampleConverter::Format_F32LE) {
+      std::uniform_real_distribution<float> distribution(-1.25F, 1.25F);
+      float *samples = reinterpret_cast<float*>(data.data());
+      for (int i = 0; i < count; ++i) samples[i] = distribution(random);
+    }
+    else {
+      for (int i = 0; i < data.size(); ++i) data[i] = static_cast<char>(random() & 0xFF);
+    }
+    return data;
+  }
+
+  static QList<SampleConverter::Format> Formats() {
+    return QList<SampleConverter::Format>() << SampleConverter::Format_S24LE << SampleConverter::Format_S32LE << SampleConverter::Format_F32LE;
+  }
+};
+
+TEST_F(SampleConverterTest, FormatFromString) {
+
+  EXPECT_EQ(SampleConverter::Format_S16LE, SampleConverter::FormatFromString("S16LE"));
+  EXPECT_EQ(SampleConverter::Format_S24LE, SampleConverter::FormatFromString("S24LE"));
+  EXPECT_EQ(SampleConverter::Format_S32LE, SampleConverter::FormatFromString("S32LE"));
+  EXPECT_EQ(SampleConverter::Format_F32LE, SampleConverter::FormatFromString("F32LE"));
+  EXPECT_EQ(SampleConverter::Format_Unknown, SampleConverter::FormatFromString("U8"));
+
+  qint16 sample = 0;
+  EXPECT_FALSE(SampleConverter::Convert(SampleConverter::Format_S16LE, &sample, &sample, 1));
+
+}
+
+TEST_F(SampleConverterTest, ScalarValues) {
+
+  const qint32 s32[] = { 0x7FFFFFFF, -0x7FFFFFFF - 1, 0x00010000, -1 };
+  const float f32[] = { 1.0F, -1.0F, 0.5F, -0.00001F };
+  const quint8 s24[] = { 0xFF, 0xFF, 0x7F, 0x00, 0x00, 0x80, 0x00, 0x01, 0x00, 0xFF, 0xFF, 0xFF };
+
+  qint16 out[4];
+  ASSERT_TRUE(SampleConverter::Convert(SampleConverter::Instructions_Scalar, SampleConverter::Format_S32LE, s32, out, 4));
+  EXPECT_EQ(32767, out[0]);
+  EXPECT_EQ(-32768, out[1]);
+  EXPECT_EQ(1, out[2]);
+  EXPECT_EQ(-1, out[3]);
+
+  ASSERT_TRUE(SampleConverter::Convert(SampleConverter::Instructions_Scalar, SampleConverter::Format_F32LE, f32, out, 4));
+  EXPECT_EQ(32767, out[0]);
+  EXPECT_EQ(-32768, out[1]);
+  EXPECT_EQ(16384, out[2]);
+  EXPECT_EQ(0, out[3]);
+
+  ASSERT_TRUE(SampleConverter::Convert(SampleConverter::Instructions_Scalar, SampleConverter::Format_S24LE, s24, out, 4));
+  EXPECT_EQ(32767, out[0]);
+  EXPECT_EQ(-32768, out[1]);
+  EXPECT_EQ(1, out[2]);
+  EXPECT_EQ(-1, out[3]);
+
+}
+
+TEST_F(SampleConverterTest, InstructionsMatchScalar) {
+
+  // Counts around the vector widths, so the remainder loops are covered.
+  const QList<int> counts = QList<int>() << 0 << 1 << 7 << 8 << 9 << 15 << 16 << 17 << 31 << 33 << 1003;
+
+  for (const SampleConverter::Format format : Formats()) {
+    for (const int count : counts) {
+      const QByteArray samples = MakeSamples(format, count);
+
+      // One extra sample to catch writes past the end.
+      QVector<qint16> expected(count + 1, 0x1234);
+      ASSERT_TRUE(SampleConverter::Convert(SampleConverter::Instructions_Scalar, format, samples.constData(), expected.data(), count));
+
+      for (const SampleConverter::Instructions instructions : SampleConverter::SupportedInstructions()) {
+        QVector<qint16> result(count + 1, 0x1234);
+        ASSERT_TRUE(SampleConverter::Convert(instructions, format, samples.constData(), result.data(), count));
+        EXPECT_EQ(expected, result) << "format " << format << ", " << SampleConverter::InstructionsName(instructions).toStdString() << ", " << count << " samples";
+      }
+    }
+  }
+
+}
+
+TEST_F(SampleConverterTest, NonFiniteFloats) {
+
+  // Enough samples for the vector loops of every instruction set, with the special values in every lane.
+  const float values[] = { std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+  const int count = 32;
+  QVector<float> samples(count);
+  for (int i = 0; i < count; ++i) samples[i] = values[(i + i / 4) % 4];
+
+  QVector<qint16> expected(count);
+  ASSERT_TRUE(SampleConverter::Convert(SampleConverter::Instructions_Scalar, SampleConverter::Format_F32LE, samples.constData(), expected.data(), count));
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(std::isinf(samples[i]) && samples[i] < 0 ? -32768 : 32767, expected[i]) << "sample " << i;
+  }
+
+  for (const SampleConverter::Instructions instructions : SampleConverter::SupportedInstructions()) {
+    QVector<qint16> result(count);
+    ASSERT_TRUE(SampleConverter::Convert(instructions, SampleConverter::Format_F32LE, samples.constData(), result.data(), count));
+    EXPECT_EQ(expected, result) << SampleConverter::InstructionsName(instructions).toStdString();
+  }
+
+}
+
+TEST_F(SampleConverterTest, Benchmark) {
+
+  // One second of 192 kHz stereo.
+  const int kSampleCount = 192000 * 2;
+  const int kRepeat = 20;
+
+  QVector<qint16> result(kSampleCount);
+
+  for (const SampleConverter::Format format : Formats()) {
+    const QByteArray samples = MakeSamples(format, kSampleCount);
+    for (const SampleConverter::Instructions instructions : SampleConverter::SupportedInstructions()) {
+      QElapsedTimer timer;
+      timer.start();
+      for (int i = 0; i < kRepeat; ++i) {
+        SampleConverter::Convert(instructions, format, samples.constData(), result.data(), kSampleCount);
+      }
+      const double nsec_per_sample = static_cast<double>(timer.nsecsElapsed()) / (static_cast<double>(kRepeat) * kSampleCount);
+      qLog(Info) << "Format" << format << SampleConverter::InstructionsName(instructions) << nsec_per_sample << "ns per sample";
+    }
+  }
+
+}
+
+}  // namespace
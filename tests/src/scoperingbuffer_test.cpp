@@ -0,0 +1,152 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+
+#include "core/timeconstants.h"
+#include "engine/scoperingbuffer.h"
+
+namespace {
+
+class ScopeRingBufferTest : public ::testing::Test {
+ protected:
+  // Stereo frames where the left sample is the frame number and the right sample its inverse.
+  static std::vector<qint16> MakeFrames(const int first, const int count) {
+    std::vector<qint16> samples(count * 2);
+    for (int i = 0; i < count; ++i) {
+      samples[i * 2] = static_cast<qint16>(first + i);
+      samples[i * 2 + 1] = static_cast<qint16>(~(first + i));
+    }
+    return samples;
+  }
+};
+
+TEST_F(ScopeRingBufferTest, Empty) {
+
+  ScopeRingBuffer buffer(1024);
+  qint16 out[64 * 2];
+  EXPECT_FALSE(buffer.Read(0, out, 64));
+
+  const std::vector<qint16> samples = MakeFrames(0, 32);
+  buffer.Write(samples.data(), 32, 2, 44100, 0);
+  EXPECT_FALSE(buffer.Read(0, out, 64));
+
+}
+
+TEST_F(ScopeRingBufferTest, TimestampAligned) {
+
+  // One frame per millisecond makes the expected frames easy to work out.
+  ScopeRingBuffer buffer(1024);
+  for (int i = 0; i < 10; ++i) {
+    const std::vector<qint16> samples = MakeFrames(i * 100, 100);
+    buffer.Write(samples.data(), 100, 2, 1000, i * 100 * kNsecPerMsec);
+  }
+
+  qint16 out[64 * 2];
+  ASSERT_TRUE(buffer.Read(800 * kNsecPerMsec, out, 64));
+  EXPECT_EQ(800 - 32, out[0]);
+  EXPECT_EQ(static_cast<qint16>(~(800 - 32)), out[1]);
+  EXPECT_EQ(800 + 31, out[63 * 2]);
+
+  // Positions outside the buffered frames give the newest frames.
+  ASSERT_TRUE(buffer.Read(100000 * kNsecPerMsec, out, 64));
+  EXPECT_EQ(1000 - 64, out[0]);
+  ASSERT_TRUE(buffer.Read(-1, out, 64));
+  EXPECT_EQ(1000 - 64, out[0]);
+
+}
+
+TEST_F(ScopeRingBufferTest, WrapAround) {
+
+  ScopeRingBuffer buffer(256);
+  EXPECT_EQ(256, buffer.capacity());
+
+  const std::vector<qint16> samples = MakeFrames(0, 1000);
+  buffer.Write(samples.data(), 300, 2, 1000, 0);
+  buffer.Write(samples.data() + 300 * 2, 700, 2, 1000, 300 * kNsecPerMsec);
+
+  qint16 out[100 * 2];
+  ASSERT_TRUE(buffer.Read(-1, out, 100));
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(900 + i, out[i * 2]);
+  }
+
+}
+
+TEST_F(ScopeRingBufferTest, ChannelLayouts) {
+
+  ScopeRingBuffer buffer(256);
+  qint16 out[4 * 2];
+
+  const qint16 mono[] = { 1, 2, 3, 4 };
+  buffer.Write(mono, 4, 1, 44100, 0);
+  ASSERT_TRUE(buffer.Read(-1, out, 4));
+  EXPECT_EQ(1, out[0]);
+  EXPECT_EQ(1, out[1]);
+  EXPECT_EQ(4, out[6]);
+  EXPECT_EQ(4, out[7]);
+
+  // Only the front channels are kept.
+  const qint16 surround[] = { 1, 2, 9, 9, 9, 9, 3, 4, 9, 9, 9, 9, 5, 6, 9, 9, 9, 9, 7, 8, 9, 9, 9, 9 };
+  buffer.Write(surround, 4, 6, 44100, 0);
+  ASSERT_TRUE(buffer.Read(-1, out, 4));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(i + 1, out[i]);
+  }
+
+}
+
+TEST_F(ScopeRingBufferTest, ConcurrentReads) {
+
+  ScopeRingBuffer buffer(4096);
+  std::atomic<bool> finished(false);
+
+  std::thread writer([&buffer, &finished]() {
+    for (int i = 0; i < 20000; ++i) {
+      const std::vector<qint16> samples = MakeFrames(i * 1024, 1024);
+      buffer.Write(samples.data(), 1024, 2, 44100, i * 1024 * kNsecPerSec / 44100);
+    }
+    finished = true;
+  });
+
+  // Every window that is returned has to be made of consecutive frames from the writer.
+  int reads = 0;
+  qint16 out[512 * 2];
+  while (!finished) {
+    if (!buffer.Read(-1, out, 512)) continue;
+    ++reads;
+    for (int i = 1; i < 512; ++i) {
+      ASSERT_EQ(static_cast<qint16>(out[(i - 1) * 2] + 1), out[i * 2]);
+      ASSERT_EQ(static_cast<qint16>(~out[i * 2]), out[i * 2 + 1]);
+    }
+  }
+  writer.join();
+
+  if (buffer.Read(-1, out, 512)) ++reads;
+  EXPECT_GT(reads, 0);
+
+}
+
+}  // namespace
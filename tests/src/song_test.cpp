@@ -0,0 +1,328 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2020, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QtNumeric>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QUrl>
+#include <QtDebug>
+
+#include "test_utils.h"
+
+#include "core/timeconstants.h"
+#include "core/song.h"
+#include "core/stringpool.h"
+#include "core/database.h"
+#include "core/logging.h"
+#include "collection/collection.h"
+#include "collection/collectionbackend.h"
+#include "collection/sqlrow.h"
+
+namespace {
+
+#define tostr(n) (q.value(n).isNull() ? QString() : q.value(n).toString())
+#define toint(n) (q.value(n).isNull() ? -1 : q.value(n).toInt())
+#define tolonglong(n) (q.value(n).isNull() ? -1 : q.value(n).toLongLong())
+#define tofloat(n) (q.value(n).isNull() ? -1 : q.value(n).toDouble())
+#define togain(n) (q.value(n).isNull() ? qQNaN() : q.value(n).toFloat())
+
+QUrl ArtUrl(const QString &art) {
+  if (art.contains(QRegularExpression("..+:.*"))) return QUrl::fromEncoded(art.toUtf8());
+  return QUrl::fromLocalFile(art);
+}
+
+// The way Song::InitFromQuery used to read a row, comparing the name of every column against the column list.
+// Kept to check and benchmark the setter table against.
+void InitFromQueryByName(Song *song, const SqlRow &q, const int col = 0) {
+
+  int x = col;
+  song->set_id(toint(col));
+
+  for (int i = 0 ; i < Song::kColumns.size(); i++) {
+    x++;
+
+    if (x >= q.columns_.size()) break;
+
+    if (Song::kColumns.value(i) == "title") song->set_title(tostr(x));
+    else if (Song::kColumns.value(i) == "album") song->set_album(tostr(x));
+    else if (Song::kColumns.value(i) == "artist") song->set_artist(tostr(x));
+    else if (Song::kColumns.value(i) == "albumartist") song->set_albumartist(tostr(x));
+    else if (Song::kColumns.value(i) == "track") song->set_track(toint(x));
+    else if (Song::kColumns.value(i) == "disc") song->set_disc(toint(x));
+    else if (Song::kColumns.value(i) == "year") song->set_year(toint(x));
+    else if (Song::kColumns.value(i) == "originalyear") song->set_originalyear(toint(x));
+    else if (Song::kColumns.value(i) == "genre") song->set_genre(tostr(x));
+    else if (Song::kColumns.value(i) == "compilation") song->set_compilation(q.value(x).toBool());
+    else if (Song::kColumns.value(i) == "composer") song->set_composer(tostr(x));
+    else if (Song::kColumns.value(i) == "performer") song->set_performer(tostr(x));
+    else if (Song::kColumns.value(i) == "grouping") song->set_grouping(tostr(x));
+    else if (Song::kColumns.value(i) == "comment") song->set_comment(tostr(x));
+    else if (Song::kColumns.value(i) == "lyrics") song->set_lyrics(tostr(x));
+    else if (Song::kColumns.value(i) == "artist_id") song->set_artist_id(tostr(x));
+    else if (Song::kColumns.value(i) == "album_id") song->set_album_id(tostr(x));
+    else if (Song::kColumns.value(i) == "song_id") song->set_song_id(tostr(x));
+    else if (Song::kColumns.value(i) == "beginning") song->set_beginning_nanosec(q.value(x).isNull() ? 0 : q.value(x).toLongLong());
+    else if (Song::kColumns.value(i) == "length") song->set_length_nanosec(tolonglong(x));
+    else if (Song::kColumns.value(i) == "bitrate") song->set_bitrate(toint(x));
+    else if (Song::kColumns.value(i) == "samplerate") song->set_samplerate(toint(x));
+    else if (Song::kColumns.value(i) == "bitdepth") song->set_bitdepth(toint(x));
+    else if (Song::kColumns.value(i) == "source") song->set_source(Song::Source(q.value(x).toInt()));
+    else if (Song::kColumns.value(i) == "directory_id") song->set_directory_id(toint(x));
+    else if (Song::kColumns.value(i) == "url") {
+      song->set_url(QUrl::fromEncoded(tostr(x).toUtf8()));
+      song->set_basefilename(QFileInfo(song->url().toLocalFile()).fileName());
+    }
+    else if (Song::kColumns.value(i) == "filetype") song->set_filetype(Song::FileType(q.value(x).toInt()));
+    else if (Song::kColumns.value(i) == "filesize") song->set_filesize(toint(x));
+    else if (Song::kColumns.value(i) == "mtime") song->set_mtime(tolonglong(x));
+    else if (Song::kColumns.value(i) == "ctime") song->set_ctime(tolonglong(x));
+    else if (Song::kColumns.value(i) == "unavailable") song->set_unavailable(q.value(x).toBool());
+    else if (Song::kColumns.value(i) == "playcount") song->set_playcount(q.value(x).isNull() ? 0 : q.value(x).toInt());
+    else if (Song::kColumns.value(i) == "skipcount") song->set_skipcount(q.value(x).isNull() ? 0 : q.value(x).toInt());
+    else if (Song::kColumns.value(i) == "lastplayed") song->set_lastplayed(toint(x));
+    else if (Song::kColumns.value(i) == "compilation_detected") song->set_compilation_detected(q.value(x).toBool());
+    else if (Song::kColumns.value(i) == "compilation_on") song->set_compilation_on(q.value(x).toBool());
+    else if (Song::kColumns.value(i) == "compilation_off") song->set_compilation_off(q.value(x).toBool());
+    else if (Song::kColumns.value(i) == "compilation_effective") {}
+    else if (Song::kColumns.value(i) == "art_automatic") song->set_art_automatic(ArtUrl(tostr(x)));
+    else if (Song::kColumns.value(i) == "art_manual") song->set_art_manual(ArtUrl(tostr(x)));
+    else if (Song::kColumns.value(i) == "effective_albumartist") {}
+    else if (Song::kColumns.value(i) == "effective_originalyear") {}
+    else if (Song::kColumns.value(i) == "cue_path") song->set_cue_path(tostr(x));
+    else if (Song::kColumns.value(i) == "rating") song->set_rating(tofloat(x));
+    else if (Song::kColumns.value(i) == "replaygain_track_gain") song->set_replaygain(togain(x), song->replaygain_track_peak(), song->replaygain_album_gain(), song->replaygain_album_peak());
+    else if (Song::kColumns.value(i) == "replaygain_track_peak") song->set_replaygain(song->replaygain_track_gain(), togain(x), song->replaygain_album_gain(), song->replaygain_album_peak());
+    else if (Song::kColumns.value(i) == "replaygain_album_gain") song->set_replaygain(song->replaygain_track_gain(), song->replaygain_track_peak(), togain(x), song->replaygain_album_peak());
+    else if (Song::kColumns.value(i) == "replaygain_album_peak") song->set_replaygain(song->replaygain_track_gain(), song->replaygain_track_peak(), song->replaygain_album_gain(), togain(x));
+  }
+
+  song->set_valid(true);
+
+}
+
+#undef tostr
+#undef toint
+#undef tolonglong
+#undef tofloat
+#undef togain
+
+class SongInitFromQueryTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new CollectionBackend);
+    backend_->Init(database_.get(), Song::Source_Collection, SCollection::kSongsTable, SCollection::kDirsTable, SCollection::kSubdirsTable, SCollection::kFtsTable);
+    backend_->AddDirectory("/tmp");
+  }
+
+  void AddSongs(const int count) {
+    SongList songs;
+    for (int i = 0; i < count; ++i) {
+      Song song(Song::Source_Collection);
+      song.set_directory_id(1);
+      song.set_title(QString("Title %1").arg(i));
+      song.set_artist(QString("Artist %1").arg(i % 100));
+      song.set_album(QString("Album %1").arg(i % 1000));
+      song.set_genre("Genre");
+      song.set_track(i % 20 + 1);
+      song.set_year(2000 + i % 20);
+      song.set_length_nanosec(180 * kNsecPerSec);
+      song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+      song.set_mtime(1);
+      song.set_ctime(1);
+      song.set_filesize(1);
+      songs << song;
+    }
+    backend_->AddOrUpdateSongs(songs);
+  }
+
+  SqlRowList SelectAll() {
+    QSqlDatabase db(database_->Connect());
+    QSqlQuery q(db);
+    q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1").arg(SCollection::kSongsTable));
+    q.exec();
+    SqlRowList rows;
+    while (q.next()) rows << SqlRow(q);
+    return rows;
+  }
+
+  std::shared_ptr<Database> database_;
+  std::unique_ptr<CollectionBackend> backend_;
+};
+
+TEST_F(SongInitFromQueryTest, RoundTrip) {
+
+  AddSongs(1);
+
+  SqlRowList rows = SelectAll();
+  ASSERT_EQ(1, rows.count());
+
+  Song song(Song::Source_Collection);
+  song.InitFromQuery(rows[0], true);
+
+  EXPECT_TRUE(song.is_valid());
+  EXPECT_EQ(1, song.id());
+  EXPECT_EQ(1, song.directory_id());
+  EXPECT_EQ("Title 0", song.title());
+  EXPECT_EQ("Artist 0", song.artist());
+  EXPECT_EQ("Album 0", song.album());
+  EXPECT_EQ("Genre", song.genre());
+  EXPECT_EQ(1, song.track());
+  EXPECT_EQ(2000, song.year());
+  EXPECT_EQ(180 * kNsecPerSec, song.length_nanosec());
+  EXPECT_EQ(QUrl::fromLocalFile("/tmp/song0.flac"), song.url());
+  EXPECT_EQ("song0.flac", song.basefilename());
+  EXPECT_EQ(Song::Source_Collection, song.source());
+
+}
+
+TEST_F(SongInitFromQueryTest, MatchesColumnNameLookup) {
+
+  AddSongs(10);
+  SqlRowList rows = SelectAll();
+  ASSERT_EQ(10, rows.count());
+
+  for (const SqlRow &row : rows) {
+    Song song(Song::Source_Collection);
+    song.InitFromQuery(row, true);
+    Song reference(Song::Source_Collection);
+    InitFromQueryByName(&reference, row);
+
+    EXPECT_EQ(reference.id(), song.id());
+    EXPECT_EQ(reference.title(), song.title());
+    EXPECT_EQ(reference.artist(), song.artist());
+    EXPECT_EQ(reference.album(), song.album());
+    EXPECT_EQ(reference.genre(), song.genre());
+    EXPECT_EQ(reference.track(), song.track());
+    EXPECT_EQ(reference.year(), song.year());
+    EXPECT_EQ(reference.length_nanosec(), song.length_nanosec());
+    EXPECT_EQ(reference.url(), song.url());
+    EXPECT_EQ(reference.basefilename(), song.basefilename());
+    EXPECT_EQ(reference.mtime(), song.mtime());
+  }
+
+}
+
+TEST_F(SongInitFromQueryTest, Benchmark) {
+
+  // Enough rows to see the difference, more only when asked for.
+  int song_count = 1000;
+  int repeat = 1;
+  if (qEnvironmentVariableIsSet("STRAWBERRY_LARGE_BENCHMARKS")) {
+    song_count = 5000;
+    repeat = 10;
+  }
+
+  AddSongs(song_count);
+  SqlRowList rows = SelectAll();
+  ASSERT_EQ(song_count, rows.count());
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int r = 0; r < repeat; ++r) {
+    for (const SqlRow &row : rows) {
+      Song song(Song::Source_Collection);
+      InitFromQueryByName(&song, row);
+      ASSERT_TRUE(song.is_valid());
+    }
+  }
+  const qint64 by_name_nsec = timer.nsecsElapsed();
+
+  timer.restart();
+  for (int r = 0; r < repeat; ++r) {
+    for (const SqlRow &row : rows) {
+      Song song(Song::Source_Collection);
+      song.InitFromQuery(row, true);
+      ASSERT_TRUE(song.is_valid());
+    }
+  }
+  const qint64 setters_nsec = timer.nsecsElapsed();
+
+  qLog(Info) << "InitFromQuery for" << song_count * repeat << "rows:" << by_name_nsec / (repeat * song_count) << "ns per row looking up column names," << setters_nsec / (repeat * song_count) << "ns per row with the setter table";
+
+}
+
+TEST_F(SongInitFromQueryTest, InternedStrings) {
+
+  AddSongs(2);
+  SongList songs = backend_->GetAllSongs();
+  ASSERT_EQ(2, songs.count());
+
+  // Same genre, different artists.
+  EXPECT_EQ(songs[0].genre().constData(), songs[1].genre().constData());
+  EXPECT_NE(songs[0].artist().constData(), songs[1].artist().constData());
+
+  Song song(Song::Source_Collection);
+  song.set_artist(QString("Artist %1").arg(1));
+  EXPECT_EQ(songs[1].artist().constData(), song.artist().constData());
+
+  // Empty strings stay empty but not null.
+  song.set_album(QString(""));
+  EXPECT_FALSE(song.album().isNull());
+
+}
+
+TEST_F(SongInitFromQueryTest, MemoryReport) {
+
+  const int kSongCount = 5000;
+
+  AddSongs(kSongCount);
+  SongList songs = backend_->GetAllSongs();
+  ASSERT_EQ(kSongCount, songs.count());
+
+  // Without interning every song had its own copy of each string.
+  qint64 copied_bytes = 0;
+  qint64 interned_bytes = 0;
+  QSet<const QChar*> seen;
+  for (const Song &song : songs) {
+    const QStringList fields = QStringList() << song.album() << song.album_sortable() << song.artist() << song.artist_sortable() << song.albumartist() << song.albumartist_sortable() << song.genre() << song.composer() << song.performer() << song.grouping();
+    for (const QString &field : fields) {
+      const qint64 bytes = field.size() * static_cast<qint64>(sizeof(QChar));
+      copied_bytes += bytes;
+      if (!field.isEmpty() && !seen.contains(field.constData())) {
+        seen.insert(field.constData());
+        interned_bytes += bytes;
+      }
+    }
+  }
+  EXPECT_LT(interned_bytes, copied_bytes);
+
+  // What each song costs: its private data, plus its share of the text of the interned fields.
+  const StringPool::Statistics statistics = StringPool::statistics();
+  qLog(Info) << "Song::Private:" << Song::PrivateSize() << "bytes";
+  qLog(Info) << "Per song with copied text:" << Song::PrivateSize() + copied_bytes / kSongCount << "bytes, with interned text:" << Song::PrivateSize() + interned_bytes / kSongCount << "bytes";
+  qLog(Info) << "String pool:" << statistics.strings << "strings," << statistics.bytes << "bytes";
+
+  songs.clear();
+  StringPool::Prune();
+  EXPECT_LT(StringPool::statistics().strings, statistics.strings);
+
+}
+
+}  // namespace